@@ -0,0 +1,321 @@
+// blitBench - times the palette blitters and scale filters of
+// src/drivers/common/vidblit.cpp and checks that every SIMD level draws
+// the same picture as the plain C code.
+//
+// Build with "make", run "./blitBench [options] [frames.raw]".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "../src/fceu.h"
+#include "../src/palette.h"
+#include "../src/drivers/common/vidblit.h"
+#include "../src/drivers/common/scalebit.h"
+
+#define FRAME_W     256
+#define FRAME_H     240
+#define FRAME_SIZE  (FRAME_W * FRAME_H)
+#define MAX_SCALE   9
+#define DEST_PITCH  (602 * 4 * MAX_SCALE)
+
+// what vidblit.cpp links against from the emulator
+u8 *XBuf = NULL;
+u8 *XBackBuf = NULL;
+u8 *XDBuf = NULL;
+u8 *XDBackBuf = NULL;
+pal *palo = NULL;
+FCEUGI *GameInfo = NULL;
+
+extern uint8 burst_phase;
+
+FCEUGI::FCEUGI() {}
+FCEUGI::~FCEUGI() {}
+
+void *FCEU_dmalloc(uint32 size)
+{
+	void *ret = calloc(1, size);
+
+	if (ret == NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
+	return ret;
+}
+
+struct filterInfo
+{
+	const char *name;
+	int specfilt;
+	int scales[4];   // xscale/yscale values passed to Blit8ToHigh, 0 terminated.
+	                 // scale2x/scale3x only draw at their own scale.
+};
+
+static const filterInfo filters[] =
+{
+	{ "none",      0, { 1, 2, 3, 4 } },
+	{ "hq2x",      1, { 1, 0 } },
+	{ "scale2x",   2, { 2, 0 } },
+	{ "ntsc",      3, { 2, 0 } },
+	{ "hq3x",      4, { 1, 0 } },
+	{ "scale3x",   5, { 3, 0 } },
+	{ "prescale2", 6, { 2, 0 } },
+	{ "prescale3", 7, { 3, 0 } },
+	{ "prescale4", 8, { 4, 0 } },
+	{ "pal",       9, { 3, 0 } },
+};
+
+static const char *simdName(int level)
+{
+	switch (level)
+	{
+		case SCALE_SIMD_NONE:  return "C";
+		case SCALE_SIMD_SSE2:  return "SSE2";
+		case SCALE_SIMD_SSSE3: return "SSSE3";
+		case SCALE_SIMD_AVX2:  return "AVX2";
+	}
+	return "?";
+}
+
+// a scrolling tiled playfield with a few sprites and some emphasis lines, for
+// when no recorded frames are given
+static void makeFrames(std::vector<u8> &frames, int count)
+{
+	frames.resize((size_t)count * FRAME_SIZE * 2);
+
+	for (int f = 0; f < count; f++)
+	{
+		u8 *pix = &frames[(size_t)f * FRAME_SIZE * 2];
+		u8 *deemph = pix + FRAME_SIZE;
+
+		for (int y = 0; y < FRAME_H; y++)
+		{
+			for (int x = 0; x < FRAME_W; x++)
+			{
+				int sx = x + f * 2;
+				int tile = ((sx >> 4) * 7 + (y >> 4) * 13) & 15;
+				int c = ((tile * 5 + ((sx ^ y) & 8 ? 1 : 0) + ((sx >> 2) & y & 1)) & 3) + (tile & 3) * 16;
+
+				// sprites
+				if (((x - f * 3) & 63) < 16 && ((y + f) & 127) < 24)
+				{
+					c = 0x16 + ((x >> 2) & 1) * 0x10;
+				}
+				pix[y * FRAME_W + x] = (u8)c;
+				deemph[y * FRAME_W + x] = (y >= 200) ? (u8)((y >> 3) & 7) : 0;
+			}
+		}
+	}
+}
+
+static bool loadFrames(const char *path, std::vector<u8> &frames)
+{
+	FILE *fp = fopen(path, "rb");
+	long size;
+
+	if (fp == NULL)
+	{
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	size -= size % (FRAME_SIZE * 2);
+
+	if (size <= 0)
+	{
+		fclose(fp);
+		return false;
+	}
+	frames.resize(size);
+
+	if (fread(&frames[0], 1, size, fp) != (size_t)size)
+	{
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+	return true;
+}
+
+static void setPalette(void)
+{
+	static pal deemphPal[512];
+	uint8 basePal[256 * 4];
+
+	// any colors do, as long as they differ
+	for (int i = 0; i < 256; i++)
+	{
+		basePal[i * 4 + 0] = (uint8)(i * 37 + 11);
+		basePal[i * 4 + 1] = (uint8)(i * 91 + 53);
+		basePal[i * 4 + 2] = (uint8)(i * 13 + 197);
+		basePal[i * 4 + 3] = 0;
+	}
+	for (int i = 0; i < 512; i++)
+	{
+		deemphPal[i].r = (uint8)(i * 29 + 7);
+		deemphPal[i].g = (uint8)(i * 71 + 3);
+		deemphPal[i].b = (uint8)(i * 17 + 101);
+	}
+	palo = deemphPal;
+
+	SetPaletteBlitToHigh(basePal);
+}
+
+static void usage(void)
+{
+	printf("usage: blitBench [-f filter] [-n frames] [-r repeat] [frames.raw]\n");
+	printf("  -f filter  only run the named filter:");
+	for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); i++)
+	{
+		printf(" %s", filters[i].name);
+	}
+	printf("\n");
+	printf("  -n frames  number of generated frames when no file is given (default 60)\n");
+	printf("  -r repeat  passes over the frames for each measurement (default 5)\n");
+	printf("  frames.raw recorded frames, see README\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *onlyFilter = NULL, *framesPath = NULL;
+	int numGenFrames = 60, repeat = 5, errors = 0, numFrames;
+	int bestLevel = scale_cpu_simd();
+	std::vector<u8> frames, frameBuf(FRAME_W * 256 * 2);
+	std::vector<u8> refOut((size_t)DEST_PITCH * FRAME_H * MAX_SCALE);
+	std::vector<u8> out(refOut.size());
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-f") && (i + 1 < argc))
+		{
+			onlyFilter = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+		{
+			numGenFrames = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-r") && (i + 1 < argc))
+		{
+			repeat = atoi(argv[++i]);
+		}
+		else if (argv[i][0] == '-')
+		{
+			usage();
+			return 1;
+		}
+		else
+		{
+			framesPath = argv[i];
+		}
+	}
+
+	if (framesPath)
+	{
+		if (!loadFrames(framesPath, frames))
+		{
+			fprintf(stderr, "Failed to read frames from %s\n", framesPath);
+			return 1;
+		}
+	}
+	else
+	{
+		makeFrames(frames, numGenFrames > 0 ? numGenFrames : 1);
+	}
+	numFrames = frames.size() / (FRAME_SIZE * 2);
+
+	if (repeat < 1)
+	{
+		repeat = 1;
+	}
+
+	GameInfo = new FCEUGI();
+	GameInfo->type = GIT_CART;
+
+	printf("%d frames, %d passes, best SIMD level %s\n\n", numFrames, repeat, simdName(bestLevel));
+	printf("%-10s %5s  %-6s %7s %10s %10s\n", "filter", "scale", "simd", "threads", "ms/frame", "frames/s");
+
+	for (size_t f = 0; f < sizeof(filters) / sizeof(filters[0]); f++)
+	{
+		if (onlyFilter && strcmp(onlyFilter, filters[f].name))
+		{
+			continue;
+		}
+		for (int s = 0; (s < 4) && filters[f].scales[s]; s++)
+		{
+			int scale = filters[f].scales[s];
+			// the ntsc filter is run on one thread and on the largest thread pool
+			int numThreadRuns = (filters[f].specfilt == 3) ? 2 : 1;
+
+			for (int run = 0; run < (bestLevel + 1) * numThreadRuns; run++)
+			{
+				int level = run / numThreadRuns;
+				int threaded = run % numThreadRuns;
+				const char *result = "";
+				double dt;
+
+				// levels without a kernel of their own in this build fall back to a lower one
+				if ((level != SCALE_SIMD_NONE) && (level != bestLevel) && (level != SCALE_SIMD_SSE2))
+				{
+					continue;
+				}
+				SetBlitSimdLevel(level);
+				SetNtscBlitThreads(threaded ? NTSC_MAX_THREADS : 1);
+
+				if (!InitBlitToHigh(4, 0xFF0000, 0x00FF00, 0x0000FF, 0, filters[f].specfilt, 0))
+				{
+					printf("%-10s %4dx  failed to initialize\n", filters[f].name, scale);
+					break;
+				}
+				setPalette();
+
+				memset(&out[0], 0, out.size());
+				burst_phase = 0;   // the ntsc filter flips it every frame
+
+				auto t0 = std::chrono::steady_clock::now();
+
+				for (int r = 0; r < repeat; r++)
+				{
+					for (int i = 0; i < numFrames; i++)
+					{
+						// laid out like the emulator's 256x256 buffers, the blitters
+						// find the emphasis bits from the XBuf offset
+						XBuf  = &frameBuf[0];
+						XDBuf = &frameBuf[FRAME_W * 256];
+						memcpy(XBuf, &frames[(size_t)i * FRAME_SIZE * 2], FRAME_SIZE);
+						memcpy(XDBuf, &frames[(size_t)i * FRAME_SIZE * 2 + FRAME_SIZE], FRAME_SIZE);
+
+						Blit8ToHigh(XBuf, &out[0], FRAME_W, FRAME_H, DEST_PITCH, scale, scale);
+					}
+				}
+				auto t1 = std::chrono::steady_clock::now();
+
+				dt = std::chrono::duration<double>(t1 - t0).count() / (numFrames * repeat);
+
+				// the last frame drawn is compared against the single threaded C code's
+				if (run == 0)
+				{
+					refOut = out;
+				}
+				else if (memcmp(&out[0], &refOut[0], out.size()))
+				{
+					result = "  MISMATCH";
+					errors++;
+				}
+				int threads = (filters[f].specfilt == 3) ? GetNtscBlitThreads() : 1;
+
+				KillBlitToHigh();
+
+				printf("%-10s %4dx  %-6s %7d %10.3f %10.0f%s\n", filters[f].name, scale, simdName(level),
+					threads, dt * 1e3, 1.0 / dt, result);
+			}
+		}
+	}
+	delete GameInfo; GameInfo = NULL;
+
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,356 @@
+// coreBench - times parts of the emulation core on a headless emulator.
+//
+//   cpu    instructions per second of the hook-free 6502 loop against the
+//          hooked one the debugger runs on
+//   state  fast savestates (FCEUSS_SaveFast/FCEUSS_LoadFast) against the
+//          uncompressed regular savestate they replace for rollback
+//
+// Build with "make", run "./coreBench [options] [rom ...]".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+#include "../src/types.h"
+#include "../src/driver.h"
+#include "../src/fceu.h"
+#include "../src/state.h"
+#include "../src/debug.h"
+#include "../src/emufile.h"
+
+#define SYNTH_ROM_NAME  "coreBench_synth.nes"
+
+static uint32 padState = 0;
+
+// A 16K NROM image whose program keeps the CPU busy with a mix of
+// addressing modes, a subroutine per iteration and an NMI every frame,
+// with the PPU rendering. Used when no ROM is given.
+static const uint8 synthProgram[] =
+{
+	0x78,                // C000 reset: SEI
+	0xD8,                // C001        CLD
+	0xA2, 0xFF,          // C002        LDX #$FF
+	0x9A,                // C004        TXS
+	0xA9, 0x80,          // C005        LDA #$80
+	0x8D, 0x00, 0x20,    // C007        STA $2000
+	0xA9, 0x1E,          // C00A        LDA #$1E
+	0x8D, 0x01, 0x20,    // C00C        STA $2001
+	0xA2, 0x00,          // C00F main:  LDX #0
+	0xBD, 0x00, 0x02,    // C011 loop:  LDA $0200,X
+	0x18,                // C014        CLC
+	0x69, 0x03,          // C015        ADC #3
+	0x9D, 0x00, 0x02,    // C017        STA $0200,X
+	0x45, 0x00,          // C01A        EOR $00
+	0x85, 0x00,          // C01C        STA $00
+	0x20, 0x29, 0xC0,    // C01E        JSR sub
+	0xE8,                // C021        INX
+	0xD0, 0xED,          // C022        BNE loop
+	0xE6, 0x01,          // C024        INC $01
+	0x4C, 0x0F, 0xC0,    // C026        JMP main
+	0xA0, 0x04,          // C029 sub:   LDY #4
+	0xB1, 0x02,          // C02B sl:    LDA ($02),Y
+	0x0A,                // C02D        ASL A
+	0x66, 0x04,          // C02E        ROR $04
+	0x88,                // C030        DEY
+	0x10, 0xF8,          // C031        BPL sl
+	0x60,                // C033        RTS
+	0x48,                // C034 nmi:   PHA
+	0xAD, 0x02, 0x20,    // C035        LDA $2002
+	0xE6, 0x05,          // C038        INC $05
+	0x68,                // C03A        PLA
+	0x40,                // C03B        RTI
+	0x40,                // C03C irq:   RTI
+};
+
+static bool writeSynthRom(const char *path)
+{
+	std::vector<uint8> rom(16 + 0x4000 + 0x2000, 0);
+	uint8 *prg = &rom[16];
+	FILE *fp;
+
+	memcpy(&rom[0], "NES\x1a", 4);
+	rom[4] = 1;   // 16K PRG
+	rom[5] = 1;   // 8K CHR
+
+	memcpy(prg, synthProgram, sizeof(synthProgram));
+
+	// NMI, reset and IRQ vectors
+	prg[0x3FFA] = 0x34; prg[0x3FFB] = 0xC0;
+	prg[0x3FFC] = 0x00; prg[0x3FFD] = 0xC0;
+	prg[0x3FFE] = 0x3C; prg[0x3FFF] = 0xC0;
+
+	fp = fopen(path, "wb");
+
+	if (fp == NULL)
+	{
+		return false;
+	}
+	if (fwrite(&rom[0], 1, rom.size(), fp) != rom.size())
+	{
+		fclose(fp);
+		return false;
+	}
+	fclose(fp);
+	return true;
+}
+
+static void runFrames(int numFrames)
+{
+	uint8 *gfx;
+	int32 *sound, ssize;
+
+	for (int i = 0; i < numFrames; i++)
+	{
+		// some input so games don't sit on their title screen
+		padState = ((i / 30) & 1) ? 0x08 : 0x01;
+
+		FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+	}
+}
+
+struct timing
+{
+	double sum;
+	double min;
+	int count;
+
+	timing() : sum(0), min(1e30), count(0) {}
+
+	void add(double dt)
+	{
+		sum += dt;
+		count++;
+
+		if (dt < min)
+		{
+			min = dt;
+		}
+	}
+	double avg(void) const
+	{
+		return count ? sum / count : 0;
+	}
+};
+
+static double now(void)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs the same frames from the same state without hooks and with one
+// execute breakpoint that is never hit, which is enough for X6502_Run to
+// take the hooked loop. Both have to end in the same state.
+static int benchCpu(const char *name, int numFrames)
+{
+	std::vector<uint8> start(FCEUSS_FastStateSize()), end[2];
+	uint64 instructions[2];
+	double dt[2];
+	int errors = 0;
+
+	FCEUSS_SaveFast(&start[0]);
+
+	for (int hooked = 0; hooked < 2; hooked++)
+	{
+		uint64 i0;
+		double t0;
+
+		FCEUSS_LoadFast(&start[0]);
+
+		if (hooked)
+		{
+			NewBreak("coreBench", 0x0000, -1, WP_X, "", 0, true);
+			numWPs = 1;
+		}
+		i0 = total_instructions;
+		t0 = now();
+
+		runFrames(numFrames);
+
+		dt[hooked] = now() - t0;
+		instructions[hooked] = total_instructions - i0;
+
+		numWPs = 0;
+
+		if (FCEUI_EmulationPaused())
+		{
+			// the game ran code at $0000, the timing is no good
+			FCEUI_SetEmulationPaused(0);
+			errors++;
+		}
+		end[hooked].resize(start.size());
+		FCEUSS_SaveFast(&end[hooked][0]);
+	}
+	if ((instructions[0] != instructions[1]) || (end[0] != end[1]))
+	{
+		errors++;
+	}
+
+	printf("%-24s %-10s %12s %10s %10s\n", name, "cpu loop", "instructions", "Minstr/s", "ms/frame");
+
+	for (int hooked = 0; hooked < 2; hooked++)
+	{
+		printf("%-24s %-10s %12llu %10.2f %10.3f%s\n", "", hooked ? "hooked" : "hook-free",
+			(unsigned long long)instructions[hooked], instructions[hooked] / dt[hooked] / 1e6,
+			dt[hooked] * 1e3 / numFrames, (hooked && errors) ? "  MISMATCH" : "");
+	}
+	printf("%-24s %-10s %12s %9.2fx\n", "", "speedup", "", dt[1] / dt[0]);
+
+	return errors;
+}
+
+static int benchState(const char *name, int repeat)
+{
+	std::vector<uint8> buf(FCEUSS_FastStateSize()), check(buf.size());
+	timing fastSave, fastLoad, fastTotal, fullSave, fullLoad, fullTotal;
+	int errors = 0;
+	size_t fullSize = 0;
+
+	// a frame between each measurement, the state changes like it does in a rollback loop
+	for (int r = 0; r < repeat; r++)
+	{
+		double t0, t1, t2;
+
+		runFrames(1);
+
+		t0 = now();
+		FCEUSS_SaveFast(&buf[0]);
+		t1 = now();
+		FCEUSS_LoadFast(&buf[0]);
+		t2 = now();
+
+		fastSave.add(t1 - t0);
+		fastLoad.add(t2 - t1);
+		fastTotal.add(t2 - t0);
+
+		// loading a state and saving it again has to give the same state back
+		FCEUSS_SaveFast(&check[0]);
+
+		if (memcmp(&buf[0], &check[0], buf.size()))
+		{
+			errors++;
+		}
+
+		EMUFILE_MEMORY ms;
+
+		t0 = now();
+		FCEUSS_SaveMS(&ms, Z_NO_COMPRESSION);
+		t1 = now();
+		ms.fseek(0, SEEK_SET);
+		FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
+		t2 = now();
+
+		fullSave.add(t1 - t0);
+		fullLoad.add(t2 - t1);
+		fullTotal.add(t2 - t0);
+		fullSize = ms.size();
+	}
+
+	printf("%-24s %-6s %8s %10s %10s %10s %10s\n", name, "state", "bytes", "save us", "load us", "total us", "min us");
+	printf("%-24s %-6s %8u %10.2f %10.2f %10.2f %10.2f%s\n", "", "fast", (unsigned)buf.size(),
+		fastSave.avg() * 1e6, fastLoad.avg() * 1e6, fastTotal.avg() * 1e6, fastTotal.min * 1e6, errors ? "  MISMATCH" : "");
+	printf("%-24s %-6s %8u %10.2f %10.2f %10.2f %10.2f\n", "", "full", (unsigned)fullSize,
+		fullSave.avg() * 1e6, fullLoad.avg() * 1e6, fullTotal.avg() * 1e6, fullTotal.min * 1e6);
+
+	return errors;
+}
+
+static void usage(void)
+{
+	printf("usage: coreBench [-t test] [-n frames] [-r repeat] [rom ...]\n");
+	printf("  -t test    only run the named test: cpu or state\n");
+	printf("  -n frames  frames run after loading a game before measuring (default 600)\n");
+	printf("  -r repeat  measurements per test (default 1000)\n");
+	printf("  rom        games to run, a generated NROM program when none is given\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *onlyTest = NULL;
+	int warmFrames = 600, repeat = 1000, errors = 0;
+	std::vector<std::string> roms;
+	bool synth = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-t") && (i + 1 < argc))
+		{
+			onlyTest = argv[++i];
+		}
+		else if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+		{
+			warmFrames = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-r") && (i + 1 < argc))
+		{
+			repeat = atoi(argv[++i]);
+		}
+		else if (argv[i][0] == '-')
+		{
+			usage();
+			return 1;
+		}
+		else
+		{
+			roms.push_back(argv[i]);
+		}
+	}
+	if (repeat < 1)
+	{
+		repeat = 1;
+	}
+
+	if (roms.empty())
+	{
+		if (!writeSynthRom(SYNTH_ROM_NAME))
+		{
+			fprintf(stderr, "Failed to write %s\n", SYNTH_ROM_NAME);
+			return 1;
+		}
+		roms.push_back(SYNTH_ROM_NAME);
+		synth = true;
+	}
+
+	if (!FCEUI_Initialize())
+	{
+		fprintf(stderr, "Failed to initialize the emulator\n");
+		return 1;
+	}
+	FCEUI_SetBaseDirectory(".");
+	FCEUI_SetInput(0, SI_GAMEPAD, &padState, 0);
+
+	printf("%d warm up frames, %d measurements\n\n", warmFrames, repeat);
+
+	for (size_t i = 0; i < roms.size(); i++)
+	{
+		const char *name = synth ? "synthetic NROM" : roms[i].c_str();
+
+		if (!FCEUI_LoadGame(roms[i].c_str(), 1, true))
+		{
+			fprintf(stderr, "Failed to load %s\n", roms[i].c_str());
+			errors++;
+			continue;
+		}
+		runFrames(warmFrames);
+
+		if (!onlyTest || !strcmp(onlyTest, "cpu"))
+		{
+			errors += benchCpu(name, repeat);
+		}
+		if (!onlyTest || !strcmp(onlyTest, "state"))
+		{
+			errors += benchState(name, repeat);
+		}
+		FCEUI_CloseGame();
+	}
+	FCEUI_Kill();
+
+	if (synth)
+	{
+		remove(SYNTH_ROM_NAME);
+	}
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,145 @@
+// drvStub.cpp - the driver side of the emulator for coreBench and verifyMovies.
+//
+// The core calls back into the driver for files, messages, input setup and
+// the like. Nothing is shown or played here, these only do what the core
+// needs to run frames without a window.
+
+#include <stdio.h>
+#include <chrono>
+
+#include "../src/types.h"
+#include "../src/driver.h"
+#include "../src/fceu.h"
+#include "../src/file.h"
+#include "../src/emufile.h"
+
+int dendy = 0;
+int pal_emulation = 0;
+int closeFinishedMovie = 0;
+int KillFCEUXonFrame = 0;
+bool paldeemphswap = false;
+bool swapDuty = false;
+bool turbo = false;
+
+unsigned int *GetKeyboard(void)
+{
+	static unsigned int keys[256];
+
+	return keys;
+}
+
+void GetMouseData(uint32 (&md)[3])
+{
+	md[0] = md[1] = md[2] = 0;
+}
+
+u32 ModernDeemphColorMap(u8 *src, u8 *srcbuf, int scale)
+{
+	return 0;
+}
+
+uint64 FCEUD_GetTime(void)
+{
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+uint64 FCEUD_GetTimeFreq(void)
+{
+	return std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+}
+
+void FCEUD_Message(const char *text)
+{
+	fputs(text, stdout);
+}
+
+void FCEUD_PrintError(const char *errormsg)
+{
+	fprintf(stderr, "%s\n", errormsg);
+}
+
+EMUFILE_FILE *FCEUD_UTF8_fstream(const char *fn, const char *m)
+{
+	return new EMUFILE_FILE(fn, m);
+}
+
+FILE *FCEUD_UTF8fopen(const char *fn, const char *mode)
+{
+	return fopen(fn, mode);
+}
+
+FCEUFILE *FCEUD_OpenArchive(ArchiveScanRecord &asr, std::string &fname, std::string *innerFilename, int *userCancel)
+{
+	return NULL;
+}
+
+FCEUFILE *FCEUD_OpenArchiveIndex(ArchiveScanRecord &asr, std::string &fname, int innerIndex, int *userCancel)
+{
+	return NULL;
+}
+
+ArchiveScanRecord FCEUD_ScanArchive(std::string fname)
+{
+	return ArchiveScanRecord();
+}
+
+const char *FCEUD_GetCompilerString(void)
+{
+	return "coreBench";
+}
+
+void FCEUD_GetPalette(uint8 index, uint8 *r, uint8 *g, uint8 *b)
+{
+	*r = *g = *b = 0;
+}
+
+int FCEUD_SendData(void *data, uint32 len) { return 0; }
+int FCEUD_RecvData(void *data, uint32 len) { return 0; }
+int FCEUD_RecvDataPending(void) { return -1; }
+void FCEUD_NetworkClose(void) {}
+void FCEUD_NetplayText(uint8 *text) {}
+
+// Movies set the ports they were recorded with. The devices only read
+// zeros from here, playback loads the recorded input.
+void FCEUD_SetInput(bool fourscore, bool microphone, ESI port0, ESI port1, ESIFC fcexp)
+{
+	static uint32 portData[3][256];
+
+	FCEUI_SetInput(0, fourscore ? SI_GAMEPAD : port0, portData[0], 0);
+	FCEUI_SetInput(1, fourscore ? SI_GAMEPAD : port1, portData[1], 0);
+	FCEUI_SetInputFC(fourscore ? SIFC_NONE : fcexp, portData[2], 0);
+	FCEUI_SetInputFourscore(fourscore);
+}
+
+bool FCEUD_PauseAfterPlayback(void) { return false; }
+bool FCEUD_ShouldDrawInputAids(void) { return false; }
+int FCEUD_ShowStatusIcon(void) { return 0; }
+
+unsigned char hubState[6];
+void HubProcessByte(unsigned char, unsigned char *) {}
+void RefreshThrottleFPS(void) {}
+void FCEUD_AviRecordTo(void) {}
+void FCEUD_AviStop(void) {}
+void FCEUD_DebugBreakpoint(int bp_num) {}
+void FCEUD_HideMenuToggle(void) {}
+void FCEUD_LoadStateFrom(void) {}
+void FCEUD_MovieRecordTo(void) {}
+void FCEUD_MovieReplayFrom(void) {}
+void FCEUD_SaveStateAs(void) {}
+void FCEUD_SetEmulationSpeed(int cmd) {}
+void FCEUD_SetPalette(uint8 index, uint8 r, uint8 g, uint8 b) {}
+void FCEUD_SoundToggle(void) {}
+void FCEUD_SoundVolumeAdjust(int n) {}
+void FCEUD_ToggleStatusIcon(void) {}
+void FCEUD_TraceInstruction(uint8 *opcode, int size) {}
+void FCEUD_TurboOff(void) {}
+void FCEUD_TurboOn(void) {}
+void FCEUD_TurboToggle(void) {}
+void FCEUD_UpdateNTView(int scanline, bool drawall) {}
+void FCEUD_UpdatePPUView(int scanline, int drawall) {}
+void FCEUD_VideoChanged(void) {}
+bool FCEUI_AviDisableMovieMessages(void) { return false; }
+bool FCEUI_AviEnableHUDrecording(void) { return false; }
+bool FCEUI_AviIsRecording(void) { return false; }
+void FCEUI_AviVideoUpdate(const unsigned char *buffer) {}
+void FCEUI_UseInputPreset(int preset) {}
@@ -0,0 +1,404 @@
+/* FCE Ultra Network Play Server
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+/* fceux-net-load - plays a number of fake games on a server and measures how
+ * long the server takes to relay the input.
+ *
+ * Every simulated client behaves like the emulator: it sends its input for a
+ * frame and waits for the server's update before sending the next one.  The
+ * input byte holds the client's slot in its game and a counter, so a client
+ * recognises its own input in the updates.  The time from sending an input
+ * to receiving the first update that has it is the relay latency, which
+ * includes the wait for the server's next frame tick.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "types.h"
+#include "md5.h"
+
+#define DEFAULT_PORT 4046
+#define MAX_EVENTS 256
+#define WARMUP_SECONDS 1
+
+typedef struct
+{
+	int TCPSocket;
+	int game;
+	int slot;              /* 0-3, the client's place in its game, -1 until the server says */
+	int connected;         /* Got the frame divisor byte */
+	uint8 seq;             /* Counter in the last input sent */
+	uint8 sent;            /* Last input sent, 0 while none is waiting */
+	uint64 senttime;
+
+	/* Message being received: 5 byte header, then the data of 0x80 commands. */
+	uint8 hdr[5];
+	uint32 hdrhas;
+	uint32 skip;           /* Data bytes of a command still to come */
+	char text[64];         /* Start of a text message */
+	uint32 textlen;
+} LoadClient;
+
+static uint64 Now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return((uint64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+}
+
+static void en32(uint8 *buf, uint32 morp)
+{
+	buf[0]=morp;
+	buf[1]=morp>>8;
+	buf[2]=morp>>16;
+	buf[3]=morp>>24;
+}
+
+static uint32 de32(uint8 *morp)
+{
+	return(morp[0]|(morp[1]<<8)|(morp[2]<<16)|(morp[3]<<24));
+}
+
+/* Blocking send of a few bytes, the socket buffer always has room for them. */
+static int SendAll(int sock, const uint8 *data, uint32 len)
+{
+	while(len)
+	{
+		int l = send(sock, data, len, MSG_NOSIGNAL);
+
+		if(l == -1)
+		{
+			if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+				continue;
+			return(0);
+		}
+		data += l;
+		len -= l;
+	}
+	return(1);
+}
+
+static int SendInput(LoadClient *client)
+{
+	/* 2 bits of slot and 6 of counter, never 0xFF as that is the command escape. */
+	client->seq = (client->seq + 1) % 62;
+	client->sent = (client->slot << 6) | (client->seq + 1);
+	client->senttime = Now();
+
+	return(SendAll(client->TCPSocket, &client->sent, 1));
+}
+
+static int Login(LoadClient *client, const uint8 *password)
+{
+	uint8 buf[4 + 16 + 16 + 64 + 1 + 32];
+	struct md5_context md5;
+	char name[32];
+	uint32 len;
+
+	snprintf(name, sizeof(name), "netload %d", client->game);
+	len = 16 + 16 + 64 + 1 + strlen(name);
+
+	memset(buf, 0, sizeof(buf));
+	en32(buf, len);
+
+	/* Game ID */
+	md5_starts(&md5);
+	md5_update(&md5, (uint8 *)name, strlen(name));
+	md5_finish(&md5, buf + 4);
+
+	if(password)
+		memcpy(buf + 4 + 16, password, 16);
+
+	buf[4 + 16 + 16 + 64] = 1; /* Local players */
+	memcpy(buf + 4 + 16 + 16 + 64 + 1, name, strlen(name));
+
+	return(SendAll(client->TCPSocket, buf, 4 + len));
+}
+
+/* Goes through what the server sent.  Returns 0 if the connection is gone. */
+static int Receive(LoadClient *client, std::vector<uint32> &latencies, uint64 warmupend, uint64 *updates)
+{
+	uint8 buf[4096];
+
+	while(1)
+	{
+		int l = recv(client->TCPSocket, buf, sizeof(buf), 0);
+		int pos = 0;
+
+		if(l == -1)
+			return(errno == EAGAIN || errno == EWOULDBLOCK);
+		if(l == 0)
+			return(0);
+
+		uint64 now = Now();
+
+		if(!client->connected)
+		{
+			/* The frame divisor comes first. */
+			client->connected = 1;
+			pos++;
+		}
+
+		while(pos < l)
+		{
+			if(client->skip)
+			{
+				uint32 n = std::min((uint32)(l - pos), client->skip);
+
+				if(client->hdr[4] == 0x90)
+				{
+					uint32 t = std::min(n, (uint32)sizeof(client->text) - 1 - client->textlen);
+
+					memcpy(client->text + client->textlen, buf + pos, t);
+					client->textlen += t;
+				}
+				client->skip -= n;
+				pos += n;
+
+				/* "* You(Player 2) have just connected as: ..." tells us our slot. */
+				if(!client->skip && client->hdr[4] == 0x90)
+				{
+					client->text[client->textlen] = 0;
+					if(client->slot == -1 && !strncmp(client->text, "* You(Player ", 13))
+					{
+						client->slot = client->text[13] - '1';
+						if(client->slot < 0 || client->slot > 3 || !SendInput(client))
+							return(0);
+					}
+				}
+				continue;
+			}
+
+			client->hdr[client->hdrhas++] = buf[pos++];
+			if(client->hdrhas < 5)
+				continue;
+			client->hdrhas = 0;
+
+			if(client->hdr[4] & 0x80)
+			{
+				if(client->hdr[4] != 0x81) /* The save state request has no data. */
+					client->skip = de32(client->hdr);
+				client->textlen = 0;
+				continue;
+			}
+			if(client->hdr[4])
+				continue; /* Other commands, no data. */
+
+			/* A frame update, look for our input in it. */
+			(*updates)++;
+			if(client->sent && client->slot != -1 && client->hdr[client->slot] == client->sent)
+			{
+				if(now >= warmupend)
+					latencies.push_back((uint32)(now - client->senttime));
+				if(!SendInput(client))
+					return(0);
+			}
+		}
+	}
+}
+
+static void usage(void)
+{
+	printf("usage: fceux-net-load [options]\n");
+	printf("  -s server   server to connect to (default localhost)\n");
+	printf("  -p port     port of the server (default %d)\n", DEFAULT_PORT);
+	printf("  -g games    number of games (default 50)\n");
+	printf("  -c clients  clients per game, 1-4 (default 2)\n");
+	printf("  -t seconds  how long to play (default 10)\n");
+	printf("  -w password server password\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *server = "localhost";
+	int port = DEFAULT_PORT, numgames = 50, pergame = 2, seconds = 10;
+	uint8 password[16], *pw = 0;
+	std::vector<LoadClient> clients;
+	std::vector<uint32> latencies;
+	struct sockaddr_in sockin;
+	struct hostent *host;
+	uint64 updates = 0;
+	int dropped = 0;
+	int epollfd;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(i + 1 >= argc)
+		{
+			usage();
+			return(1);
+		}
+		if(!strcmp(argv[i], "-s"))
+			server = argv[++i];
+		else if(!strcmp(argv[i], "-p"))
+			port = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-g"))
+			numgames = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-c"))
+			pergame = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-t"))
+			seconds = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "-w"))
+		{
+			struct md5_context md5;
+			char *pass = argv[++i];
+
+			md5_starts(&md5);
+			md5_update(&md5, (uint8 *)pass, strlen(pass));
+			md5_finish(&md5, password);
+			pw = password;
+		}
+		else
+		{
+			usage();
+			return(1);
+		}
+	}
+	if(numgames < 1 || pergame < 1 || pergame > 4 || seconds < 1)
+	{
+		usage();
+		return(1);
+	}
+
+	if(!(host = gethostbyname(server)))
+	{
+		printf("Unknown server %s\n", server);
+		return(1);
+	}
+	memset(&sockin, 0, sizeof(sockin));
+	sockin.sin_family = AF_INET;
+	sockin.sin_port = htons(port);
+	memcpy(&sockin.sin_addr, host->h_addr, 4);
+
+	epollfd = epoll_create1(0);
+	clients.resize(numgames * pergame);
+
+	for(size_t n = 0; n < clients.size(); n++)
+	{
+		LoadClient *client = &clients[n];
+		struct epoll_event ev;
+		int tcpopt = 1;
+
+		memset(client, 0, sizeof(LoadClient));
+		client->game = n / pergame;
+		client->slot = -1;
+		client->TCPSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+		setsockopt(client->TCPSocket, IPPROTO_TCP, TCP_NODELAY, &tcpopt, sizeof(int));
+		if(connect(client->TCPSocket, (struct sockaddr *)&sockin, sizeof(sockin)))
+		{
+			printf("Connecting client %d failed: %s\n", (int)n, strerror(errno));
+			return(1);
+		}
+
+		if(!Login(client, pw))
+		{
+			printf("Logging in client %d failed\n", (int)n);
+			return(1);
+		}
+		fcntl(client->TCPSocket, F_SETFL, fcntl(client->TCPSocket, F_GETFL) | O_NONBLOCK);
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = client;
+		epoll_ctl(epollfd, EPOLL_CTL_ADD, client->TCPSocket, &ev);
+
+		/* Wait until the server has seated this client before the next one. */
+		for(uint64 t = Now(); client->slot == -1 && client->TCPSocket != -1 && Now() - t < 2000000; )
+		{
+			struct epoll_event events[MAX_EVENTS];
+			int count = epoll_wait(epollfd, events, MAX_EVENTS, 10);
+
+			for(int i = 0; i < count; i++)
+			{
+				LoadClient *c = (LoadClient *)events[i].data.ptr;
+				if(c->TCPSocket != -1 && !Receive(c, latencies, ~0ULL, &updates))
+				{
+					close(c->TCPSocket);
+					c->TCPSocket = -1;
+					dropped++;
+				}
+			}
+		}
+	}
+	latencies.clear();
+	updates = 0;
+
+	printf("%d games with %d clients each, playing for %d seconds...\n", numgames, pergame, seconds);
+
+	uint64 start = Now();
+	uint64 warmupend = start + WARMUP_SECONDS * 1000000;
+	uint64 end = start + (uint64)seconds * 1000000;
+
+	while(Now() < end)
+	{
+		struct epoll_event events[MAX_EVENTS];
+		int count = epoll_wait(epollfd, events, MAX_EVENTS, 100);
+
+		for(int i = 0; i < count; i++)
+		{
+			LoadClient *client = (LoadClient *)events[i].data.ptr;
+
+			if(client->TCPSocket != -1 && !Receive(client, latencies, warmupend, &updates))
+			{
+				close(client->TCPSocket);
+				client->TCPSocket = -1;
+				dropped++;
+			}
+		}
+	}
+
+	double measured = (Now() - warmupend) / 1e6;
+
+	printf("%llu updates received, %.0f per second per client\n", (unsigned long long)updates,
+		updates / (seconds * (double)clients.size()));
+	printf("%d client(s) dropped by the server\n", dropped);
+
+	if(latencies.empty())
+	{
+		printf("No input was relayed.\n");
+		return(1);
+	}
+	std::sort(latencies.begin(), latencies.end());
+
+	printf("%zu inputs relayed, %.0f per second\n", latencies.size(), latencies.size() / measured);
+	printf("relay latency ms:  p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n",
+		latencies[latencies.size() * 50 / 100] / 1e3,
+		latencies[latencies.size() * 90 / 100] / 1e3,
+		latencies[latencies.size() * 99 / 100] / 1e3,
+		latencies[latencies.size() * 999 / 1000] / 1e3,
+		latencies.back() / 1e3);
+
+	return(dropped ? 1 : 0);
+}
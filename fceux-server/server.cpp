@@ -18,6 +18,30 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+/* How it works:
+ *
+ * The main thread listens for connections and runs the login of every new
+ * client.  Once a client has logged in, it is handed over to one of the worker
+ * threads, picked from the game ID, so all of the players of a game end up on
+ * the same worker and the workers never share a game.
+ *
+ * Every worker has its own epoll set with the sockets of its clients, all
+ * non-blocking and edge triggered, and a timerfd that ticks at the frame rate.
+ * Input is read as soon as it arrives, and on every tick the joypad data of
+ * each game goes out to its players.  Nothing is sent directly, everything is
+ * put in the client's send ring first, and the rings are written to the
+ * sockets once per batch of events, or when epoll says the socket can take
+ * more.  A client whose ring fills up is too slow and gets disconnected.
+ *
+ * In rollback mode there is no tick.  Each input message of a client is the
+ * next frame of its players, and a frame goes out as soon as every player of
+ * the game has sent it, so clients that run ahead predicting the others get
+ * the real input as early as possible.
+ *
+ * The receive buffers and send rings are allocated once at startup, so nothing
+ * is allocated per message.
+ */
+
 #include <time.h>
 #include <stdlib.h>
 #include <string.h>
@@ -26,6 +50,10 @@
 #include <sys/ioctl.h>
 #include <sys/time.h>
 #include <sys/param.h>
+#include <sys/uio.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
@@ -37,24 +65,43 @@
 #include <stdarg.h>
 
 #include <exception>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "types.h"
 #include "md5.h"
 #include "throttle.h"
 
-#define VERSION "0.0.5"
+#define VERSION "0.1.1"
 #define DEFAULT_PORT 4046
 #define DEFAULT_MAX 100
 #define DEFAULT_TIMEOUT 5
 #define DEFAULT_FRAMEDIVISOR 1
+#define DEFAULT_WORKERS 0            /* One per cpu */
+#define DEFAULT_SENDBUFFER 262144
 #define DEFAULT_CONFIG "/etc/fceux-server.conf"
 
-// MSG_NOSIGNAL and SOL_TCP have been depreciated on osx
-#if defined (__APPLE__) || defined(BSD)
-#define MSG_NOSIGNAL SO_NOSIGPIPE
+#define MAX_WORKERS 64
+#define MAX_MESSAGE 200000          /* Largest command a client may send. */
+#define MIN_SENDBUFFER 262144       /* Must hold the largest command, relayed. */
+#define RECV_CHUNK 4096
+#define MAX_EVENTS 256
+#define MAX_CATCHUP_FRAMES 4
+#define ROLLBACK_QUEUE 64           /* Frames a client may be ahead of the others in rollback mode. */
+
+#ifndef SOL_TCP
 #define SOL_TCP IPPROTO_TCP
 #endif
 
+/* Client states */
+#define CLIENT_FREE     0
+#define CLIENT_LOGIN    1           /* Owned by the main thread */
+#define CLIENT_GAME     2           /* Owned by its worker */
+
+struct WorkerEntry;
+
 typedef struct {
 	uint32 id; /* mainly for faster referencing when pointed to from the Games
 	              entries.
@@ -70,6 +117,25 @@ typedef struct {
 	uint8 *nbtcp;
 	uint32 nbtcphas, nbtcplen;
 	uint32 nbtcptype;
+	uint32 nbtcpsize;   /* Allocated size of nbtcp, it only ever grows. */
+
+	/* Data read from the socket that hasn't gone through the above yet. */
+	uint8 *recvbuf;
+	uint32 recvpos, recvlen;
+
+	/* Data waiting to be sent.  head and tail run freely, and are masked
+	   with SendRingMask to index the ring.
+	*/
+	uint8 *sendring;
+	uint32 sendhead, sendtail;
+	int sendqueued;     /* Set while on its worker's flush list. */
+
+	/* Login data, used by the worker when the client joins its game. */
+	uint8 gameid[16];
+	uint8 extra[64];
+
+	struct WorkerEntry *worker;   /* NULL during the login */
+	std::atomic<int> state;       /* CLIENT_* */
 } ClientEntry;
 
 typedef struct
@@ -85,8 +151,28 @@ typedef struct
 	uint8 ExtraInfo[64];     /* Expansion information to be used in future versions
 	                            of FCE Ultra.
 	                         */
+
+	/* Rollback mode: input of each player that wasn't relayed yet. */
+	uint8 InputQueue[4][ROLLBACK_QUEUE];
+	int InputHead[4], InputLen[4];
 } GameEntry;
 
+typedef struct WorkerEntry
+{
+	int num;
+	std::thread thread;
+	int epollfd;
+	int wakefd;              /* eventfd, written when clients are handed over. */
+	int timerfd;             /* Ticks once per frame. */
+	GameEntry *Games;        /* ServerConfig.MaxClients entries */
+
+	std::mutex queuelock;
+	std::vector<ClientEntry *> queue;   /* Clients handed over by the main thread. */
+
+	std::vector<ClientEntry *> flush;   /* Clients with data in their send ring. */
+	std::vector<ClientEntry *> dead;    /* Killed clients, freed after the current batch. */
+} WorkerEntry;
+
 typedef struct
 {
 	unsigned int MaxClients;     /* The maximum number of clients to allow. */
@@ -103,6 +189,10 @@ typedef struct
 	                                2 = 30 updates/sec, etc. */
 	unsigned int Port;           /* The port to listen on. */
 	uint8 *Password;             /* The server password. */
+	unsigned int Workers;        /* Number of worker threads, 0 = one per cpu. */
+	unsigned int SendBuffer;     /* Bytes of outgoing data to keep per client. */
+	unsigned int Rollback;       /* Relay a frame as soon as all players sent it,
+	                                instead of on the frame timer. */
 } CONFIG;
 
 CONFIG ServerConfig;
@@ -124,10 +214,16 @@ int LoadConfigFile(const char *fn)
 				sscanf(buf,"%*s %d",&ServerConfig.FrameDivisor);
 			else if(!strncasecmp(buf,"port",strlen("port")))
 				sscanf(buf,"%*s %d",&ServerConfig.Port);
+			else if(!strncasecmp(buf,"workers",strlen("workers")))
+				sscanf(buf,"%*s %d",&ServerConfig.Workers);
+			else if(!strncasecmp(buf,"sendbuffer",strlen("sendbuffer")))
+				sscanf(buf,"%*s %d",&ServerConfig.SendBuffer);
+			else if(!strncasecmp(buf,"rollback",strlen("rollback")))
+				sscanf(buf,"%*s %d",&ServerConfig.Rollback);
 			else if(!strncasecmp(buf,"password",strlen("password")))
 			{
 				char *pass = 0;
-				sscanf(buf,"%*s %as",&pass);
+				sscanf(buf,"%*s %ms",&pass);
 				if(pass)
 				{
 					struct md5_context md5;
@@ -157,7 +253,12 @@ int LoadConfigFile(const char *fn)
 }
 
 static ClientEntry *Clients;
-static GameEntry *Games;
+static WorkerEntry *Workers;
+static unsigned int NumWorkers;
+static uint32 SendRingMask;
+
+/* Number of a game for the log, unique over all workers. */
+#define GAMENUM(worker, game) ((worker)->num * ServerConfig.MaxClients + (int)((game) - (worker)->Games))
 
 static void en32(uint8 *buf, uint32 morp)
 {
@@ -174,11 +275,14 @@ static uint32 de32(uint8 *morp)
 
 static char *CleanNick(char *nick);
 static int NickUnique(ClientEntry *client);
-static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64]) throw();
-static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw();
-static void BroadcastText(GameEntry *game, const char *fmt, ...) throw();
-static void TextToClient(ClientEntry *client, const char *fmt, ...) throw();
+static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64]);
+static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len);
+static void SendToAllPrefixed(GameEntry *game, int cmd, const uint8 *prefix, uint32 prefixlen, const uint8 *data, uint32 len);
+static void BroadcastText(GameEntry *game, const char *fmt, ...);
+static void TextToClient(ClientEntry *client, const char *fmt, ...);
 static void KillClient(ClientEntry *client);
+static void HandOffClient(ClientEntry *client);
+static void RelayFrames(GameEntry *game);
 
 #define NBTCP_LOGINLEN      0x100
 #define NBTCP_LOGIN         0x200
@@ -189,7 +293,11 @@ static void KillClient(ClientEntry *client);
 
 static void StartNBTCPReceive(ClientEntry *client, uint32 type, uint32 len)
 {
-	client->nbtcp = (uint8 *)malloc(len);
+	if(len > client->nbtcpsize)
+	{
+		client->nbtcp = (uint8 *)realloc(client->nbtcp, len);
+		client->nbtcpsize = len;
+	}
 	client->nbtcplen = len;
 	client->nbtcphas = 0;
 	client->nbtcptype = type;
@@ -202,17 +310,15 @@ static void RedoNBTCPReceive(ClientEntry *client)
 
 static void EndNBTCPReceive(ClientEntry *client)
 {
-	free(client->nbtcp);
 	client->nbtcplen = client->localplayers;
 	client->nbtcphas = 0;
 	client->nbtcptype = 0;
-	client->nbtcp = 0;
 }
 
-static uint8 *MakeMPS(ClientEntry *client)
+/* Writes the player numbers of the client, like "1,2", to buf. */
+static char *MakeMPS(ClientEntry *client, char *buf)
 {
-	static uint8 buf[64];
-	uint8 *bp = buf;
+	char *bp = buf;
 	int x;
 	GameEntry *game = (GameEntry *)client->game;
 
@@ -226,217 +332,274 @@ static uint8 *MakeMPS(ClientEntry *client)
 			bp++;
 		}
 	}
-	if(*(bp-1) == ',') bp--;
+	if(bp > buf && *(bp-1) == ',') bp--;
 
 	*bp = 0;
 	return(buf);
 }
 
-/* Returns 1 if we are back to normal game mode, 0 if more data is yet to arrive. */
-static int CheckNBTCPReceive(ClientEntry *client) throw()
+/* Queues data to be sent to the client.  Throws if the send ring is full. */
+static void QueueSendTCP(ClientEntry *client, const uint8 *data, uint32 len)
 {
-	if(!client->nbtcplen)
-		throw(1); /* Should not happen. */
+	uint32 ringsize = SendRingMask + 1;
+
+	if(client->TCPSocket == -1)
+		throw(1);
+
+	if(len > ringsize - (client->sendhead - client->sendtail))
+		throw(1); /* The client isn't keeping up. */
+
+	uint32 off = client->sendhead & SendRingMask;
+	uint32 first = (len < ringsize - off) ? len : ringsize - off;
 
-	int l;
+	memcpy(client->sendring + off, data, first);
+	memcpy(client->sendring, data + first, len - first);
+	client->sendhead += len;
 
-	while(l = recv(client->TCPSocket, client->nbtcp + client->nbtcphas, client->nbtcplen  - client->nbtcphas, MSG_NOSIGNAL))
+	if(client->worker && !client->sendqueued)
 	{
+		client->sendqueued = 1;
+		client->worker->flush.push_back(client);
+	}
+}
+
+/* Writes as much of the send ring as the socket takes. */
+static void FlushSendTCP(ClientEntry *client)
+{
+	uint32 ringsize = SendRingMask + 1;
+
+	while(client->sendhead != client->sendtail)
+	{
+		uint32 pending = client->sendhead - client->sendtail;
+		uint32 off = client->sendtail & SendRingMask;
+		uint32 first = (pending < ringsize - off) ? pending : ringsize - off;
+		struct iovec iov[2];
+		struct msghdr msg;
+		ssize_t l;
+
+		iov[0].iov_base = client->sendring + off;
+		iov[0].iov_len = first;
+		iov[1].iov_base = client->sendring;
+		iov[1].iov_len = pending - first;
+
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = (pending > first) ? 2 : 1;
+
+		l = sendmsg(client->TCPSocket, &msg, MSG_NOSIGNAL);
 		if(l == -1)
 		{
 			if(errno == EAGAIN || errno == EWOULDBLOCK)
-				break;
-			throw(1); /* Die now.  NOW. */
+				return; /* epoll tells us when there's room again. */
+			if(errno == EINTR)
+				continue;
+			throw(1);
 		}
-		client->nbtcphas += l;
+		client->sendtail += l;
+	}
+}
 
-		//printf("Read: %d, %04x, %d, %d\n",l,client->nbtcptype,client->nbtcphas, client->nbtcplen);
+/* Handles a complete message in client->nbtcp.  Returns 0 when the client has
+   been handed over to a worker and must not be touched anymore.
+*/
+static int HandleNBTCPMessage(ClientEntry *client)
+{
+	uint32 len;
 
-		/* We're all full.  Yippie. */
-		if(client->nbtcphas == client->nbtcplen)
+	switch(client->nbtcptype & 0xF00)
+	{
+	case NBTCP_UPDATEDATA:
 		{
-			uint32 len;
-
-			switch(client->nbtcptype & 0xF00)
+			GameEntry *game = (GameEntry *)client->game;
+			int x, wx;
+			if(client->nbtcp[0] == 0xFF)
 			{
-			case NBTCP_UPDATEDATA:
+				EndNBTCPReceive(client);
+				StartNBTCPReceive(client, NBTCP_COMMANDLEN, 5);
+				return(1);
+			}
+			for(x=0,wx=0; x < 4; x++)
+			{
+				if(game->Players[x] == client)
 				{
-					GameEntry *game = (GameEntry *)client->game;
-					int x, wx;
-					if(client->nbtcp[0] == 0xFF)
+					game->joybuf[x] = client->nbtcp[wx];
+					if(ServerConfig.Rollback)
 					{
-						EndNBTCPReceive(client);
-						StartNBTCPReceive(client, NBTCP_COMMANDLEN, 5);
-						return(1);
+						if(game->InputLen[x] == ROLLBACK_QUEUE)
+							throw(1); /* Way ahead of the others. */
+						game->InputQueue[x][(game->InputHead[x] + game->InputLen[x]) % ROLLBACK_QUEUE] = client->nbtcp[wx];
+						game->InputLen[x]++;
 					}
-					for(x=0,wx=0; x < 4; x++)
-					{
-						if(game->Players[x] == client)
-						{
-							game->joybuf[x] = client->nbtcp[wx];
-							wx++;
-						}
-					}
-					RedoNBTCPReceive(client);
+					wx++;
 				}
-				return(1);
-			case NBTCP_COMMANDLEN:
-				{
-					uint8 cmd = client->nbtcp[4];
-					len = de32(client->nbtcp);
-					if(len > 200000) /* Sanity check. */
-						throw(1);
+			}
+			RedoNBTCPReceive(client);
+			if(ServerConfig.Rollback)
+				RelayFrames(game);
+		}
+		return(1);
+	case NBTCP_COMMANDLEN:
+		{
+			uint8 cmd = client->nbtcp[4];
+			len = de32(client->nbtcp);
+			if(len > MAX_MESSAGE) /* Sanity check. */
+				throw(1);
 
-					//printf("%02x, %d\n",cmd,len);
-					if(!len && !(cmd&0x80))
-					{
-						SendToAll((GameEntry*)client->game, client->nbtcp[4], 0, 0);
-						EndNBTCPReceive(client);
-						StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
-					}
-					else if(client->nbtcp[4]&0x80)
-					{
-						EndNBTCPReceive(client);
-						if(len)
-						{
-							StartNBTCPReceive(client,NBTCP_COMMAND | cmd,len);
-						}
-						else
-						{
-							/* Woops.  Client probably tried to send a text message of 0 length.
-							   Or maybe a 0-length cheat file?  Better be safe! */
-							StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
-						}
-					}
-					else throw(1);
-					return(1);
+			//printf("%02x, %d\n",cmd,len);
+			if(!len && !(cmd&0x80))
+			{
+				SendToAll((GameEntry*)client->game, client->nbtcp[4], 0, 0);
+				EndNBTCPReceive(client);
+				StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+			}
+			else if(client->nbtcp[4]&0x80)
+			{
+				EndNBTCPReceive(client);
+				if(len)
+				{
+					StartNBTCPReceive(client,NBTCP_COMMAND | cmd,len);
 				}
-			case NBTCP_COMMAND:
+				else
 				{
-					len = client->nbtcplen;
-					uint32 tocmd = client->nbtcptype & 0xFF;
-
-					if(tocmd == 0x90) /* Text */
-					{
-						char *ma, *ma2;
-
-						ma = (char *) malloc(len + 1);
-						memcpy(ma, client->nbtcp, len);
-						ma[len] = 0;
-						asprintf(&ma2, "<%s> %s",client->nickname,ma);
-						free(ma);
-						ma = ma2;
-						len=strlen(ma);
-						SendToAll((GameEntry*)client->game, tocmd, (uint8 *)ma, len);
-						free(ma);
-					}
-					else
-					{
-						SendToAll((GameEntry*)client->game, tocmd, client->nbtcp, len);
-					}
-					EndNBTCPReceive(client);
+					/* Woops.  Client probably tried to send a text message of 0 length.
+					   Or maybe a 0-length cheat file?  Better be safe! */
 					StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
-					return(1);
 				}
-			case NBTCP_LOGINLEN:
-				len = de32(client->nbtcp);
-				if(len > 1024 || len < (16 + 16 + 64 + 1))
-				throw(1);
-				EndNBTCPReceive(client);
-				StartNBTCPReceive(client,NBTCP_LOGIN,len);
-				return(1);
-			case NBTCP_LOGIN:
-				{
-					uint32 len;
-					uint8 gameid[16];
-					uint8 *sexybuf;
-					uint8 extra[64];
+			}
+			else throw(1);
+			return(1);
+		}
+	case NBTCP_COMMAND:
+		{
+			len = client->nbtcplen;
+			uint32 tocmd = client->nbtcptype & 0xFF;
 
-					len = client->nbtcplen;
-					sexybuf = client->nbtcp;
+			if(tocmd == 0x90) /* Text */
+			{
+				char prefix[1100];
+				int prefixlen = snprintf(prefix, sizeof(prefix), "<%s> ", client->nickname);
 
-					/* Game ID(MD5'd game MD5 and password on client side). */
-					memcpy(gameid, sexybuf, 16);
-					sexybuf += 16;
-					len -= 16;
+				if(prefixlen >= (int)sizeof(prefix))
+					prefixlen = sizeof(prefix) - 1;
+				SendToAllPrefixed((GameEntry*)client->game, tocmd, (uint8 *)prefix, prefixlen, client->nbtcp, len);
+			}
+			else
+			{
+				SendToAll((GameEntry*)client->game, tocmd, client->nbtcp, len);
+			}
+			EndNBTCPReceive(client);
+			StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+			return(1);
+		}
+	case NBTCP_LOGINLEN:
+		len = de32(client->nbtcp);
+		if(len > 1024 || len < (16 + 16 + 64 + 1))
+		throw(1);
+		EndNBTCPReceive(client);
+		StartNBTCPReceive(client,NBTCP_LOGIN,len);
+		return(1);
+	case NBTCP_LOGIN:
+		{
+			uint8 *sexybuf;
 
-					if(ServerConfig.Password)
-					if(memcmp(ServerConfig.Password,sexybuf,16))
-					{
-						TextToClient(client,"Invalid server password.");
-						throw(1);
-					}
-					sexybuf += 16;
-					len -= 16;
+			len = client->nbtcplen;
+			sexybuf = client->nbtcp;
 
-					memcpy(extra, sexybuf, 64);
-					sexybuf += 64;
-					len -= 64;
+			/* Game ID(MD5'd game MD5 and password on client side). */
+			memcpy(client->gameid, sexybuf, 16);
+			sexybuf += 16;
+			len -= 16;
 
-					client->localplayers = *sexybuf;
-					if(client->localplayers < 1 || client->localplayers > 4)
-					{
-						TextToClient(client,"Invalid number(%d) of local players!",client->localplayers);
-						throw(1);
-					}
-					sexybuf++;
-					len -= 1;
+			if(ServerConfig.Password)
+			if(memcmp(ServerConfig.Password,sexybuf,16))
+			{
+				TextToClient(client,"Invalid server password.");
+				throw(1);
+			}
+			sexybuf += 16;
+			len -= 16;
 
-					AddClientToGame(client, gameid, extra);
-					/* Get the nickname */
-					if(len)
-					{
-						client->nickname = (char *)malloc(len + 1);
-						memcpy(client->nickname, sexybuf, len);
-						client->nickname[len] = 0;
-						if((client->nickname = CleanNick(client->nickname)))
-						if(!NickUnique(client)) /* Nickname already exists */
-						{
-							free(client->nickname);
-							client->nickname = 0;
-						}
-					}
-					uint8 *mps = MakeMPS(client);
+			memcpy(client->extra, sexybuf, 64);
+			sexybuf += 64;
+			len -= 64;
 
-					if(!client->nickname)
-						asprintf(&client->nickname,"*Player %s",mps);
+			client->localplayers = *sexybuf;
+			if(client->localplayers < 1 || client->localplayers > 4)
+			{
+				TextToClient(client,"Invalid number(%d) of local players!",client->localplayers);
+				throw(1);
+			}
+			sexybuf++;
+			len -= 1;
 
-					printf("Client %d assigned to game %d as player %s <%s>\n",client->id,(GameEntry*)client->game - Games,mps, client->nickname);
+			/* The nickname is checked once the client is in its game. */
+			if(len)
+			{
+				client->nickname = (char *)malloc(len + 1);
+				memcpy(client->nickname, sexybuf, len);
+				client->nickname[len] = 0;
+			}
+		}
+		EndNBTCPReceive(client);
+		StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
+		HandOffClient(client);
+		return(0);
+	}
+	throw(1); /* Should not happen. */
+}
+
+/* Runs the messages in what the socket has to offer.  Returns when the socket
+   is drained, when the client is handed over to a worker, or throws if the
+   client has to go.
+*/
+static void CheckNBTCPReceive(ClientEntry *client)
+{
+	if(!client->nbtcplen)
+		throw(1); /* Should not happen. */
 
-					int x;
-					GameEntry *tg=(GameEntry *)client->game;
+	while(client->TCPSocket != -1)
+	{
+		if(client->recvpos == client->recvlen)
+		{
+			int l = recv(client->TCPSocket, client->recvbuf, RECV_CHUNK, MSG_NOSIGNAL);
 
-					for(x=0; x<tg->MaxPlayers; x++)
-					{
-						if(tg->Players[x] && tg->IsUnique[x])
-						{
-							if(tg->Players[x] != client)
-							{
-								try
-								{
-									TextToClient(tg->Players[x], "* Player %s has just connected as: %s",MakeMPS(client),client->nickname);
-								}
-								catch(int i)
-								{
-									KillClient(tg->Players[x]);
-								}
-								TextToClient(client, "* Player %s is already connected as: %s",MakeMPS(tg->Players[x]),tg->Players[x]->nickname);
-							}
-							else
-								TextToClient(client, "* You(Player %s) have just connected as: %s",MakeMPS(client),client->nickname);
-						}
-					}
-				}
-				EndNBTCPReceive(client);
-				StartNBTCPReceive(client,NBTCP_UPDATEDATA,client->localplayers);
-				return(1);
+			if(l == -1)
+			{
+				if(errno == EAGAIN || errno == EWOULDBLOCK)
+					return;
+				if(errno == EINTR)
+					continue;
+				throw(1); /* Die now.  NOW. */
 			}
+			if(l == 0)
+				throw(1); /* Connection closed. */
+
+			client->recvpos = 0;
+			client->recvlen = l;
+		}
+
+		uint32 n = client->recvlen - client->recvpos;
+
+		if(n > client->nbtcplen - client->nbtcphas)
+			n = client->nbtcplen - client->nbtcphas;
+
+		memcpy(client->nbtcp + client->nbtcphas, client->recvbuf + client->recvpos, n);
+		client->recvpos += n;
+		client->nbtcphas += n;
+
+		//printf("Read: %d, %04x, %d, %d\n",n,client->nbtcptype,client->nbtcphas, client->nbtcplen);
+
+		/* We're all full.  Yippie. */
+		if(client->nbtcphas == client->nbtcplen)
+		{
+			if(!HandleNBTCPMessage(client))
+				return;
 		}
 	}
-	return(0);
 }
 
 int ListenSocket;
+static int ListenEpoll;
 
 static char *CleanNick(char *nick)
 {
@@ -463,26 +626,19 @@ static int NickUnique(ClientEntry *client)
 	for(x=0; x<game->MaxPlayers; x++)
 		if(game->Players[x] && client != game->Players[x])
 
-	if(!strcasecmp(client->nickname, game->Players[x]->nickname))
+	if(game->Players[x]->nickname && !strcasecmp(client->nickname, game->Players[x]->nickname))
 		return(0);
 
 	return(1);
 }
 
-static int MakeSendTCP(ClientEntry *client, uint8 *data, uint32 len) throw()
-{
-	if(send(client->TCPSocket, data, len, MSG_NOSIGNAL) != len)
-		throw(1);
-
-	return(1);
-}
-
-static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw()
+static void SendToAllPrefixed(GameEntry *game, int cmd, const uint8 *prefix, uint32 prefixlen, const uint8 *data, uint32 len)
 {
 	uint8 poo[5];
 	int x;
 
 	poo[4] = cmd;
+	en32(poo, (cmd & 0x80) ? prefixlen + len : 0);
 
 	for(x=0;x<game->MaxPlayers;x++)
 	{
@@ -490,13 +646,12 @@ static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw()
 
 		try
 		{
-			if(cmd & 0x80)
-				en32(poo, len);
-			MakeSendTCP(game->Players[x],poo,5);
+			QueueSendTCP(game->Players[x],poo,5);
 
 			if(cmd & 0x80)
 			{
-				MakeSendTCP(game->Players[x], data, len);
+				QueueSendTCP(game->Players[x], prefix, prefixlen);
+				QueueSendTCP(game->Players[x], data, len);
 			}
 		}
 		catch(int i)
@@ -506,7 +661,12 @@ static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len) throw()
 	}
 }
 
-static void TextToClient(ClientEntry *client, const char *fmt, ...) throw()
+static void SendToAll(GameEntry *game, int cmd, uint8 *data, uint32 len)
+{
+	SendToAllPrefixed(game, cmd, 0, 0, data, len);
+}
+
+static void TextToClient(ClientEntry *client, const char *fmt, ...)
 {
 	char *moo;
 	va_list ap;
@@ -523,12 +683,20 @@ static void TextToClient(ClientEntry *client, const char *fmt, ...) throw()
 	len = strlen(moo);
 	en32(poo, len);
 
-	MakeSendTCP(client, poo, 5);
-	MakeSendTCP(client, (uint8*)moo, len);
+	try
+	{
+		QueueSendTCP(client, poo, 5);
+		QueueSendTCP(client, (uint8*)moo, len);
+	}
+	catch(int i)
+	{
+		free(moo);
+		throw;
+	}
 	free(moo);
 }
 
-static void BroadcastText(GameEntry *game, const char *fmt, ...) throw()
+static void BroadcastText(GameEntry *game, const char *fmt, ...)
 {
 	char *moo;
 	va_list ap;
@@ -541,11 +709,31 @@ static void BroadcastText(GameEntry *game, const char *fmt, ...) throw()
 	free(moo);
 }
 
+/* Gets a client slot ready for the next connection.  The buffers stay. */
+static void ResetClient(ClientEntry *client)
+{
+	client->id = 0;
+	client->nickname = 0;
+	client->TCPSocket = -1;
+	client->game = 0;
+	client->localplayers = 0;
+	client->timeconnect = 0;
+	client->nbtcphas = client->nbtcplen = client->nbtcptype = 0;
+	client->recvpos = client->recvlen = 0;
+	client->sendhead = client->sendtail = 0;
+	client->sendqueued = 0;
+	client->worker = 0;
+}
+
 static void KillClient(ClientEntry *client)
 {
 	GameEntry *game;
-	uint8 *mps;
-	char *bmsg;
+	WorkerEntry *worker = client->worker;
+	char mps[16];
+	char *bmsg = 0;
+
+	if(client->TCPSocket == -1)
+		return; /* Already gone. */
 
 	game = (GameEntry *)client->game;
 	if(game)
@@ -553,22 +741,27 @@ static void KillClient(ClientEntry *client)
 		int w;
 		int tc = 0;
 
+		MakeMPS(client, mps);
+
 		for(w=0;w<game->MaxPlayers;w++)
 			if(game->Players[w]) tc++;
 
 		for(w=0;w<game->MaxPlayers;w++)
 			if(game->Players[w])
 				if(game->Players[w] == client)
+				{
 					game->Players[w] = NULL;
+					game->InputLen[w] = 0;
+				}
 
 		time_t curtime = time(0);
-		printf("Player <%s> disconnected from game %d on %s",client->nickname,game-Games,ctime(&curtime));
-		asprintf(&bmsg, "* Player %s <%s> left.",MakeMPS(client),client->nickname);
+		printf("Player <%s> disconnected from game %d on %s",client->nickname,GAMENUM(worker,game),ctime(&curtime));
+		asprintf(&bmsg, "* Player %s <%s> left.",mps,client->nickname);
 		if(tc == client->localplayers) /* If total players for this game = total local
 		                                  players for this client, destroy the game.
 		                               */
 		{
-			printf("Game %d destroyed.\n",game-Games);
+			printf("Game %d destroyed.\n",GAMENUM(worker,game));
 			memset(game, 0, sizeof(GameEntry));
 			game = 0;
 		}
@@ -579,26 +772,45 @@ static void KillClient(ClientEntry *client)
 		printf("Unassigned client %d disconnected on %s",client->id, ctime(&curtime));
 	}
 
-	if(client->nbtcp)
-		free(client->nbtcp);
-
 	if(client->nickname)
 		free(client->nickname);
 
-	if(client->TCPSocket != -1)
-		close(client->TCPSocket);
+	/* Try to get out what's still queued, like why the client is being dropped. */
+	try
+	{
+		FlushSendTCP(client);
+	}
+	catch(int i)
+	{
+	}
 
-	memset(client, 0, sizeof(ClientEntry));
-	client->TCPSocket = -1;
+	/* Closing it takes it out of its epoll set too. */
+	close(client->TCPSocket);
+
+	ResetClient(client);
+
+	/* A worker may still have the client on its lists or in the events it is
+	   going through, so it only frees the slot when it's done with the batch.
+	*/
+	if(worker)
+		worker->dead.push_back(client);
+	else
+		client->state.store(CLIENT_FREE, std::memory_order_release);
 
 	if(game)
 		BroadcastText(game,"%s",bmsg);
+	free(bmsg);
+
+	/* The frames that were only waiting for this client can go now. */
+	if(game && game->MaxPlayers && ServerConfig.Rollback)
+		RelayFrames(game);
 }
 
-static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64]) throw()
+static void AddClientToGame(ClientEntry *client, uint8 id[16], uint8 extra[64])
 {
 	int wg;
 	GameEntry *game,*fegame;
+	GameEntry *Games = client->worker->Games;
 
 retry:
 
@@ -613,7 +825,7 @@ retry:
 			if(!fegame)
 				fegame=&Games[wg];
 		}
-		else if(!memcmp(Games[wg].id,id,16)) /* A match was found! */
+		else if(Games[wg].MaxPlayers && !memcmp(Games[wg].id,id,16)) /* A match was found! */
 		{
 			game = &Games[wg];
 			break;
@@ -623,7 +835,7 @@ retry:
 	if(!game) /* Hmm, no game found.  Guess we'll have to create one. */
 	{
 		game=fegame;
-		printf("Game %d added\n",game-Games);
+		printf("Game %d added\n",GAMENUM(client->worker,game));
 		memset(game, 0, sizeof(GameEntry));
 		game->MaxPlayers = 4;
 		memcpy(game->id, id, 16);
@@ -637,8 +849,9 @@ retry:
 		try
 		{
 			uint8 b[5];
+			memset(b, 0, 5);
 			b[4] = 0x81;
-			MakeSendTCP(game->Players[n], b, 5);
+			QueueSendTCP(game->Players[n], b, 5);
 			break;
 		}
 		catch(int i)
@@ -683,8 +896,395 @@ retry:
 	client->game = (void *)game;
 }
 
+/* Puts a client that just logged in into its game, on its worker thread. */
+static void JoinGame(ClientEntry *client)
+{
+	char mps[16], mps2[16];
+
+	AddClientToGame(client, client->gameid, client->extra);
+
+	/* Get the nickname */
+	if(client->nickname)
+	{
+		if((client->nickname = CleanNick(client->nickname)))
+		if(!NickUnique(client)) /* Nickname already exists */
+		{
+			free(client->nickname);
+			client->nickname = 0;
+		}
+	}
+	MakeMPS(client, mps);
+
+	if(!client->nickname)
+		asprintf(&client->nickname,"*Player %s",mps);
 
+	printf("Client %d assigned to game %d as player %s <%s>\n",client->id,GAMENUM(client->worker,(GameEntry*)client->game),mps, client->nickname);
 
+	int x;
+	GameEntry *tg=(GameEntry *)client->game;
+
+	for(x=0; x<tg->MaxPlayers; x++)
+	{
+		if(tg->Players[x] && tg->IsUnique[x])
+		{
+			if(tg->Players[x] != client)
+			{
+				try
+				{
+					TextToClient(tg->Players[x], "* Player %s has just connected as: %s",mps,client->nickname);
+				}
+				catch(int i)
+				{
+					KillClient(tg->Players[x]);
+				}
+				if(tg->Players[x])
+					TextToClient(client, "* Player %s is already connected as: %s",MakeMPS(tg->Players[x],mps2),tg->Players[x]->nickname);
+			}
+			else
+				TextToClient(client, "* You(Player %s) have just connected as: %s",mps,client->nickname);
+		}
+	}
+
+	/* Rollback clients have to know which joypads in the updates are theirs. */
+	if(ServerConfig.Rollback)
+	{
+		uint8 b[5];
+
+		for(x=0; x<4; x++)
+			b[x] = (tg->Players[x] == client);
+		b[4] = 0x40;
+		QueueSendTCP(client, b, 5);
+	}
+}
+
+/* Passes a client that has logged in to the worker of its game.  The worker
+   takes it from there, the main thread mustn't touch it anymore.
+*/
+static void HandOffClient(ClientEntry *client)
+{
+	WorkerEntry *worker = &Workers[de32(client->gameid) % NumWorkers];
+	uint64 one = 1;
+
+	/* Whatever is still in the ring is small, it can go out right away. */
+	FlushSendTCP(client);
+
+	epoll_ctl(ListenEpoll, EPOLL_CTL_DEL, client->TCPSocket, NULL);
+
+	client->state.store(CLIENT_GAME, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(worker->queuelock);
+		worker->queue.push_back(client);
+	}
+	if(write(worker->wakefd, &one, sizeof(one)) != sizeof(one))
+		printf("Waking worker %d failed: %s\n", worker->num, strerror(errno));
+}
+
+/* Takes over the clients the main thread handed to this worker. */
+static void AdoptClients(WorkerEntry *worker)
+{
+	std::vector<ClientEntry *> adopt;
+	uint64 count;
+
+	if(read(worker->wakefd, &count, sizeof(count)) != sizeof(count))
+		return;
+	{
+		std::lock_guard<std::mutex> lock(worker->queuelock);
+		adopt.swap(worker->queue);
+	}
+
+	for(size_t i = 0; i < adopt.size(); i++)
+	{
+		ClientEntry *client = adopt[i];
+		struct epoll_event ev;
+
+		client->worker = worker;
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		ev.data.ptr = client;
+
+		try
+		{
+			if(epoll_ctl(worker->epollfd, EPOLL_CTL_ADD, client->TCPSocket, &ev))
+				throw(1);
+			JoinGame(client);
+
+			/* There may be input left from when the main thread read the login. */
+			CheckNBTCPReceive(client);
+		}
+		catch(int i)
+		{
+			KillClient(client);
+		}
+	}
+}
+
+/* Rollback mode: sends the frames that every player of the game has sent the
+   input for.
+*/
+static void RelayFrames(GameEntry *game)
+{
+	int n;
+
+	while(game->MaxPlayers)
+	{
+		int players = 0;
+
+		for(n = 0; n < 4; n++)
+		{
+			if(!game->Players[n]) continue;
+			if(!game->InputLen[n]) return;
+			players++;
+		}
+		if(!players) return;
+
+		for(n = 0; n < 4; n++)
+		{
+			if(game->Players[n])
+			{
+				game->joybuf[n] = game->InputQueue[n][game->InputHead[n]];
+				game->InputHead[n] = (game->InputHead[n] + 1) % ROLLBACK_QUEUE;
+				game->InputLen[n]--;
+			}
+			else
+				game->joybuf[n] = 0;
+		}
+		game->joybuf[4] = 0;
+
+		for(n = 0; n < game->MaxPlayers; n++)
+		{
+			if(!game->Players[n] || !game->IsUnique[n]) continue;
+			try
+			{
+				QueueSendTCP(game->Players[n], game->joybuf, 5);
+			}
+			catch(int i)
+			{
+				KillClient(game->Players[n]);
+			}
+		}
+	}
+}
+
+/* Sends the joypad data of every game, once per frame that has passed. */
+static void RunFrames(WorkerEntry *worker)
+{
+	uint64 frames;
+	int whichgame, n;
+
+	if(read(worker->timerfd, &frames, sizeof(frames)) != sizeof(frames))
+		return;
+
+	/* Running late, catch up a little but not too much. */
+	if(frames > MAX_CATCHUP_FRAMES)
+		frames = MAX_CATCHUP_FRAMES;
+
+	for(whichgame = 0; whichgame < ServerConfig.MaxClients; whichgame++)
+	{
+		GameEntry *game = &worker->Games[whichgame];
+
+		for(uint64 f = 0; f < frames; f++)
+		{
+			for(n = 0; n < game->MaxPlayers; n++)
+			{
+				if(!game->Players[n] || !game->IsUnique[n]) continue;
+				try
+				{
+					QueueSendTCP(game->Players[n], game->joybuf, 5);
+				}
+				catch(int i)
+				{
+					KillClient(game->Players[n]);
+				}
+			} // A game's clients
+		}
+	} // Games
+}
+
+static void FlushClients(WorkerEntry *worker)
+{
+	/* Killing a client can queue messages to others, so the list may grow
+	   while we go through it.
+	*/
+	for(size_t i = 0; i < worker->flush.size(); i++)
+	{
+		ClientEntry *client = worker->flush[i];
+
+		if(client->TCPSocket == -1 || client->worker != worker)
+			continue;
+		try
+		{
+			FlushSendTCP(client);
+		}
+		catch(int i)
+		{
+			KillClient(client);
+		}
+		client->sendqueued = 0;
+	}
+	worker->flush.clear();
+
+	for(size_t i = 0; i < worker->dead.size(); i++)
+		worker->dead[i]->state.store(CLIENT_FREE, std::memory_order_release);
+	worker->dead.clear();
+}
+
+static void WorkerMain(WorkerEntry *worker)
+{
+	struct epoll_event events[MAX_EVENTS];
+
+	while(1)
+	{
+		int count = epoll_wait(worker->epollfd, events, MAX_EVENTS, -1);
+
+		if(count == -1)
+		{
+			if(errno == EINTR)
+				continue;
+			printf("Worker %d: epoll_wait failed: %s\n", worker->num, strerror(errno));
+			exit(-1);
+		}
+
+		for(int i = 0; i < count; i++)
+		{
+			if(events[i].data.ptr == &worker->wakefd)
+			{
+				AdoptClients(worker);
+				continue;
+			}
+			if(events[i].data.ptr == &worker->timerfd)
+			{
+				RunFrames(worker);
+				continue;
+			}
+
+			ClientEntry *client = (ClientEntry *)events[i].data.ptr;
+
+			/* Killed earlier in this batch. */
+			if(client->TCPSocket == -1)
+				continue;
+			try
+			{
+				if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+					CheckNBTCPReceive(client);
+				if((events[i].events & EPOLLOUT) && client->TCPSocket != -1)
+					FlushSendTCP(client);
+			}
+			catch(int i)
+			{
+				KillClient(client);
+			}
+		}
+		FlushClients(worker);
+	}
+}
+
+static void StartWorkers(void)
+{
+	uint64 period = GetThrottlePeriod(ServerConfig.FrameDivisor);
+
+	Workers = new WorkerEntry[NumWorkers];
+
+	for(unsigned int w = 0; w < NumWorkers; w++)
+	{
+		WorkerEntry *worker = &Workers[w];
+		struct epoll_event ev;
+		struct itimerspec its;
+
+		worker->num = w;
+		worker->Games = (GameEntry *)calloc(ServerConfig.MaxClients, sizeof(GameEntry));
+		worker->flush.reserve(ServerConfig.MaxClients);
+		worker->dead.reserve(ServerConfig.MaxClients);
+		worker->queue.reserve(ServerConfig.MaxClients);
+
+		worker->epollfd = epoll_create1(0);
+		worker->wakefd = eventfd(0, EFD_NONBLOCK);
+		worker->timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+		if(!worker->Games || worker->epollfd == -1 || worker->wakefd == -1 || worker->timerfd == -1)
+		{
+			printf("Error starting worker %d: %s\n", w, strerror(errno));
+			exit(-1);
+		}
+
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = &worker->wakefd;
+		epoll_ctl(worker->epollfd, EPOLL_CTL_ADD, worker->wakefd, &ev);
+		ev.data.ptr = &worker->timerfd;
+		epoll_ctl(worker->epollfd, EPOLL_CTL_ADD, worker->timerfd, &ev);
+
+		its.it_interval.tv_sec = its.it_value.tv_sec = period / 1000000000;
+		its.it_interval.tv_nsec = its.it_value.tv_nsec = period % 1000000000;
+		if(!ServerConfig.Rollback)
+			timerfd_settime(worker->timerfd, 0, &its, NULL);
+
+		worker->thread = std::thread(WorkerMain, worker);
+	}
+}
+
+/* Accepts the waiting connections and starts their login. */
+static void AcceptClients(void)
+{
+	struct sockaddr_in sockin;
+	socklen_t sockin_len;
+	int sock;
+
+	while(1)
+	{
+		sockin_len = sizeof(sockin);
+		if((sock = accept4(ListenSocket, (struct sockaddr *)&sockin, &sockin_len, SOCK_NONBLOCK)) == -1)
+		{
+			if(errno == EINTR || errno == ECONNABORTED)
+				continue;
+			return;
+		}
+
+		int n;
+		for(n=0; n<ServerConfig.MaxClients; n++)
+			if(Clients[n].state.load(std::memory_order_acquire) == CLIENT_FREE)
+				break;
+
+		if(n == ServerConfig.MaxClients)
+		{
+			printf("Server full, refused connection from %s\n",inet_ntoa(sockin.sin_addr));
+			close(sock);
+			continue;
+		}
+
+		/* We have a new client.  Yippie. */
+		ClientEntry *client = &Clients[n];
+		struct epoll_event ev;
+
+		client->state.store(CLIENT_LOGIN, std::memory_order_relaxed);
+		client->TCPSocket = sock;
+		client->timeconnect = time(0);
+		client->id = n;
+		printf("Client %d connecting from %s on %s",n,inet_ntoa(sockin.sin_addr),ctime(&client->timeconnect));
+
+		try
+		{
+			uint8 buf[1];
+
+			buf[0] = ServerConfig.Rollback ? 1 : ServerConfig.FrameDivisor;
+			QueueSendTCP(client, buf, 1);
+			FlushSendTCP(client);
+
+			StartNBTCPReceive(client, NBTCP_LOGINLEN, 4);
+
+			memset(&ev, 0, sizeof(ev));
+			ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+			ev.data.ptr = client;
+			if(epoll_ctl(ListenEpoll, EPOLL_CTL_ADD, sock, &ev))
+				throw(1);
+
+			CheckNBTCPReceive(client);
+		}
+		catch(int i)
+		{
+			KillClient(client);
+		}
+	}
+}
 
 int main(int argc, char *argv[])
 {
@@ -692,6 +1292,10 @@ int main(int argc, char *argv[])
 	socklen_t sockin_len;
 	int i;
 	char* pass = 0;
+
+	ServerConfig.Workers = DEFAULT_WORKERS;
+	ServerConfig.SendBuffer = DEFAULT_SENDBUFFER;
+
 	/* If we can't load the default config file, use some defined values */
 	if(!LoadConfigFile(DEFAULT_CONFIG))
 	{
@@ -717,6 +1321,9 @@ int main(int argc, char *argv[])
 			printf("-m\t--maxclients\tSpecifies the maximum amount of clients allowed \n\t\t\tto access the server. (default=%d)\n", DEFAULT_MAX);
 			printf("-t\t--timeout\tSpecifies the amount of seconds before the server \n\t\t\ttimes out. (default=%d)\n", DEFAULT_TIMEOUT);
 			printf("-f\t--framedivisor\tSpecifies frame divisor.\n\t\t\t(eg: 60 / framedivisor = updates per second)(default=%d)\n", DEFAULT_FRAMEDIVISOR);
+			printf("-n\t--workers\tSpecifies the number of worker threads the games \n\t\t\tare spread over. (default=one per cpu)\n");
+			printf("-b\t--sendbuffer\tSpecifies the bytes of outgoing data kept per client.\n\t\t\t(default=%d)\n", DEFAULT_SENDBUFFER);
+			printf("-r\t--rollback\tRelays each frame as soon as all players sent it,\n\t\t\tfor clients with rollback netplay. (default=0)\n");
 			printf("-c\t--configfile\tLoads the given configuration file.\n");
 			return -1;
 		}
@@ -781,6 +1388,39 @@ int main(int argc, char *argv[])
 			ServerConfig.FrameDivisor = atoi(argv[i]);
 			continue;
 		}
+		if(!strcmp(argv[i], "--workers") || !strcmp(argv[i], "-n"))
+		{
+			i++;
+			if(argc == i)
+			{
+				printf("Please specify the number of worker threads.\n");
+				return -1;
+			}
+			ServerConfig.Workers = atoi(argv[i]);
+			continue;
+		}
+		if(!strcmp(argv[i], "--sendbuffer") || !strcmp(argv[i], "-b"))
+		{
+			i++;
+			if(argc == i)
+			{
+				printf("Please specify the send buffer size.\n");
+				return -1;
+			}
+			ServerConfig.SendBuffer = atoi(argv[i]);
+			continue;
+		}
+		if(!strcmp(argv[i], "--rollback") || !strcmp(argv[i], "-r"))
+		{
+			i++;
+			if(argc == i)
+			{
+				printf("Please specify 1 or 0 for rollback mode.\n");
+				return -1;
+			}
+			ServerConfig.Rollback = atoi(argv[i]);
+			continue;
+		}
 		if(!strcmp(argv[i], "--configfile") || !strcmp(argv[i], "-c"))
 		{
 			i++;
@@ -807,18 +1447,51 @@ int main(int argc, char *argv[])
 		return -1;
 	}
 
-	Games = (GameEntry *)malloc(sizeof(GameEntry) * ServerConfig.MaxClients);
-	Clients = (ClientEntry *)malloc(sizeof(ClientEntry) * ServerConfig.MaxClients);
+	if(!ServerConfig.FrameDivisor)
+		ServerConfig.FrameDivisor = 1;
 
-	memset(Games,0,sizeof(GameEntry) * ServerConfig.MaxClients);
-	memset(Clients,0,sizeof(ClientEntry) * ServerConfig.MaxClients);
+	NumWorkers = ServerConfig.Workers;
+	if(!NumWorkers)
+		NumWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+	if(NumWorkers < 1)
+		NumWorkers = 1;
+	if(NumWorkers > MAX_WORKERS)
+		NumWorkers = MAX_WORKERS;
+
+	/* The ring has to hold the biggest command relayed, and be a power of 2. */
+	{
+		uint32 ringsize = MIN_SENDBUFFER;
+
+		while(ringsize < ServerConfig.SendBuffer && ringsize < 0x40000000)
+			ringsize <<= 1;
+		SendRingMask = ringsize - 1;
+	}
+
+	/* All of the buffers in one go.  Pages nobody has touched yet don't cost
+	   anything, so a high maxclients is cheap until the clients show up.
+	*/
+	Clients = new ClientEntry[ServerConfig.MaxClients];
+	uint8 *sendrings = (uint8 *)malloc((size_t)(SendRingMask + 1) * ServerConfig.MaxClients);
+	uint8 *recvbufs = (uint8 *)malloc((size_t)RECV_CHUNK * ServerConfig.MaxClients);
+
+	if(!sendrings || !recvbufs)
+	{
+		puts("Not enough memory for the client buffers.");
+		exit(-1);
+	}
 
 	{
 		int x;
 		for(x=0; x<ServerConfig.MaxClients; x++)
-			Clients[x].TCPSocket = -1;
+		{
+			ResetClient(&Clients[x]);
+			Clients[x].state.store(CLIENT_FREE, std::memory_order_relaxed);
+			Clients[x].nbtcp = 0;
+			Clients[x].nbtcpsize = 0;
+			Clients[x].sendring = sendrings + (size_t)(SendRingMask + 1) * x;
+			Clients[x].recvbuf = recvbufs + (size_t)RECV_CHUNK * x;
+		}
 	}
-	RefreshThrottleFPS(ServerConfig.FrameDivisor);
 
 	/* First, we need to create a socket to listen on. */
 	ListenSocket = socket(AF_INET, SOCK_STREAM, 0);
@@ -834,6 +1507,8 @@ int main(int argc, char *argv[])
 		printf("Nodelay fail: %s",strerror(errno));
 		exit(-1);
 	}
+	if(setsockopt(ListenSocket, SOL_SOCKET, SO_REUSEADDR, &tcpopt, sizeof(int)))
+		printf("Address reuse set failed: %s",strerror(errno));
 
 	memset(&sockin, 0, sizeof(sockin));
 	sockin.sin_family = AF_INET;
@@ -849,7 +1524,7 @@ int main(int argc, char *argv[])
 	}
 	puts("Ok");
 	printf("Listening on socket... ");
-	if(listen(ListenSocket, 8))
+	if(listen(ListenSocket, SOMAXCONN))
 	{
 		printf("Error: %s",strerror(errno));
 		exit(-1);
@@ -859,89 +1534,63 @@ int main(int argc, char *argv[])
 	/* We don't want to block on accept() */
 	fcntl(ListenSocket, F_SETFL, fcntl(ListenSocket, F_GETFL) | O_NONBLOCK);
 
-	/* Now for the BIG LOOP. */
-	while(1)
+	ListenEpoll = epoll_create1(0);
 	{
-		int n;
+		struct epoll_event ev;
 
-		for(n=0; n<ServerConfig.MaxClients; n++)
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN | EPOLLET;
+		ev.data.ptr = NULL;
+		if(ListenEpoll == -1 || epoll_ctl(ListenEpoll, EPOLL_CTL_ADD, ListenSocket, &ev))
 		{
-			if(Clients[n].TCPSocket != -1) continue;
-			if((Clients[n].TCPSocket = accept(ListenSocket, (struct sockaddr *)&sockin, &sockin_len)) != -1)
-			{
-				struct sockaddr_in usockin;
-				/* We have a new client.  Yippie. */
+			printf("Error: %s\n",strerror(errno));
+			exit(-1);
+		}
+	}
 
-				fcntl(Clients[n].TCPSocket, F_SETFL, fcntl(Clients[n].TCPSocket, F_GETFL) | O_NONBLOCK);
+	printf("Running %d worker thread(s)\n", NumWorkers);
+	StartWorkers();
 
-				Clients[n].timeconnect = time(0);
-				Clients[n].id = n;
-				printf("Client %d connecting from %s on %s",n,inet_ntoa(sockin.sin_addr),ctime(&Clients[n].timeconnect));
-				{
-					uint8 buf[1];
+	/* Now for the BIG LOOP.  The games are run by the workers, this one only
+	   takes care of new connections and logins.
+	*/
+	while(1)
+	{
+		struct epoll_event events[MAX_EVENTS];
+		int count = epoll_wait(ListenEpoll, events, MAX_EVENTS, 1000);
+		int n;
 
-					buf[0] = ServerConfig.FrameDivisor;
-					send(Clients[n].TCPSocket,buf,1,MSG_NOSIGNAL);
-				}
-				StartNBTCPReceive(&Clients[n], NBTCP_LOGINLEN, 4);
+		for(n = 0; n < count; n++)
+		{
+			ClientEntry *client = (ClientEntry *)events[n].data.ptr;
+
+			if(!client)
+			{
+				AcceptClients();
+				continue;
+			}
+			if(client->state.load(std::memory_order_relaxed) != CLIENT_LOGIN || client->TCPSocket == -1)
+				continue;
+			try
+			{
+				CheckNBTCPReceive(client);
+			}
+			catch(int i)
+			{
+				KillClient(client);
 			}
 		}
 
 		/* Check for users still in the login process(not yet assigned a game). BOING */
 		time_t curtime = time(0);
 		for(n = 0; n < ServerConfig.MaxClients; n++)
-		try
-		{
-			if(Clients[n].TCPSocket != -1 && !Clients[n].game)
-			{
-				if((Clients[n].timeconnect + ServerConfig.ConnectTimeout) < curtime)
-				{
-					KillClient(&Clients[n]);
-				}
-				else
-					while(CheckNBTCPReceive(&Clients[n])) {};
-			}
-		}
-		catch(int i)
 		{
-			KillClient(&Clients[n]);
-		}
-
-		int whichgame;
-		for(whichgame = 0; whichgame < ServerConfig.MaxClients; whichgame ++)
-		{
-			/* Now, the loop to get data from each client.  Meep. */
-			for(n = 0; n < Games[whichgame].MaxPlayers; n++)
-			{
-				try
-				{
-					ClientEntry *client = Games[whichgame].Players[n];
-					if(!client || !Games[whichgame].IsUnique[n]) continue;
-					int localplayers = client->localplayers;
-
-					while(CheckNBTCPReceive(client)) {};
-				} // catch
-				catch(int i)
-				{
-					KillClient(Games[whichgame].Players[n]);
-				}
-			} // A games clients
+			ClientEntry *client = &Clients[n];
 
-			/* Now we send the data to all the clients. */
-			for(n = 0; n < Games[whichgame].MaxPlayers; n++)
-			{
-				if(!Games[whichgame].Players[n] || !Games[whichgame].IsUnique[n]) continue;
-				try
-				{
-					MakeSendTCP(Games[whichgame].Players[n], Games[whichgame].joybuf, 5);
-				}
-				catch(int i)
-				{
-					KillClient(Games[whichgame].Players[n]);
-				}
-			} // A game's clients
-		} // Games
-
-		SpeedThrottle();
+			if(client->state.load(std::memory_order_relaxed) != CLIENT_LOGIN)
+				continue;
+			if((client->timeconnect + ServerConfig.ConnectTimeout) < curtime)
+				KillClient(client);
+		}
 	} // while(1)
 }
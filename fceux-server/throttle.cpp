@@ -53,9 +53,6 @@ void KillThrottle(THROTTLE *throt)
 
 #endif
 
-static uint64 tfreq;
-static uint64 desiredfps;
-
 int32 FCEUI_GetDesiredFPS(void)
 {
   //if(PAL)
@@ -64,39 +61,8 @@ int32 FCEUI_GetDesiredFPS(void)
    return(1008307711);  // ~60.1
 }
 
-void RefreshThrottleFPS(int divooder)
+uint64 GetThrottlePeriod(int divooder)
 {
- desiredfps=(FCEUI_GetDesiredFPS() / divooder)>>8;
- tfreq=1000000;
- tfreq<<=16;    /* Adjustment for fps returned from FCEUI_GetDesiredFPS(). */
-}
-
-static uint64 GetCurTime(void)
-{
- uint64 ret;
- struct timeval tv;
-
- gettimeofday(&tv,0);
- ret=(uint64)tv.tv_sec*1000000;
- ret+=tv.tv_usec;
- return(ret);
+ /* FCEUI_GetDesiredFPS() is the frame rate times 2^24. */
+ return(((uint64)1000000000 << 24) * divooder / FCEUI_GetDesiredFPS());
 }
-
-void SpeedThrottle(void)
-{
- static uint64 ttime,ltime;
-
- waiter:
- ttime=GetCurTime();
-
- if( (ttime-ltime) < (tfreq/desiredfps) )
- {
-  usleep(1000);
-  goto waiter;
- }
- if( (ttime-ltime) >= (tfreq*4/desiredfps))
-  ltime=ttime;
- else
-  ltime+=tfreq/desiredfps;
-}
-
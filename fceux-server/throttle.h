@@ -19,5 +19,5 @@
  * */
 
 
-void RefreshThrottleFPS(int divooder);
-void SpeedThrottle(void);
+/* Nanoseconds between two updates sent to the clients. */
+uint64 GetThrottlePeriod(int divooder);
@@ -92,6 +92,7 @@ static INLINE void setpageptr(int s, uint32 A, uint8 *p, int ram) {
 			PRGIsRAM[AB + x] = 0;
 			Page[AB + x] = 0;
 		}
+	UpdateReadDirect(A, A + (s << 10) - 1);
 }
 
 static uint8 nothing[8192];
@@ -108,6 +109,7 @@ void ResetCartMapping(void) {
 	for (x = 0; x < 8; x++) {
 		MMC5SPRVPage[x] = MMC5BGVPage[x] = VPageR[x] = nothing - 0x400 * x;
 	}
+	UpdateReadDirect(0x0000, 0xFFFF);
 }
 
 void SetupCartPRGMapping(int chip, uint8 *p, uint32 size, int ram) {
@@ -13,11 +13,16 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <string>
+#include <vector>
 
 unsigned int debuggerPageSize = 14;
 int vblankScanLines = 0;	//Used to calculate scanlines 240-261 (vblank)
 int vblankPixel = 0;		//Used to calculate the pixels in vblank
 
+//set whenever the core changes a watchpoint, the index is rebuilt before it is used again
+static bool watchpointIndexStale = true;
+
 int offsetStringToInt(unsigned int type, const char* offsetBuffer)
 {
 	int offset = -1;
@@ -104,6 +109,8 @@ int getValue(int type)
 **/
 int checkCondition(const char* condition, int num)
 {
+	watchpointIndexStale = true;
+
 	const char* b = condition;
 
 	// Check if the condition isn't just all spaces.
@@ -211,6 +218,8 @@ unsigned int NewBreak(const char* name, int start, int end, unsigned int type, c
 	if (watchpoint[num].desc)
 		free(watchpoint[num].desc);
 
+	watchpointIndexStale = true;
+
 	watchpoint[num].desc = (char*)malloc(strlen(name) + 1);
 	strcpy(watchpoint[num].desc, name);
 
@@ -442,9 +451,200 @@ int evaluate(Condition* c)
 	return f;
 }
 
+// Conditions are also compiled into a flat list of stack machine
+// instructions, so that checking them on every instruction doesn't walk the
+// tree. A compiled condition gives the same result as evaluate(), quirks
+// included; trees that don't fit are left to evaluate().
+enum
+{
+	// OP_EQ .. OP_AND pop two values and push the result
+	COND_PUSH_NUM = 0x10,	// push arg
+	COND_PUSH_VALUE,	// push getValue(arg)
+	COND_MEM,		// replace the top value with the memory it addresses
+	COND_PC_BANK,		// replace the top value with the bank of the PC
+	COND_DATA_BANK,		// replace the top value with the bank of the last address
+	COND_VALUE_READ,	// replace the top value with the value read
+	COND_VALUE_WRITE,	// replace the top value with the value written
+};
+
+#define COND_MAX_STACK 32
+
+struct CondInstr
+{
+	unsigned int op;
+	int arg;
+};
+
+struct CompiledCondition
+{
+	Condition* src;		// the tree the code was compiled from
+	std::string text;	// and its text, a freed tree can come back at the same address
+	std::vector<CondInstr> code;
+};
+
+static CompiledCondition compiledCond[65];
+
+static void compileType(std::vector<CondInstr>& code, unsigned int type)
+{
+	CondInstr i = { 0, 0 };
+
+	switch (type)
+	{
+		case TYPE_ADDR: i.op = COND_MEM; break;
+		case TYPE_PC_BANK: i.op = COND_PC_BANK; break;
+		case TYPE_DATA_BANK: i.op = COND_DATA_BANK; break;
+		case TYPE_VALUE_READ: i.op = COND_VALUE_READ; break;
+		case TYPE_VALUE_WRITE: i.op = COND_VALUE_WRITE; break;
+		default: return;
+	}
+	code.push_back(i);
+}
+
+// Emits the code of one node, following evaluate() step by step.
+// depth is the number of values already on the stack.
+static bool compileCondition(std::vector<CondInstr>& code, Condition* c, int depth)
+{
+	CondInstr i = { 0, 0 };
+
+	if (depth + 2 > COND_MAX_STACK)
+	{
+		return false;
+	}
+
+	if (c->lhs)
+	{
+		if (!compileCondition(code, c->lhs, depth))
+			return false;
+	}
+	else
+	{
+		switch(c->type1)
+		{
+			case TYPE_ADDR:
+			case TYPE_NUM: i.op = COND_PUSH_NUM; break;
+			default: i.op = COND_PUSH_VALUE; break;
+		}
+		i.arg = c->value1;
+		code.push_back(i);
+	}
+	compileType(code, c->type1);
+
+	if (c->op)
+	{
+		if ((c->op < OP_EQ) || (c->op > OP_AND))
+			return false;
+
+		if (c->rhs)
+		{
+			if (!compileCondition(code, c->rhs, depth + 1))
+				return false;
+		}
+		else
+		{
+			// evaluate() reads registers of a leaf on the right by type2, not value2
+			switch(c->type2)
+			{
+				case TYPE_ADDR:
+				case TYPE_NUM: i.op = COND_PUSH_NUM; i.arg = c->value2; break;
+				default: i.op = COND_PUSH_VALUE; i.arg = c->type2; break;
+			}
+			code.push_back(i);
+		}
+		compileType(code, c->type2);
+
+		i.op = c->op;
+		i.arg = 0;
+		code.push_back(i);
+	}
+	return true;
+}
+
+static void compileWatchpointCondition(int num)
+{
+	CompiledCondition& cc = compiledCond[num];
+	const char* text = watchpoint[num].condText;
+
+	cc.src = watchpoint[num].cond;
+
+	if (!cc.src || !text)
+	{
+		cc.code.clear();
+		return;
+	}
+	// the same text compiles to the same code, the tree was only parsed again
+	if (!cc.code.empty() && (cc.text == text))
+	{
+		return;
+	}
+	cc.text = text;
+	cc.code.clear();
+
+	if (!compileCondition(cc.code, cc.src, 0))
+	{
+		cc.code.clear();
+	}
+}
+
+static int runCondition(const CondInstr* ip, const CondInstr* end)
+{
+	int stack[COND_MAX_STACK];
+	int sp = -1;
+
+	for (; ip != end; ip++)
+	{
+		switch (ip->op)
+		{
+			case COND_PUSH_NUM: stack[++sp] = ip->arg; break;
+			case COND_PUSH_VALUE: stack[++sp] = getValue(ip->arg); break;
+			case COND_MEM: stack[sp] = GetMem(stack[sp]); break;
+			case COND_PC_BANK: stack[sp] = getBank(_PC); break;
+			case COND_DATA_BANK: stack[sp] = getBank(debugLastAddress); break;
+			case COND_VALUE_READ: stack[sp] = GetMem(debugLastAddress); break;
+			case COND_VALUE_WRITE: stack[sp] = evaluateWrite(debugLastOpcode, debugLastAddress); break;
+			default:
+			{
+				int value2 = stack[sp--];
+				int value1 = stack[sp];
+				int f = value1;
+
+				switch (ip->op)
+				{
+					case OP_EQ: f = value1 == value2; break;
+					case OP_NE: f = value1 != value2; break;
+					case OP_GE: f = value1 >= value2; break;
+					case OP_LE: f = value1 <= value2; break;
+					case OP_G: f = value1 > value2; break;
+					case OP_L: f = value1 < value2; break;
+					case OP_MULT: f = value1 * value2; break;
+					case OP_DIV: f = (value2==0) ? 0 : (value1 / value2); break;
+					case OP_PLUS: f = value1 + value2; break;
+					case OP_MINUS: f = value1 - value2; break;
+					case OP_OR: f = value1 || value2; break;
+					case OP_AND: f = value1 && value2; break;
+				}
+				stack[sp] = f;
+				break;
+			}
+		}
+	}
+	return stack[0];
+}
+
 int condition(watchpointinfo* wp)
 {
-	return wp->cond == 0 || evaluate(wp->cond);
+	if (wp->cond == 0)
+		return 1;
+
+	int num = (int)(wp - watchpoint);
+
+	if ((num >= 0) && (num < 65))
+	{
+		const CompiledCondition& cc = compiledCond[num];
+
+		if ((cc.src == wp->cond) && !cc.code.empty() && wp->condText && (cc.text == wp->condText))
+			return runCondition(&cc.code[0], &cc.code[0] + cc.code.size());
+	}
+	return evaluate(wp->cond);
 }
 
 
@@ -456,6 +656,7 @@ unsigned int cdloggerdataSize = 0;
 static int indirectnext = 0;
 
 int debug_loggingCD = 0;
+int debug_tracing = 0;
 
 //called by the cpu to perform logging if CDLogging is enabled
 void LogCDVectors(int which){
@@ -486,7 +687,7 @@ void LogCDData(uint8 *opcode, uint16 A, int size)
 	uint8 memop = 0;
 	bool newCodeHit = false, newDataHit = false;
 
-	if ((j = GetPRGAddress(_PC)) != -1)
+	if ((j = debugInstr.prgAddr) != -1)
 	{
 		for (i = 0; i < size; i++)
 		{
@@ -600,6 +801,108 @@ void IncrementInstructionsCounters()
 	delta_instructions++;
 }
 
+// Summary of the enabled watchpoints, rebuilt from watchpoint[] whenever one
+// changes, so that breakpoint() can tell at a glance that an instruction
+// can't hit any of them and skip the full scan.
+static struct
+{
+	uint64 timestamp;	// timestampbase when watchpoint[] was last compared with wpIndexKey
+	uint8 cpuPage[256];	// WP_R/WP_W/WP_X of the CPU watchpoints covering some address of each page
+	bool ppu;		// any PPU, sprite or ROM watchpoints, these are always scanned
+	bool sprite;
+	bool rom;
+	uint8 stackIgnore;	// bit (opbrktype>>1) set when the scan would clear StackNextIgnorePC
+} wpIndex;
+
+// what the index was built from, the frontends edit watchpoint[] directly
+// without telling the core, so it is compared with them once per frame
+static struct
+{
+	uint32 address;
+	uint32 endaddress;
+	uint16 flags;
+	Condition* cond;
+	char* condText;
+} wpIndexKey[65];
+static int wpIndexKeyCount = -1;
+
+static bool WatchpointsEdited()
+{
+	if (wpIndexKeyCount != numWPs)
+		return true;
+
+	for (int i = 0; i < numWPs; i++)
+	{
+		const watchpointinfo& wp = watchpoint[i];
+
+		if ((wpIndexKey[i].address != wp.address) || (wpIndexKey[i].endaddress != wp.endaddress) ||
+		    (wpIndexKey[i].flags != wp.flags) || (wpIndexKey[i].cond != wp.cond) || (wpIndexKey[i].condText != wp.condText))
+			return true;
+	}
+	return false;
+}
+
+static void RebuildWatchpointIndex()
+{
+	memset(wpIndex.cpuPage, 0, sizeof(wpIndex.cpuPage));
+	wpIndex.ppu = wpIndex.sprite = wpIndex.rom = false;
+	wpIndex.stackIgnore = 0;
+
+	for (int i = 0; i < numWPs; i++)
+	{
+		const watchpointinfo& wp = watchpoint[i];
+
+		wpIndexKey[i].address = wp.address;
+		wpIndexKey[i].endaddress = wp.endaddress;
+		wpIndexKey[i].flags = wp.flags;
+		wpIndexKey[i].cond = wp.cond;
+		wpIndexKey[i].condText = wp.condText;
+
+		compileWatchpointCondition(i);
+
+		if (!(wp.flags & WP_E))
+			continue;
+
+		if (wp.flags & BT_P)
+		{
+			wpIndex.ppu = true;
+			continue;
+		}
+		if (wp.flags & BT_S)
+		{
+			wpIndex.sprite = true;
+			continue;
+		}
+		for (int t = 0; t < 4; t++)
+		{
+			if (!(wp.flags & ((t << 1) | WP_X)))
+				wpIndex.stackIgnore |= 1 << t;
+		}
+		if (wp.flags & BT_R)
+		{
+			wpIndex.rom = true;
+			continue;
+		}
+
+		uint32 start = wp.address, end = wp.address;
+
+		if (wp.endaddress)
+		{
+			end = wp.endaddress;
+		}
+		if (end > 0xFFFF)
+		{
+			end = 0xFFFF;
+		}
+		for (uint32 page = start >> 8; page <= (end >> 8); page++)
+		{
+			wpIndex.cpuPage[page] |= wp.flags & (WP_R | WP_W | WP_X);
+		}
+	}
+	wpIndexKeyCount = numWPs;
+	watchpointIndexStale = false;
+}
+
 bool CondForbidTest(int bp_num) {
 	if (bp_num >= 0 && !condition(&watchpoint[bp_num]))
 	{
@@ -635,6 +938,9 @@ void BreakHit(int bp_num)
 //#ifdef WIN32
 	FCEUD_DebugBreakpoint(bp_num);
 //#endif
+
+	//the watchpoints may have been edited while we were stopped here
+	watchpointIndexStale = true;
 }
 
 int StackAddrBackup;
@@ -707,8 +1013,6 @@ static void breakpoint(uint8 *opcode, uint16 A, int size) {
 		return;
 	}
 
-	romAddrPC = GetNesFileAddress(_PC);
-
 	brk_type = opbrktype[opcode[0]] | WP_X;
 
 	switch (opcode[0]) {
@@ -727,6 +1031,33 @@ static void breakpoint(uint8 *opcode, uint16 A, int size) {
 		default: break;
 	}
 
+	if (wpIndex.timestamp != timestampbase)
+	{
+		wpIndex.timestamp = timestampbase;
+		if (WatchpointsEdited())
+			watchpointIndexStale = true;
+	}
+	if (watchpointIndexStale)
+		RebuildWatchpointIndex();
+
+	//skip the scan when no watchpoint covers the addresses this instruction touches
+	if (!wpIndex.rom &&
+	    !(wpIndex.cpuPage[_PC >> 8] & WP_X) &&
+	    !(wpIndex.cpuPage[A >> 8] & (WP_R | WP_W)) &&
+	    !((wpIndex.cpuPage[0x01] & (WP_R | WP_W)) && (stackop || (X.S != StackAddrBackup))) &&
+	    !(wpIndex.ppu && (A >= 0x2000) && (A < 0x4000) && ((A&7) == 7)) &&
+	    !(wpIndex.sprite && (((A >= 0x2000) && (A < 0x4000) && ((A&7) == 4)) || (A == 0x4014))))
+	{
+		//the scan would still have dropped a pending stack ignore address
+		if ((StackNextIgnorePC == _PC) && (wpIndex.stackIgnore & (1 << (opbrktype[opcode[0]] >> 1))))
+			StackNextIgnorePC = 0xFFFF;
+
+		StackAddrBackup = X.S;
+		return;
+	}
+
+	romAddrPC = GetNesFileAddress(_PC);
+
 #define BREAKHIT(x) { if (CondForbidTest(x)) { breakHit = (x); goto STOPCHECKING; } }
 	int breakHit = -1;
 	for (i = 0; i < numWPs; i++)
@@ -893,12 +1224,8 @@ STOPCHECKING:
 }
 //bbit edited: this is the end of the inserted code
 
-void DebugCycle()
+void UpdateVBlankScanLines()
 {
-	uint8 opcode[3] = {0};
-	uint16 A = 0, tmp;
-	int size;
-
 	if (scanline == 240)
 	{
 		vblankScanLines = (PAL?int((double)timestamp / ((double)341 / (double)3.2)):timestamp / 114);	//114 approximates the number of timestamps per scanline during vblank.  Approx 2508. NTSC: (341 / 3.0) PAL: (341 / 3.2). Uses (3.? * cpu_cycles) / 341.0, and assumes 1 cpu cycle.
@@ -908,25 +1235,57 @@ void DebugCycle()
 	}
 	else
 		vblankScanLines = 0;
+}
+
+DebugInstruction debugInstr;
+
+//reads a byte for decoding the current instruction, same as GetMem(A).
+//RAM and plain PRG pages are read straight through the cpu's page table,
+//which always follows the current banks and never covers registers or
+//addresses with cheats or mapper handlers, so only those go through GetMem.
+static INLINE uint8 DecodeMem(uint16 A)
+{
+	uint8 *p = AReadDirect[A >> 8];
+
+	if (p && ((A < 0x2000) || (A >= 0x5000)))
+		return p[A];
+	return GetMem(A);
+}
+
+//returns true if DebugCycle() has anything to do; when it doesn't,
+//the cpu core is free to run its plain loop without calling it at all
+bool DebugCycleActive()
+{
+	return numWPs || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap || debug_loggingCD || debug_tracing;
+}
+
+void DebugCycle()
+{
+	uint8 *opcode = debugInstr.opcode;
+	uint16 A = 0, tmp;
+	int size;
+
+	UpdateVBlankScanLines();
 
 	if (GameInfo->type==GIT_NSF)
 	{
 		if ((_PC >= 0x3801) && (_PC <= 0x3824)) return;
 	}
 
-	opcode[0] = GetMem(_PC);
+	opcode[0] = DecodeMem(_PC);
+	opcode[1] = opcode[2] = 0;
 	size = opsize[opcode[0]];
 	switch (size)
 	{
 		default:
 		case 1: break;
 		case 2:
-			opcode[1] = GetMem(_PC + 1);
+			opcode[1] = DecodeMem(_PC + 1);
 			break;
 		case 0: // illegal instructions may have operands
 		case 3:
-			opcode[1] = GetMem(_PC + 1);
-			opcode[2] = GetMem(_PC + 2);
+			opcode[1] = DecodeMem(_PC + 1);
+			opcode[2] = DecodeMem(_PC + 2);
 			break;
 	}
 
@@ -935,19 +1294,24 @@ void DebugCycle()
 		case 0: break;
 		case 1:
 			tmp = (opcode[1] + _X) & 0xFF;
-			A = GetMem(tmp);
+			A = DecodeMem(tmp);
 			tmp = (opcode[1] + _X + 1) & 0xFF;
-			A |= (GetMem(tmp) << 8);
+			A |= (DecodeMem(tmp) << 8);
 			break;
 		case 2: A = opcode[1]; break;
 		case 3: A = opcode[1] | (opcode[2] << 8); break;
-		case 4: A = (GetMem(opcode[1]) | (GetMem((opcode[1] + 1) & 0xFF) << 8)) + _Y; break;
+		case 4: A = (DecodeMem(opcode[1]) | (DecodeMem((opcode[1] + 1) & 0xFF) << 8)) + _Y; break;
 		case 5: A = opcode[1] + _X; break;
 		case 6: A = (opcode[1] | (opcode[2] << 8)) + _Y; break;
 		case 7: A = (opcode[1] | (opcode[2] << 8)) + _X; break;
 		case 8: A = opcode[1] + _Y; break;
 	}
 
+	debugInstr.pc = _PC;
+	debugInstr.addr = A;
+	debugInstr.size = size;
+	debugInstr.prgAddr = GetPRGAddress(_PC);
+
 	if (numWPs || dbgstate.step || dbgstate.runline || dbgstate.stepout || watchpoint[64].flags || dbgstate.badopbreak || break_on_cycles || break_on_instructions || break_asap)
 		breakpoint(opcode, A, size);
 
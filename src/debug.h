@@ -87,16 +87,32 @@ static INLINE int FCEUI_GetLoggingCD() { return debug_loggingCD; }
 //-------
 
 //-------tracing
-//we're letting the win32 driver handle this ittself for now
-//extern int debug_tracing;
-//static INLINE void FCEUI_SetTracing(int val) { debug_tracing = val; }
-//static INLINE int FCEUI_GetTracing() { return debug_tracing; }
+//the drivers still do the actual logging in FCEUD_TraceInstruction(),
+//but they have to tell the core when a trace is running so that DebugCycle() gets called
+extern int debug_tracing;
+static INLINE void FCEUI_SetTracing(int val) { debug_tracing = val; }
+static INLINE int FCEUI_GetTracing() { return debug_tracing; }
 //---------
 
 //--------debugger
 extern int iaPC;
 extern uint32 iapoffset; //mbg merge 7/18/06 changed from int
+
+//the instruction DebugCycle() is about to let the cpu run. it is decoded once there
+//and shared with the code/data logger and the trace loggers, which used to decode it again.
+struct DebugInstruction
+{
+	uint16 pc;
+	uint16 addr;	//operand address, 0 when the instruction has none
+	int prgAddr;	//GetPRGAddress(pc), -1 when not running from PRG
+	int size;	//opsize[opcode[0]]
+	uint8 opcode[3];
+};
+extern DebugInstruction debugInstr;
+
 void DebugCycle();
+bool DebugCycleActive();
+void UpdateVBlankScanLines();
 bool CondForbidTest(int bp_num);
 void BreakHit(int bp_num);
 
@@ -37,7 +37,10 @@ void FCEUD_Message(const char *s);
 //Network interface
 
 //Call only when a game is loaded.
-int FCEUI_NetplayStart(int nlocal, int divisor);
+//rollback is 0 for lockstep netplay, or how many frames may run ahead of the server with the
+//remote joypads predicted, up to NETPLAY_ROLLBACK_MAX.  Rollback needs fceux-server in rollback mode.
+#define NETPLAY_ROLLBACK_MAX 30
+int FCEUI_NetplayStart(int nlocal, int divisor, int rollback = 0);
 
 // Call when network play needs to stop.
 void FCEUI_NetplayStop(void);
@@ -48,6 +51,13 @@ void FCEUI_NetplayStop(void);
 int FCEUD_SendData(void *data, uint32 len);
 int FCEUD_RecvData(void *data, uint32 len);
 
+//Returns how many bytes FCEUD_RecvData() can get without waiting, -1 on failure.
+int FCEUD_RecvDataPending(void);
+
+//Runs rollback netplay for two players over a simulated server and network, see netplay.cpp.
+//Returns 1 when both players end up with the same state as the relayed input gives.
+int FCEUI_NetplayLoopbackTest(int frames, int delay, int jitter, int rollback);
+
 //Display text received over the network.
 void FCEUD_NetplayText(uint8 *text);
 
@@ -104,12 +114,51 @@ FCEUGI *FCEUI_LoadGame(const char *name, int OverwriteVidMode, bool silent = fal
 //name is the logical path to open; archiveFilename is the archive which contains name
 FCEUGI *FCEUI_LoadGameVirtual(const char *name, int OverwriteVidMode, bool silent = false);
 
+//Checks the iNES files named in list, one path a line, without loading them and writes a CSV line
+//for each one to csv: the mapper, mirroring, battery and region the game would get after the
+//header corrections, what was corrected and whether it's a known bad dump.  "-" is stdin/stdout.
+//A file shorter than its header says only gets "truncated", impossible sizes get "bad header".
+//Returns the number of files checked, -1 if list or csv couldn't be opened.
+int FCEUI_ValidateRomSet(const char *list, const char *csv);
+
+//Plays back the movies named in list, one "rom<TAB>movie" pair a line, without a driver and compares
+//the emulation against <movie>.hashes, which has a crc32 of every savestate entry (RAM, PPU, APU,
+//mapper...) every interval frames and is written the first time a movie is verified.  A CSV line for
+//each movie goes to report, in the order of the list: the status (new, ok, desync or error) and for a
+//desync the first checkpoint and savestate entry that differ.  Up to jobs movies (0 for one per CPU
+//core) are played at the same time, each in a process of its own; on Windows they run one at a time.
+//Returns the number of movies that desynced or failed, -1 if list or report couldn't be opened.
+int FCEUI_VerifyMovies(const char *list, const char *report, int interval, int jobs);
+
 //general purpose emulator initialization. returns true if successful
 bool FCEUI_Initialize();
 
 //Emulates a frame.
 void FCEUI_Emulate(uint8 **, int32 **, int32 *, int);
 
+//Describes a run of frames for FCEUI_EmulateFrames. Every output pointer may be NULL when that output is not wanted.
+struct FCEUI_FrameBatch
+{
+	int frames;               //number of frames to run
+	const uint32 *input;      //frames entries, gamepad N in bits 8*N..8*N+7 like the FCEUI_SetInput gamepad data. NULL keeps the current input
+	const uint16 *ramAddrs;   //CPU addresses sampled at the end of every frame
+	int ramAddrCount;
+	uint8 *ramOut;            //frames*ramAddrCount bytes, the samples of frame 0 first
+	uint8 *frameOut;          //256*240 bytes, the palette indices of the last frame
+	int32 *soundOut;          //samples of all the frames one after another. NULL skips sound synthesis
+	int soundOutMax;          //size of soundOut in samples, extra samples are dropped
+
+	//set by FCEUI_EmulateFrames
+	int framesRun;
+	int soundOutCount;
+};
+
+//Emulates several frames back to back for headless users such as bots and training loops.
+//Unlike FCEUI_Emulate it does not poll the drivers, record or play movies, run Lua callbacks,
+//draw overlays or honor pause and frame advance; only the emulation itself and the cheats run.
+//Returns the number of frames emulated.
+int FCEUI_EmulateFrames(FCEUI_FrameBatch *batch);
+
 //Closes currently loaded game
 void FCEUI_CloseGame(void);
 
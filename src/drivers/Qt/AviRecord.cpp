@@ -26,6 +26,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <string>
+#include <atomic>
 
 #ifdef WIN32
 #include <windows.h>
@@ -78,19 +79,37 @@ extern "C"
 static gwavi_t  *gwavi = NULL;
 static bool      recordEnable = false;
 static bool      recordAudio  = true;
-static int       vbufHead = 0;
-static int       vbufTail = 0;
-static int       vbufSize = 0;
 static int       abufHead = 0;
 static int       abufTail = 0;
 static int       abufSize = 0;
-static uint32_t *rawVideoBuf = NULL;
 static int16_t  *rawAudioBuf = NULL;
 static int       aviDriver = 0;
 static int       videoFormat = AVI_RGB24;
 static int       audioSampleRate = 48000;
 static FILE     *avLogFp = NULL;
 
+// Video frames travel through a small pool of recycled slots. The emulator
+// copies each frame into the next free slot, converter threads turn it into
+// the encoder's pixel format in place and the disk thread encodes and writes
+// the slots back out in frame order before handing them back to the emulator.
+#define  AVI_FRAME_POOL_SIZE   8
+
+struct aviFrameSlot_t
+{
+	uint32_t      *rgb32;  // frame as copied from nes_shm->avibuf
+	unsigned char *out;    // converted frame, unused for libav which takes rgb32
+	std::atomic <uint64_t> convSeq;  // frame number + 1 once out holds that frame
+};
+
+static aviFrameSlot_t aviFramePool[ AVI_FRAME_POOL_SIZE ];
+static int       aviFramePixels = 0;
+static int       aviNumConvThreads = 1;
+static std::atomic <uint64_t> frameFillCount(0);  // frames queued by the emulator
+static std::atomic <uint64_t> frameDoneCount(0);  // frames written by the disk thread
+static std::atomic <uint64_t> frameBackpressureCount(0);
+static std::atomic <bool>     frameConvStop(false);
+static std::atomic <bool>     diskThreadActive(false);  // cleared once the disk thread takes no more frames
+
 //**************************************************************************************
 
 static void convertRgb_32_to_24( const unsigned char *src, unsigned char *dest, int w, int h, int nPix, bool verticalFlip )
@@ -341,7 +360,10 @@ static int encode_frame( unsigned char *inBuf, int width, int height )
 		{
 			flags |= gwavi_t::IF_KEYFRAME;
 		}
-		gwavi->add_frame( nal->p_payload, i_frame_size, flags );
+		if ( gwavi->add_frame( nal->p_payload, i_frame_size, flags ) < 0 )
+		{
+			return -1;
+		}
 	}
 	return i_frame_size;
 }
@@ -461,7 +483,7 @@ static int encode_frame( unsigned char *inBuf, int width, int height )
 
 	ret = x265_encoder_encode( hdl, &nal, &i_nal, pic, &pic_out );
 
-	if ( ret <= 0 )
+	if ( ret < 0 )
 	{
 		return -1;
 	}
@@ -479,7 +501,10 @@ static int encode_frame( unsigned char *inBuf, int width, int height )
 		{
 			totalPayload += nal[i].sizeBytes;
 		}
-		gwavi->add_frame( nal[0].payload, totalPayload, flags );
+		if ( gwavi->add_frame( nal[0].payload, totalPayload, flags ) < 0 )
+		{
+			return -1;
+		}
 	}
 	return ret;
 }
@@ -730,7 +755,10 @@ static int encode_frame( unsigned char *inBuf, int width, int height )
 		//printf("Compressing Frame:%i   Size:%i  Flags:%08X\n",
 		//		frameNum, bmapOut->biSizeImage, flagsOut );
 		bytesWritten = bmapOut->biSizeImage;
-		gwavi->add_frame( (unsigned char*)outBuf, bytesWritten, flagsOut );
+		if ( gwavi->add_frame( (unsigned char*)outBuf, bytesWritten, flagsOut ) < 0 )
+		{
+			return -1;
+		}
 	}
 	else
 	{
@@ -2248,17 +2276,42 @@ int aviRecordOpenFile( const char *filepath )
 		}
 	}
 
-	vbufSize    = 1024 * 1024 * 60;
-	rawVideoBuf = (uint32_t*)malloc( vbufSize * sizeof(uint32_t) );
+	aviFramePixels = nes_shm->video.ncol * nes_shm->video.nrow;
+
+	for (int i=0; i<AVI_FRAME_POOL_SIZE; i++)
+	{
+		aviFramePool[i].rgb32 = (uint32_t*)malloc( aviFramePixels * sizeof(uint32_t) );
+		aviFramePool[i].out   = (unsigned char*)malloc( aviFramePixels * sizeof(uint32_t) );
+		aviFramePool[i].convSeq = 0;
+
+		if ( aviFramePool[i].out )
+		{
+			memset( aviFramePool[i].out, 0, aviFramePixels * sizeof(uint32_t) );
+		}
+	}
+	frameFillCount = 0;
+	frameDoneCount = 0;
+	frameBackpressureCount = 0;
+
+	// Leave a core for the emulator and one for the disk thread.
+	aviNumConvThreads = QThread::idealThreadCount() - 2;
+
+	if ( aviNumConvThreads < 1 )
+	{
+		aviNumConvThreads = 1;
+	}
+	else if ( aviNumConvThreads > AVI_MAX_CONV_THREADS )
+	{
+		aviNumConvThreads = AVI_MAX_CONV_THREADS;
+	}
 
 	abufSize    = 96000;
 	rawAudioBuf = (int16_t*)malloc( abufSize * sizeof(uint16_t) );
 
-	vbufHead = 0;
-	vbufTail = 0;
 	abufHead = 0;
 	abufTail = 0;
 
+	diskThreadActive = true;
 	recordEnable = true;
 	return 0;
 }
@@ -2274,42 +2327,48 @@ int aviRecordAddFrame( void )
 	//{
 	//	return -1;
 	//}
+	if ( !diskThreadActive.load( std::memory_order_acquire ) )
+	{
+		// The disk thread stopped on an error and is closing the file.
+		return -1;
+	}
 	if ( FCEUI_EmulationPaused() )
 	{
 		return 0;
 	}
 
-	int i, head, numPixels, availSize;
-
-	numPixels  = nes_shm->video.ncol * nes_shm->video.nrow;
+	int numPixels;
+	uint64_t fill = frameFillCount.load( std::memory_order_relaxed );
+	aviFrameSlot_t *slot;
 
-	availSize = (vbufTail - vbufHead);
-	if ( availSize <= 0 )
+	if ( (fill - frameDoneCount.load( std::memory_order_acquire )) >= AVI_FRAME_POOL_SIZE )
 	{
-		availSize += vbufSize;
-	}
-
-	while ( numPixels > availSize )
-	{
-		//printf("Video Unavail %i \n", availSize );
-		msleep(1);
+		// Every slot is still waiting for the encoder, hold the emulator
+		// back until one is recycled. The frame is never dropped, its audio
+		// has already been queued and the file would drift out of sync.
+		frameBackpressureCount++;
 
-		availSize = (vbufTail - vbufHead);
-		if ( availSize <= 0 )
+		while ( (fill - frameDoneCount.load( std::memory_order_acquire )) >= AVI_FRAME_POOL_SIZE )
 		{
-			availSize += vbufSize;
+			if ( !diskThreadActive.load( std::memory_order_acquire ) )
+			{
+				// Nothing will recycle the slots anymore.
+				return -1;
+			}
+			msleep(1);
 		}
 	}
+	slot = &aviFramePool[ fill % AVI_FRAME_POOL_SIZE ];
 
-	i = 0; head = vbufHead;
+	numPixels  = nes_shm->video.ncol * nes_shm->video.nrow;
 
-	while ( i < numPixels )
+	if ( numPixels > aviFramePixels )
 	{
-		rawVideoBuf[ head ] = nes_shm->avibuf[i]; i++;
-
-		head = (head + 1) % vbufSize;
+		numPixels = aviFramePixels;
 	}
-	vbufHead = head;
+	memcpy( slot->rgb32, nes_shm->avibuf, numPixels * sizeof(uint32_t) );
+
+	frameFillCount.store( fill + 1, std::memory_order_release );
 
 	return 0;
 }
@@ -2351,20 +2410,40 @@ int aviRecordClose(void)
 		delete gwavi; gwavi = NULL;
 	}
 
-	if ( rawVideoBuf != NULL )
+	for (int i=0; i<AVI_FRAME_POOL_SIZE; i++)
 	{
-		free(rawVideoBuf); rawVideoBuf = NULL;
+		if ( aviFramePool[i].rgb32 != NULL )
+		{
+			free(aviFramePool[i].rgb32); aviFramePool[i].rgb32 = NULL;
+		}
+		if ( aviFramePool[i].out != NULL )
+		{
+			free(aviFramePool[i].out); aviFramePool[i].out = NULL;
+		}
 	}
+	aviFramePixels = 0;
+
 	if ( rawAudioBuf != NULL )
 	{
 		free(rawAudioBuf); rawAudioBuf = NULL;
 	}
-	vbufTail = abufTail = 0;
-	vbufSize = abufSize = 0;
+	abufTail = 0;
+	abufSize = 0;
 
 	return 0;
 }
 //**************************************************************************************
+void aviRecordGetStats( aviRecordStats_t *stats )
+{
+	uint64_t fill = frameFillCount.load( std::memory_order_relaxed );
+	uint64_t done = frameDoneCount.load( std::memory_order_relaxed );
+
+	stats->queueDepth   = recordEnable && (fill > done) ? (unsigned int)(fill - done) : 0;
+	stats->queueSize    = AVI_FRAME_POOL_SIZE;
+	stats->convThreads  = aviNumConvThreads;
+	stats->backpressureCount = frameBackpressureCount.load( std::memory_order_relaxed );
+}
+//**************************************************************************************
 bool aviGetAudioEnable(void)
 {
 	return recordAudio;
@@ -2496,6 +2575,80 @@ int FCEUD_AviGetFormatOpts( std::vector <std::string> &formatList )
 	return AVI_NUM_ENC;
 }
 //**************************************************************************************
+// AVI Recorder Conversion Threads
+//**************************************************************************************
+//----------------------------------------------------
+AviRecordConvThread_t::AviRecordConvThread_t( int id, int format, int width, int height, QObject *parent )
+	: QThread(parent)
+{
+	this->id     = id;
+	this->format = format;
+	this->width  = width;
+	this->height = height;
+}
+//----------------------------------------------------
+AviRecordConvThread_t::~AviRecordConvThread_t(void)
+{
+
+}
+//----------------------------------------------------
+void AviRecordConvThread_t::convertFrame( aviFrameSlot_t *slot )
+{
+	int numPixels = width * height;
+
+	switch ( format )
+	{
+		case AVI_I420:
+		#ifdef _USE_X264
+		case AVI_X264:
+		#endif
+		#ifdef _USE_X265
+		case AVI_X265:
+		#endif
+			Convert_4byte_To_I420Frame<4>(slot->rgb32,slot->out,numPixels,width);
+		break;
+		#ifdef _USE_LIBAV
+		case AVI_LIBAV:
+			// libav does its own colorspace conversion from the rgb32 frame.
+		break;
+		#endif
+		default:
+			convertRgb_32_to_24( (const unsigned char*)slot->rgb32, slot->out,
+					width, height, numPixels, true );
+		break;
+	}
+}
+//----------------------------------------------------
+void AviRecordConvThread_t::run(void)
+{
+	// Thread n converts frames n, n + aviNumConvThreads, ... so the
+	// threads never share a slot and each one works through its frames in order.
+	uint64_t frame = id;
+
+	while ( true )
+	{
+		if ( frame < frameFillCount.load( std::memory_order_acquire ) )
+		{
+			aviFrameSlot_t *slot = &aviFramePool[ frame % AVI_FRAME_POOL_SIZE ];
+
+			convertFrame( slot );
+
+			slot->convSeq.store( frame + 1, std::memory_order_release );
+
+			frame += aviNumConvThreads;
+		}
+		else if ( frameConvStop.load( std::memory_order_acquire ) )
+		{
+			break;
+		}
+		else
+		{
+			msleep(1);
+		}
+	}
+}
+//----------------------------------------------------
+//**************************************************************************************
 // AVI Recorder Disk Thread
 //**************************************************************************************
 //----------------------------------------------------
@@ -2511,16 +2664,17 @@ AviRecordDiskThread_t::~AviRecordDiskThread_t(void)
 //----------------------------------------------------
 void AviRecordDiskThread_t::run(void)
 {
-	int numPixels, width, height, numPixelsReady = 0;
+	int numPixels, width, height;
 	int numSamples = 0;
 	double fps = 60.0;
-	unsigned char *rgb24;
 	int16_t *audioOut;
-	uint32_t *videoOut;
 	char writeAudio = 1;
 	char localRecordAudio = 0;
 	int  avgAudioPerFrame, audioChunkSize, audioSamplesAvail=0;
 	int  localVideoFormat;
+	int  ret;
+	bool writeFailed = false;
+	bool emuLocked = false;
 
 	fprintf( avLogFp, "AVI Record Disk Thread Start\n");
 
@@ -2537,16 +2691,14 @@ void AviRecordDiskThread_t::run(void)
 	height    = nes_shm->video.nrow;
 	numPixels = width * height;
 
-	rgb24 = (unsigned char *)malloc( numPixels * sizeof(uint32_t) );
-
-	if ( rgb24 )
+	for (int i=0; i<AVI_FRAME_POOL_SIZE; i++)
 	{
-		memset( rgb24, 0, numPixels * sizeof(uint32_t) );
-	}
-	else
-	{
-		// Error allocating buffer.
-		return;
+		if ( (aviFramePool[i].rgb32 == NULL) || (aviFramePool[i].out == NULL) )
+		{
+			// Error allocating buffer.
+			diskThreadActive = false;
+			return;
+		}
 	}
 #ifdef _USE_LIBAV
 	if ( aviDriver == AVI_DRIVER_LIBAV )
@@ -2588,20 +2740,24 @@ void AviRecordDiskThread_t::run(void)
 #endif
 
 	audioOut = (int16_t *)malloc(96000);
-	videoOut = (uint32_t*)malloc(1048576);
 
-	// Main Disk Record Loop
-	while ( !isInterruptionRequested() )
+	frameConvStop = false;
+
+	for (int i=0; i<aviNumConvThreads; i++)
 	{
-		
-		while ( (numPixelsReady < numPixels) && (vbufTail != vbufHead) )
-		{
-			videoOut[ numPixelsReady ] = rawVideoBuf[ vbufTail ]; numPixelsReady++;
-			
-			vbufTail = (vbufTail + 1) % vbufSize;
-		}
+		convThread[i] = new AviRecordConvThread_t( i, localVideoFormat, width, height );
+		convThread[i]->start( QThread::HighPriority );
+	}
 
-		if ( numPixelsReady >= numPixels )
+	// Main Disk Record Loop, keeps going after a stop request until
+	// every queued frame has been written.
+	while ( !isInterruptionRequested() || (frameDoneCount.load( std::memory_order_relaxed ) < frameFillCount.load( std::memory_order_acquire )) )
+	{
+		uint64_t frame = frameDoneCount.load( std::memory_order_relaxed );
+		aviFrameSlot_t *slot = &aviFramePool[ frame % AVI_FRAME_POOL_SIZE ];
+
+		if ( (frame < frameFillCount.load( std::memory_order_acquire )) &&
+				(slot->convSeq.load( std::memory_order_acquire ) == (frame + 1)) )
 		{
 			//printf("Adding Frame:%i\n", frameCount++);
 
@@ -2609,48 +2765,46 @@ void AviRecordDiskThread_t::run(void)
 
 			if ( localVideoFormat == AVI_I420)
 			{
-				Convert_4byte_To_I420Frame<4>(videoOut,rgb24,numPixels,width);
-				gwavi->add_frame( rgb24, (numPixels*3)/2 );
+				ret = gwavi->add_frame( slot->out, (numPixels*3)/2 );
 			}
 			#ifdef _USE_X264
 			else if ( localVideoFormat == AVI_X264)
 			{
-				Convert_4byte_To_I420Frame<4>(videoOut,rgb24,numPixels,width);
-				X264::encode_frame( rgb24, width, height );
+				ret = X264::encode_frame( slot->out, width, height );
 			}
 			#endif
 			#ifdef _USE_X265
 			else if ( localVideoFormat == AVI_X265)
 			{
-				Convert_4byte_To_I420Frame<4>(videoOut,rgb24,numPixels,width);
-				X265::encode_frame( rgb24, width, height );
+				ret = X265::encode_frame( slot->out, width, height );
 			}
 			#endif
 			#ifdef WIN32
 			else if ( localVideoFormat == AVI_VFW)
 			{
-				convertRgb_32_to_24( (const unsigned char*)videoOut, rgb24,
-						width, height, numPixels, true );
-				VFW::encode_frame( rgb24, width, height );
+				ret = VFW::encode_frame( slot->out, width, height );
 			}
 			#endif
 			#ifdef _USE_LIBAV
 			else if ( localVideoFormat == AVI_LIBAV)
 			{
-				//Convert_4byte_To_I420Frame<4>(videoOut,rgb24,numPixels,width);
-				//convertRgb_32_to_24( (const unsigned char*)videoOut, rgb24,
-				//		width, height, numPixels, true );
-				LIBAV::encode_video_frame( (unsigned char*)videoOut );
+				ret = LIBAV::encode_video_frame( (unsigned char*)slot->rgb32 );
 			}
 			#endif
 			else
 			{
-				convertRgb_32_to_24( (const unsigned char*)videoOut, rgb24,
-						width, height, numPixels, true );
-				gwavi->add_frame( rgb24, numPixels*3 );
+				ret = gwavi->add_frame( slot->out, numPixels*3 );
+			}
+
+			if ( ret < 0 )
+			{
+				fprintf( avLogFp, "Error: Failed to write video frame %llu, stopping recording.\n", (unsigned long long)frame );
+				writeFailed = true;
+				break;
 			}
 
-			numPixelsReady = 0;
+			// Slot goes back to the emulator.
+			frameDoneCount.store( frame + 1, std::memory_order_release );
 
 			audioSamplesAvail = abufHead - abufTail;
 
@@ -2682,15 +2836,22 @@ void AviRecordDiskThread_t::run(void)
 					#ifdef _USE_LIBAV
 					if ( localVideoFormat == AVI_LIBAV)
 					{
-						LIBAV::encode_audio_frame( audioOut, numSamples );
+						ret = LIBAV::encode_audio_frame( audioOut, numSamples );
 					}
 					else
 					#endif
 					{
-						gwavi->add_audio( (unsigned char *)audioOut, numSamples*2);
+						ret = gwavi->add_audio( (unsigned char *)audioOut, numSamples*2);
 					}
 
 					numSamples = 0;
+
+					if ( ret < 0 )
+					{
+						fprintf( avLogFp, "Error: Failed to write audio, stopping recording.\n");
+						writeFailed = true;
+						break;
+					}
 				}
 			}
 		}
@@ -2699,6 +2860,9 @@ void AviRecordDiskThread_t::run(void)
 			msleep(1);
 		}
 	}
+	// Frames queued from here on are never written, stop the emulator
+	// waiting on them.
+	diskThreadActive = false;
 
 	// Write Leftover Audio Samples
 	audioSamplesAvail = abufHead - abufTail;
@@ -2707,7 +2871,7 @@ void AviRecordDiskThread_t::run(void)
 	{
 		audioSamplesAvail += abufSize;
 	}
-	writeAudio = (audioSamplesAvail > 0);
+	writeAudio = (audioSamplesAvail > 0) && !writeFailed;
 
 	if ( writeAudio && localRecordAudio )
 	{
@@ -2740,7 +2904,14 @@ void AviRecordDiskThread_t::run(void)
 	}
 
 	// Start of Disk Thread Cleanup
-	free(rgb24);
+	frameConvStop = true;
+
+	for (int i=0; i<aviNumConvThreads; i++)
+	{
+		convThread[i]->wait();
+
+		delete convThread[i]; convThread[i] = NULL;
+	}
 
 #ifdef _USE_X264
 	if ( localVideoFormat == AVI_X264)
@@ -2766,10 +2937,29 @@ void AviRecordDiskThread_t::run(void)
 		VFW::close();
 	}
 #endif
+	if ( writeFailed )
+	{
+		// Nobody asked to stop, so the emulator may still be copying a
+		// frame into the pool. Take its mutex before freeing the pool,
+		// unless a stop request comes in, the GUI holds the mutex then.
+		while ( !isInterruptionRequested() )
+		{
+			if ( FCEU_WRAPPER_TRYLOCK(100) )
+			{
+				emuLocked = true;
+				break;
+			}
+		}
+	}
 	aviRecordClose();
 
+	if ( emuLocked )
+	{
+		FCEU_DispMessage("AVI recording stopped, write error. See %s", 0, AV_LOG_FILE_NAME);
+		FCEU_WRAPPER_UNLOCK();
+	}
+
 	free(audioOut);
-	free(videoOut);
 
 	fprintf( avLogFp, "AVI Record Disk Thread Exit\n");
 	emit finished();
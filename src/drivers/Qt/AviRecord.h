@@ -63,6 +63,16 @@ int aviRecordClose(void);
 
 bool aviRecordRunning(void);
 
+struct aviRecordStats_t
+{
+	unsigned int queueDepth;   // frames copied in but not yet written
+	unsigned int queueSize;    // frame slots in the pool
+	unsigned int convThreads;  // colorspace conversion threads
+	unsigned long long backpressureCount;  // times the emulator waited for a free slot
+};
+
+void aviRecordGetStats( aviRecordStats_t *stats );
+
 bool aviGetAudioEnable(void);
 
 void aviSetAudioEnable(bool val);
@@ -81,6 +91,30 @@ int FCEUD_AviGetFormatOpts( std::vector <std::string> &formatList );
 
 //int aviDebugOpenFile( const char *filepath );
 
+#define  AVI_MAX_CONV_THREADS  4
+
+struct aviFrameSlot_t;
+
+class  AviRecordConvThread_t : public QThread
+{
+	Q_OBJECT
+
+	protected:
+		void run( void ) override;
+
+	public:
+		AviRecordConvThread_t( int id, int format, int width, int height, QObject *parent = 0 );
+		~AviRecordConvThread_t(void);
+
+	private:
+		void convertFrame( aviFrameSlot_t *slot );
+
+		int id;
+		int format;
+		int width;
+		int height;
+};
+
 class  AviRecordDiskThread_t : public QThread
 {
 	Q_OBJECT
@@ -93,6 +127,7 @@ class  AviRecordDiskThread_t : public QThread
 		~AviRecordDiskThread_t(void);
 
 	private:
+		AviRecordConvThread_t *convThread[AVI_MAX_CONV_THREADS];
 
 	signals:
 		void finished(void);
@@ -45,6 +45,7 @@ ConsoleSndConfDialog_t::ConsoleSndConfDialog_t(QWidget *parent)
 	QSlider *vslider;
 
 	sndQuality = 1;
+	starveBase = 0;
 
 	setWindowTitle(tr("Sound Config"));
 
@@ -133,6 +134,13 @@ ConsoleSndConfDialog_t::ConsoleSndConfDialog_t(QWidget *parent)
 
 	connect(bufSizeSlider, SIGNAL(valueChanged(int)), this, SLOT(bufSizeChanged(int)));
 
+	adaptiveBufSize = new QCheckBox(tr("Adaptive Buffer Size"));
+	adaptiveBufSize->setToolTip( tr("Start with a small buffer and grow it when the audio output underruns,\nthe buffer size above is the upper limit.") );
+	setCheckBoxFromProperty(adaptiveBufSize, "SDL.Sound.AdaptiveBufSize");
+	connect(adaptiveBufSize, SIGNAL(stateChanged(int)), this, SLOT(adaptiveBufSizeChanged(int)));
+
+	vbox1->addWidget(adaptiveBufSize);
+
 	bufUsage = new QProgressBar();
 	bufUsage->setToolTip( tr("% use of audio samples FIFO buffer.\n\nThe emulation thread fills the buffer and the audio thread drains it.") );
 	bufUsage->setOrientation( Qt::Horizontal );
@@ -309,7 +317,8 @@ void ConsoleSndConfDialog_t::closeWindow(void)
 //----------------------------------------------------
 void ConsoleSndConfDialog_t::resetCounters(void)
 {
-	nes_shm->sndBuf.starveCounter = 0;
+	// the count is shared with the adaptive buffer, only move the baseline
+	starveBase = GetSoundStarveCount();
 
 	periodicUpdate();
 }
@@ -327,7 +336,7 @@ void ConsoleSndConfDialog_t::periodicUpdate(void)
 
 	bufUsage->setValue( (int)(percBufUse) );
 
-	sprintf( stmp, "Sink Starve Count: %u", nes_shm->sndBuf.starveCounter );
+	sprintf( stmp, "Sink Starve Count: %u", GetSoundStarveCount() - starveBase );
 
 	starveLbl->setText( tr(stmp) );
 }
@@ -408,6 +417,18 @@ void ConsoleSndConfDialog_t::bufSizeChanged(int value)
 	}
 }
 //----------------------------------------------------
+void ConsoleSndConfDialog_t::adaptiveBufSizeChanged(int value)
+{
+	g_config->setOption("SDL.Sound.AdaptiveBufSize", value != Qt::Unchecked);
+	// reset sound subsystem for changes to take effect
+	if (FCEU_WRAPPER_TRYLOCK(1000))
+	{
+		KillSound();
+		InitSound();
+		FCEU_WRAPPER_UNLOCK();
+	}
+}
+//----------------------------------------------------
 void ConsoleSndConfDialog_t::volumeChanged(int value)
 {
 	char stmp[32];
@@ -34,6 +34,7 @@ protected:
 	QCheckBox *enaLowPass;
 	QCheckBox *swapDutyChkbox;
 	QCheckBox *useGlobalFocus;
+	QCheckBox *adaptiveBufSize;
 	QComboBox *qualitySelect;
 	QComboBox *rateSelect;
 	QSlider *bufSizeSlider;
@@ -50,6 +51,7 @@ protected:
 	QSlider *pcmSlider;
 	QProgressBar *bufUsage;
 	QTimer       *updateTimer;
+	unsigned int  starveBase;
 
 	void setCheckBoxFromProperty(QCheckBox *cbx, const char *property);
 	void setComboBoxFromProperty(QComboBox *cbx, const char *property);
@@ -61,6 +63,7 @@ private slots:
 	void resetCounters(void);
 	void periodicUpdate(void);
 	void bufSizeChanged(int value);
+	void adaptiveBufSizeChanged(int value);
 	void volumeChanged(int value);
 	void triangleChanged(int value);
 	void square1Changed(int value);
@@ -0,0 +1,143 @@
+/* FCE Ultra - NES/Famicom Emulator
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+// FrameSnapshot.cpp
+//
+// Hands the state of the last emulated frame to the tool windows without
+// making them take the emulator mutex. Three snapshot slots are rotated:
+// the emulator fills the back slot and swaps it with the middle one, the GUI
+// swaps the middle slot with its front slot whenever the middle one is newer.
+// Neither side ever waits for the other.
+//
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "../../types.h"
+#include "../../fceu.h"
+#include "../../debug.h"
+#include "../../movie.h"
+#include "../../x6502.h"
+
+#include "Qt/FrameSnapshot.h"
+
+#define SLOT_INDEX  0x03
+#define SLOT_FRESH  0x04
+
+static frameSnapshot_t slot[3];
+
+static std::atomic<int> middleSlot(1);
+static int backSlot  = 2;  // emulator thread only
+static int frontSlot = 0;  // GUI thread only
+
+static unsigned int publishCount = 0;
+
+static std::atomic<int> cpuMemSubscribers(0);
+static std::atomic<int> ppuMemSubscribers(0);
+static std::atomic<int> oamSubscribers(0);
+//----------------------------------------------------------------------------
+void frameSnapshotSubscribe( int flags )
+{
+	if ( flags & FRAME_SNAPSHOT_CPU_MEM ) cpuMemSubscribers++;
+	if ( flags & FRAME_SNAPSHOT_PPU_MEM ) ppuMemSubscribers++;
+	if ( flags & FRAME_SNAPSHOT_OAM     ) oamSubscribers++;
+}
+//----------------------------------------------------------------------------
+void frameSnapshotUnsubscribe( int flags )
+{
+	if ( flags & FRAME_SNAPSHOT_CPU_MEM ) cpuMemSubscribers--;
+	if ( flags & FRAME_SNAPSHOT_PPU_MEM ) ppuMemSubscribers--;
+	if ( flags & FRAME_SNAPSHOT_OAM     ) oamSubscribers--;
+}
+//----------------------------------------------------------------------------
+static uint8 readPPU( unsigned int i )
+{
+	if (i < 0x2000)return VPage[(i) >> 10][(i)];
+	//NSF PPU Viewer crash here (UGETAB)
+	if (GameInfo->type == GIT_NSF)
+		return 0;
+	if (i < 0x3F00)
+		return vnapage[(i >> 10) & 0x3][i & 0x3FF];
+	return READPAL_MOTHEROFALL(i & 0x1F);
+}
+//----------------------------------------------------------------------------
+void frameSnapshotPublish(void)
+{
+	int flags = 0;
+	frameSnapshot_t *s;
+
+	if ( GameInfo == NULL )
+	{
+		return;
+	}
+	if ( cpuMemSubscribers > 0 ) flags |= FRAME_SNAPSHOT_CPU_MEM;
+	if ( ppuMemSubscribers > 0 ) flags |= FRAME_SNAPSHOT_PPU_MEM;
+	if ( oamSubscribers    > 0 ) flags |= FRAME_SNAPSHOT_OAM;
+
+	if ( flags == 0 )
+	{
+		return;
+	}
+	s = &slot[ backSlot ];
+
+	s->seq          = ++publishCount;
+	s->flags        = flags;
+	s->frame        = currFrameCounter;
+	s->instructions = total_instructions;
+
+	s->PC = X.PC;
+	s->A  = X.A;
+	s->X  = X.X;
+	s->Y  = X.Y;
+	s->S  = X.S;
+	s->P  = X.P;
+
+	memcpy( s->ppuReg, PPU, sizeof(s->ppuReg) );
+
+	if ( flags & FRAME_SNAPSHOT_CPU_MEM )
+	{
+		for (unsigned int addr = 0; addr < 0x10000; addr++)
+		{
+			s->cpuMem[addr] = GetMem(addr);
+		}
+	}
+	if ( flags & FRAME_SNAPSHOT_PPU_MEM )
+	{
+		for (unsigned int addr = 0; addr < 0x4000; addr++)
+		{
+			s->ppuMem[addr] = readPPU(addr);
+		}
+	}
+	if ( flags & FRAME_SNAPSHOT_OAM )
+	{
+		memcpy( s->oam, SPRAM, sizeof(s->oam) );
+	}
+	backSlot = middleSlot.exchange( backSlot | SLOT_FRESH ) & SLOT_INDEX;
+}
+//----------------------------------------------------------------------------
+const frameSnapshot_t *frameSnapshotAcquire(void)
+{
+	if ( middleSlot.load() & SLOT_FRESH )
+	{
+		frontSlot = middleSlot.exchange( frontSlot ) & SLOT_INDEX;
+	}
+	if ( slot[ frontSlot ].seq == 0 )
+	{
+		return NULL;
+	}
+	return &slot[ frontSlot ];
+}
+//----------------------------------------------------------------------------
@@ -0,0 +1,44 @@
+// FrameSnapshot.h
+//
+
+#pragma once
+
+#include <stdint.h>
+
+// Parts of the machine state that a snapshot can carry.
+// Registers and counters are always present, memory only when someone subscribed to it.
+enum frameSnapshotFlags
+{
+	FRAME_SNAPSHOT_CPU_MEM = 0x01,  // 64K CPU address space as seen by GetMem
+	FRAME_SNAPSHOT_PPU_MEM = 0x02,  // 16K PPU address space
+	FRAME_SNAPSHOT_OAM     = 0x04,  // sprite RAM
+};
+
+struct frameSnapshot_t
+{
+	unsigned int  seq;           // number of snapshots published before this one + 1
+	int           flags;         // frameSnapshotFlags present in this snapshot
+	int           frame;         // currFrameCounter
+	uint64_t      instructions;  // total_instructions
+
+	uint16_t      PC;
+	uint8_t       A, X, Y, S, P;
+	uint8_t       ppuReg[4];
+
+	uint8_t       cpuMem[0x10000];
+	uint8_t       ppuMem[0x4000];
+	uint8_t       oam[0x100];
+};
+
+// Viewers register interest in memory regions so the emulator only copies what is being looked at.
+void frameSnapshotSubscribe( int flags );
+void frameSnapshotUnsubscribe( int flags );
+
+// Called by the emulator thread at the end of each frame while it holds the wrapper mutex.
+void frameSnapshotPublish(void);
+
+// GUI thread only. Returns the newest published snapshot or NULL if there is none yet.
+// All windows share one front slot, so the pointer is only valid until the next
+// frameSnapshotAcquire() by any caller. Use it within the current slot call and
+// never keep it across event loop iterations; copy what has to be kept.
+const frameSnapshot_t *frameSnapshotAcquire(void);
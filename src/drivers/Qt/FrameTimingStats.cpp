@@ -35,6 +35,7 @@
 #include "Qt/config.h"
 #include "Qt/keyscan.h"
 #include "Qt/throttle.h"
+#include "Qt/AviRecord.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/FrameTimingStats.h"
 
@@ -89,6 +90,12 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	frameTimeIdlePct = new QTreeWidgetItem();
 	frameLateCount = new QTreeWidgetItem();
 	videoTimeAbs = new QTreeWidgetItem();
+	videoFilterTime = new QTreeWidgetItem();
+	audioLatency = new QTreeWidgetItem();
+	audioStarveCount = new QTreeWidgetItem();
+	aviQueueDepth = new QTreeWidgetItem();
+	aviBackpressureCount = new QTreeWidgetItem();
+	emuStallCount = new QTreeWidgetItem();
 
 	tree->addTopLevelItem(frameTimeAbs);
 	tree->addTopLevelItem(frameTimeDel);
@@ -97,7 +104,13 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	tree->addTopLevelItem(frameTimeWorkPct);
 	tree->addTopLevelItem(frameTimeIdlePct);
 	tree->addTopLevelItem(videoTimeAbs);
+	tree->addTopLevelItem(videoFilterTime);
 	tree->addTopLevelItem(frameLateCount);
+	tree->addTopLevelItem(audioLatency);
+	tree->addTopLevelItem(audioStarveCount);
+	tree->addTopLevelItem(aviQueueDepth);
+	tree->addTopLevelItem(aviBackpressureCount);
+	tree->addTopLevelItem(emuStallCount);
 
 	frameTimeAbs->setFlags(Qt::ItemIsEnabled | Qt::ItemNeverHasChildren);
 	frameTimeDel->setFlags(Qt::ItemIsEnabled | Qt::ItemNeverHasChildren);
@@ -110,6 +123,12 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	frameTimeIdlePct->setText(0, tr("Frame Idle %"));
 	frameLateCount->setText(0, tr("Frame Late Count"));
 	videoTimeAbs->setText(0, tr("Video Period ms"));
+	videoFilterTime->setText(0, tr("Video Filter ms"));
+	audioLatency->setText(0, tr("Audio Latency ms"));
+	audioStarveCount->setText(0, tr("Audio Starve Count"));
+	aviQueueDepth->setText(0, tr("AVI Queue Depth"));
+	aviBackpressureCount->setText(0, tr("AVI Backpressure Count"));
+	emuStallCount->setText(0, tr("Emulator Stall Count"));
 
 	frameTimeAbs->setTextAlignment(0, Qt::AlignLeft);
 	frameTimeDel->setTextAlignment(0, Qt::AlignLeft);
@@ -119,6 +138,12 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 	frameTimeIdlePct->setTextAlignment(0, Qt::AlignLeft);
 	frameLateCount->setTextAlignment(0, Qt::AlignLeft);
 	videoTimeAbs->setTextAlignment(0, Qt::AlignLeft);
+	videoFilterTime->setTextAlignment(0, Qt::AlignLeft);
+	audioLatency->setTextAlignment(0, Qt::AlignLeft);
+	audioStarveCount->setTextAlignment(0, Qt::AlignLeft);
+	aviQueueDepth->setTextAlignment(0, Qt::AlignLeft);
+	aviBackpressureCount->setTextAlignment(0, Qt::AlignLeft);
+	emuStallCount->setTextAlignment(0, Qt::AlignLeft);
 
 	for (int i = 0; i < 4; i++)
 	{
@@ -130,6 +155,12 @@ FrameTimingDialog_t::FrameTimingDialog_t(QWidget *parent)
 		frameTimeIdlePct->setTextAlignment(i + 1, Qt::AlignCenter);
 		frameLateCount->setTextAlignment(i + 1, Qt::AlignCenter);
 		videoTimeAbs->setTextAlignment(i + 1, Qt::AlignCenter);
+		videoFilterTime->setTextAlignment(i + 1, Qt::AlignCenter);
+		audioLatency->setTextAlignment(i + 1, Qt::AlignCenter);
+		audioStarveCount->setTextAlignment(i + 1, Qt::AlignCenter);
+		aviQueueDepth->setTextAlignment(i + 1, Qt::AlignCenter);
+		aviBackpressureCount->setTextAlignment(i + 1, Qt::AlignCenter);
+		emuStallCount->setTextAlignment(i + 1, Qt::AlignCenter);
 	}
 
 	hbox = new QHBoxLayout();
@@ -294,11 +325,59 @@ void FrameTimingDialog_t::updateTimingStats(void)
 	sprintf(stmp, "%.3f", stats.videoTimeDel.max * 1e3);
 	videoTimeAbs->setText(4, tr(stmp));
 
+	// Video Filter
+	sprintf(stmp, "%.3f", stats.videoFilterTime.cur * 1e3);
+	videoFilterTime->setText(2, tr(stmp));
+
+	sprintf(stmp, "%.3f", stats.videoFilterTime.min * 1e3);
+	videoFilterTime->setText(3, tr(stmp));
+
+	sprintf(stmp, "%.3f", stats.videoFilterTime.max * 1e3);
+	videoFilterTime->setText(4, tr(stmp));
+
 	// Late Count
 	sprintf(stmp, "%u", stats.lateCount);
 	frameLateCount->setText(1, tr("0"));
 	frameLateCount->setText(2, tr(stmp));
 
+	// Audio Latency
+	sprintf(stmp, "%.3f", stats.audioLatency.tgt * 1e3);
+	audioLatency->setText(1, tr(stmp));
+
+	sprintf(stmp, "%.3f", stats.audioLatency.cur * 1e3);
+	audioLatency->setText(2, tr(stmp));
+
+	sprintf(stmp, "%.3f", stats.audioLatency.min * 1e3);
+	audioLatency->setText(3, tr(stmp));
+
+	sprintf(stmp, "%.3f", stats.audioLatency.max * 1e3);
+	audioLatency->setText(4, tr(stmp));
+
+	// Audio Starve Count
+	sprintf(stmp, "%u", stats.audioStarveCount);
+	audioStarveCount->setText(1, tr("0"));
+	audioStarveCount->setText(2, tr(stmp));
+
+	// AVI Record Pipeline
+	aviRecordStats_t aviStats;
+
+	aviRecordGetStats( &aviStats );
+
+	sprintf(stmp, "%u", aviStats.queueSize);
+	aviQueueDepth->setText(1, tr(stmp));
+
+	sprintf(stmp, "%u", aviStats.queueDepth);
+	aviQueueDepth->setText(2, tr(stmp));
+
+	sprintf(stmp, "%llu", aviStats.backpressureCount);
+	aviBackpressureCount->setText(1, tr("0"));
+	aviBackpressureCount->setText(2, tr(stmp));
+
+	// Times the emulator thread had to wait for a GUI thread holding the mutex
+	sprintf(stmp, "%u", fceuWrapperStallCount());
+	emuStallCount->setText(1, tr("0"));
+	emuStallCount->setText(2, tr(stmp));
+
 	statFrame->setEnabled(stats.enabled);
 
 	tree->viewport()->update();
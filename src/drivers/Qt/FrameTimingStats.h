@@ -40,6 +40,12 @@ protected:
 	QTreeWidgetItem *frameTimeIdlePct;
 	QTreeWidgetItem *frameLateCount;
 	QTreeWidgetItem *videoTimeAbs;
+	QTreeWidgetItem *videoFilterTime;
+	QTreeWidgetItem *audioLatency;
+	QTreeWidgetItem *audioStarveCount;
+	QTreeWidgetItem *aviQueueDepth;
+	QTreeWidgetItem *aviBackpressureCount;
+	QTreeWidgetItem *emuStallCount;
 	QGroupBox *statFrame;
 
 	QTreeWidget *tree;
@@ -60,6 +60,7 @@
 #include "Qt/keyscan.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/HexEditor.h"
+#include "Qt/FrameSnapshot.h"
 #include "Qt/CheatsConf.h"
 #include "Qt/SymbolicDebug.h"
 #include "Qt/ConsoleDebugger.h"
@@ -1427,6 +1428,8 @@ HexEditorDialog_t::HexEditorDialog_t(QWidget *parent)
 
 	findDialog = NULL;
 
+	snapshotFlags = 0;
+
 	editor->memModeUpdate();
 
 	periodicTimer  = new QTimer( this );
@@ -1459,6 +1462,8 @@ HexEditorDialog_t::~HexEditorDialog_t(void)
 	//printf("Hex Editor Deleted\n");
 	periodicTimer->stop();
 
+	frameSnapshotUnsubscribe( snapshotFlags );
+
 	// Lock the emulation thread mutex to ensure
 	// that the emulator is not attempting to update memory values
 	// for window while we are destroying it or editing the window list.
@@ -1806,11 +1811,40 @@ void HexEditorDialog_t::openDebugSymbolEditWindow( int addr )
 //----------------------------------------------------------------------------
 void HexEditorDialog_t::updatePeriodic(void)
 {
+	int snapFlags;
+
 	//printf("Update Periodic\n");
 	
 	undoEditAct->setEnabled( romEditList.undoQueueSize() > 0 );
 
-	if ( fceuWrapperTryLock(0) )
+	// Only ask the emulator to publish the memory that is on display
+	switch ( editor->getMode() )
+	{
+		case QHexEdit::MODE_NES_RAM:
+			snapFlags = FRAME_SNAPSHOT_CPU_MEM;
+		break;
+		case QHexEdit::MODE_NES_PPU:
+			snapFlags = FRAME_SNAPSHOT_PPU_MEM;
+		break;
+		case QHexEdit::MODE_NES_OAM:
+			snapFlags = FRAME_SNAPSHOT_OAM;
+		break;
+		default:
+			snapFlags = 0;
+		break;
+	}
+	if ( snapFlags != snapshotFlags )
+	{
+		frameSnapshotUnsubscribe( snapshotFlags );
+		frameSnapshotSubscribe( snapFlags );
+		snapshotFlags = snapFlags;
+	}
+
+	if ( editor->checkSnapshotActivity( frameSnapshotAcquire() ) != -2 )
+	{
+		memNeedsCheck = false;
+	}
+	else if ( fceuWrapperTryLock(0) )
 	{
 		memNeedsCheck = false;
 
@@ -3493,6 +3527,69 @@ int QHexEdit::checkMemActivity(void)
    return 0;
 }
 //----------------------------------------------------------------------------
+// Same as checkMemActivity but compares against memory the emulator published
+// at the end of a frame, so it can run in the GUI thread without the mutex.
+// Returns -2 when the snapshot does not hold the memory being viewed.
+int QHexEdit::checkSnapshotActivity( const frameSnapshot_t *snap )
+{
+	const uint8_t *buf;
+	int bufSize, snapFlag;
+
+	// A requested refresh usually follows a write that the last
+	// snapshot has not seen yet, read the live memory for that one.
+	if ( (snap == NULL) || updateRequested )
+	{
+		return -2;
+	}
+
+	switch ( viewMode )
+	{
+		case MODE_NES_RAM:
+			buf      = snap->cpuMem;
+			bufSize  = sizeof(snap->cpuMem);
+			snapFlag = FRAME_SNAPSHOT_CPU_MEM;
+		break;
+		case MODE_NES_PPU:
+			buf      = snap->ppuMem;
+			bufSize  = sizeof(snap->ppuMem);
+			snapFlag = FRAME_SNAPSHOT_PPU_MEM;
+		break;
+		case MODE_NES_OAM:
+			buf      = snap->oam;
+			bufSize  = sizeof(snap->oam);
+			snapFlag = FRAME_SNAPSHOT_OAM;
+		break;
+		default:
+			return -2;
+		break;
+	}
+	if ( !(snap->flags & snapFlag) || (mb.size() > bufSize) )
+	{
+		return -2;
+	}
+
+	if ( total_instructions_lp == snap->instructions )
+	{
+		return -1;
+	}
+
+	for (int i=0; i<mb.size(); i++)
+	{
+		if ( buf[i] != mb.buf[i].data )
+		{
+			mb.buf[i].actv  = 15;
+			mb.buf[i].data  = buf[i];
+		}
+		else if ( mb.buf[i].actv > 0 )
+		{
+			mb.buf[i].actv--;
+		}
+	}
+	total_instructions_lp = snap->instructions;
+
+	return 0;
+}
+//----------------------------------------------------------------------------
 int QHexEdit::getRomAddrColor( int addr, QColor &fg, QColor &bg )
 {
 	int temp_offset;
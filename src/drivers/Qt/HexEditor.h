@@ -79,6 +79,7 @@ class HexBookMarkManager_t
 };
 
 class QHexEdit;
+struct frameSnapshot_t;
 
 class HexBookMarkMenuAction : public QAction
 {
@@ -134,6 +135,7 @@ class QHexEdit : public QWidget
 		void memModeUpdate(void);
 		void openGotoAddrDialog(void);
 		int  checkMemActivity(void);
+		int  checkSnapshotActivity( const frameSnapshot_t *snap );
 		int  getAddr(void){ return cursorAddr; };
 		int  FreezeRam( const char *name, uint32_t a, uint8_t v, int c, int s, int type );
 		void loadHighlightToClipboard(void);
@@ -317,6 +319,8 @@ class HexEditorDialog_t : public QDialog
 		QAction    *rolColHlgtAct;
 		QAction    *altColHlgtAct;
 
+		int         snapshotFlags;
+
 	private:
 
 	public slots:
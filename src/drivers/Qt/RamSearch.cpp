@@ -57,6 +57,7 @@
 #include "Qt/RamWatch.h"
 #include "Qt/RamSearch.h"
 #include "Qt/HexEditor.h"
+#include "Qt/FrameSnapshot.h"
 #include "Qt/CheatsConf.h"
 #include "Qt/ConsoleWindow.h"
 #include "Qt/ConsoleUtilities.h"
@@ -484,6 +485,8 @@ RamSearchDialog_t::RamSearchDialog_t(QWidget *parent)
 
 	connect(updateTimer, &QTimer::timeout, this, &RamSearchDialog_t::periodicUpdate);
 
+	frameSnapshotSubscribe( FRAME_SNAPSHOT_CPU_MEM );
+
 	updateTimer->start(8); // ~120hz
 
 	restoreGeometry(settings.value("ramSearchWindow/geometry").toByteArray());
@@ -494,6 +497,7 @@ RamSearchDialog_t::~RamSearchDialog_t(void)
 	QSettings settings;
 
 	updateTimer->stop();
+	frameSnapshotUnsubscribe( FRAME_SNAPSHOT_CPU_MEM );
 	//printf("Destroy RAM Search Window\n");
 	ramSearchWin = NULL;
 
@@ -526,12 +530,32 @@ void RamSearchDialog_t::closeWindow(void)
 void RamSearchDialog_t::periodicUpdate(void)
 {
 	int selAddr = -1;
+	int frame = currFrameCounter;
+	const frameSnapshot_t *snap = frameSnapshotAcquire();
+
+	// Prefer the memory the emulator published at the end of its last frame,
+	// only stop the emulator to read it when there is no snapshot yet.
+	if ( (snap != NULL) && (snap->flags & FRAME_SNAPSHOT_CPU_MEM) )
+	{
+		frame = snap->frame;
+	}
+	else
+	{
+		snap = NULL;
+	}
 
-	if (currFrameCounter != frameCounterLastPass)
+	if (frame != frameCounterLastPass)
 	{
-		FCEU_WRAPPER_LOCK();
-		copyRamToLocalBuffer();
-		FCEU_WRAPPER_UNLOCK();
+		if ( snap != NULL )
+		{
+			memcpy( lclMemBuf, snap->cpuMem, sizeof(lclMemBuf) );
+		}
+		else
+		{
+			FCEU_WRAPPER_LOCK();
+			copyRamToLocalBuffer();
+			FCEU_WRAPPER_UNLOCK();
+		}
 
 		//if ( currFrameCounter != (frameCounterLastPass+1) )
 		//{
@@ -543,7 +567,7 @@ void RamSearchDialog_t::periodicUpdate(void)
 		{
 			runSearch();
 		}
-		frameCounterLastPass = currFrameCounter;
+		frameCounterLastPass = frame;
 	}
 
 	if ((cycleCounter % 10) == 0)
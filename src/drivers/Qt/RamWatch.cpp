@@ -49,6 +49,7 @@
 #include "Qt/keyscan.h"
 #include "Qt/fceuWrapper.h"
 #include "Qt/RamWatch.h"
+#include "Qt/FrameSnapshot.h"
 #include "Qt/CheatsConf.h"
 #include "Qt/ConsoleUtilities.h"
 
@@ -304,6 +305,8 @@ RamWatchDialog_t::RamWatchDialog_t(QWidget *parent)
 
 	connect( updateTimer, &QTimer::timeout, this, &RamWatchDialog_t::periodicUpdate );
 
+	frameSnapshotSubscribe( FRAME_SNAPSHOT_CPU_MEM );
+
 	updateTimer->start( 100 ); // 10hz
 
 	restoreGeometry(settings.value("ramWatch/geometry").toByteArray());
@@ -314,6 +317,7 @@ RamWatchDialog_t::~RamWatchDialog_t(void)
 	QSettings settings;
 
 	updateTimer->stop();
+	frameSnapshotUnsubscribe( FRAME_SNAPSHOT_CPU_MEM );
 
 	if ( ramWatchMainWin == this )
 	{
@@ -377,6 +381,12 @@ void RamWatchDialog_t::updateRamWatchDisplay(void)
 	std::list < ramWatch_t * >::iterator it;
 	char addrStr[32], valStr1[16], valStr2[16];
 	ramWatch_t *rw;
+	const frameSnapshot_t *snap = frameSnapshotAcquire();
+
+	if ( (snap != NULL) && !(snap->flags & FRAME_SNAPSHOT_CPU_MEM) )
+	{
+		snap = NULL;
+	}
 
 	for (it = ramWatchList.ls.begin (); it != ramWatchList.ls.end (); it++)
 	{
@@ -411,7 +421,7 @@ void RamWatchDialog_t::updateRamWatchDisplay(void)
 			}
 		}
 
-		rw->updateMem ();
+		rw->updateMem (snap);
 
 		if ( rw->isSep || (rw->addr < 0) )
 		{
@@ -725,7 +735,16 @@ void RamWatchDialog_t::saveListAs(void)
 	saveWatchFile( filename.toStdString().c_str() );
 }
 //----------------------------------------------------------------------------
-void ramWatch_t::updateMem (void)
+static uint8_t readWatchMem( const frameSnapshot_t *snap, int addr )
+{
+	if ( snap != NULL )
+	{
+		return snap->cpuMem[ addr & 0xFFFF ];
+	}
+	return GetMem (addr);
+}
+//----------------------------------------------------------------------------
+void ramWatch_t::updateMem (const frameSnapshot_t *snap)
 {
 	if ( addr < 0 )
 	{
@@ -733,18 +752,18 @@ void ramWatch_t::updateMem (void)
 	}
 	if (size == 1)
 	{
-		val.u8 = GetMem (addr);
+		val.u8 = readWatchMem (snap, addr);
 	}
 	else if (size == 2)
 	{
-		val.u16 = (GetMem (addr) << 8) | GetMem (addr + 1);
+		val.u16 = (readWatchMem (snap, addr) << 8) | readWatchMem (snap, addr + 1);
 	}
 	else if (size == 4)
 	{
-		val.u32  = GetMem (addr + 3);
-		val.u32 |= GetMem (addr + 2) << 8;
-		val.u32 |= GetMem (addr + 1) << 16;
-		val.u32 |= GetMem (addr    ) << 24;
+		val.u32  = readWatchMem (snap, addr + 3);
+		val.u32 |= readWatchMem (snap, addr + 2) << 8;
+		val.u32 |= readWatchMem (snap, addr + 1) << 16;
+		val.u32 |= readWatchMem (snap, addr    ) << 24;
 	}
 }
 //------------------------------------------------------------------------.----
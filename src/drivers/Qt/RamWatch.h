@@ -19,6 +19,8 @@
 
 #include "Qt/main.h"
 
+struct frameSnapshot_t;
+
 struct ramWatch_t
 {
 	std::string name;
@@ -46,7 +48,7 @@ struct ramWatch_t
 		val.u32 = 0;
 	};
 
-	void updateMem (void);
+	void updateMem (const frameSnapshot_t *snap = NULL);
 };
 
 struct ramWatchList_t
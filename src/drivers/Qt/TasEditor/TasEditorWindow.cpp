@@ -203,6 +203,12 @@ TasEditorWindow::TasEditorWindow(QWidget *parent)
 	mainHBox->addWidget( controlPanelContainerWidget );
 	mainLayout->addWidget(mainHBox);
 
+	statusBar = new QStatusBar();
+	greenzoneStatusLbl = new QLabel();
+	statusBar->addWidget( greenzoneStatusLbl );
+	mainLayout->addWidget( statusBar );
+	nextStatusUpdateTime = 0;
+
 	mainHBox->setStretchFactor( 0, 5 );
 	mainHBox->setStretchFactor( 1, 1 );
 
@@ -1460,6 +1466,7 @@ int TasEditorWindow::initModules(void)
 		// use current movie to create a new project
 		FCEUI_StopMovie();
 		movieMode = MOVIEMODE_TASEDITOR;
+		currMovieData.unpackRecords();
 	}
 	// if movie length is less or equal to currFrame, pad it with empty frames
 	if (((int)currMovieData.records.size() - 1) < currFrameCounter)
@@ -1520,6 +1527,12 @@ void TasEditorWindow::frameUpdate(void)
 
 	pianoRoll->update();
 
+	if ( clock() > nextStatusUpdateTime )
+	{
+		updateGreenzoneStatus();
+		nextStatusUpdateTime = clock() + CLOCKS_PER_SEC;
+	}
+
 	if ( recentProjectMenuReset )
 	{
 		buildRecentProjectMenu();
@@ -1529,6 +1542,17 @@ void TasEditorWindow::frameUpdate(void)
 	FCEU_WRAPPER_UNLOCK();
 }
 //----------------------------------------------------------------------------
+void TasEditorWindow::updateGreenzoneStatus(void)
+{
+	int count = greenzone.getSavestatesCount();
+	size_t bytes = greenzone.getMemoryUsage();
+	size_t bytesPerFrame = count ? bytes / count : 0;
+
+	greenzoneStatusLbl->setText( tr("Greenzone: %1 frames, %2 MB, %3 bytes/frame, last seek %4 ms")
+			.arg(count).arg( (qulonglong)(bytes >> 20) ).arg( (qulonglong)bytesPerFrame )
+			.arg( greenzone.getLastSeekTime() * 1000.0, 0, 'f', 2 ) );
+}
+//----------------------------------------------------------------------------
 bool TasEditorWindow::loadProject(const char* fullname)
 {
 	bool success = false;
@@ -3075,7 +3099,7 @@ void TasEditorWindow::openProjectSaveOptions(void)
 	QGroupBox *settingsBox, *fileContentsBox, *greenZoneSaveBox;
 	QVBoxLayout *mainLayout, *vbox1, *vbox;
 	QHBoxLayout *hbox1, *hbox;
-	QCheckBox *autoSaveOpt, *saveSilentOpt;
+	QCheckBox *autoSaveOpt, *saveSilentOpt, *indexedFileOpt;
 	QSpinBox  *autoSavePeriod;
 	QCheckBox *binaryInput, *saveMarkers, *saveBookmarks;
 	QCheckBox *saveHistory, *savePianoRoll, *saveSelection;
@@ -3093,6 +3117,7 @@ void TasEditorWindow::openProjectSaveOptions(void)
 	autoSaveOpt    = new QCheckBox( tr("Autosave project") );
 	saveSilentOpt  = new QCheckBox( tr("silently") );
 	autoSavePeriod = new QSpinBox();
+	indexedFileOpt = new QCheckBox( tr("Only write changes\n(fm3 version 4, older versions can't read it)") );
 
 	binaryInput    = new QCheckBox( tr("Binary Input") );
 	saveMarkers    = new QCheckBox( tr("Markers") );
@@ -3132,6 +3157,7 @@ void TasEditorWindow::openProjectSaveOptions(void)
 	vbox->addWidget( autoSaveOpt );
 	vbox->addLayout( hbox );
 	vbox->addWidget( saveSilentOpt );
+	vbox->addWidget( indexedFileOpt );
 	vbox->addStretch( 10 );
 
 	vbox1 = new QVBoxLayout();
@@ -3164,6 +3190,7 @@ void TasEditorWindow::openProjectSaveOptions(void)
 	autoSaveOpt->setChecked( taseditorConfig.autosaveEnabled );
 	autoSavePeriod->setValue( taseditorConfig.autosavePeriod );
 	saveSilentOpt->setChecked( taseditorConfig.autosaveSilent );
+	indexedFileOpt->setChecked( taseditorConfig.projectSavingOptions_IndexedFile );
 
 	autoSavePeriod->setEnabled( taseditorConfig.autosaveEnabled );
 	saveSilentOpt->setEnabled( taseditorConfig.autosaveEnabled );
@@ -3192,6 +3219,7 @@ void TasEditorWindow::openProjectSaveOptions(void)
 		taseditorConfig.autosaveEnabled = autoSaveOpt->isChecked();
 		taseditorConfig.autosavePeriod  = autoSavePeriod->value();
 		taseditorConfig.autosaveSilent  = saveSilentOpt->isChecked();
+		taseditorConfig.projectSavingOptions_IndexedFile = indexedFileOpt->isChecked();
 
 		taseditorConfig.projectSavingOptions_SaveInBinary  = binaryInput->isChecked();
 		taseditorConfig.projectSavingOptions_SaveMarkers   = saveMarkers->isChecked();
@@ -3222,14 +3250,14 @@ void TasEditorWindow::openProjectSaveOptions(void)
 void TasEditorWindow::setGreenzoneCapacity(void)
 {
 	int ret;
-	int newValue = taseditorConfig.greenzoneCapacity;
+	int newValue = taseditorConfig.greenzoneMemoryLimit;
 	QInputDialog dialog(this);
 	FCEU_CRITICAL_SECTION( emuLock );
 
 	dialog.setWindowTitle( tr("Greenzone Capacity") );
 	dialog.setInputMode( QInputDialog::IntInput );
-	dialog.setIntRange( GREENZONE_CAPACITY_MIN, GREENZONE_CAPACITY_MAX );
-	dialog.setLabelText( tr("Keep savestates for how many frames?\n(actual limit of savestates can be 5 times more than the number provided)") );
+	dialog.setIntRange( GREENZONE_MEMORY_LIMIT_MIN, GREENZONE_MEMORY_LIMIT_MAX );
+	dialog.setLabelText( tr("How many megabytes of memory can Greenzone savestates take?\n(currently used: %1 MB)").arg( (qulonglong)(greenzone.getMemoryUsage() >> 20) ) );
 	dialog.setIntValue( newValue );
 
 	ret = dialog.exec();
@@ -3238,22 +3266,22 @@ void TasEditorWindow::setGreenzoneCapacity(void)
 	{
 		newValue = dialog.intValue();
 
-		if (newValue < GREENZONE_CAPACITY_MIN)
+		if (newValue < GREENZONE_MEMORY_LIMIT_MIN)
 		{
-			newValue = GREENZONE_CAPACITY_MIN;
+			newValue = GREENZONE_MEMORY_LIMIT_MIN;
 		}
-		else if (newValue > GREENZONE_CAPACITY_MAX)
+		else if (newValue > GREENZONE_MEMORY_LIMIT_MAX)
 		{
-			newValue = GREENZONE_CAPACITY_MAX;
+			newValue = GREENZONE_MEMORY_LIMIT_MAX;
 		}
-		if (newValue < taseditorConfig.greenzoneCapacity)
+		if (newValue < taseditorConfig.greenzoneMemoryLimit)
 		{
-			taseditorConfig.greenzoneCapacity = newValue;
+			taseditorConfig.greenzoneMemoryLimit = newValue;
 			greenzone.runGreenzoneCleaning();
 		}
 		else
 		{
-			taseditorConfig.greenzoneCapacity = newValue;
+			taseditorConfig.greenzoneMemoryLimit = newValue;
 		}
 	}
 }
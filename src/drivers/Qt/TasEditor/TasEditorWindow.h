@@ -36,6 +36,7 @@
 #include <QTabWidget>
 #include <QStackedWidget>
 #include <QClipboard>
+#include <QStatusBar>
 
 #include "Qt/config.h"
 #include "Qt/ConsoleUtilities.h"
@@ -462,6 +463,10 @@ class TasEditorWindow : public QDialog
 		QLabel      *selectionLbl;
 		QLabel      *clipboardLbl;
 
+		QStatusBar  *statusBar;
+		QLabel      *greenzoneStatusLbl;
+		clock_t      nextStatusUpdateTime;
+
 		//QPushButton *runLuaBtn;
 		//QCheckBox   *autoLuaCBox;
 
@@ -494,6 +499,7 @@ class TasEditorWindow : public QDialog
 		void buildRecentProjectMenu(void);
 		void saveRecentProjectMenu(void);
 		void addRecentProject(const char *prog);
+		void updateGreenzoneStatus(void);
 
 
 	public slots:
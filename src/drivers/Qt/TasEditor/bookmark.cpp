@@ -73,6 +73,8 @@ void BOOKMARK::set()
 	snapshot.keyFrame = currFrameCounter;
 	if (taseditorConfig->enableHotChanges)
 		snapshot.inputlog.copyHotChanges(&history->getCurrentSnapshot().inputlog);
+	// share unchanged Input with the current History snapshot
+	snapshot.inputlog.pack(&history->getCurrentSnapshot().inputlog);
 	// copy savestate
 	savestate = greenzone->getSavestateOfFrame(currFrameCounter);
 	// save screenshot
@@ -102,13 +104,13 @@ void BOOKMARK::handleDeploy()
 	flashType = FLASH_TYPE_DEPLOY;
 }
 
-void BOOKMARK::save(EMUFILE *os)
+void BOOKMARK::save(EMUFILE *os, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	if (notEmpty)
 	{
 		write8le(1, os);
 		// write snapshot
-		snapshot.save(os);
+		snapshot.save(os, chunkTable);
 		// write savestate
 		int size = savestate.size();
 		write32le(size, os);
@@ -120,7 +122,7 @@ void BOOKMARK::save(EMUFILE *os)
 	} else write8le((uint8)0, os);
 }
 // returns true if couldn't load
-bool BOOKMARK::load(EMUFILE *is)
+bool BOOKMARK::load(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	uint8 tmp;
 	if (!read8le(&tmp, is)) return true;
@@ -128,7 +130,7 @@ bool BOOKMARK::load(EMUFILE *is)
 	if (notEmpty)
 	{
 		// read snapshot
-		if (snapshot.load(is)) return true;
+		if (snapshot.load(is, chunkTable)) return true;
 		// read savestate
 		int size;
 		if (!read32le(&size, is)) return true;
@@ -146,14 +148,14 @@ bool BOOKMARK::load(EMUFILE *is)
 	flashType = flashPhase = floatingPhase = 0;
 	return false;
 }
-bool BOOKMARK::skipLoad(EMUFILE *is)
+bool BOOKMARK::skipLoad(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	uint8 tmp;
 	if (!read8le(&tmp, is)) return true;
 	if (tmp != 0)
 	{
 		// read snapshot
-		if (snapshot.skipLoad(is)) return true;
+		if (snapshot.skipLoad(is, chunkTable)) return true;
 		// read savestate
 		int size;
 		if (!read32le(&size, is)) return true;
@@ -32,9 +32,9 @@ public:
 	void handleJump();
 	void handleDeploy();
 
-	void save(EMUFILE *os);
-	bool load(EMUFILE *is);
-	bool skipLoad(EMUFILE *is);
+	void save(EMUFILE *os, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
+	bool load(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
+	bool skipLoad(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
 
 	// saved vars
 	bool notEmpty;
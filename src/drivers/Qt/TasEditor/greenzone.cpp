@@ -15,16 +15,26 @@ Greenzone - Access zone
 * saves and loads the data from a project file. On error: truncates Greenzone to last successfully read savestate
 * regularly checks if there's a savestate of current emulation state, if there's no such savestate in array then creates one and updates lag info for previous frame
 * implements the working of "Auto-adjust Input according to lag" feature
-* regularly runs gradual cleaning of the savestates array (for memory saving), deleting oldest savestates
+* keeps a full savestate every GREENZONE_KEYFRAME_INTERVAL frames, frames in between are stored as deltas against it, so any frame is restored from one savestate and one delta
+* keeps fresh savestates uncompressed and compresses them on background threads
+* regularly runs cleaning of the savestates array (for memory saving), evicting savestates far from Playback cursor and Bookmarks when over the memory limit
 * on demand: (when movie Input was changed) truncates the size of Greenzone, deleting savestates that became irrelevant because of new Input. After truncating it may also move Playback cursor (which must always reside within Greenzone) and may launch Playback seeking
 * stores resources: save id, properties of gradual cleaning, timing of cleaning
 ------------------------------------------------------------------------------------ */
 
 #include <zlib.h>
+#include <climits>
+#include <algorithm>
+
+#include <QRunnable>
+#include <QThread>
+#include <QMutexLocker>
 
 #include "fceu.h"
 #include "state.h"
+#include "utils/endian.h"
 #include "driver.h"
+#include "Qt/throttle.h"
 #include "Qt/TasEditor/taseditor_project.h"
 #include "Qt/TasEditor/TasEditorWindow.h"
 
@@ -32,10 +42,91 @@ extern char lagFlag;
 
 static char greenzone_save_id[GREENZONE_ID_LEN] = "GREENZONE";
 static char greenzone_skipsave_id[GREENZONE_ID_LEN] = "GREENZONX";
+static char greenzone_states_id[GREENZONE_ID_LEN] = "GREENZOND";
+
+#define SAVESTATE_HEADER_SIZE 16
+
+// turns an uncompressed savestate made by FCEUSS_SaveMS into the same savestate with the body deflated,
+// FCEUSS_LoadFP accepts both forms
+static bool compressSavestate(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out)
+{
+	if (raw.size() <= SAVESTATE_HEADER_SIZE)
+		return false;
+	uLong len = raw.size() - SAVESTATE_HEADER_SIZE;
+	uLongf comprlen = (len >> 9) + 12 + len;
+	out.resize(SAVESTATE_HEADER_SIZE + comprlen);
+	if (compress2(&out[SAVESTATE_HEADER_SIZE], &comprlen, &raw[SAVESTATE_HEADER_SIZE], len, Z_DEFAULT_COMPRESSION) != Z_OK)
+		return false;
+	out.resize(SAVESTATE_HEADER_SIZE + comprlen);
+	memcpy(&out[0], &raw[0], SAVESTATE_HEADER_SIZE);
+	FCEU_en32lsb(&out[12], comprlen);
+	return true;
+}
+
+// the other way around, also accepts savestates that are already uncompressed
+static bool inflateSavestate(const std::vector<uint8_t>& savestate, std::vector<uint8_t>& out)
+{
+	if (savestate.size() < SAVESTATE_HEADER_SIZE)
+		return false;
+	int comprlen = FCEU_de32lsb((uint8*)&savestate[12]);
+	if (comprlen == -1)
+	{
+		out = savestate;
+		return true;
+	}
+	uLongf len = FCEU_de32lsb((uint8*)&savestate[4]);
+	out.resize(SAVESTATE_HEADER_SIZE + len);
+	if (uncompress(&out[SAVESTATE_HEADER_SIZE], &len, &savestate[SAVESTATE_HEADER_SIZE], savestate.size() - SAVESTATE_HEADER_SIZE) != Z_OK
+		|| len != out.size() - SAVESTATE_HEADER_SIZE)
+		return false;
+	memcpy(&out[0], &savestate[0], SAVESTATE_HEADER_SIZE);
+	FCEU_en32lsb(&out[12], (uint32)-1);
+	return true;
+}
+
+static bool deflateBuffer(const std::vector<uint8_t>& raw, std::vector<uint8_t>& out)
+{
+	uLongf comprlen = (raw.size() >> 9) + 12 + raw.size();
+	out.resize(comprlen);
+	if (compress2(&out[0], &comprlen, &raw[0], raw.size(), Z_DEFAULT_COMPRESSION) != Z_OK)
+		return false;
+	out.resize(comprlen);
+	return true;
+}
+
+class GreenzoneCompressionTask : public QRunnable
+{
+public:
+	GreenzoneCompressionTask(GREENZONE *greenzone, int frame, unsigned int ticket, bool deltas, const std::vector<uint8_t>& raw)
+		: greenzone(greenzone), raw(raw)
+	{
+		result.frame = frame;
+		result.ticket = ticket;
+		result.deltas = deltas;
+	}
+	void run()
+	{
+		if (result.deltas ? deflateBuffer(raw, result.savestate) : compressSavestate(raw, result.savestate))
+			greenzone->submitCompressedState(result);
+	}
+private:
+	GREENZONE *greenzone;
+	std::vector<uint8_t> raw;
+	GREENZONE_COMPRESSED_STATE result;
+};
 
 GREENZONE::GREENZONE()
 {
 	nextCleaningTime = 0;
+	savestatesMemory = 0;
+	lastTicket = 0;
+	cachedKeyFrame = -1;
+	cachedDeltaGroup = -1;
+	lastSeekTime = 0;
+	evictionBlocked = false;
+	changeCount = 0;
+	// leave one core to the emulation thread
+	compressionPool.setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
 }
 
 void GREENZONE::init()
@@ -45,7 +136,17 @@ void GREENZONE::init()
 }
 void GREENZONE::free()
 {
+	// results of the jobs still running will be dropped because their tickets are gone
+	pendingCompression.clear();
+	installCompressedStates();
 	savestates.resize(0);
+	deltaBase.resize(0);
+	deltaGroups.clear();
+	cachedKeyFrame = -1;
+	cachedDeltaGroup = -1;
+	savestatesMemory = 0;
+	evictionBlocked = false;
+	changeCount++;
 	greenzoneSize = 0;
 	lagLog.reset();
 }
@@ -55,6 +156,7 @@ void GREENZONE::reset()
 }
 void GREENZONE::update()
 {
+	installCompressedStates();
 	// keep collecting savestates, this code must be executed at the end of every frame
 	if (taseditorConfig->enableGreenzoning)
 	{
@@ -66,8 +168,8 @@ void GREENZONE::update()
 			greenzoneSize = currFrameCounter + 1;
 	}
 
-	// run cleaning from time to time
-	if (clock() > nextCleaningTime)
+	// run cleaning from time to time, or right away when the memory limit is exceeded
+	if (clock() > nextCleaningTime || savestatesMemory > ((size_t)taseditorConfig->greenzoneMemoryLimit << 20))
 		runGreenzoneCleaning();
 
 	// also log lag frames
@@ -107,74 +209,178 @@ void GREENZONE::update()
 void GREENZONE::collectCurrentState()
 {
 	if ((int)savestates.size() <= currFrameCounter)
-		savestates.resize(currFrameCounter + 1);
+		resizeSavestates(currFrameCounter + 1);
 	// if frame is not saved - log savestate
-	if (!savestates[currFrameCounter].size())
+	if (!isFrameStored(currFrameCounter))
 	{
-		EMUFILE_MEMORY ms(&savestates[currFrameCounter]);
-		FCEUSS_SaveMS(&ms, Z_DEFAULT_COMPRESSION);
+		changeCount++;
+		// store it uncompressed for now, so that collecting doesn't slow down seeking
+		collectedState.clear();
+		EMUFILE_MEMORY ms(&collectedState);
+		FCEUSS_SaveMS(&ms, Z_NO_COMPRESSION);
 		ms.trim();
+		if (!appendDelta(currFrameCounter))
+		{
+			// start new keyframe
+			savestates[currFrameCounter].swap(collectedState);
+			savestatesMemory += savestates[currFrameCounter].size();
+			cachedKeyFrame = currFrameCounter;
+			cachedKeyState = savestates[currFrameCounter];
+			queueCompression(currFrameCounter);
+		}
 	}
 	if (greenzoneSize <= currFrameCounter)
 		greenzoneSize = currFrameCounter + 1;
 }
 
+// stores collectedState as a delta against the keyframe of previous frame, if that frame is the last one of its group
+// returns false if the frame has to become a keyframe
+bool GREENZONE::appendDelta(int frame)
+{
+	if (frame <= 0 || !(frame % GREENZONE_KEYFRAME_INTERVAL) || !isFrameStored(frame - 1))
+		return false;
+	int keyFrame = (deltaBase[frame - 1] >= 0) ? deltaBase[frame - 1] : frame - 1;
+	std::map<int, GREENZONE_DELTA_GROUP>::iterator it = deltaGroups.find(keyFrame);
+	if (it != deltaGroups.end() && (int)it->second.ends.size() != frame - keyFrame - 1)
+		return false;
+	const std::vector<uint8_t>* keyState = getKeyFrameState(keyFrame);
+	if (!keyState || keyState->size() != collectedState.size())
+		return false;
+	// the group may have been closed already, then reopen it
+	if (it != deltaGroups.end() && !inflateDeltaGroup(keyFrame))
+		return false;
+	GREENZONE_DELTA_GROUP& group = deltaGroups[keyFrame];
+
+	deltaBuffer.resize(FCEUSS_DeltaMaxSize(collectedState.size()));
+	uint32 len = FCEUSS_EncodeDelta(&(*keyState)[0], &collectedState[0], collectedState.size(), &deltaBuffer[0]);
+	group.deltas.insert(group.deltas.end(), deltaBuffer.begin(), deltaBuffer.begin() + len);
+	group.ends.push_back(group.deltas.size());
+	savestatesMemory += len;
+	deltaBase[frame] = keyFrame;
+	// the group is complete when the next frame is a keyframe
+	if (!((frame + 1) % GREENZONE_KEYFRAME_INTERVAL))
+		queueDeltaCompression(keyFrame);
+	return true;
+}
+
 bool GREENZONE::loadSavestateOfFrame(unsigned int frame)
 {
-	if (frame >= savestates.size() || !savestates[frame].size())
+	if (frame >= savestates.size())
 		return false;
-	EMUFILE_MEMORY ms(&savestates[frame]);
-	return FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
+	double startTime = getHighPrecTimeStamp();
+	bool success;
+	if (deltaBase[frame] >= 0)
+	{
+		if (!reconstructSavestate(frame, restoredState))
+			return false;
+		EMUFILE_MEMORY ms(&restoredState);
+		success = FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
+	} else
+	{
+		if (!savestates[frame].size())
+			return false;
+		EMUFILE_MEMORY ms(&savestates[frame]);
+		success = FCEUSS_LoadFP(&ms, SSLOADPARAM_NOBACKUP);
+	}
+	lastSeekTime = getHighPrecTimeStamp() - startTime;
+	return success;
+}
+
+// uncompressed savestate of a frame that has a full savestate, the last one asked for is cached
+const std::vector<uint8_t>* GREENZONE::getKeyFrameState(int frame)
+{
+	if (cachedKeyFrame == frame)
+		return &cachedKeyState;
+	cachedKeyFrame = -1;
+	if (!savestates[frame].size() || !inflateSavestate(savestates[frame], cachedKeyState))
+		return NULL;
+	cachedKeyFrame = frame;
+	return &cachedKeyState;
+}
+// uncompressed deltas of the group, the last compressed group asked for is cached
+const std::vector<uint8_t>* GREENZONE::getDeltaGroupDeltas(int keyFrame)
+{
+	GREENZONE_DELTA_GROUP& group = deltaGroups[keyFrame];
+	if (!group.compressed)
+		return &group.deltas;
+	if (cachedDeltaGroup == keyFrame)
+		return &cachedDeltas;
+	cachedDeltaGroup = -1;
+	uLongf len = group.ends.back();
+	cachedDeltas.resize(len);
+	if (uncompress(&cachedDeltas[0], &len, &group.deltas[0], group.deltas.size()) != Z_OK || len != group.ends.back())
+		return NULL;
+	cachedDeltaGroup = keyFrame;
+	return &cachedDeltas;
+}
+// makes the deltas of the group uncompressed again so that they can be changed
+bool GREENZONE::inflateDeltaGroup(int keyFrame)
+{
+	GREENZONE_DELTA_GROUP& group = deltaGroups[keyFrame];
+	group.ticket = 0;
+	if (!group.compressed)
+		return true;
+	const std::vector<uint8_t>* deltas = getDeltaGroupDeltas(keyFrame);
+	if (!deltas)
+		return false;
+	changeCount++;
+	savestatesMemory -= group.deltas.size();
+	group.deltas = *deltas;
+	group.compressed = false;
+	savestatesMemory += group.deltas.size();
+	cachedDeltaGroup = -1;
+	return true;
+}
+// restores uncompressed savestate of a frame stored as delta
+bool GREENZONE::reconstructSavestate(int frame, std::vector<uint8_t>& out)
+{
+	int keyFrame = deltaBase[frame];
+	const std::vector<uint8_t>* keyState = getKeyFrameState(keyFrame);
+	const std::vector<uint8_t>* deltas = getDeltaGroupDeltas(keyFrame);
+	if (!keyState || !deltas)
+		return false;
+	GREENZONE_DELTA_GROUP& group = deltaGroups[keyFrame];
+	int index = frame - keyFrame - 1;
+	uint32 start = index ? group.ends[index - 1] : 0;
+	out = *keyState;
+	FCEUSS_ApplyFastDelta(&out[0], deltas->data() + start, group.ends[index] - start);
+	return true;
+}
+// drops the deltas of the frames from "frame" to the end of its group
+void GREENZONE::truncateDeltaGroup(int frame)
+{
+	int keyFrame = deltaBase[frame];
+	GREENZONE_DELTA_GROUP& group = deltaGroups[keyFrame];
+	int keep = frame - keyFrame - 1;
+	changeCount++;
+	for (int i = keyFrame + group.ends.size(); i >= frame; i--)
+		deltaBase[i] = -1;
+	if (!keep || !inflateDeltaGroup(keyFrame))
+	{
+		for (int i = keyFrame + 1; i < frame; i++)
+			deltaBase[i] = -1;
+		savestatesMemory -= group.deltas.size();
+		deltaGroups.erase(keyFrame);
+		if (cachedDeltaGroup == keyFrame)
+			cachedDeltaGroup = -1;
+		return;
+	}
+	savestatesMemory -= group.deltas.size();
+	group.deltas.resize(group.ends[keep - 1]);
+	group.ends.resize(keep);
+	savestatesMemory += group.deltas.size();
 }
 
 void GREENZONE::runGreenzoneCleaning()
 {
-	bool changed = false;
-	int i = currFrameCounter - taseditorConfig->greenzoneCapacity;
-	if (i <= 0) goto finish;	// zeroth frame should not be cleaned
-	int limit;
-	// 2x of 1/2
-	limit = i - 2 * taseditorConfig->greenzoneCapacity;
-	if (limit < 0) limit = 0;
-	for (; i > limit; i--)
-	{
-		if (i & 0x1)
-			changed = changed | clearSavestateAndFreeMemory(i);
-	}
-	if (i < 0) goto finish;
-	// 4x of 1/4
-	limit = i - 4 * taseditorConfig->greenzoneCapacity;
-	if (limit < 0) limit = 0;
-	for (; i > limit; i--)
-	{
-		if (i & 0x3)
-			changed = changed | clearSavestateAndFreeMemory(i);
-	}
-	if (i < 0) goto finish;
-	// 8x of 1/8
-	limit = i - 8 * taseditorConfig->greenzoneCapacity;
-	if (limit < 0) limit = 0;
-	for (; i > limit; i--)
-	{
-		if (i & 0x7)
-			changed = changed | clearSavestateAndFreeMemory(i);
-	}
-	if (i < 0) goto finish;
-	// 16x of 1/16
-	limit = i - 16 * taseditorConfig->greenzoneCapacity;
-	if (limit < 0) limit = 0;
-	for (; i > limit; i--)
-	{
-		if (i & 0xF)
-			changed = changed | clearSavestateAndFreeMemory(i);
-	}
-	// clear all remaining
-	for (; i > 0; i--)
-	{
-		changed = changed | clearSavestateAndFreeMemory(i);
-	}
-finish:
-	if (changed)
+	installCompressedStates();
+	// groups that stopped growing before they were complete
+	for (std::map<int, GREENZONE_DELTA_GROUP>::iterator it = deltaGroups.begin(); it != deltaGroups.end(); ++it)
+	{
+		if (!it->second.compressed && !it->second.ticket && it->second.deltas.size() && it->first + (int)it->second.ends.size() != currFrameCounter)
+			queueDeltaCompression(it->first);
+	}
+	if (evictSavestates())
 	{
 		//pianoRoll.redraw();
 		bookmarks->redrawBookmarksList();
@@ -183,12 +389,97 @@ finish:
 	nextCleaningTime = clock() + TIME_BETWEEN_CLEANINGS;
 }
 
+// when savestates take more memory than allowed, evicts savestates that are least likely to be needed soon:
+// the further a frame is from Playback cursor and from Bookmarks, the sooner it goes,
+// but frames divisible by higher powers of 2 are kept longer, so distant parts of Greenzone get thinned out rather than erased.
+// Deltas go as whole groups, before their keyframe
+// returns true if any savestate was evicted
+bool GREENZONE::evictSavestates()
+{
+	size_t limit = (size_t)taseditorConfig->greenzoneMemoryLimit << 20;
+	if (savestatesMemory <= limit)
+		return false;
+
+	std::vector<int> anchorFrames;
+	anchorFrames.push_back(currFrameCounter);
+	for (int i = 0; i < TOTAL_BOOKMARKS; ++i)
+	{
+		if (bookmarks->bookmarksArray[i].notEmpty)
+			anchorFrames.push_back(bookmarks->bookmarksArray[i].snapshot.keyFrame);
+	}
+	// the last pass freed nothing and nothing changed since then, another one would free nothing either
+	if (evictionBlocked && savestatesMemory == blockedMemory && limit == blockedLimit && anchorFrames == blockedAnchorFrames)
+		return false;
+
+	// (score, frame), zeroth frame, Playback cursor and Bookmark frames are never evicted
+	// a delta group is represented by its first frame, clearing it clears the whole group
+	std::vector<std::pair<int, int>> candidates;
+	for (int frame = savestates.size() - 1; frame > 0; frame--)
+	{
+		int distance = INT_MAX;
+		if (deltaBase[frame] >= 0)
+		{
+			if (deltaBase[frame] != frame - 1) continue;
+			int last = frame + deltaGroups[frame - 1].ends.size() - 1;
+			for (size_t i = 0; i < anchorFrames.size(); ++i)
+			{
+				if (anchorFrames[i] < frame)
+					distance = std::min(distance, frame - anchorFrames[i]);
+				else if (anchorFrames[i] > last)
+					distance = std::min(distance, anchorFrames[i] - last);
+				else
+					distance = 0;
+			}
+			// the group holds an anchor frame
+			if (distance)
+				candidates.push_back(std::make_pair(distance, frame));
+			continue;
+		}
+		if (!savestates[frame].size() || frame == currFrameCounter || deltaGroups.count(frame)) continue;
+		// the score is shifted by roundness, so a zero score doesn't mean the frame is an anchor
+		if (std::find(anchorFrames.begin(), anchorFrames.end(), frame) != anchorFrames.end()) continue;
+		for (size_t i = 0; i < anchorFrames.size(); ++i)
+			distance = std::min(distance, abs(frame - anchorFrames[i]));
+		int roundness = 0;
+		while (roundness < 16 && !(frame & (1 << roundness)))
+			roundness++;
+		candidates.push_back(std::make_pair(distance >> roundness, frame));
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	size_t target = limit / 100 * GREENZONE_CLEANING_TARGET;
+	bool changed = false;
+	for (int i = candidates.size() - 1; i >= 0 && savestatesMemory > target; i--)
+		changed = changed | clearSavestateAndFreeMemory(candidates[i].second);
+	// nothing could go, remember that until the Greenzone, the anchors or the limit change
+	evictionBlocked = !changed;
+	blockedMemory = savestatesMemory;
+	blockedLimit = limit;
+	blockedAnchorFrames.swap(anchorFrames);
+	return changed;
+}
+
 // returns true if actually cleared savestate data
+// clearing a frame stored as delta also clears the following frames of its group, clearing a keyframe clears its whole group
 bool GREENZONE::clearSavestateOfFrame(unsigned int frame)
 {
-	if (frame < savestates.size() && savestates[frame].size())
+	if (frame >= savestates.size())
+		return false;
+	if (deltaBase[frame] >= 0)
 	{
-	    savestates[frame].resize(0);
+		truncateDeltaGroup(frame);
+		return true;
+	}
+	if (savestates[frame].size())
+	{
+		if (deltaGroups.count(frame))
+			truncateDeltaGroup(frame + 1);
+		finishCompression(frame);
+		changeCount++;
+		savestatesMemory -= savestates[frame].size();
+		savestates[frame].resize(0);
+		if (cachedKeyFrame == (int)frame)
+			cachedKeyFrame = -1;
 		return true;
 	}
 	else
@@ -198,11 +489,14 @@ bool GREENZONE::clearSavestateOfFrame(unsigned int frame)
 }
 bool GREENZONE::clearSavestateAndFreeMemory(unsigned int frame)
 {
-	if (frame < savestates.size() && savestates[frame].size())
+	int keyFrame = (frame < deltaBase.size()) ? deltaBase[frame] : -1;
+	if (clearSavestateOfFrame(frame))
 	{
 		//savestates[frame].swap(std::vector<uint8_t>()); //FIXME
 		savestates[frame].clear();
 		savestates[frame].shrink_to_fit();
+		if (keyFrame >= 0 && deltaGroups.count(keyFrame))
+			deltaGroups[keyFrame].deltas.shrink_to_fit();
 		return true;
 	}
 	else
@@ -237,9 +531,13 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 	if (save_type != GREENZONE_SAVING_MODE_NO)
 	{
 		collectCurrentState();		// in case the project is being saved before the greenzone.update() was called within current frame
+		waitForCompression();		// don't write uncompressed savestates into the file
 		runGreenzoneCleaning();
 		if (greenzoneSize > (int)savestates.size())
 			greenzoneSize = savestates.size();
+	}
+	if (save_type == GREENZONE_SAVING_MODE_16TH || save_type == GREENZONE_SAVING_MODE_MARKED)
+	{
 		// write "GREENZONE" string
 		os->fwrite(greenzone_save_id, GREENZONE_ID_LEN);
 		// write LagLog
@@ -256,7 +554,27 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 	{
 		case GREENZONE_SAVING_MODE_ALL:
 		{
-			// write savestates
+			// written as a Greenzone holding only the savestate at Playback cursor, which is all that older versions read,
+			// followed by the keyframes and delta groups just as they are kept in memory, so nothing has to be recompressed
+			// write "GREENZONX" string
+			os->fwrite(greenzone_skipsave_id, GREENZONE_ID_LEN);
+			// write LagLog
+			lagLog.save(os);
+			// write Playback cursor position
+			write32le(currFrameCounter, os);
+			if (currFrameCounter > 0)
+			{
+				// write ONE savestate for currFrameCounter
+				std::vector<uint8_t>& savestate = getSavestateOfFrame(currFrameCounter);
+				size = savestate.size();
+				write32le(size, os);
+				os->fwrite(&savestate[0], size);
+			}
+			// write "GREENZOND" string
+			os->fwrite(greenzone_states_id, GREENZONE_ID_LEN);
+			// write size
+			write32le(greenzoneSize, os);
+			// write keyframes, each one followed by its delta group
 			for (frame = 0; frame < greenzoneSize; ++frame)
 			{
 				// update TASEditor progressbar from time to time
@@ -267,10 +585,21 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 				}
 				if (!savestates[frame].size()) continue;
 				write32le(frame, os);
-				// write savestate
 				size = savestates[frame].size();
 				write32le(size, os);
 				os->fwrite(&savestates[frame][0], size);
+				std::map<int, GREENZONE_DELTA_GROUP>::iterator it = deltaGroups.find(frame);
+				if (it == deltaGroups.end() || !it->second.ends.size() || frame + (int)it->second.ends.size() >= greenzoneSize) continue;
+				GREENZONE_DELTA_GROUP& group = it->second;
+				write32le(GREENZONE_DELTA_GROUP_ENTRY, os);
+				write32le(frame, os);
+				write32le(group.compressed ? 1 : 0, os);
+				write32le(group.ends.size(), os);
+				for (size_t i = 0; i < group.ends.size(); ++i)
+					write32le(group.ends[i], os);
+				size = group.deltas.size();
+				write32le(size, os);
+				os->fwrite(&group.deltas[0], size);
 			}
 			// write -1 as eof for greenzone
 			write32le(-1, os);
@@ -289,12 +618,13 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 						playback->setProgressbar(frame, greenzoneSize);
 						last_tick = frame / PROGRESSBAR_UPDATE_RATE;
 					}
-					if (!savestates[frame].size()) continue;
+					if (!isFrameStored(frame)) continue;
 					write32le(frame, os);
 					// write savestate
-					size = savestates[frame].size();
+					std::vector<uint8_t>& savestate = getSavestateOfFrame(frame);
+					size = savestate.size();
 					write32le(size, os);
-					os->fwrite(&savestates[frame][0], size);
+					os->fwrite(&savestate[0], size);
 				}
 			}
 			// write -1 as eof for greenzone
@@ -314,12 +644,13 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 						playback->setProgressbar(frame, greenzoneSize);
 						last_tick = frame / PROGRESSBAR_UPDATE_RATE;
 					}
-					if (!savestates[frame].size()) continue;
+					if (!isFrameStored(frame)) continue;
 					write32le(frame, os);
 					// write savestate
-					size = savestates[frame].size();
+					std::vector<uint8_t>& savestate = getSavestateOfFrame(frame);
+					size = savestate.size();
 					write32le(size, os);
-					os->fwrite(&savestates[frame][0], size);
+					os->fwrite(&savestate[0], size);
 				}
 			}
 			// write -1 as eof for greenzone
@@ -338,14 +669,30 @@ void GREENZONE::save(EMUFILE *os, int save_type)
 			{
 				// write ONE savestate for currFrameCounter
 				collectCurrentState();
-				int size = savestates[currFrameCounter].size();
+				waitForCompression();
+				std::vector<uint8_t>& savestate = getSavestateOfFrame(currFrameCounter);
+				int size = savestate.size();
 				write32le(size, os);
-				os->fwrite(&savestates[currFrameCounter][0], size);
+				os->fwrite(&savestate[0], size);
 			}
 			break;
 		}
 	}
 }
+// identifies what save() would write in the given mode without writing it: equal keys mean equal data, an empty key means it can't tell
+std::vector<unsigned int> GREENZONE::getSavingKey(int save_type)
+{
+	std::vector<unsigned int> key;
+	// what MARKED mode writes depends on Markers too
+	if (save_type == GREENZONE_SAVING_MODE_MARKED)
+		return key;
+	key.push_back(save_type);
+	key.push_back(changeCount);
+	key.push_back(greenzoneSize);
+	key.push_back(currFrameCounter);
+	key.push_back(lagLog.getRevision());
+	return key;
+}
 // returns true if couldn't load
 bool GREENZONE::load(EMUFILE *is, unsigned int offset)
 {
@@ -375,7 +722,7 @@ bool GREENZONE::load(EMUFILE *is, unsigned int offset)
 		{
 			currFrameCounter = frame;
 			greenzoneSize = currFrameCounter + 1;
-			savestates.resize(greenzoneSize);
+			resizeSavestates(greenzoneSize);
 			if (currFrameCounter)
 			{
 				// there must be one savestate in the file
@@ -384,13 +731,21 @@ bool GREENZONE::load(EMUFILE *is, unsigned int offset)
 					savestates[frame].resize(size);
 					if (is->fread(&savestates[frame][0], size) == size)
 					{
+						savestatesMemory += size;
+						// the whole Greenzone may follow it
+						bool stored = loadStoredStates(is);
 						if (loadSavestateOfFrame(currFrameCounter))
 						{
-							FCEU_printf("No Greenzone in the file\n");
+							if (!stored)
+								FCEU_printf("No Greenzone in the file\n");
 							return false;
 						}
 					}
 				}
+			} else if (loadStoredStates(is))
+			{
+				playback->restartPlaybackFromZeroGround();		// Playback cursor is at frame 0
+				return false;
 			} else
 			{
 				// literally no Greenzone in the file, but this is still not a error
@@ -409,16 +764,11 @@ bool GREENZONE::load(EMUFILE *is, unsigned int offset)
 	if (read32le(&size, is) && size >= 0 && size <= currMovieData.getNumRecords())
 	{
 		greenzoneSize = size;
-		savestates.resize(greenzoneSize);
+		resizeSavestates(greenzoneSize);
 		// read Playback cursor position
 		if (read32le(&frame, is))
 		{
 			currFrameCounter = frame;
-			int greenzone_tail_frame = currFrameCounter - taseditorConfig->greenzoneCapacity;
-			int greenzone_tail_frame2 = greenzone_tail_frame - 2 * taseditorConfig->greenzoneCapacity;
-			int greenzone_tail_frame4 = greenzone_tail_frame - 4 * taseditorConfig->greenzoneCapacity;
-			int greenzone_tail_frame8 = greenzone_tail_frame - 8 * taseditorConfig->greenzoneCapacity;
-			int greenzone_tail_frame16 = greenzone_tail_frame - 16 * taseditorConfig->greenzoneCapacity;
 			// read savestates
 			while(1)
 			{
@@ -433,23 +783,19 @@ bool GREENZONE::load(EMUFILE *is, unsigned int offset)
 				// read savestate
 				if (!read32le(&size, is)) break;
 				if (size < 0) break;
-				if (frame <= greenzone_tail_frame16
-					|| (frame <= greenzone_tail_frame8 && (frame & 0xF))
-					|| (frame <= greenzone_tail_frame4 && (frame & 0x7))
-					|| (frame <= greenzone_tail_frame2 && (frame & 0x3))
-					|| (frame <= greenzone_tail_frame && (frame & 0x1)))
+				// load this savestate
+				if ((int)savestates.size() <= frame)
+					resizeSavestates(frame + 1);
+				savestates[frame].resize(size);
+				if ((int)is->fread(&savestates[frame][0], size) < size)
 				{
-					// skip loading this savestate
-					if (is->fseek(size, SEEK_CUR) != 0) break;
-				} else
-				{
-					// load this savestate
-					if ((int)savestates.size() <= frame)
-						savestates.resize(frame + 1);
-					savestates[frame].resize(size);
-					if ((int)is->fread(&savestates[frame][0], size) < size) break;
-					prev_frame = frame;			// successfully read one Greenzone frame info
+					savestates[frame].resize(0);
+					break;
 				}
+				savestatesMemory += size;
+				prev_frame = frame;			// successfully read one Greenzone frame info
+				// don't let a huge Greenzone go over the memory limit while loading
+				evictSavestates();
 			}
 			if (prev_frame+1 == greenzoneSize)
 			{
@@ -484,6 +830,100 @@ error:
 	playback->restartPlaybackFromZeroGround();		// reset Playback cursor to frame 0
 	return true;
 }
+// reads the keyframes and delta groups that follow the savestate at Playback cursor, see save()
+// returns false if there are none, on error keeps what was read
+bool GREENZONE::loadStoredStates(EMUFILE *is)
+{
+	char save_id[GREENZONE_ID_LEN];
+	int frame, size, storedSize, lastFrame = -1;
+	int last_tick = 0;
+	bool complete = false;
+	std::vector<uint8_t> cursorState;
+
+	if ((int)is->fread(save_id, GREENZONE_ID_LEN) < GREENZONE_ID_LEN || strcmp(greenzone_states_id, save_id)) return false;
+	if (!read32le(&storedSize, is) || storedSize < 0 || storedSize > currMovieData.getNumRecords()) return false;
+	if ((int)savestates.size() < storedSize)
+		resizeSavestates(storedSize);
+	// the frame at Playback cursor is among the stored ones, keep its separate savestate only if it's missing
+	if (currFrameCounter < (int)savestates.size())
+	{
+		savestatesMemory -= savestates[currFrameCounter].size();
+		cursorState.swap(savestates[currFrameCounter]);
+	}
+	while (1)
+	{
+		if (!read32le(&frame, is)) break;
+		if (frame == -1)
+		{
+			complete = true;
+			break;
+		}
+		if (frame == GREENZONE_DELTA_GROUP_ENTRY)
+		{
+			// read delta group of the keyframe before it
+			int keyFrame, compressed, count;
+			if (!read32le(&keyFrame, is) || keyFrame != lastFrame || !savestates[keyFrame].size()) break;
+			if (!read32le(&compressed, is) || !read32le(&count, is)) break;
+			if (count <= 0 || count >= storedSize - keyFrame) break;
+			GREENZONE_DELTA_GROUP& group = deltaGroups[keyFrame];
+			group.compressed = compressed != 0;
+			group.ends.resize(count);
+			uint32 prev_end = 0;
+			int i;
+			for (i = 0; i < count; ++i)
+			{
+				if (!read32le(&group.ends[i], is) || group.ends[i] < prev_end) break;
+				prev_end = group.ends[i];
+			}
+			if (i < count || !read32le(&size, is) || size <= 0 || (!group.compressed && size != (int)prev_end))
+			{
+				deltaGroups.erase(keyFrame);
+				break;
+			}
+			group.deltas.resize(size);
+			if ((int)is->fread(&group.deltas[0], size) < size)
+			{
+				deltaGroups.erase(keyFrame);
+				break;
+			}
+			savestatesMemory += size;
+			for (i = 1; i <= count; ++i)
+				deltaBase[keyFrame + i] = keyFrame;
+			lastFrame = keyFrame + count;
+		} else
+		{
+			// read savestate of a keyframe
+			if (frame <= lastFrame || frame >= storedSize) break;
+			// don't let a huge Greenzone go over the memory limit while loading, the group of the previous keyframe is complete by now
+			evictSavestates();
+			if (!read32le(&size, is) || size <= 0) break;
+			savestates[frame].resize(size);
+			if ((int)is->fread(&savestates[frame][0], size) < size)
+			{
+				savestates[frame].resize(0);
+				break;
+			}
+			savestatesMemory += size;
+			lastFrame = frame;
+		}
+		// update TASEditor progressbar from time to time
+		if (lastFrame / PROGRESSBAR_UPDATE_RATE > last_tick)
+		{
+			playback->setProgressbar(lastFrame, storedSize);
+			last_tick = lastFrame / PROGRESSBAR_UPDATE_RATE;
+		}
+	}
+	evictSavestates();
+	if (currFrameCounter < (int)savestates.size() && !isFrameStored(currFrameCounter) && cursorState.size())
+	{
+		savestates[currFrameCounter].swap(cursorState);
+		savestatesMemory += savestates[currFrameCounter].size();
+	}
+	greenzoneSize = std::max(complete ? storedSize : lastFrame + 1, currFrameCounter + 1);
+	if (!complete)
+		FCEU_printf("Greenzone loaded partially\n");
+	return true;
+}
 // -------------------------------------------------------------------------------------------------
 void GREENZONE::adjustUp()
 {
@@ -636,7 +1076,7 @@ void GREENZONE::invalidateAndUpdatePlayback(int after)
 int GREENZONE::findFirstGreenzonedFrame(int starting_index)
 {
 	for (int i = starting_index; i < greenzoneSize; ++i)
-		if (savestates[i].size()) return i;
+		if (isFrameStored(i)) return i;
 	return -1;	// error
 }
 
@@ -649,23 +1089,147 @@ int GREENZONE::getSize()
 // this should only be used by Bookmark Set procedure
 std::vector<uint8>& GREENZONE::getSavestateOfFrame(int frame)
 {
+	// Bookmarks keep their savestates for long, so give them the compressed one
+	if (deltaBase[frame] >= 0)
+	{
+		exportedState.clear();
+		if (reconstructSavestate(frame, restoredState))
+			compressSavestate(restoredState, exportedState);
+		return exportedState;
+	}
+	if (frame < (int)pendingCompression.size() && pendingCompression[frame])
+	{
+		std::vector<uint8_t> compressed;
+		if (compressSavestate(savestates[frame], compressed))
+		{
+			finishCompression(frame);
+			changeCount++;
+			savestatesMemory -= savestates[frame].size();
+			savestates[frame].swap(compressed);
+			savestatesMemory += savestates[frame].size();
+		}
+	}
 	return savestates[frame];
 }
 // this function should only be used by Bookmark Deploy procedure
 void GREENZONE::writeSavestateForFrame(int frame, std::vector<uint8>& savestate)
 {
 	if ((int)savestates.size() <= frame)
-		savestates.resize(frame + 1);
+		resizeSavestates(frame + 1);
+	clearSavestateOfFrame(frame);
+	changeCount++;
 	savestates[frame] = savestate;
+	savestatesMemory += savestates[frame].size();
 	if (greenzoneSize <= frame)
 		greenzoneSize = frame + 1;
 }
 
+size_t GREENZONE::getMemoryUsage()
+{
+	return savestatesMemory;
+}
+int GREENZONE::getSavestatesCount()
+{
+	int count = 0;
+	for (int i = 0; i < (int)savestates.size(); ++i)
+		if (isFrameStored(i)) count++;
+	return count;
+}
+// seconds it took to restore the savestate last time
+double GREENZONE::getLastSeekTime()
+{
+	return lastSeekTime;
+}
+
 bool GREENZONE::isSavestateEmpty(unsigned int frame)
 {
-	if ((int)frame < greenzoneSize && frame < savestates.size() && savestates[frame].size())
+	if ((int)frame < greenzoneSize && frame < savestates.size() && isFrameStored(frame))
 		return false;
 	else
 		return true;
 }
-
+// -------------------------------------------------------------------------------------------------
+void GREENZONE::resizeSavestates(int size)
+{
+	savestates.resize(size);
+	deltaBase.resize(size, -1);
+}
+bool GREENZONE::isFrameStored(int frame)
+{
+	return savestates[frame].size() || deltaBase[frame] >= 0;
+}
+// -------------------------------------------------------------------------------------------------
+unsigned int GREENZONE::getNextTicket()
+{
+	if (!++lastTicket)
+		++lastTicket;
+	return lastTicket;
+}
+// hands a copy of the freshly collected savestate to the compression workers
+void GREENZONE::queueCompression(int frame)
+{
+	if ((int)pendingCompression.size() <= frame)
+		pendingCompression.resize(frame + 1, 0);
+	pendingCompression[frame] = getNextTicket();
+	compressionPool.start(new GreenzoneCompressionTask(this, frame, pendingCompression[frame], false, savestates[frame]));
+}
+void GREENZONE::queueDeltaCompression(int keyFrame)
+{
+	GREENZONE_DELTA_GROUP& group = deltaGroups[keyFrame];
+	if (!group.deltas.size()) return;
+	group.ticket = getNextTicket();
+	compressionPool.start(new GreenzoneCompressionTask(this, keyFrame, group.ticket, true, group.deltas));
+}
+// forgets about the compression job of the frame, its result will be dropped when it arrives
+void GREENZONE::finishCompression(int frame)
+{
+	if (frame < (int)pendingCompression.size())
+		pendingCompression[frame] = 0;
+}
+// called from the worker threads
+void GREENZONE::submitCompressedState(GREENZONE_COMPRESSED_STATE& state)
+{
+	QMutexLocker lock(&compressedStatesMutex);
+	compressedStates.push_back(GREENZONE_COMPRESSED_STATE());
+	compressedStates.back().frame = state.frame;
+	compressedStates.back().ticket = state.ticket;
+	compressedStates.back().deltas = state.deltas;
+	compressedStates.back().savestate.swap(state.savestate);
+}
+// replaces uncompressed savestates with the compressed ones that are ready,
+// unless the savestate was changed or deleted since the job was started
+void GREENZONE::installCompressedStates()
+{
+	std::vector<GREENZONE_COMPRESSED_STATE> ready;
+	{
+		QMutexLocker lock(&compressedStatesMutex);
+		ready.swap(compressedStates);
+	}
+	for (size_t i = 0; i < ready.size(); ++i)
+	{
+		int frame = ready[i].frame;
+		if (ready[i].deltas)
+		{
+			std::map<int, GREENZONE_DELTA_GROUP>::iterator it = deltaGroups.find(frame);
+			if (it == deltaGroups.end() || it->second.ticket != ready[i].ticket) continue;
+			it->second.ticket = 0;
+			it->second.compressed = true;
+			changeCount++;
+			savestatesMemory -= it->second.deltas.size();
+			it->second.deltas.swap(ready[i].savestate);
+			savestatesMemory += it->second.deltas.size();
+			continue;
+		}
+		if (frame >= (int)pendingCompression.size() || pendingCompression[frame] != ready[i].ticket) continue;
+		pendingCompression[frame] = 0;
+		changeCount++;
+		savestatesMemory -= savestates[frame].size();
+		savestates[frame].swap(ready[i].savestate);
+		savestatesMemory += savestates[frame].size();
+	}
+}
+void GREENZONE::waitForCompression()
+{
+	compressionPool.waitForDone();
+	installCompressedStates();
+}
@@ -2,6 +2,10 @@
 #pragma once
 #include <stdint.h>
 #include <vector>
+#include <map>
+
+#include <QMutex>
+#include <QThreadPool>
 
 #include "Qt/TasEditor/laglog.h"
 
@@ -17,6 +21,31 @@
 
 #define PROGRESSBAR_UPDATE_RATE 1000	// progressbar is updated after every 1000 savestates loaded from FM3 file
 
+#define GREENZONE_KEYFRAME_INTERVAL 16	// a full savestate is kept at every 16th frame, other frames are deltas against the full savestate before them
+
+#define GREENZONE_CLEANING_TARGET 90	// when over the memory limit, savestates are evicted until this percent of the limit is used
+
+#define GREENZONE_DELTA_GROUP_ENTRY -2	// in the stored states of a project file: a delta group follows instead of a savestate
+
+// savestate compressed by the background workers, waiting to be put into the Greenzone
+struct GREENZONE_COMPRESSED_STATE
+{
+	int frame;
+	unsigned int ticket;
+	bool deltas;						// deltas of the group of this keyframe rather than its savestate
+	std::vector<uint8_t> savestate;
+};
+
+// frames following a keyframe, stored as deltas against the keyframe savestate
+struct GREENZONE_DELTA_GROUP
+{
+	GREENZONE_DELTA_GROUP() : compressed(false), ticket(0) {}
+	std::vector<uint8_t> deltas;		// deltas of frames keyframe+1, keyframe+2... one after another, deflated when the group is complete
+	std::vector<uint32_t> ends;			// end of each delta in the inflated deltas
+	bool compressed;
+	unsigned int ticket;				// compression job running for the group, 0 = none
+};
+
 class GREENZONE
 {
 public:
@@ -27,6 +56,7 @@ public:
 	void update();
 
 	void save(EMUFILE *os, int save_type = GREENZONE_SAVING_MODE_ALL);
+	std::vector<unsigned int> getSavingKey(int save_type);
 	bool load(EMUFILE *is, unsigned int offset);
 
 	bool loadSavestateOfFrame(unsigned int frame);
@@ -44,23 +74,65 @@ public:
 	std::vector<uint8_t>& getSavestateOfFrame(int frame);
 	void writeSavestateForFrame(int frame, std::vector<uint8>& savestate);
 	bool isSavestateEmpty(unsigned int frame);
+	size_t getMemoryUsage();
+	int getSavestatesCount();
+	double getLastSeekTime();
 
 	// saved data
 	LAGLOG lagLog;
 
 private:
 	void collectCurrentState();
+	bool loadStoredStates(EMUFILE *is);
+	bool appendDelta(int frame);
 	bool clearSavestateOfFrame(unsigned int frame);
 	bool clearSavestateAndFreeMemory(unsigned int frame);
+	void resizeSavestates(int size);
+	bool isFrameStored(int frame);
+
+	const std::vector<uint8_t>* getKeyFrameState(int frame);
+	const std::vector<uint8_t>* getDeltaGroupDeltas(int keyFrame);
+	bool inflateDeltaGroup(int keyFrame);
+	bool reconstructSavestate(int frame, std::vector<uint8_t>& out);
+	void truncateDeltaGroup(int frame);
+
+	unsigned int getNextTicket();
+	void queueCompression(int frame);
+	void queueDeltaCompression(int keyFrame);
+	void finishCompression(int frame);
+	void installCompressedStates();
+	void waitForCompression();
+	void submitCompressedState(GREENZONE_COMPRESSED_STATE& state);
+	bool evictSavestates();
 
 	void adjustUp();
 	void adjustDown();
 
 	// saved data
 	int greenzoneSize;
-	std::vector<std::vector<uint8_t>> savestates;
+	std::vector<std::vector<uint8_t>> savestates;		// full savestates, only keyframes and savestates loaded from the project or Bookmarks
 
 	// not saved data
 	clock_t nextCleaningTime;
-	
+	size_t savestatesMemory;							// total bytes held by savestates and deltas
+	std::vector<int> deltaBase;							// for frames stored as deltas: the keyframe, -1 for others
+	std::map<int, GREENZONE_DELTA_GROUP> deltaGroups;	// by keyframe
+	int cachedKeyFrame;
+	std::vector<uint8_t> cachedKeyState;				// uncompressed savestate of cachedKeyFrame
+	int cachedDeltaGroup;
+	std::vector<uint8_t> cachedDeltas;					// inflated deltas of the group of cachedDeltaGroup
+	std::vector<uint8_t> collectedState, restoredState, exportedState, deltaBuffer;
+	double lastSeekTime;
+	unsigned int changeCount;							// changes of the stored savestates, for getSavingKey()
+	bool evictionBlocked;								// the last eviction pass freed nothing
+	size_t blockedMemory, blockedLimit;
+	std::vector<int> blockedAnchorFrames;
+	std::vector<unsigned int> pendingCompression;		// ticket of the compression job running for each frame, 0 = none
+	unsigned int lastTicket;
+	QMutex compressedStatesMutex;
+	std::vector<GREENZONE_COMPRESSED_STATE> compressedStates;
+	// must stay the last member: its destructor waits for the running jobs, which still use the members above
+	QThreadPool compressionPool;
+
+	friend class GreenzoneCompressionTask;
 };
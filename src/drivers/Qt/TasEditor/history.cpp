@@ -50,6 +50,7 @@ extern int getInputType(MovieData& md);
 
 char historySaveID[HISTORY_ID_LEN] = "HISTORY";
 char historySkipSaveID[HISTORY_ID_LEN] = "HISTORX";
+char historyChunkedSaveID[HISTORY_ID_LEN] = "HISTORC";		// InputLogs saved as ids in the table of chunks
 char modCaptions[MODTYPES_TOTAL][20] = {" Initialization",
 					" Undefined",
 					" Set",
@@ -113,6 +114,7 @@ char joypadCaptions[5][11] = {"(Commands)", "(1P)", "(2P)", "(3P)", "(4P)"};
 HISTORY::HISTORY()
 {
 	updateScheduled = false;
+	changeCount = 0;
 }
 
 void HISTORY::init(void)
@@ -127,6 +129,7 @@ void HISTORY::free()
 	bookmarkBackups.resize(0);
 	currentBranchNumberBackups.resize(0);
 	historyTotalItems = 0;
+	changeCount++;
 }
 void HISTORY::reset()
 {
@@ -188,10 +191,12 @@ void HISTORY::update()
 				real_pos = (historyStartPos + i) % historySize;
 				if (!snapshots[real_pos].isAlreadyCompressed())
 				{
+					changeCount++;
 					snapshots[real_pos].compressData();
 					break;
 				} else if (bookmarkBackups[real_pos].notEmpty && bookmarkBackups[real_pos].snapshot.isAlreadyCompressed())
 				{
+					changeCount++;
 					bookmarkBackups[real_pos].snapshot.compressData();
 					break;
 				}
@@ -204,6 +209,7 @@ void HISTORY::update()
 void HISTORY::updateHistoryLogSize()
 {
 	int newHistorySize = taseditorConfig->maxUndoLevels + 1;
+	changeCount++;
 	std::vector<SNAPSHOT> new_snapshots(newHistorySize);
 	std::vector<BOOKMARK> new_backup_bookmarks(newHistorySize);
 	std::vector<int8> new_backup_current_branch(newHistorySize);
@@ -257,6 +263,7 @@ int HISTORY::jumpInTime(int new_pos)
 	// make jump
 	int old_pos = historyCursorPos;
 	historyCursorPos = new_pos;
+	changeCount++;
 	redrawList();
 
 	int real_pos, mod_type, slot, current_branch = branches->getCurrentBranch();
@@ -442,6 +449,12 @@ void HISTORY::redo()
 // ----------------------------
 void HISTORY::addItemToHistoryLog(SNAPSHOT &snap, int currentBranch)
 {
+	changeCount++;
+	// share unchanged Input with the current snapshot
+	if (historyTotalItems)
+		snap.inputlog.pack(&snapshots[(historyStartPos + historyCursorPos) % historySize].inputlog);
+	else
+		snap.inputlog.pack();
 	historyCursorPos++;
 	historyTotalItems = historyCursorPos + 1;
 	// history uses ring buffer to avoid frequent reallocations caused by vector resizing, which would be awfully expensive with such large objects as SNAPSHOT and BOOKMARK
@@ -464,6 +477,12 @@ void HISTORY::addItemToHistoryLog(SNAPSHOT &snap, int currentBranch)
 }
 void HISTORY::addItemToHistoryLog(SNAPSHOT &snap, int cur_branch, BOOKMARK &bookm)
 {
+	changeCount++;
+	// share unchanged Input with the current snapshot
+	if (historyTotalItems)
+		snap.inputlog.pack(&snapshots[(historyStartPos + historyCursorPos) % historySize].inputlog);
+	else
+		snap.inputlog.pack();
 	// history uses ring buffer to avoid frequent reallocations caused by vector resizing, which would be awfully expensive with such large objects as SNAPSHOT and BOOKMARK
 	if (historyTotalItems >= historySize)
 	{
@@ -579,6 +598,7 @@ int HISTORY::registerChanges(int mod_type, int start, int end, int size, const c
 				snap.inputlog.fillHotChanges(snapshots[real_pos].inputlog, first_changes, end);
 			}
 			// replace current snapshot with this cloned snapshot and truncate history here
+			changeCount++;
 			snapshots[real_pos] = snap;
 			historyTotalItems = historyCursorPos+1;
 			updateList();
@@ -677,6 +697,8 @@ int HISTORY::registerAdjustLag(int start, int size)
 				snap.inputlog.inheritHotChanges_InsertNum(&snapshots[real_pos].inputlog, start, 1, false);
 		}
 		// replace current snapshot with this cloned snapshot and don't truncate history
+		snap.inputlog.pack(&current_snap.inputlog);
+		changeCount++;
 		snapshots[real_pos] = snap;
 		updateList();
 		redrawList();
@@ -815,8 +837,10 @@ void HISTORY::registerRecording(int frameOfChange, uint32 joypadDifferenceBits)
 		&& snapshots[real_pos].recordedJoypadDifferenceBits == joypadDifferenceBits)	// c) recorded same set of joysticks/commands
 	{
 		// reinit current snapshot and set hotchanges
+		changeCount++;
 		SNAPSHOT* snap = &snapshots[real_pos];
 		snap->reinit(currMovieData, greenzone->lagLog, taseditorConfig->enableHotChanges, frameOfChange);
+		snap->inputlog.pack();
 		// refill description
 		strcat(snap->description, modCaptions[MODTYPE_RECORD]);
 		char framenum[11];
@@ -1008,17 +1032,27 @@ void HISTORY::save(EMUFILE *os, bool really_save)
 	if (really_save)
 	{
 		int real_pos, last_tick = 0;
-		// write "HISTORY" string
-		os->fwrite(historySaveID, HISTORY_ID_LEN);
+		// write "HISTORC" string
+		os->fwrite(historyChunkedSaveID, HISTORY_ID_LEN);
 		// write vars
 		write32le(historyCursorPos, os);
 		write32le(historyTotalItems, os);
+		// write every chunk of Input only once, items refer to them by ids
+		INPUTLOG_CHUNK_TABLE chunkTable;
+		for (int i = 0; i < historyTotalItems; ++i)
+		{
+			real_pos = (historyStartPos + i) % historySize;
+			chunkTable.add(snapshots[real_pos].inputlog);
+			if (bookmarkBackups[real_pos].notEmpty)
+				chunkTable.add(bookmarkBackups[real_pos].snapshot.inputlog);
+		}
+		chunkTable.save(os);
 		// write items starting from history_start_pos
 		for (int i = 0; i < historyTotalItems; ++i)
 		{
 			real_pos = (historyStartPos + i) % historySize;
-			snapshots[real_pos].save(os);
-			bookmarkBackups[real_pos].save(os);
+			snapshots[real_pos].save(os, &chunkTable);
+			bookmarkBackups[real_pos].save(os, &chunkTable);
 			os->fwrite(&currentBranchNumberBackups[real_pos], 1);
 			if (i / SAVING_HISTORY_PROGRESSBAR_UPDATE_RATE > last_tick)
 			{
@@ -1032,6 +1066,20 @@ void HISTORY::save(EMUFILE *os, bool really_save)
 		os->fwrite(historySkipSaveID, HISTORY_ID_LEN);
 	}
 }
+// identifies what save() would write without writing it: equal keys mean equal data
+std::vector<unsigned int> HISTORY::getSavingKey(bool reallySave)
+{
+	std::vector<unsigned int> key;
+	key.push_back(reallySave);
+	if (reallySave)
+	{
+		key.push_back(changeCount);
+		// the LagLog of the current snapshot is kept in touch with the Greenzone from outside
+		if (historyTotalItems)
+			key.push_back(getCurrentSnapshot().laglog.getRevision());
+	}
+	return key;
+}
 // returns true if couldn't load
 bool HISTORY::load(EMUFILE *is, unsigned int offset)
 {
@@ -1039,6 +1087,8 @@ bool HISTORY::load(EMUFILE *is, unsigned int offset)
 	char save_id[HISTORY_ID_LEN];
 	SNAPSHOT snap;
 	BOOKMARK bookm;
+	INPUTLOG_CHUNK_TABLE chunkTable;
+	INPUTLOG_CHUNK_TABLE* chunks = NULL;
 
 	if (offset)
 	{
@@ -1057,8 +1107,11 @@ bool HISTORY::load(EMUFILE *is, unsigned int offset)
 		reset();
 		return false;
 	}
-	if (strcmp(historySaveID, save_id)) goto error;		// string is not valid
+	if (!strcmp(historyChunkedSaveID, save_id))
+		chunks = &chunkTable;
+	else if (strcmp(historySaveID, save_id)) goto error;		// string is not valid
 	// delete old items
+	changeCount++;
 	snapshots.resize(historySize);
 	bookmarkBackups.resize(historySize);
 	currentBranchNumberBackups.resize(historySize);
@@ -1067,6 +1120,7 @@ bool HISTORY::load(EMUFILE *is, unsigned int offset)
 	if (!read32le(&historyTotalItems, is)) goto error;
 	if (historyCursorPos > historyTotalItems) goto error;
 	historyStartPos = 0;
+	if (chunks && chunks->load(is)) goto error;
 	// read items
 	total = historyTotalItems;
 	if (historyTotalItems > historySize)
@@ -1083,8 +1137,8 @@ bool HISTORY::load(EMUFILE *is, unsigned int offset)
 			// and still need to skip some undo items
 			for (i = 0; i < num_items_to_skip; ++i)
 			{
-				if (snap.skipLoad(is)) goto error;
-				if (bookm.skipLoad(is)) goto error;
+				if (snap.skipLoad(is, chunks)) goto error;
+				if (bookm.skipLoad(is, chunks)) goto error;
 				if (is->fseek(1, SEEK_CUR)) goto error;		// backup_current_branch
 			}
 			total -= num_items_to_skip;
@@ -1095,16 +1149,23 @@ bool HISTORY::load(EMUFILE *is, unsigned int offset)
 	// load items
 	for (i = 0; i < historyTotalItems; ++i)
 	{
-		if (snapshots[i].load(is)) goto error;
-		if (bookmarkBackups[i].load(is)) goto error;
+		if (snapshots[i].load(is, chunks)) goto error;
+		if (bookmarkBackups[i].load(is, chunks)) goto error;
 		if (is->fread(&currentBranchNumberBackups[i], 1) != 1) goto error;
+		if (!chunks)
+		{
+			// old format, find the data shared with the previous item
+			snapshots[i].inputlog.pack(i ? &snapshots[i - 1].inputlog : NULL);
+			if (bookmarkBackups[i].notEmpty)
+				bookmarkBackups[i].snapshot.inputlog.pack(&snapshots[i].inputlog);
+		}
 		playback->setProgressbar(i, historyTotalItems);
 	}
 	// skip redo items if needed
 	for (; i < total; ++i)
 	{
-		if (snap.skipLoad(is)) goto error;
-		if (bookm.skipLoad(is)) goto error;
+		if (snap.skipLoad(is, chunks)) goto error;
+		if (bookm.skipLoad(is, chunks)) goto error;
 		if (is->fseek(1, SEEK_CUR)) goto error;		// backup_current_branch
 	}
 
@@ -109,6 +109,7 @@ public:
 
 	void save(EMUFILE *os, bool reallySave = true);
 	bool load(EMUFILE *is, unsigned int offset);
+	std::vector<unsigned int> getSavingKey(bool reallySave);
 
 	void undo();
 	void redo();
@@ -161,6 +162,7 @@ private:
 	bool showUndoHint, oldShowUndoHint;
 	bool updateScheduled;
 	clock_t nextAutocompressTime;
+	unsigned int changeCount;				// changes of the saved data, for getSavingKey()
 
 };
 
@@ -14,6 +14,7 @@ InputLog - Log of Input
 * implements InputLog creation: copying Input, copying Hot Changes
 * implements full/partial restoring of data from InputLog: Input, Hot Changes
 * implements compression and decompression of stored data
+* packs the data into immutable chunks, so that InputLogs of History and Bookmarks share all unchanged chunks with each other
 * saves and loads the data from a project file. On error: sends warning to caller
 * implements searching of first mismatch comparing two InputLogs or comparing this InputLog to a movie
 * provides interface for reading specific data: reading Input of any given frame, reading value at any point of Hot Changes map
@@ -21,23 +22,287 @@ InputLog - Log of Input
 ------------------------------------------------------------------------------------ */
 
 #include <zlib.h>
+#include <algorithm>
 #include "Qt/TasEditor/inputlog.h"
 #include "Qt/TasEditor/taseditor_project.h"
+#include "utils/crc32.h"
 
 extern SELECTION selection;
 
 int joysticksPerFrame[INPUT_TYPES_TOTAL] = {1, 2, 4};
 
+// what is read beyond the end of the data
+static const uint8_t zeroFrames[INPUTLOG_CHUNK_SIZE] = {0};
+
+void INPUTLOG_CHUNK::compress()
+{
+	int len = data.size();
+	uLongf comprlen = (len>>9)+12 + len;
+	compressedData.resize(comprlen);
+	::compress(&compressedData[0], &comprlen, data.size() ? &data[0] : NULL, len);
+	compressedData.resize(comprlen);
+}
+
+INPUTLOG_CHUNKS::INPUTLOG_CHUNKS()
+{
+	frames = 0;
+	bytesPerFrame = 0;
+	lastChunk = 0;
+}
+
+void INPUTLOG_CHUNKS::clear()
+{
+	chunks.resize(0);
+	starts.resize(0);
+	frames = 0;
+	lastChunk = 0;
+}
+
+// cut the source array into chunks, reusing chunks of the base wherever the base has the same data,
+// either at the same frames or at frames shifted by the number of inserted/deleted frames
+void INPUTLOG_CHUNKS::pack(const std::vector<uint8_t>& source, int bytes, const INPUTLOG_CHUNKS& base)
+{
+	std::vector<INPUTLOG_CHUNK_PTR> new_chunks;
+	std::vector<int> new_starts;
+	int total = source.size() / bytes;
+	bool use_base = (base.bytesPerFrame == bytes && base.chunks.size());
+	int shift = total - base.frames;
+	int chunk_frames = INPUTLOG_CHUNK_SIZE / bytes;
+	int last_new = -1;		// chunk created by the last iteration, small pieces of new data are appended to it
+	int pos = 0, next, i;
+	while (pos < total)
+	{
+		next = total;
+		if (use_base)
+		{
+			i = base.findChunk(pos);
+			if (i >= 0 && (base.chunks[i]->frames > total - pos || memcmp(&base.chunks[i]->data[0], &source[pos * bytes], base.chunks[i]->data.size())))
+				i = -1;
+			if (i < 0 && shift)
+			{
+				i = base.findChunk(pos - shift);
+				if (i >= 0 && (base.chunks[i]->frames > total - pos || memcmp(&base.chunks[i]->data[0], &source[pos * bytes], base.chunks[i]->data.size())))
+					i = -1;
+			}
+			if (i >= 0)
+			{
+				// share the chunk
+				new_chunks.push_back(base.chunks[i]);
+				new_starts.push_back(pos);
+				pos += base.chunks[i]->frames;
+				last_new = -1;
+				continue;
+			}
+			// new data lasts at most until the next place where a chunk of the base may match again
+			next = std::min(next, base.findNextStart(pos));
+			if (shift)
+				next = std::min(next, base.findNextStart(pos - shift) + shift);
+		}
+		int len = next - pos;
+		if (last_new >= 0 && len < chunk_frames / 4 && new_chunks[last_new]->frames + len <= chunk_frames * 2)
+		{
+			INPUTLOG_CHUNK* chunk = new_chunks[last_new].get();
+			chunk->data.insert(chunk->data.end(), source.begin() + pos * bytes, source.begin() + next * bytes);
+			chunk->frames += len;
+		} else
+		{
+			// split the data evenly into chunks of up to INPUTLOG_CHUNK_SIZE bytes
+			int pieces = (len + chunk_frames - 1) / chunk_frames;
+			for (i = 0; i < pieces; ++i)
+			{
+				int piece_start = pos + (int)((int64)len * i / pieces);
+				int piece_end = pos + (int)((int64)len * (i + 1) / pieces);
+				INPUTLOG_CHUNK_PTR chunk = std::make_shared<INPUTLOG_CHUNK>();
+				chunk->frames = piece_end - piece_start;
+				chunk->data.assign(source.begin() + piece_start * bytes, source.begin() + piece_end * bytes);
+				new_chunks.push_back(chunk);
+				new_starts.push_back(piece_start);
+			}
+			last_new = new_chunks.size() - 1;
+		}
+		pos = next;
+	}
+	// the base may be this object, so replace the chunks only now
+	chunks.swap(new_chunks);
+	starts.swap(new_starts);
+	frames = total;
+	bytesPerFrame = bytes;
+	lastChunk = 0;
+}
+
+void INPUTLOG_CHUNKS::unpack(std::vector<uint8_t>& dest) const
+{
+	dest.resize(frames * bytesPerFrame);
+	for (int i = chunks.size() - 1; i >= 0; i--)
+		memcpy(&dest[starts[i] * bytesPerFrame], &chunks[i]->data[0], chunks[i]->data.size());
+}
+
+void INPUTLOG_CHUNKS::compress()
+{
+	for (int i = chunks.size() - 1; i >= 0; i--)
+		if (chunks[i]->compressedData.empty())
+			chunks[i]->compress();
+}
+bool INPUTLOG_CHUNKS::isCompressed() const
+{
+	for (int i = chunks.size() - 1; i >= 0; i--)
+		if (chunks[i]->compressedData.empty())
+			return false;
+	return true;
+}
+
+// returns pointer to the data of the frame and the number of frames that can be read from there
+const uint8_t* INPUTLOG_CHUNKS::getFrames(int frame, int* count) const
+{
+	if (frame >= frames)
+	{
+		*count = INPUTLOG_CHUNK_SIZE / bytesPerFrame;
+		return zeroFrames;
+	}
+	int i = lastChunk;
+	if (frame < starts[i] || frame >= starts[i] + chunks[i]->frames)
+	{
+		i = (std::upper_bound(starts.begin(), starts.end(), frame) - starts.begin()) - 1;
+		lastChunk = i;
+	}
+	*count = starts[i] + chunks[i]->frames - frame;
+	return &chunks[i]->data[(frame - starts[i]) * bytesPerFrame];
+}
+
+// returns index of the chunk beginning at the frame, or -1
+int INPUTLOG_CHUNKS::findChunk(int start) const
+{
+	std::vector<int>::const_iterator it = std::lower_bound(starts.begin(), starts.end(), start);
+	if (it == starts.end() || *it != start)
+		return -1;
+	return it - starts.begin();
+}
+// returns the first frame after the given one where a chunk begins or the data ends
+int INPUTLOG_CHUNKS::findNextStart(int frame) const
+{
+	std::vector<int>::const_iterator it = std::upper_bound(starts.begin(), starts.end(), frame);
+	if (it == starts.end())
+		return std::max(frames, frame + 1);
+	return *it;
+}
+// -----------------------------------------------------------------------------------------------
+void INPUTLOG_CHUNK_TABLE::add(INPUTLOG& inputlog)
+{
+	inputlog.pack();
+	addChunks(inputlog.joysticksChunks);
+	addChunks(inputlog.commandsChunks);
+	if (inputlog.hasHotChanges)
+		addChunks(inputlog.hotChangesChunks);
+}
+void INPUTLOG_CHUNK_TABLE::addChunks(INPUTLOG_CHUNKS& source)
+{
+	for (unsigned int i = 0; i < source.chunks.size(); ++i)
+	{
+		INPUTLOG_CHUNK* chunk = source.chunks[i].get();
+		if (ids.find(chunk) != ids.end())
+			continue;
+		// chunks that were made separately may still have the same data
+		uint32 crc = CalcCRC32(0, &chunk->data[0], chunk->data.size());
+		int id = -1;
+		for (std::multimap<uint32, int>::iterator it = checksums.lower_bound(crc); it != checksums.end() && it->first == crc; ++it)
+		{
+			INPUTLOG_CHUNK* other = chunks[it->second].get();
+			if (other->frames == chunk->frames && other->data == chunk->data)
+			{
+				id = it->second;
+				break;
+			}
+		}
+		if (id < 0)
+		{
+			id = chunks.size();
+			chunks.push_back(source.chunks[i]);
+			checksums.insert(std::make_pair(crc, id));
+		}
+		ids[chunk] = id;
+	}
+}
+
+void INPUTLOG_CHUNK_TABLE::save(EMUFILE *os)
+{
+	write32le((int)chunks.size(), os);
+	for (unsigned int i = 0; i < chunks.size(); ++i)
+	{
+		INPUTLOG_CHUNK* chunk = chunks[i].get();
+		if (chunk->compressedData.empty())
+			chunk->compress();
+		write32le(chunk->frames, os);
+		write32le((int)chunk->data.size(), os);
+		write32le((int)chunk->compressedData.size(), os);
+		os->fwrite(&chunk->compressedData[0], chunk->compressedData.size());
+	}
+}
+// returns true if couldn't load
+bool INPUTLOG_CHUNK_TABLE::load(EMUFILE *is)
+{
+	int total, len, comprlen;
+	chunks.resize(0);
+	ids.clear();
+	checksums.clear();
+	if (!read32le(&total, is)) return true;
+	if (total < 0) return true;
+	for (int i = 0; i < total; ++i)
+	{
+		INPUTLOG_CHUNK_PTR chunk = std::make_shared<INPUTLOG_CHUNK>();
+		if (!read32le(&chunk->frames, is)) return true;
+		if (!read32le(&len, is)) return true;
+		if (!read32le(&comprlen, is)) return true;
+		if (chunk->frames <= 0 || len <= 0 || len % chunk->frames || comprlen <= 0) return true;
+		chunk->compressedData.resize(comprlen);
+		if ((int)is->fread(&chunk->compressedData[0], comprlen) != comprlen) return true;
+		chunk->data.resize(len);
+		uLongf destlen = len;
+		int e = uncompress(&chunk->data[0], &destlen, &chunk->compressedData[0], comprlen);
+		if (e != Z_OK || (int)destlen != len) return true;
+		chunks.push_back(chunk);
+	}
+	return false;
+}
+
+void INPUTLOG_CHUNK_TABLE::saveChunks(INPUTLOG_CHUNKS& source, EMUFILE *os)
+{
+	write32le((int)source.chunks.size(), os);
+	for (unsigned int i = 0; i < source.chunks.size(); ++i)
+		write32le(ids[source.chunks[i].get()], os);
+}
+// returns true if couldn't load
+bool INPUTLOG_CHUNK_TABLE::loadChunks(INPUTLOG_CHUNKS& dest, int bytes, EMUFILE *is)
+{
+	int total, id;
+	dest.clear();
+	dest.bytesPerFrame = bytes;
+	if (!read32le(&total, is)) return true;
+	if (total < 0) return true;
+	for (int i = 0; i < total; ++i)
+	{
+		if (!read32le(&id, is)) return true;
+		if (id < 0 || id >= (int)chunks.size()) return true;
+		if ((int)chunks[id]->data.size() != chunks[id]->frames * bytes) return true;
+		dest.chunks.push_back(chunks[id]);
+		dest.starts.push_back(dest.frames);
+		dest.frames += chunks[id]->frames;
+	}
+	return false;
+}
+// -----------------------------------------------------------------------------------------------
 INPUTLOG::INPUTLOG()
 {
 	size = 0;
 	inputType = 0;
 	hasHotChanges = 0;
+	packed = false;
 	alreadyCompressed = false;
 }
 
 void INPUTLOG::init(MovieData& md, bool hotchanges, int force_input_type)
 {
+	// the old chunks are kept, they will be reused if the new data has same pieces
+	packed = false;
 	hasHotChanges = hotchanges;
 	if (force_input_type < 0)
 		inputType = getInputType(md);
@@ -48,6 +313,7 @@ void INPUTLOG::init(MovieData& md, bool hotchanges, int force_input_type)
 	size = md.getNumRecords();
 	joysticks.resize(BYTES_PER_JOYSTICK * num_joys * size);		// it's much faster to have this format than have [frame][joy] or other structures
 	commands.resize(size);				// commands take 1 byte per frame
+	hotChanges.resize(0);
 	if (hasHotChanges)
 		initHotChanges();
 
@@ -66,6 +332,7 @@ void INPUTLOG::init(MovieData& md, bool hotchanges, int force_input_type)
 // the function should only be used when combining consecutive Recordings
 void INPUTLOG::reinit(MovieData& md, bool hotchanges, int frame_of_change)
 {
+	unpack();
 	hasHotChanges = hotchanges;
 	int num_joys = joysticksPerFrame[inputType];
 	int joy;
@@ -105,38 +372,63 @@ void INPUTLOG::toMovie(MovieData& md, int start, int end)
 	// write Input data to movie data
 	md.records.resize(end + 1);
 	int num_joys = joysticksPerFrame[inputType];
-	int joy;
-	for (int frame = start; frame <= end; ++frame)
+	int joy, count, commands_count;
+	for (int frame = start; frame <= end; )
 	{
-		for (joy = num_joys - 1; joy >= 0; joy--)
-			md.records[frame].joysticks[joy] = joysticks[frame * num_joys * BYTES_PER_JOYSTICK + joy * BYTES_PER_JOYSTICK];
-		md.records[frame].commands = commands[frame];
+		const uint8_t* joy_data = getJoysticksBlock(frame, &count);
+		const uint8_t* commands_data = getCommandsBlock(frame, &commands_count);
+		if (count > commands_count) count = commands_count;
+		if (count > end - frame + 1) count = end - frame + 1;
+		for (; count > 0; --count, ++frame, joy_data += num_joys * BYTES_PER_JOYSTICK, ++commands_data)
+		{
+			for (joy = num_joys - 1; joy >= 0; joy--)
+				md.records[frame].joysticks[joy] = joy_data[joy * BYTES_PER_JOYSTICK];
+			md.records[frame].commands = *commands_data;
+		}
 	}
 }
+// -----------------------------------------------------------------------------------------------
+// move the data into chunks, sharing all chunks that have the same data as chunks of the base InputLog
+// (if no base is given, the chunks this InputLog had before it was unpacked are used)
+void INPUTLOG::pack(INPUTLOG* base)
+{
+	if (packed)
+	{
+		if (!base || base == this)
+			return;
+		unpack();
+	}
+	if (!base)
+		base = this;
+	int num_joys = joysticksPerFrame[inputType];
+	joysticksChunks.pack(joysticks, BYTES_PER_JOYSTICK * num_joys, base->joysticksChunks);
+	commandsChunks.pack(commands, 1, base->commandsChunks);
+	hotChangesChunks.pack(hotChanges, num_joys * HOTCHANGE_BYTES_PER_JOY, base->hotChangesChunks);
+	std::vector<uint8_t>().swap(joysticks);
+	std::vector<uint8_t>().swap(commands);
+	std::vector<uint8_t>().swap(hotChanges);
+	packed = true;
+}
+// get the data back from chunks, the chunks are kept for the next packing
+void INPUTLOG::unpack()
+{
+	if (!packed)
+		return;
+	joysticksChunks.unpack(joysticks);
+	commandsChunks.unpack(commands);
+	hotChangesChunks.unpack(hotChanges);
+	packed = false;
+	alreadyCompressed = false;
+}
 
 void INPUTLOG::compressData()
 {
-	// compress joysticks
-	int len = joysticks.size();
-	uLongf comprlen = (len>>9)+12 + len;
-	compressedJoysticks.resize(comprlen);
-	compress(&compressedJoysticks[0], &comprlen, &joysticks[0], len);
-	compressedJoysticks.resize(comprlen);
-	// compress commands
-	len = commands.size();
-	comprlen = (len>>9)+12 + len;
-	compressedCommands.resize(comprlen);
-	compress(&compressedCommands[0], &comprlen, &commands[0], len);
-	compressedCommands.resize(comprlen);
+	// only the chunks that weren't compressed before are compressed, so shared chunks are compressed once
+	pack();
+	joysticksChunks.compress();
+	commandsChunks.compress();
 	if (hasHotChanges)
-	{
-		// compress hot_changes
-		len = hotChanges.size();
-		comprlen = (len>>9)+12 + len;
-		compressedHotChanges.resize(comprlen);
-		compress(&compressedHotChanges[0], &comprlen, &hotChanges[0], len);
-		compressedHotChanges.resize(comprlen);
-	}
+		hotChangesChunks.compress();
 	// don't recompress anymore
 	alreadyCompressed = true;
 }
@@ -145,52 +437,106 @@ bool INPUTLOG::isAlreadyCompressed()
 	return alreadyCompressed;
 }
 
-void INPUTLOG::save(EMUFILE *os)
+static void writeCompressed(const std::vector<uint8_t>& data, EMUFILE *os)
+{
+	int len = data.size();
+	uLongf comprlen = (len>>9)+12 + len;
+	std::vector<uint8_t> compressed(comprlen);
+	compress(&compressed[0], &comprlen, len ? &data[0] : NULL, len);
+	write32le((int)comprlen, os);
+	os->fwrite(&compressed[0], comprlen);
+}
+
+// without a chunk table the data is saved in the old format: every array compressed as a whole
+void INPUTLOG::save(EMUFILE *os, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	// write vars
 	write32le(size, os);
 	write8le(inputType, os);
-	// write data
-	if (!alreadyCompressed)
-		compressData();
+	if (chunkTable)
+	{
+		// write ids of the chunks, the chunks themselves are saved by the table
+		pack();
+		chunkTable->saveChunks(joysticksChunks, os);
+		chunkTable->saveChunks(commandsChunks, os);
+		if (hasHotChanges)
+		{
+			write8le((uint8)1, os);
+			chunkTable->saveChunks(hotChangesChunks, os);
+		} else
+		{
+			write8le((uint8)0, os);
+		}
+		return;
+	}
+	std::vector<uint8_t> temp;
 	// save joysticks data
-	write32le(compressedJoysticks.size(), os);
-	os->fwrite(&compressedJoysticks[0], compressedJoysticks.size());
+	if (packed)
+		joysticksChunks.unpack(temp);
+	writeCompressed(packed ? temp : joysticks, os);
 	// save commands data
-	write32le(compressedCommands.size(), os);
-	os->fwrite(&compressedCommands[0], compressedCommands.size());
+	if (packed)
+		commandsChunks.unpack(temp);
+	writeCompressed(packed ? temp : commands, os);
 	if (hasHotChanges)
 	{
 		write8le((uint8)1, os);
 		// save hot_changes data
-		write32le(compressedHotChanges.size(), os);
-		os->fwrite(&compressedHotChanges[0], compressedHotChanges.size());
+		writeCompressed(getUnpackedHotChanges(temp), os);
 	} else
 	{
 		write8le((uint8)0, os);
 	}
 }
 // returns true if couldn't load
-bool INPUTLOG::load(EMUFILE *is)
+bool INPUTLOG::load(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	uint8 tmp;
 	// read vars
 	if (!read32le(&size, is)) return true;
 	if (!read8le(&tmp, is)) return true;
+	if (size < 0 || tmp >= INPUT_TYPES_TOTAL) return true;
 	inputType = tmp;
+	int num_joys = joysticksPerFrame[inputType];
+	if (chunkTable)
+	{
+		// read ids of the chunks, the chunks themselves were loaded by the table
+		std::vector<uint8_t>().swap(joysticks);
+		std::vector<uint8_t>().swap(commands);
+		std::vector<uint8_t>().swap(hotChanges);
+		packed = true;
+		if (chunkTable->loadChunks(joysticksChunks, BYTES_PER_JOYSTICK * num_joys, is) || joysticksChunks.frames != size) return true;
+		if (chunkTable->loadChunks(commandsChunks, 1, is) || commandsChunks.frames != size) return true;
+		if (!read8le(&tmp, is)) return true;
+		hasHotChanges = (tmp != 0);
+		if (hasHotChanges)
+		{
+			if (chunkTable->loadChunks(hotChangesChunks, num_joys * HOTCHANGE_BYTES_PER_JOY, is) || hotChangesChunks.frames != size) return true;
+		} else
+		{
+			hotChangesChunks.clear();
+		}
+		alreadyCompressed = (joysticksChunks.isCompressed() && commandsChunks.isCompressed() && hotChangesChunks.isCompressed());
+		return false;
+	}
 	// read data
-	alreadyCompressed = true;
+	packed = false;
+	alreadyCompressed = false;
+	joysticksChunks.clear();
+	commandsChunks.clear();
+	hotChangesChunks.clear();
 	int comprlen;
 	uLongf destlen;
+	std::vector<uint8_t> compressed;
 	// read and uncompress joysticks data
-	destlen = size * BYTES_PER_JOYSTICK * joysticksPerFrame[inputType];
+	destlen = size * BYTES_PER_JOYSTICK * num_joys;
 	joysticks.resize(destlen);
 	// read size
 	if (!read32le(&comprlen, is)) return true;
 	if (comprlen <= 0) return true;
-	compressedJoysticks.resize(comprlen);
-	if (is->fread(&compressedJoysticks[0], comprlen) != comprlen) return true;
-	int e = uncompress(&joysticks[0], &destlen, &compressedJoysticks[0], comprlen);
+	compressed.resize(comprlen);
+	if (is->fread(&compressed[0], comprlen) != comprlen) return true;
+	int e = uncompress(&joysticks[0], &destlen, &compressed[0], comprlen);
 	if (e != Z_OK && e != Z_BUF_ERROR) return true;
 	// read and uncompress commands data
 	destlen = size;
@@ -198,29 +544,30 @@ bool INPUTLOG::load(EMUFILE *is)
 	// read size
 	if (!read32le(&comprlen, is)) return true;
 	if (comprlen <= 0) return true;
-	compressedCommands.resize(comprlen);
-	if (is->fread(&compressedCommands[0], comprlen) != comprlen) return true;
-	e = uncompress(&commands[0], &destlen, &compressedCommands[0], comprlen);
+	compressed.resize(comprlen);
+	if (is->fread(&compressed[0], comprlen) != comprlen) return true;
+	e = uncompress(&commands[0], &destlen, &compressed[0], comprlen);
 	if (e != Z_OK && e != Z_BUF_ERROR) return true;
 	// read hotchanges
 	if (!read8le(&tmp, is)) return true;
 	hasHotChanges = (tmp != 0);
+	hotChanges.resize(0);
 	if (hasHotChanges)
 	{
 		// read and uncompress hot_changes data
-		destlen = size * joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
+		destlen = size * num_joys * HOTCHANGE_BYTES_PER_JOY;
 		hotChanges.resize(destlen);
 		// read size
 		if (!read32le(&comprlen, is)) return true;
 		if (comprlen <= 0) return true;
-		compressedHotChanges.resize(comprlen);
-		if (is->fread(&compressedHotChanges[0], comprlen) != comprlen) return true;
-		e = uncompress(&hotChanges[0], &destlen, &compressedHotChanges[0], comprlen);
+		compressed.resize(comprlen);
+		if (is->fread(&compressed[0], comprlen) != comprlen) return true;
+		e = uncompress(&hotChanges[0], &destlen, &compressed[0], comprlen);
 		if (e != Z_OK && e != Z_BUF_ERROR) return true;
 	}
 	return false;
 }
-bool INPUTLOG::skipLoad(EMUFILE *is)
+bool INPUTLOG::skipLoad(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	int tmp;
 	uint8 tmp1;
@@ -228,36 +575,74 @@ bool INPUTLOG::skipLoad(EMUFILE *is)
 	if (is->fseek(sizeof(int) +	// size
 				sizeof(uint8)	// input_type
 				, SEEK_CUR)) return true;
-	// skip joysticks data
+	// skip joysticks data (or ids of its chunks)
 	if (!read32le(&tmp, is)) return true;
-	if (is->fseek(tmp, SEEK_CUR) != 0) return true;
+	if (is->fseek(chunkTable ? tmp * sizeof(int) : tmp, SEEK_CUR) != 0) return true;
 	// skip commands data
 	if (!read32le(&tmp, is)) return true;
-	if (is->fseek(tmp, SEEK_CUR) != 0) return true;
+	if (is->fseek(chunkTable ? tmp * sizeof(int) : tmp, SEEK_CUR) != 0) return true;
 	// skip hot_changes data
 	if (!read8le(&tmp1, is)) return true;
 	if (tmp1)
 	{
 		if (!read32le(&tmp, is)) return true;
-		if (is->fseek(tmp, SEEK_CUR) != 0) return true;
+		if (is->fseek(chunkTable ? tmp * sizeof(int) : tmp, SEEK_CUR) != 0) return true;
 	}
 	return false;
 }
 // --------------------------------------------------------------------------------------------
+// return number of first frame of difference between two arrays of the InputLogs, or -1
+static int findFirstDifference(INPUTLOG& myLog, INPUTLOG& theirLog, const uint8_t* (INPUTLOG::*getBlock)(int, int*), int bytes, int start, int end)
+{
+	int my_count, their_count;
+	for (int frame = start; frame <= end; )
+	{
+		const uint8_t* my_data = (myLog.*getBlock)(frame, &my_count);
+		const uint8_t* their_data = (theirLog.*getBlock)(frame, &their_count);
+		int count = std::min(std::min(my_count, their_count), end - frame + 1);
+		// chunks shared by both InputLogs are skipped without comparing
+		if (my_data != their_data && memcmp(my_data, their_data, count * bytes))
+		{
+			while (!memcmp(my_data, their_data, bytes))
+			{
+				my_data += bytes;
+				their_data += bytes;
+				frame++;
+			}
+			return frame;
+		}
+		frame += count;
+	}
+	return -1;
+}
 // return number of first frame of difference between two InputLogs
 int INPUTLOG::findFirstChange(INPUTLOG& theirLog, int start, int end)
 {
 	// search for differences to the specified end (or to the end of this InputLog)
 	if (end < 0 || end >= size) end = size-1;
+	if (start < 0) start = 0;
 	int their_log_end = theirLog.size;
 
-	int joy;
 	int num_joys = joysticksPerFrame[inputType];
-	for (int frame = start; frame <= end; ++frame)
+	if (inputType == theirLog.inputType)
 	{
-		for (joy = num_joys - 1; joy >= 0; joy--)
-			if (getJoystickData(frame, joy) != theirLog.getJoystickData(frame, joy)) return frame;
-		if (getCommandsData(frame) != theirLog.getCommandsData(frame)) return frame;
+		int frame = findFirstDifference(*this, theirLog, &INPUTLOG::getJoysticksBlock, BYTES_PER_JOYSTICK * num_joys, start, end);
+		if (frame >= 0)
+			end = frame - 1;
+		int commands_frame = findFirstDifference(*this, theirLog, &INPUTLOG::getCommandsBlock, 1, start, end);
+		if (commands_frame >= 0)
+			return commands_frame;
+		if (frame >= 0)
+			return frame;
+	} else
+	{
+		int joy;
+		for (int frame = start; frame <= end; ++frame)
+		{
+			for (joy = num_joys - 1; joy >= 0; joy--)
+				if (getJoystickData(frame, joy) != theirLog.getJoystickData(frame, joy)) return frame;
+			if (getCommandsData(frame) != theirLog.getCommandsData(frame)) return frame;
+		}
 	}
 	// no difference was found
 
@@ -272,14 +657,22 @@ int INPUTLOG::findFirstChange(MovieData& md, int start, int end)
 	// search for differences to the specified end (or to the end of this InputLog / to the end of the movie data)
 	if (end < 0 || end >= size) end = size - 1;
 	if (end >= md.getNumRecords()) end = md.getNumRecords() - 1;
+	if (start < 0) start = 0;
 
-	int joy;
+	int joy, count, commands_count;
 	int num_joys = joysticksPerFrame[inputType];
-	for (int frame = start; frame <= end; ++frame)
+	for (int frame = start; frame <= end; )
 	{
-		for (joy = num_joys - 1; joy >= 0; joy--)
-			if (getJoystickData(frame, joy) != md.records[frame].joysticks[joy]) return frame;
-		if (getCommandsData(frame) != md.records[frame].commands) return frame;
+		const uint8_t* joy_data = getJoysticksBlock(frame, &count);
+		const uint8_t* commands_data = getCommandsBlock(frame, &commands_count);
+		if (count > commands_count) count = commands_count;
+		if (count > end - frame + 1) count = end - frame + 1;
+		for (; count > 0; --count, ++frame, joy_data += num_joys * BYTES_PER_JOYSTICK, ++commands_data)
+		{
+			for (joy = num_joys - 1; joy >= 0; joy--)
+				if (joy_data[joy * BYTES_PER_JOYSTICK] != md.records[frame].joysticks[joy]) return frame;
+			if (*commands_data != md.records[frame].commands) return frame;
+		}
 	}
 	// no difference was found
 
@@ -298,17 +691,58 @@ int INPUTLOG::getJoystickData(int frame, int joy)
 		return 0;
 	if (joy > joysticksPerFrame[inputType])
 		return 0;
-	return joysticks[frame * BYTES_PER_JOYSTICK * joysticksPerFrame[inputType] + joy];
+	int index = frame * BYTES_PER_JOYSTICK * joysticksPerFrame[inputType] + joy;
+	if (!packed)
+		return joysticks[index];
+	int count;
+	return joysticksChunks.getFrames(index / joysticksChunks.bytesPerFrame, &count)[index % joysticksChunks.bytesPerFrame];
 }
 int INPUTLOG::getCommandsData(int frame)
 {
 	if (frame < 0 || frame >= size)
 		return 0;
-	return commands[frame];
+	if (!packed)
+		return commands[frame];
+	int count;
+	return *commandsChunks.getFrames(frame, &count);
+}
+
+// return pointer to the data of the frame and the number of frames that can be read from there (zeros after the end of data)
+const uint8_t* INPUTLOG::getJoysticksBlock(int frame, int* count)
+{
+	if (packed)
+		return joysticksChunks.getFrames(frame, count);
+	if (frame >= size)
+	{
+		*count = INPUTLOG_CHUNK_SIZE / (BYTES_PER_JOYSTICK * joysticksPerFrame[inputType]);
+		return zeroFrames;
+	}
+	*count = size - frame;
+	return &joysticks[frame * BYTES_PER_JOYSTICK * joysticksPerFrame[inputType]];
+}
+const uint8_t* INPUTLOG::getCommandsBlock(int frame, int* count)
+{
+	if (packed)
+		return commandsChunks.getFrames(frame, count);
+	if (frame >= size)
+	{
+		*count = INPUTLOG_CHUNK_SIZE;
+		return zeroFrames;
+	}
+	*count = size - frame;
+	return &commands[frame];
+}
+const std::vector<uint8_t>& INPUTLOG::getUnpackedHotChanges(std::vector<uint8_t>& temp)
+{
+	if (!packed)
+		return hotChanges;
+	hotChangesChunks.unpack(temp);
+	return temp;
 }
 
 void INPUTLOG::insertFrames(int at, int frames)
 {
+	unpack();
 	size += frames;
 	if (at == -1) 
 	{
@@ -343,6 +777,7 @@ void INPUTLOG::insertFrames(int at, int frames)
 }
 void INPUTLOG::eraseFrame(int frame)
 {
+	unpack();
 	// erase 1 byte of commands
 	commands.erase(commands.begin() + frame);
 	// erase X bytes of joystics
@@ -361,6 +796,7 @@ void INPUTLOG::eraseFrame(int frame)
 // -----------------------------------------------------------------------------------------------
 void INPUTLOG::initHotChanges()
 {
+	unpack();
 	hotChanges.resize(joysticksPerFrame[inputType] * size * HOTCHANGE_BYTES_PER_JOY);
 }
 
@@ -377,7 +813,9 @@ void INPUTLOG::copyHotChanges(INPUTLOG* sourceOfHotChanges, int limiterFrameOfSo
 			frames_to_copy = limiterFrameOfSource;
 
 		int bytes_to_copy = frames_to_copy * joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
-		memcpy(&hotChanges[0], &sourceOfHotChanges->hotChanges[0], bytes_to_copy);
+		unpack();
+		std::vector<uint8_t> temp;
+		memcpy(&hotChanges[0], &sourceOfHotChanges->getUnpackedHotChanges(temp)[0], bytes_to_copy);
 	}
 } 
 void INPUTLOG::inheritHotChanges(INPUTLOG* sourceOfHotChanges)
@@ -390,7 +828,9 @@ void INPUTLOG::inheritHotChanges(INPUTLOG* sourceOfHotChanges)
 			frames_to_copy = size;
 
 		int bytes_to_copy = frames_to_copy * joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
-		memcpy(&hotChanges[0], &sourceOfHotChanges->hotChanges[0], bytes_to_copy);
+		unpack();
+		std::vector<uint8_t> temp;
+		memcpy(&hotChanges[0], &sourceOfHotChanges->getUnpackedHotChanges(temp)[0], bytes_to_copy);
 		fadeHotChanges();
 	}
 } 
@@ -399,9 +839,12 @@ void INPUTLOG::inheritHotChanges_DeleteSelection(INPUTLOG* sourceOfHotChanges, R
 	// copy hot changes from source InputLog, but omit deleted frames (which are represented by the "frameset")
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		unpack();
+		std::vector<uint8_t> temp;
+		const std::vector<uint8_t>& source_hot_changes = sourceOfHotChanges->getUnpackedHotChanges(temp);
 		int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 		int frame = 0, pos = 0, source_pos = 0;
-		int this_size = hotChanges.size(), source_size = sourceOfHotChanges->hotChanges.size();
+		int this_size = hotChanges.size(), source_size = source_hot_changes.size();
 		RowsSelection::iterator it(frameset->begin());
 		RowsSelection::iterator frameset_end(frameset->end());
 		while (pos < this_size && source_pos < source_size)
@@ -414,7 +857,7 @@ void INPUTLOG::inheritHotChanges_DeleteSelection(INPUTLOG* sourceOfHotChanges, R
 			} else
 			{
 				// copy hotchanges of this frame
-				memcpy(&hotChanges[pos], &sourceOfHotChanges->hotChanges[source_pos], bytes);
+				memcpy(&hotChanges[pos], &source_hot_changes[source_pos], bytes);
 				pos += bytes;
 				source_pos += bytes;
 			}
@@ -426,13 +869,16 @@ void INPUTLOG::inheritHotChanges_DeleteSelection(INPUTLOG* sourceOfHotChanges, R
 void INPUTLOG::inheritHotChanges_InsertSelection(INPUTLOG* sourceOfHotChanges, RowsSelection* frameset)
 {
 	// copy hot changes from source InputLog, but insert filled lines for inserted frames (which are represented by the "frameset")
+	unpack();
 	RowsSelection::iterator it(frameset->begin());
 	RowsSelection::iterator frameset_end(frameset->end());
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		std::vector<uint8_t> temp;
+		const std::vector<uint8_t>& source_hot_changes = sourceOfHotChanges->getUnpackedHotChanges(temp);
 		int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 		int frame = 0, region_len = 0, pos = 0, source_pos = 0;
-		int this_size = hotChanges.size(), source_size = sourceOfHotChanges->hotChanges.size();
+		int this_size = hotChanges.size(), source_size = source_hot_changes.size();
 		while (pos < this_size)
 		{
 			if (it != frameset_end && frame == *it)
@@ -448,7 +894,7 @@ void INPUTLOG::inheritHotChanges_InsertSelection(INPUTLOG* sourceOfHotChanges, R
 				frame -= region_len;
 				region_len = 0;
 				// copy hotchanges of this frame
-				memcpy(&hotChanges[pos], &sourceOfHotChanges->hotChanges[source_pos], bytes);
+				memcpy(&hotChanges[pos], &source_hot_changes[source_pos], bytes);
 				fadeHotChanges(pos, pos + bytes);
 				source_pos += bytes;
 			}
@@ -486,44 +932,50 @@ void INPUTLOG::inheritHotChanges_InsertSelection(INPUTLOG* sourceOfHotChanges, R
 }
 void INPUTLOG::inheritHotChanges_DeleteNum(INPUTLOG* sourceOfHotChanges, int start, int frames, bool fadeOld)
 {
+	unpack();
 	int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 	// copy hot changes from source InputLog up to "start" and from "start+frames" to end
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
-		int this_size = hotChanges.size(), source_size = sourceOfHotChanges->hotChanges.size();
+		std::vector<uint8_t> temp;
+		const std::vector<uint8_t>& source_hot_changes = sourceOfHotChanges->getUnpackedHotChanges(temp);
+		int this_size = hotChanges.size(), source_size = source_hot_changes.size();
 		int bytes_to_copy = bytes * start;
 		int dest_pos = 0, source_pos = 0;
 		if (bytes_to_copy > source_size)
 			bytes_to_copy = source_size;
-		memcpy(&hotChanges[dest_pos], &sourceOfHotChanges->hotChanges[source_pos], bytes_to_copy);
+		memcpy(&hotChanges[dest_pos], &source_hot_changes[source_pos], bytes_to_copy);
 		dest_pos += bytes_to_copy;
 		source_pos += bytes_to_copy + bytes * frames;
 		bytes_to_copy = this_size - dest_pos;
 		if (bytes_to_copy > source_size - source_pos)
 			bytes_to_copy = source_size - source_pos;
-		memcpy(&hotChanges[dest_pos], &sourceOfHotChanges->hotChanges[source_pos], bytes_to_copy);
+		memcpy(&hotChanges[dest_pos], &source_hot_changes[source_pos], bytes_to_copy);
 		if (fadeOld)
 			fadeHotChanges();
 	}
 } 
 void INPUTLOG::inheritHotChanges_InsertNum(INPUTLOG* sourceOfHotChanges, int start, int frames, bool fadeOld)
 {
+	unpack();
 	int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 	// copy hot changes from source InputLog up to "start", then make a gap, then copy from "start+frames" to end
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
-		int this_size = hotChanges.size(), source_size = sourceOfHotChanges->hotChanges.size();
+		std::vector<uint8_t> temp;
+		const std::vector<uint8_t>& source_hot_changes = sourceOfHotChanges->getUnpackedHotChanges(temp);
+		int this_size = hotChanges.size(), source_size = source_hot_changes.size();
 		int bytes_to_copy = bytes * start;
 		int dest_pos = 0, source_pos = 0;
 		if (bytes_to_copy > source_size)
 			bytes_to_copy = source_size;
-		memcpy(&hotChanges[dest_pos], &sourceOfHotChanges->hotChanges[source_pos], bytes_to_copy);
+		memcpy(&hotChanges[dest_pos], &source_hot_changes[source_pos], bytes_to_copy);
 		dest_pos += bytes_to_copy + bytes * frames;
 		source_pos += bytes_to_copy;
 		bytes_to_copy = this_size - dest_pos;
 		if (bytes_to_copy > source_size - source_pos)
 			bytes_to_copy = source_size - source_pos;
-		memcpy(&hotChanges[dest_pos], &sourceOfHotChanges->hotChanges[source_pos], bytes_to_copy);
+		memcpy(&hotChanges[dest_pos], &source_hot_changes[source_pos], bytes_to_copy);
 		if (fadeOld)
 			fadeHotChanges();
 	}
@@ -533,6 +985,7 @@ void INPUTLOG::inheritHotChanges_InsertNum(INPUTLOG* sourceOfHotChanges, int sta
 void INPUTLOG::inheritHotChanges_PasteInsert(INPUTLOG* sourceOfHotChanges, RowsSelection* insertedSet)
 {
 	// copy hot changes from source InputLog and insert filled lines for inserted frames (which are represented by "inserted_set")
+	unpack();
 	int bytes = joysticksPerFrame[inputType] * HOTCHANGE_BYTES_PER_JOY;
 	int frame = 0, pos = 0;
 	int this_size = hotChanges.size();
@@ -541,8 +994,10 @@ void INPUTLOG::inheritHotChanges_PasteInsert(INPUTLOG* sourceOfHotChanges, RowsS
 
 	if (sourceOfHotChanges && sourceOfHotChanges->hasHotChanges && sourceOfHotChanges->inputType == inputType)
 	{
+		std::vector<uint8_t> temp;
+		const std::vector<uint8_t>& source_hot_changes = sourceOfHotChanges->getUnpackedHotChanges(temp);
 		int source_pos = 0;
-		int source_size = sourceOfHotChanges->hotChanges.size();
+		int source_size = source_hot_changes.size();
 		while (pos < this_size)
 		{
 			if (it != inserted_set_end && frame == *it)
@@ -554,7 +1009,7 @@ void INPUTLOG::inheritHotChanges_PasteInsert(INPUTLOG* sourceOfHotChanges, RowsS
 			} else if (source_pos < source_size)
 			{
 				// copy hotchanges of this frame
-				memcpy(&hotChanges[pos], &sourceOfHotChanges->hotChanges[source_pos], bytes);
+				memcpy(&hotChanges[pos], &source_hot_changes[source_pos], bytes);
 				fadeHotChanges(pos, pos + bytes);
 				source_pos += bytes;
 			}
@@ -615,6 +1070,7 @@ void INPUTLOG::setMaxHotChangeBits(int frame, int joypad, uint8 joyBits)
 void INPUTLOG::setMaxHotChanges(int frame, int absoluteButtonNumber)
 {
 	if (frame < 0 || frame >= size || !hasHotChanges) return;
+	unpack();
 	// set max value to the button hotness
 	if (absoluteButtonNumber & 1)
 		hotChanges[frame * (HOTCHANGE_BYTES_PER_JOY * joysticksPerFrame[inputType]) + (absoluteButtonNumber >> 1)] |= BYTE_VALUE_CONTAINING_MAX_HOTCHANGE_HI;
@@ -625,6 +1081,7 @@ void INPUTLOG::setMaxHotChanges(int frame, int absoluteButtonNumber)
 void INPUTLOG::fadeHotChanges(int startByte, int endByte)
 {
 	uint8 hi_half, low_half;
+	unpack();
 	if (endByte < 0)
 		endByte = hotChanges.size();
 	for (int i = endByte - 1; i >= startByte; i--)
@@ -645,7 +1102,15 @@ int INPUTLOG::getHotChangesInfo(int frame, int absoluteButtonNumber)
 	if (!hasHotChanges || frame < 0 || frame >= size || absoluteButtonNumber < 0 || absoluteButtonNumber >= NUM_JOYPAD_BUTTONS * joysticksPerFrame[inputType])
 		return 0;
 
-	uint8 val = hotChanges[frame * (HOTCHANGE_BYTES_PER_JOY * joysticksPerFrame[inputType]) + (absoluteButtonNumber >> 1)];
+	uint8 val;
+	if (packed)
+	{
+		int count;
+		val = hotChangesChunks.getFrames(frame, &count)[absoluteButtonNumber >> 1];
+	} else
+	{
+		val = hotChanges[frame * (HOTCHANGE_BYTES_PER_JOY * joysticksPerFrame[inputType]) + (absoluteButtonNumber >> 1)];
+	}
 
 	if (absoluteButtonNumber & 1)
 		// odd buttons (B, T, D, R) take upper 4 bits of the byte 
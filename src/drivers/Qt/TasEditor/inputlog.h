@@ -2,6 +2,8 @@
 #pragma once
 #include <stdint.h>
 #include <vector>
+#include <map>
+#include <memory>
 
 #include "fceu.h"
 #include "movie.h"
@@ -29,6 +31,46 @@ enum INPUT_TYPES
 #define BYTE_VALUE_CONTAINING_MAX_HOTCHANGE_LO HOTCHANGE_MAX_VALUE														// "0x0F"
 #define HOTCHANGE_BYTES_PER_JOY (BYTES_PER_JOYSTICK * HOTCHANGE_BITS_PER_VALUE)	// 4 bytes per 8 buttons
 
+#define INPUTLOG_CHUNK_SIZE 8192		// packed InputLogs keep their data in chunks of about this many bytes (4096 frames of 2 joysticks)
+
+// piece of packed InputLog data, never modified after creation, so InputLogs can share it
+struct INPUTLOG_CHUNK
+{
+	void compress();
+
+	int frames;
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> compressedData;		// empty until the chunk is compressed
+};
+typedef std::shared_ptr<INPUTLOG_CHUNK> INPUTLOG_CHUNK_PTR;
+
+// one array of InputLog data (joysticks, commands or Hot Changes) stored as a sequence of chunks
+class INPUTLOG_CHUNKS
+{
+public:
+	INPUTLOG_CHUNKS();
+	void clear();
+	void pack(const std::vector<uint8_t>& source, int bytes, const INPUTLOG_CHUNKS& base);
+	void unpack(std::vector<uint8_t>& dest) const;
+	void compress();
+	bool isCompressed() const;
+
+	const uint8_t* getFrames(int frame, int* count) const;
+
+	std::vector<INPUTLOG_CHUNK_PTR> chunks;
+	std::vector<int> starts;			// number of first frame of every chunk
+	int frames;
+	int bytesPerFrame;
+
+private:
+	int findChunk(int start) const;
+	int findNextStart(int frame) const;
+
+	mutable int lastChunk;				// speeds up reading frames in a row
+};
+
+class INPUTLOG_CHUNK_TABLE;
+
 class INPUTLOG
 {
 public:
@@ -37,9 +79,12 @@ public:
 	void reinit(MovieData& md, bool hotchanges, int frame_of_change);		// used when combining consecutive Recordings
 	void toMovie(MovieData& md, int start = 0, int end = -1);
 
-	void save(EMUFILE *os);
-	bool load(EMUFILE *is);
-	bool skipLoad(EMUFILE *is);
+	void save(EMUFILE *os, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
+	bool load(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
+	bool skipLoad(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
+
+	void pack(INPUTLOG* base = NULL);
+	void unpack(void);
 
 	void compressData(void);
 	bool isAlreadyCompressed(void);
@@ -77,17 +122,43 @@ public:
 	bool hasHotChanges;
 
 private:
-	
+	friend class INPUTLOG_CHUNK_TABLE;
+
+	const uint8_t* getJoysticksBlock(int frame, int* count);
+	const uint8_t* getCommandsBlock(int frame, int* count);
+	const std::vector<uint8_t>& getUnpackedHotChanges(std::vector<uint8_t>& temp);
+
 	// also saved data
-	std::vector<uint8_t> compressedJoysticks;
-	std::vector<uint8_t> compressedCommands;
-	std::vector<uint8_t> compressedHotChanges;
+	INPUTLOG_CHUNKS joysticksChunks;
+	INPUTLOG_CHUNKS commandsChunks;
+	INPUTLOG_CHUNKS hotChangesChunks;
 
-	// not saved data
+	// not saved data (while the InputLog is packed the data is only in chunks, these vectors are empty)
 	std::vector<uint8_t> hotChanges;		// Format: buttons01joy0-for-frame0, buttons23joy0-for-frame0, buttons45joy0-for-frame0, buttons67joy0-for-frame0, buttons01joy1-for-frame0, ...
 	std::vector<uint8_t> joysticks;		// Format: joy0-for-frame0, joy1-for-frame0, joy2-for-frame0, joy3-for-frame0, joy0-for-frame1, joy1-for-frame1, ...
 	std::vector<uint8_t> commands;		// Format: commands-for-frame0, commands-for-frame1, ...
+	bool packed;
 	bool alreadyCompressed;			// to compress only once
 };
 
+// list of all chunks used by a set of InputLogs, so that every chunk is saved only once
+class INPUTLOG_CHUNK_TABLE
+{
+public:
+	void add(INPUTLOG& inputlog);
+
+	void save(EMUFILE *os);
+	bool load(EMUFILE *is);
+
+	void saveChunks(INPUTLOG_CHUNKS& chunks, EMUFILE *os);
+	bool loadChunks(INPUTLOG_CHUNKS& chunks, int bytes, EMUFILE *is);
+
+private:
+	void addChunks(INPUTLOG_CHUNKS& chunks);
+
+	std::vector<INPUTLOG_CHUNK_PTR> chunks;
+	std::map<const INPUTLOG_CHUNK*, int> ids;
+	std::multimap<uint32, int> checksums;		// to find chunks with the same data
+};
+
 extern int joysticksPerFrame[INPUT_TYPES_TOTAL];
@@ -21,15 +21,20 @@ LagLog - Log of Lag appearance
 #include "fceu.h"
 #include "Qt/TasEditor/laglog.h"
 
+// every change of any LagLog gets a new revision, copies keep the revision of their data
+static unsigned int lastRevision = 0;
+
 LAGLOG::LAGLOG(void)
 {
 	alreadyCompressed = false;
+	revision = ++lastRevision;
 }
 
 void LAGLOG::reset(void)
 {
 	lagLog.resize(0);
 	alreadyCompressed = false;
+	revision = ++lastRevision;
 }
 
 void LAGLOG::compressData(void)
@@ -75,6 +80,7 @@ void LAGLOG::save(EMUFILE *os)
 bool LAGLOG::load(EMUFILE *is)
 {
 	int size;
+	revision = ++lastRevision;
 	if (read32le(&size, is))
 	{
 		alreadyCompressed = true;
@@ -122,6 +128,7 @@ void LAGLOG::invalidateFromFrame(int frame)
 	{
 		lagLog.resize(frame);
 		alreadyCompressed = false;
+		revision = ++lastRevision;
 	}
 }
 
@@ -136,6 +143,7 @@ void LAGLOG::setLagInfo(int frame, bool lagFlag)
 		lagLog[frame] = LAGGED_NO;
 
 	alreadyCompressed = false;
+	revision = ++lastRevision;
 }
 void LAGLOG::eraseFrame(int frame, int numFrames)
 {
@@ -146,6 +154,7 @@ void LAGLOG::eraseFrame(int frame, int numFrames)
 			// erase 1 frame
 			lagLog.erase(lagLog.begin() + frame);
 			alreadyCompressed = false;
+			revision = ++lastRevision;
 		} else if (numFrames > 1)
 		{
 			// erase many frames
@@ -153,6 +162,7 @@ void LAGLOG::eraseFrame(int frame, int numFrames)
 				numFrames = (int)lagLog.size() - frame;
 			lagLog.erase(lagLog.begin() + frame, lagLog.begin() + (frame + numFrames));
 			alreadyCompressed = false;
+			revision = ++lastRevision;
 		}
 	}
 }
@@ -172,6 +182,7 @@ void LAGLOG::insertFrame(int frame, bool lagFlag, int numFrames)
 			lagLog[frame] = LAGGED_NO;
 	}
 	alreadyCompressed = false;
+	revision = ++lastRevision;
 }
 
 // getters
@@ -179,6 +190,10 @@ int LAGLOG::getSize(void)
 {
 	return lagLog.size();
 }
+unsigned int LAGLOG::getRevision(void)
+{
+	return revision;
+}
 int LAGLOG::getLagInfoAtFrame(int frame)
 {
 	if (frame < (int)lagLog.size())
@@ -32,6 +32,7 @@ public:
 
 	int getSize(void);
 	int getLagInfoAtFrame(int frame);
+	unsigned int getRevision(void);
 
 	int findFirstChange(LAGLOG& theirLog);
 
@@ -42,4 +43,5 @@ private:
 	// not saved data
 	std::vector<uint8_t> lagLog;
 	bool alreadyCompressed;			// to compress only once
+	unsigned int revision;			// equal revisions mean equal data
 };
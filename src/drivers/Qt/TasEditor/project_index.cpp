@@ -0,0 +1,544 @@
+/* ---------------------------------------------------------------------------------
+Implementation file of PROJECT_INDEX class
+
+(The MIT License)
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+------------------------------------------------------------------------------------
+Project Index - Block container of fm3 files
+
+* lays out the project file as: header slot (fm2 data + fm3 header), data blocks, index, trailer
+* the trailer at the end of the file points to the index, which lists the blocks of every section
+* on save, only appends the blocks whose contents are not in the file yet, and rewrites the header slot only if it changed
+* rewrites the whole file when the header doesn't fit its slot or when more than half of the file is dead blocks
+* maps the file into memory on load and gives out readers for the sections, so only the blocks that are read get paged in
+------------------------------------------------------------------------------------ */
+
+#include <QFile>
+#include <zlib.h>
+
+#include "fceu.h"
+#include "driver.h"
+#include "Qt/TasEditor/project_index.h"
+
+// reads a section from the blocks of a mapped project file
+// positions start at the file offset of the first block, so the offset given to the modules is never 0
+class PROJECT_SECTION_READER : public EMUFILE
+{
+public:
+	PROJECT_SECTION_READER(unsigned int base) : base(base), pos(0), len(0) {}
+
+	void addBlock(const uint8_t* data, unsigned int size)
+	{
+		blockData.push_back(data);
+		blockStarts.push_back(len);
+		len += size;
+	}
+
+	virtual EMUFILE* memwrap() { return this; }
+	virtual FILE *get_fp() { return NULL; }
+
+	virtual int fprintf(const char *format, ...) { failbit = true; return 0; }
+	virtual int fputc(int c) { failbit = true; return EOF; }
+	virtual void fwrite(const void *ptr, size_t bytes) { failbit = true; }
+	virtual void truncate(s32 length) { failbit = true; }
+	virtual void fflush() {}
+
+	virtual int fgetc()
+	{
+		u8 temp;
+		if (_fread(&temp, 1) != 1)
+			return EOF;
+		return temp;
+	}
+
+	virtual size_t _fread(const void *ptr, size_t bytes)
+	{
+		u8* dst = (u8*)ptr;
+		size_t done = 0;
+		if (pos < len)
+		{
+			// find the block holding pos
+			int block = std::upper_bound(blockStarts.begin(), blockStarts.end(), pos) - blockStarts.begin() - 1;
+			while (done < bytes && pos < len)
+			{
+				unsigned int blockEnd = (block + 1 < (int)blockStarts.size()) ? blockStarts[block + 1] : len;
+				unsigned int todo = std::min<size_t>(bytes - done, blockEnd - pos);
+				memcpy(dst + done, blockData[block] + (pos - blockStarts[block]), todo);
+				done += todo;
+				pos += todo;
+				block++;
+			}
+		}
+		if (done < bytes)
+			failbit = true;
+		return done;
+	}
+
+	virtual int fseek(int offset, int origin)
+	{
+		long long target;
+		switch (origin)
+		{
+			case SEEK_SET:
+				target = (long long)offset - base;
+				break;
+			case SEEK_CUR:
+				target = (long long)pos + offset;
+				break;
+			case SEEK_END:
+				target = (long long)len + offset;
+				break;
+			default:
+				return -1;
+		}
+		if (target < 0 || target > len)
+			return -1;
+		pos = (unsigned int)target;
+		return 0;
+	}
+
+	virtual int ftell() { return base + pos; }
+	virtual int size() { return base + len; }
+
+private:
+	std::vector<const uint8_t*> blockData;
+	std::vector<unsigned int> blockStarts;
+	unsigned int base, pos, len;
+};
+
+// random values for the rolling hash that finds block boundaries
+static uint64_t gearTable[256];
+
+static void initGearTable()
+{
+	if (gearTable[0])
+		return;
+	uint64_t x = 0x9E3779B97F4A7C15ULL;
+	for (int i = 0; i < 256; ++i)
+	{
+		// splitmix64
+		uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		gearTable[i] = z ^ (z >> 31);
+	}
+}
+
+// returns the size of the block starting at data
+static unsigned int findBlockEnd(const uint8_t* data, unsigned int size)
+{
+	if (size <= PROJECT_INDEX_MIN_BLOCK_SIZE)
+		return size;
+	unsigned int limit = std::min<unsigned int>(size, PROJECT_INDEX_MAX_BLOCK_SIZE);
+	uint64_t hash = 0;
+	for (unsigned int i = PROJECT_INDEX_MIN_BLOCK_SIZE - 64; i < limit; ++i)
+	{
+		hash = (hash << 1) + gearTable[data[i]];
+		if (i >= PROJECT_INDEX_MIN_BLOCK_SIZE && !(hash & PROJECT_INDEX_BLOCK_BOUNDARY_MASK))
+			return i + 1;
+	}
+	return limit;
+}
+
+static void calculateMD5(const uint8_t* data, unsigned int size, MD5DATA& result)
+{
+	md5_context ctx;
+	md5_starts(&ctx);
+	md5_update(&ctx, (uint8*)data, size);
+	md5_finish(&ctx, result.data);
+}
+
+static std::string getMD5Key(MD5DATA& md5)
+{
+	return std::string((const char*)md5.data, md5.size);
+}
+
+static void writeZeros(EMUFILE* os, unsigned int size)
+{
+	static const uint8_t zeros[PROJECT_INDEX_HEADER_ALIGNMENT] = {0};
+	while (size)
+	{
+		unsigned int todo = std::min<unsigned int>(size, sizeof(zeros));
+		os->fwrite(zeros, todo);
+		size -= todo;
+	}
+}
+
+PROJECT_INDEX::PROJECT_INDEX()
+{
+	mappedFile = 0;
+	fileData = 0;
+	reset();
+}
+
+PROJECT_INDEX::~PROJECT_INDEX()
+{
+	close();
+}
+
+void PROJECT_INDEX::reset()
+{
+	close();
+	fileName.clear();
+	fileSize = 0;
+	indexOffset = 0;
+	headerSlotSize = 0;
+	memset(headerMD5.data, 0, headerMD5.size);
+	blocks.resize(0);
+	sections.resize(0);
+	lastSaveSize = 0;
+}
+
+// writes the header and the sections to the file
+// if allowAppending is set and the file is the one that was last saved or opened, only the blocks that are not in the file yet are appended to it
+// sections marked in reusedSections weren't serialized again, they keep their blocks from the file (see canReuseSection)
+// returns false without touching the file if those blocks have to be copied and the file doesn't hold them anymore
+bool PROJECT_INDEX::save(const char* fullName, EMUFILE_MEMORY& header, EMUFILE_MEMORY* newSections, int numberOfSections, bool allowAppending, const bool* reusedSections)
+{
+	close();
+	initGearTable();
+
+	bool appending = allowAppending && indexOffset && fileName == fullName;
+	std::map<std::string, int> blocksInFile;
+	if (appending)
+	{
+		for (int i = 0; i < (int)blocks.size(); ++i)
+			blocksInFile[getMD5Key(blocks[i].md5)] = i;
+	}
+
+	// cut the sections into blocks, blocks that are already in the file keep their offsets
+	std::vector<PROJECT_BLOCK> newBlocks;
+	std::vector<const uint8_t*> newBlocksData;
+	std::vector<std::vector<int>> newSectionBlocks(numberOfSections);
+	std::map<std::string, int> blocksInSave;
+	unsigned int liveSize = 0, appendSize = 0;
+	for (int s = 0; s < numberOfSections; ++s)
+	{
+		if (reusedSections && reusedSections[s])
+		{
+			if (!canReuseSection(fullName, s))
+				return false;
+			for (int i = 0; i < (int)sections[s].size(); ++i)
+			{
+				PROJECT_BLOCK& block = blocks[sections[s][i]];
+				std::string key = getMD5Key(block.md5);
+				std::map<std::string, int>::iterator it = blocksInSave.find(key);
+				if (it == blocksInSave.end())
+				{
+					liveSize += block.size;
+					it = blocksInSave.insert(std::make_pair(key, (int)newBlocks.size())).first;
+					newBlocks.push_back(block);
+					newBlocksData.push_back(0);
+				}
+				newSectionBlocks[s].push_back(it->second);
+			}
+			continue;
+		}
+		const uint8_t* data = newSections[s].size() ? newSections[s].buf() : 0;
+		unsigned int size = newSections[s].size();
+		unsigned int pos = 0;
+		while (pos < size)
+		{
+			PROJECT_BLOCK block;
+			block.offset = 0;
+			block.size = findBlockEnd(data + pos, size - pos);
+			calculateMD5(data + pos, block.size, block.md5);
+			std::string key = getMD5Key(block.md5);
+			std::map<std::string, int>::iterator it = blocksInSave.find(key);
+			if (it == blocksInSave.end())
+			{
+				std::map<std::string, int>::iterator inFile = blocksInFile.find(key);
+				if (inFile != blocksInFile.end() && blocks[inFile->second].size == block.size)
+					block.offset = blocks[inFile->second].offset;
+				else
+					appendSize += block.size;
+				liveSize += block.size;
+				it = blocksInSave.insert(std::make_pair(key, (int)newBlocks.size())).first;
+				newBlocks.push_back(block);
+				newBlocksData.push_back(data + pos);
+			}
+			newSectionBlocks[s].push_back(it->second);
+			pos += block.size;
+		}
+	}
+
+	MD5DATA newHeaderMD5;
+	calculateMD5(header.buf(), header.size(), newHeaderMD5);
+	bool headerChanged = memcmp(newHeaderMD5.data, headerMD5.data, headerMD5.size) != 0;
+	if (appending)
+	{
+		// the header must fit its slot, and the file shouldn't end up mostly made of blocks that are no longer used
+		if ((unsigned int)header.size() > headerSlotSize)
+			appending = false;
+		else if ((unsigned long long)fileSize + appendSize > 2ULL * (headerSlotSize + liveSize))
+			appending = false;
+	}
+
+	EMUFILE_FILE* os = 0;
+	if (appending)
+	{
+		os = FCEUD_UTF8_fstream(fullName, "r+b");
+		// make sure nobody touched the file since it was last saved or opened
+		uint8_t trailer[PROJECT_INDEX_TRAILER_SIZE];
+		unsigned int trailerIndexOffset, trailerIndexSize;
+		uint32_t trailerCRC;
+		if (!os || os->fail() || os->size() != (int)fileSize
+			|| os->fseek(fileSize - PROJECT_INDEX_TRAILER_SIZE, SEEK_SET) || os->fread(trailer, PROJECT_INDEX_TRAILER_SIZE) != PROJECT_INDEX_TRAILER_SIZE
+			|| !readTrailer(trailer, fileSize, trailerIndexOffset, trailerIndexSize, trailerCRC) || trailerIndexOffset != indexOffset)
+		{
+			delete os;
+			os = 0;
+			appending = false;
+		}
+	}
+	// blocks of the reused sections are copied from the file before it is rewritten
+	std::vector<std::vector<uint8_t>> reusedData;
+	if (!appending)
+	{
+		EMUFILE_FILE* is = 0;
+		reusedData.resize(newBlocks.size());
+		for (int i = 0; i < (int)newBlocks.size(); ++i)
+		{
+			if (newBlocksData[i])
+				continue;
+			if (!is)
+				is = FCEUD_UTF8_fstream(fileName.c_str(), "rb");
+			reusedData[i].resize(newBlocks[i].size);
+			bool copied = is && !is->fail() && !is->fseek(newBlocks[i].offset, SEEK_SET)
+				&& is->fread(&reusedData[i][0], newBlocks[i].size) == newBlocks[i].size;
+			if (copied)
+			{
+				// the file may have been changed by someone else
+				MD5DATA md5;
+				calculateMD5(&reusedData[i][0], newBlocks[i].size, md5);
+				copied = !memcmp(md5.data, newBlocks[i].md5.data, md5.size);
+			}
+			if (!copied)
+			{
+				delete is;
+				return false;
+			}
+			newBlocksData[i] = &reusedData[i][0];
+		}
+		delete is;
+	}
+	if (!appending)
+	{
+		// everything is written anew
+		for (int i = 0; i < (int)newBlocks.size(); ++i)
+			newBlocks[i].offset = 0;
+		os = FCEUD_UTF8_fstream(fullName, "wb");
+		if (!os || os->fail())
+		{
+			delete os;
+			return false;
+		}
+	}
+
+	unsigned int newHeaderSlotSize = headerSlotSize;
+	unsigned int pos;
+	lastSaveSize = 0;
+	if (appending)
+	{
+		pos = fileSize;
+		os->fseek(pos, SEEK_SET);
+	} else
+	{
+		// leave some room for the movie to grow, so that the next saves don't have to rewrite the file
+		newHeaderSlotSize = header.size() + header.size() / 4 + PROJECT_INDEX_HEADER_ALIGNMENT;
+		newHeaderSlotSize -= newHeaderSlotSize % PROJECT_INDEX_HEADER_ALIGNMENT;
+		os->fwrite(header.buf(), header.size());
+		writeZeros(os, newHeaderSlotSize - header.size());
+		pos = newHeaderSlotSize;
+		lastSaveSize += newHeaderSlotSize;
+	}
+	// blocks
+	for (int i = 0; i < (int)newBlocks.size(); ++i)
+	{
+		if (newBlocks[i].offset)
+			continue;
+		newBlocks[i].offset = pos;
+		os->fwrite(newBlocksData[i], newBlocks[i].size);
+		pos += newBlocks[i].size;
+		lastSaveSize += newBlocks[i].size;
+	}
+	// index
+	blocks.swap(newBlocks);
+	sections.swap(newSectionBlocks);
+	headerSlotSize = newHeaderSlotSize;
+	headerMD5 = newHeaderMD5;
+	EMUFILE_MEMORY index;
+	saveIndex(&index);
+	os->fwrite(index.buf(), index.size());
+	// trailer
+	write32le(pos, os);
+	write32le(index.size(), os);
+	write32le((uint32)crc32(0, index.buf(), index.size()), os);
+	os->fwrite(PROJECT_INDEX_ID, PROJECT_INDEX_ID_LEN);
+	indexOffset = pos;
+	pos += index.size() + PROJECT_INDEX_TRAILER_SIZE;
+	lastSaveSize += index.size() + PROJECT_INDEX_TRAILER_SIZE;
+	// header slot is only rewritten when the movie or the fm3 header changed
+	if (appending && headerChanged)
+	{
+		os->fseek(0, SEEK_SET);
+		os->fwrite(header.buf(), header.size());
+		writeZeros(os, headerSlotSize - header.size());
+		lastSaveSize += headerSlotSize;
+	}
+	bool failed = os->fail();
+	delete os;
+	if (failed)
+	{
+		// don't trust the index, the next save will rewrite the file
+		reset();
+		return false;
+	}
+	fileName = fullName;
+	fileSize = pos;
+	return true;
+}
+
+// true if the section is in the file the next save to fullName can append to
+bool PROJECT_INDEX::canReuseSection(const char* fullName, int number)
+{
+	return indexOffset && fileName == fullName && number >= 0 && number < (int)sections.size();
+}
+
+void PROJECT_INDEX::saveIndex(EMUFILE* os)
+{
+	write32le(headerSlotSize, os);
+	os->fwrite(headerMD5.data, headerMD5.size);
+	write32le(blocks.size(), os);
+	for (int i = 0; i < (int)blocks.size(); ++i)
+	{
+		write32le(blocks[i].offset, os);
+		write32le(blocks[i].size, os);
+		os->fwrite(blocks[i].md5.data, blocks[i].md5.size);
+	}
+	write32le(sections.size(), os);
+	for (int s = 0; s < (int)sections.size(); ++s)
+	{
+		write32le(sections[s].size(), os);
+		for (int i = 0; i < (int)sections[s].size(); ++i)
+			write32le(sections[s][i], os);
+	}
+}
+// returns true if the index is consistent with the file
+bool PROJECT_INDEX::loadIndex(const uint8_t* data, unsigned int size)
+{
+	EMUFILE_MEMORY is((void*)data, size);
+	unsigned int numberOfBlocks, numberOfSections, numberOfSectionBlocks, blockNumber;
+	if (!read32le(&headerSlotSize, &is)) return false;
+	if (headerSlotSize > indexOffset) return false;
+	if (is.fread(headerMD5.data, headerMD5.size) != (size_t)headerMD5.size) return false;
+	if (!read32le(&numberOfBlocks, &is)) return false;
+	if (numberOfBlocks > size / (8 + MD5DATA::size)) return false;
+	blocks.resize(numberOfBlocks);
+	for (unsigned int i = 0; i < numberOfBlocks; ++i)
+	{
+		if (!read32le(&blocks[i].offset, &is)) return false;
+		if (!read32le(&blocks[i].size, &is)) return false;
+		if (is.fread(blocks[i].md5.data, blocks[i].md5.size) != (size_t)blocks[i].md5.size) return false;
+		// blocks must lie between the header slot and the index, compare without letting the subtraction wrap
+		if (blocks[i].offset < headerSlotSize || blocks[i].offset > indexOffset || blocks[i].size > indexOffset - blocks[i].offset) return false;
+	}
+	if (!read32le(&numberOfSections, &is)) return false;
+	if (numberOfSections > size / 4) return false;
+	sections.resize(numberOfSections);
+	for (unsigned int s = 0; s < numberOfSections; ++s)
+	{
+		if (!read32le(&numberOfSectionBlocks, &is)) return false;
+		if (numberOfSectionBlocks > size / 4) return false;
+		sections[s].resize(numberOfSectionBlocks);
+		for (unsigned int i = 0; i < numberOfSectionBlocks; ++i)
+		{
+			if (!read32le(&blockNumber, &is)) return false;
+			if (blockNumber >= numberOfBlocks) return false;
+			sections[s][i] = blockNumber;
+		}
+	}
+	return is.ftell() == (int)size;
+}
+
+bool PROJECT_INDEX::readTrailer(const uint8_t* trailer, unsigned int fileLength, unsigned int& offset, unsigned int& size, uint32_t& crc)
+{
+	if (memcmp(trailer + 12, PROJECT_INDEX_ID, PROJECT_INDEX_ID_LEN))
+		return false;
+	offset = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | ((unsigned int)trailer[3] << 24);
+	size = trailer[4] | (trailer[5] << 8) | (trailer[6] << 16) | ((unsigned int)trailer[7] << 24);
+	crc = trailer[8] | (trailer[9] << 8) | (trailer[10] << 16) | ((uint32_t)trailer[11] << 24);
+	return offset < fileLength && size == fileLength - PROJECT_INDEX_TRAILER_SIZE - offset;
+}
+
+// maps the file and reads its index, returns false if the file has no index (fm3 version 3 or older, or fm2)
+bool PROJECT_INDEX::open(const char* fullName)
+{
+	reset();
+	mappedFile = new QFile(fullName);
+	if (!mappedFile->open(QIODevice::ReadOnly))
+	{
+		reset();
+		return false;
+	}
+	qint64 length = mappedFile->size();
+	if (length < PROJECT_INDEX_TRAILER_SIZE || length > 0x7FFFFFFF)
+	{
+		reset();
+		return false;
+	}
+	fileData = mappedFile->map(0, length);
+	if (!fileData)
+	{
+		// some filesystems can't be mapped, read the whole file then
+		mappedFile->close();
+		if (!EMUFILE::readAllBytes(&fileCopy, fullName) || (qint64)fileCopy.size() != length)
+		{
+			reset();
+			return false;
+		}
+		fileData = &fileCopy[0];
+	}
+	unsigned int indexSize;
+	uint32_t crc;
+	fileSize = (unsigned int)length;
+	if (!readTrailer(fileData + fileSize - PROJECT_INDEX_TRAILER_SIZE, fileSize, indexOffset, indexSize, crc)
+		|| (uint32_t)crc32(0, fileData + indexOffset, indexSize) != crc
+		|| !loadIndex(fileData + indexOffset, indexSize))
+	{
+		reset();
+		return false;
+	}
+	fileName = fullName;
+	return true;
+}
+// returns a reader for the section (to be deleted by the caller), or NULL if the section is empty or the file isn't open
+EMUFILE* PROJECT_INDEX::getSection(int number)
+{
+	if (!fileData || number < 0 || number >= (int)sections.size() || sections[number].empty())
+		return NULL;
+	std::vector<int>& sectionBlocks = sections[number];
+	PROJECT_SECTION_READER* reader = new PROJECT_SECTION_READER(blocks[sectionBlocks[0]].offset);
+	for (int i = 0; i < (int)sectionBlocks.size(); ++i)
+		reader->addBlock(fileData + blocks[sectionBlocks[i]].offset, blocks[sectionBlocks[i]].size);
+	return reader;
+}
+// unmaps the file but keeps the index, so that the next save can append to the file
+void PROJECT_INDEX::close()
+{
+	if (mappedFile)
+	{
+		mappedFile->close();
+		delete mappedFile;
+		mappedFile = 0;
+	}
+	fileData = 0;
+	fileCopy = std::vector<uint8_t>();
+}
+
+unsigned int PROJECT_INDEX::getLastSaveSize()
+{
+	return lastSaveSize;
+}
@@ -0,0 +1,66 @@
+// Specification file for PROJECT_INDEX class
+#pragma once
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "emufile.h"
+#include "utils/md5.h"
+
+#define PROJECT_INDEX_ID "FM3I"
+#define PROJECT_INDEX_ID_LEN 4
+#define PROJECT_INDEX_TRAILER_SIZE (12 + PROJECT_INDEX_ID_LEN)
+
+// sections are cut into blocks where the content says so, so inserting data in the middle of a section only changes the blocks around it
+#define PROJECT_INDEX_MIN_BLOCK_SIZE 4096
+#define PROJECT_INDEX_MAX_BLOCK_SIZE 131072
+#define PROJECT_INDEX_BLOCK_BOUNDARY_MASK 0xFFFE000000000000ULL	// top 15 bits, ~32K between boundaries on average
+
+#define PROJECT_INDEX_HEADER_ALIGNMENT 4096
+
+class QFile;
+
+struct PROJECT_BLOCK
+{
+	unsigned int offset;
+	unsigned int size;
+	MD5DATA md5;
+};
+
+class PROJECT_INDEX
+{
+public:
+	PROJECT_INDEX();
+	~PROJECT_INDEX();
+	void reset();
+
+	bool save(const char* fullName, EMUFILE_MEMORY& header, EMUFILE_MEMORY* sections, int numberOfSections, bool allowAppending, const bool* reusedSections = 0);
+	bool canReuseSection(const char* fullName, int number);
+
+	bool open(const char* fullName);
+	EMUFILE* getSection(int number);
+	void close();
+
+	unsigned int getLastSaveSize();
+
+private:
+	void saveIndex(EMUFILE* os);
+	bool loadIndex(const uint8_t* data, unsigned int size);
+	bool readTrailer(const uint8_t* trailer, unsigned int fileLength, unsigned int& offset, unsigned int& size, uint32_t& crc);
+
+	// index of the file as it was last saved or opened
+	std::string fileName;
+	unsigned int fileSize;
+	unsigned int indexOffset;
+	unsigned int headerSlotSize;
+	MD5DATA headerMD5;
+	std::vector<PROJECT_BLOCK> blocks;
+	std::vector<std::vector<int>> sections;		// block numbers of each section
+
+	// not saved data
+	unsigned int lastSaveSize;					// bytes written by the last save
+	QFile* mappedFile;
+	const uint8_t* fileData;
+	std::vector<uint8_t> fileCopy;				// used when the file can't be mapped
+};
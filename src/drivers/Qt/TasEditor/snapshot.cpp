@@ -92,7 +92,7 @@ bool SNAPSHOT::isAlreadyCompressed()
 	return (inputlog.isAlreadyCompressed() && laglog.isAlreadyCompressed() && markers.isAalreadyCompressed());
 }
 
-void SNAPSHOT::save(EMUFILE *os)
+void SNAPSHOT::save(EMUFILE *os, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	// write vars
 	write32le(keyFrame, os);
@@ -106,14 +106,14 @@ void SNAPSHOT::save(EMUFILE *os)
 	write8le(len, os);
 	os->fwrite(&description[0], len);
 	// save InputLog data
-	inputlog.save(os);
+	inputlog.save(os, chunkTable);
 	// save LagLog data
 	laglog.save(os);
 	// save Markers data
 	markers.save(os);
 }
 // returns true if couldn't load
-bool SNAPSHOT::load(EMUFILE *is)
+bool SNAPSHOT::load(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	uint8 tmp;
 	// read vars
@@ -129,14 +129,14 @@ bool SNAPSHOT::load(EMUFILE *is)
 	if (is->fread(&description[0], tmp) != tmp) return true;
 	description[tmp] = 0;		// add '0' because it wasn't saved in the file
 	// load InputLog data
-	if (inputlog.load(is)) return true;
+	if (inputlog.load(is, chunkTable)) return true;
 	// load LagLog data
 	if (laglog.load(is)) return true;
 	// load Markers data
 	if (markers.load(is)) return true;
 	return false;
 }
-bool SNAPSHOT::skipLoad(EMUFILE *is)
+bool SNAPSHOT::skipLoad(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable)
 {
 	uint8 tmp1;
 	// skip vars
@@ -152,7 +152,7 @@ bool SNAPSHOT::skipLoad(EMUFILE *is)
 	if (tmp1 >= SNAPSHOT_DESCRIPTION_MAX_LEN) return true;
 	if (is->fseek(tmp1, SEEK_CUR) != 0) return true;
 	// skip InputLog data
-	if (inputlog.skipLoad(is)) return true;
+	if (inputlog.skipLoad(is, chunkTable)) return true;
 	// skip LagLog data
 	if (laglog.skipLoad(is)) return true;
 	// skip Markers data
@@ -20,9 +20,9 @@ public:
 	void compressData();
 	bool isAlreadyCompressed();
 
-	void save(EMUFILE *os);
-	bool load(EMUFILE *is);
-	bool skipLoad(EMUFILE *is);
+	void save(EMUFILE *os, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
+	bool load(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
+	bool skipLoad(EMUFILE *is, INPUTLOG_CHUNK_TABLE* chunkTable = NULL);
 
 	// saved data
 	INPUTLOG inputlog;
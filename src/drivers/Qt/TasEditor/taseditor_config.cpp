@@ -53,7 +53,7 @@ TASEDITOR_CONFIG::TASEDITOR_CONFIG(void)
 	followUndoContext = true;
 	followMarkerNoteContext = true;
 
-	greenzoneCapacity = GREENZONE_CAPACITY_DEFAULT;
+	greenzoneMemoryLimit = GREENZONE_MEMORY_LIMIT_DEFAULT;
 	maxUndoLevels = UNDO_LEVELS_DEFAULT;
 	enableGreenzoning = true;
 	autofirePatternSkipsLag = true;
@@ -79,6 +79,7 @@ TASEDITOR_CONFIG::TASEDITOR_CONFIG(void)
 	projectSavingOptions_SavePianoRoll = true;
 	projectSavingOptions_SaveSelection = true;
 	projectSavingOptions_GreenzoneSavingMode = GREENZONE_SAVING_MODE_ALL;
+	projectSavingOptions_IndexedFile = false;
 
 	saveCompact_SaveInBinary = true;
 	saveCompact_SaveMarkers = true;
@@ -119,7 +120,7 @@ void TASEDITOR_CONFIG::load(void)
 	g_config->getOption("SDL.TasEnableHotChanges"                        , &enableHotChanges  );
 	g_config->getOption("SDL.TasFollowUndoContext"                       , &followUndoContext  );
 	g_config->getOption("SDL.TasFollowMarkerNoteContext"                 , &followMarkerNoteContext  );
-	g_config->getOption("SDL.TasGreenzoneCapacity"                       , &greenzoneCapacity  );
+	g_config->getOption("SDL.TasGreenzoneMemoryLimit"                    , &greenzoneMemoryLimit  );
 	g_config->getOption("SDL.TasMaxUndoLevels"                           , &maxUndoLevels  );
 	g_config->getOption("SDL.TasEnableGreenzoning"                       , &enableGreenzoning  );
 	g_config->getOption("SDL.TasAutofirePatternSkipsLag"                 , &autofirePatternSkipsLag  );
@@ -143,6 +144,7 @@ void TASEDITOR_CONFIG::load(void)
 	g_config->getOption("SDL.TasProjectSavingOptions_SavePianoRoll"      , &projectSavingOptions_SavePianoRoll  );
 	g_config->getOption("SDL.TasProjectSavingOptions_SaveSelection"      , &projectSavingOptions_SaveSelection  );
 	g_config->getOption("SDL.TasProjectSavingOptions_GreenzoneSavingMode", &projectSavingOptions_GreenzoneSavingMode  );
+	g_config->getOption("SDL.TasProjectSavingOptions_IndexedFile"        , &projectSavingOptions_IndexedFile  );
 	g_config->getOption("SDL.TasSaveCompact_SaveInBinary"                , &saveCompact_SaveInBinary  );
 	g_config->getOption("SDL.TasSaveCompact_SaveMarkers"                 , &saveCompact_SaveMarkers  );
 	g_config->getOption("SDL.TasSaveCompact_SaveBookmarks"               , &saveCompact_SaveBookmarks  );
@@ -175,7 +177,7 @@ void TASEDITOR_CONFIG::save(void)
 	g_config->setOption("SDL.TasEnableHotChanges"                        , enableHotChanges  );
 	g_config->setOption("SDL.TasFollowUndoContext"                       , followUndoContext  );
 	g_config->setOption("SDL.TasFollowMarkerNoteContext"                 , followMarkerNoteContext  );
-	g_config->setOption("SDL.TasGreenzoneCapacity"                       , greenzoneCapacity  );
+	g_config->setOption("SDL.TasGreenzoneMemoryLimit"                    , greenzoneMemoryLimit  );
 	g_config->setOption("SDL.TasMaxUndoLevels"                           , maxUndoLevels  );
 	g_config->setOption("SDL.TasEnableGreenzoning"                       , enableGreenzoning  );
 	g_config->setOption("SDL.TasAutofirePatternSkipsLag"                 , autofirePatternSkipsLag  );
@@ -199,6 +201,7 @@ void TASEDITOR_CONFIG::save(void)
 	g_config->setOption("SDL.TasProjectSavingOptions_SavePianoRoll"      , projectSavingOptions_SavePianoRoll  );
 	g_config->setOption("SDL.TasProjectSavingOptions_SaveSelection"      , projectSavingOptions_SaveSelection  );
 	g_config->setOption("SDL.TasProjectSavingOptions_GreenzoneSavingMode", projectSavingOptions_GreenzoneSavingMode  );
+	g_config->setOption("SDL.TasProjectSavingOptions_IndexedFile"        , projectSavingOptions_IndexedFile  );
 	g_config->setOption("SDL.TasSaveCompact_SaveInBinary"                , saveCompact_SaveInBinary  );
 	g_config->setOption("SDL.TasSaveCompact_SaveMarkers"                 , saveCompact_SaveMarkers  );
 	g_config->setOption("SDL.TasSaveCompact_SaveBookmarks"               , saveCompact_SaveBookmarks  );
@@ -1,9 +1,10 @@
 // Specification file for TASEDITOR_CONFIG class
 #pragma once
 
-#define GREENZONE_CAPACITY_MIN 1
-#define GREENZONE_CAPACITY_MAX 50000	// this limitation is here just because we're running in 32-bit OS, so there's 2GB limit of RAM
-#define GREENZONE_CAPACITY_DEFAULT 10000
+// Greenzone memory limit, in megabytes
+#define GREENZONE_MEMORY_LIMIT_MIN 16
+#define GREENZONE_MEMORY_LIMIT_MAX 65536
+#define GREENZONE_MEMORY_LIMIT_DEFAULT 1024
 
 #define UNDO_LEVELS_MIN 1
 #define UNDO_LEVELS_MAX 1000			// this limitation is here just because we're running in 32-bit OS, so there's 2GB limit of RAM
@@ -64,7 +65,7 @@ public:
 	bool followUndoContext;
 	bool followMarkerNoteContext;
 
-	int greenzoneCapacity;
+	int greenzoneMemoryLimit;
 	int maxUndoLevels;
 
 	bool enableGreenzoning;
@@ -91,6 +92,7 @@ public:
 	bool projectSavingOptions_SavePianoRoll;
 	bool projectSavingOptions_SaveSelection;
 	int projectSavingOptions_GreenzoneSavingMode;
+	bool projectSavingOptions_IndexedFile;
 
 	bool saveCompact_SaveInBinary;
 	bool saveCompact_SaveMarkers;
@@ -53,6 +53,9 @@ void TASEDITOR_PROJECT::init()
 	projectFile = "";
 	projectName = "";
 	fm2FileName = "";
+	fileIndex.reset();
+	for (int i = 0; i < DEFAULT_NUMBER_OF_POINTERS; ++i)
+		savedSectionKeys[i].clear();
 	reset();
 }
 void TASEDITOR_PROJECT::reset()
@@ -129,70 +132,116 @@ bool TASEDITOR_PROJECT::save(const char* differentName, bool inputInBinary, bool
 			//}
 		}
 	}
-	// open file for write
-	EMUFILE_FILE* ofs = 0;
-	if (differentName)
-		ofs = FCEUD_UTF8_fstream(differentName, "wb");
-	else
-		ofs = FCEUD_UTF8_fstream(getProjectFile().c_str(), "wb");
-	if (ofs)
+	// change cursor to hourglass
+	//SetCursor(LoadCursor(0, IDC_WAIT));
+	// version 4 files are only written when asked for, older versions and the Windows TAS Editor can't read them
+	bool indexed = taseditorConfig->projectSavingOptions_IndexedFile;
+	std::string fullName = differentName ? differentName : getProjectFile();
+	// put fm2 data and fm3 header together, they go to the beginning of the file
+	currMovieData.loadFrameCount = currMovieData.records.size();
+	currMovieData.emuVersion = FCEU_VERSION_NUMERIC;
+	EMUFILE_MEMORY header;
+	currMovieData.dump(&header, inputInBinary);
+	unsigned int taseditorDataOffset = header.size();
+	write32le(indexed ? PROJECT_FILE_INDEXED_VERSION : PROJECT_FILE_CURRENT_VERSION, &header);
+	unsigned int savedStuffMap = 0;
+	if (saveMarkers) savedStuffMap |= MARKERS_SAVED;
+	if (saveBookmarks) savedStuffMap |= BOOKMARKS_SAVED;
+	if (saveGreenzone != GREENZONE_SAVING_MODE_NO) savedStuffMap |= GREENZONE_SAVED;
+	if (saveHistory) savedStuffMap |= HISTORY_SAVED;
+	if (savePianoRoll) savedStuffMap |= PIANO_ROLL_SAVED;
+	if (saveSelection) savedStuffMap |= SELECTION_SAVED;
+	write32le(savedStuffMap, &header);
+	if (indexed)
 	{
-		// change cursor to hourglass
-		//SetCursor(LoadCursor(0, IDC_WAIT));
-		// save fm2 data to the project file
-		currMovieData.loadFrameCount = currMovieData.records.size();
-		currMovieData.emuVersion = FCEU_VERSION_NUMERIC;
-		currMovieData.dump(ofs, inputInBinary);
-		unsigned int taseditorDataOffset = ofs->ftell();
-		// save header: fm3 version + saved_stuff
-		write32le(PROJECT_FILE_CURRENT_VERSION, ofs);
-		unsigned int savedStuffMap = 0;
-		if (saveMarkers) savedStuffMap |= MARKERS_SAVED;
-		if (saveBookmarks) savedStuffMap |= BOOKMARKS_SAVED;
-		if (saveGreenzone != GREENZONE_SAVING_MODE_NO) savedStuffMap |= GREENZONE_SAVED;
-		if (saveHistory) savedStuffMap |= HISTORY_SAVED;
-		if (savePianoRoll) savedStuffMap |= PIANO_ROLL_SAVED;
-		if (saveSelection) savedStuffMap |= SELECTION_SAVED;
-		write32le(savedStuffMap, ofs);
-		unsigned int numberOfPointers = DEFAULT_NUMBER_OF_POINTERS;
-		write32le(numberOfPointers, ofs);
-		// write dummy zeros to the file, where the offsets will be
-		for (unsigned int i = 0; i < numberOfPointers; ++i)
-			write32le(0, ofs);
-		// save specified modules
-		unsigned int markersOffset = ofs->ftell();
-		markersManager->save(ofs, saveMarkers);
-		unsigned int bookmarksOffset = ofs->ftell();
-		bookmarks->save(ofs, saveBookmarks);
-		unsigned int greenzoneOffset = ofs->ftell();
-		greenzone->save(ofs, saveGreenzone);
-		unsigned int historyOffset = ofs->ftell();
-		history->save(ofs, saveHistory);
-		unsigned int pianoRollOffset = ofs->ftell();
-		tasWin->pianoRoll->save(ofs, savePianoRoll);
-		unsigned int selectionOffset = ofs->ftell();
-		selection->save(ofs, saveSelection);
-		// now write offsets (pointers)
-		ofs->fseek(taseditorDataOffset + PROJECT_FILE_OFFSET_OF_POINTERS_DATA, SEEK_SET);
-		write32le(markersOffset, ofs);
-		write32le(bookmarksOffset, ofs);
-		write32le(greenzoneOffset, ofs);
-		write32le(historyOffset, ofs);
-		write32le(pianoRollOffset, ofs);
-		write32le(selectionOffset, ofs);
-		// finish
-		delete ofs;
-		playback->updateProgressbar();
-		// also set project.changed to false, unless it was SaveCompact
-		if (!differentName)
-			reset();
-		// restore cursor
-		//taseditorWindow.mustUpdateMouseCursor = true;
-		return true;
+		// no pointers, the modules are found through the index at the end of the file
+		write32le(0, &header);
 	} else
 	{
-		return false;
+		// dummy zeros where the offsets will be
+		write32le(DEFAULT_NUMBER_OF_POINTERS, &header);
+		for (int i = 0; i < DEFAULT_NUMBER_OF_POINTERS; ++i)
+			write32le(0, &header);
+	}
+	// modules that didn't change since they were saved to this file last time aren't serialized again, the file keeps their blocks
+	std::vector<unsigned int> keys[DEFAULT_NUMBER_OF_POINTERS];
+	bool reused[DEFAULT_NUMBER_OF_POINTERS];
+	keys[PROJECT_SECTION_GREENZONE] = greenzone->getSavingKey(saveGreenzone);
+	keys[PROJECT_SECTION_HISTORY] = history->getSavingKey(saveHistory);
+	for (int i = 0; i < DEFAULT_NUMBER_OF_POINTERS; ++i)
+		reused[i] = indexed && !differentName && keys[i].size() && keys[i] == savedSectionKeys[i] && fileIndex.canReuseSection(fullName.c_str(), i);
+	// save specified modules
+	EMUFILE_MEMORY sections[DEFAULT_NUMBER_OF_POINTERS];
+	if (!reused[PROJECT_SECTION_MARKERS])
+		markersManager->save(&sections[PROJECT_SECTION_MARKERS], saveMarkers);
+	if (!reused[PROJECT_SECTION_BOOKMARKS])
+		bookmarks->save(&sections[PROJECT_SECTION_BOOKMARKS], saveBookmarks);
+	if (!reused[PROJECT_SECTION_GREENZONE])
+	{
+		greenzone->save(&sections[PROJECT_SECTION_GREENZONE], saveGreenzone);
+		// saving may tidy up the Greenzone
+		keys[PROJECT_SECTION_GREENZONE] = greenzone->getSavingKey(saveGreenzone);
 	}
+	if (!reused[PROJECT_SECTION_HISTORY])
+	{
+		history->save(&sections[PROJECT_SECTION_HISTORY], saveHistory);
+		keys[PROJECT_SECTION_HISTORY] = history->getSavingKey(saveHistory);
+	}
+	if (!reused[PROJECT_SECTION_PIANO_ROLL])
+		tasWin->pianoRoll->save(&sections[PROJECT_SECTION_PIANO_ROLL], savePianoRoll);
+	if (!reused[PROJECT_SECTION_SELECTION])
+		selection->save(&sections[PROJECT_SECTION_SELECTION], saveSelection);
+	bool saved;
+	if (indexed)
+	{
+		// write the file, when saving to the same file again only what changed since the last save/load is written
+		saved = fileIndex.save(fullName.c_str(), header, sections, DEFAULT_NUMBER_OF_POINTERS, !differentName, reused);
+		if (!saved && (reused[PROJECT_SECTION_GREENZONE] || reused[PROJECT_SECTION_HISTORY]))
+		{
+			// the file doesn't hold the reused blocks anymore, serialize everything
+			greenzone->save(&sections[PROJECT_SECTION_GREENZONE], saveGreenzone);
+			keys[PROJECT_SECTION_GREENZONE] = greenzone->getSavingKey(saveGreenzone);
+			history->save(&sections[PROJECT_SECTION_HISTORY], saveHistory);
+			keys[PROJECT_SECTION_HISTORY] = history->getSavingKey(saveHistory);
+			saved = fileIndex.save(fullName.c_str(), header, sections, DEFAULT_NUMBER_OF_POINTERS, !differentName);
+		}
+	} else
+	{
+		// version 3: the modules follow the header, which points to them
+		fileIndex.reset();
+		unsigned int offset = header.size();
+		for (int i = 0; i < DEFAULT_NUMBER_OF_POINTERS; ++i)
+		{
+			FCEU_en32lsb(header.buf() + taseditorDataOffset + PROJECT_FILE_OFFSET_OF_POINTERS_DATA + i * sizeof(unsigned int), offset);
+			offset += sections[i].size();
+		}
+		EMUFILE_FILE* ofs = FCEUD_UTF8_fstream(fullName.c_str(), "wb");
+		saved = ofs && !ofs->fail();
+		if (saved)
+		{
+			ofs->fwrite(header.buf(), header.size());
+			for (int i = 0; i < DEFAULT_NUMBER_OF_POINTERS; ++i)
+				ofs->fwrite(sections[i].buf(), sections[i].size());
+			saved = !ofs->fail();
+		}
+		delete ofs;
+	}
+	for (int i = 0; i < DEFAULT_NUMBER_OF_POINTERS; ++i)
+	{
+		if (saved && indexed)
+			savedSectionKeys[i].swap(keys[i]);
+		else
+			savedSectionKeys[i].clear();
+	}
+	// restore cursor
+	//taseditorWindow.mustUpdateMouseCursor = true;
+	if (!saved)
+		return false;
+	playback->updateProgressbar();
+	// also set project.changed to false, unless it was SaveCompact
+	if (!differentName)
+		reset();
+	return true;
 }
 bool TASEDITOR_PROJECT::load(const char* fullName)
 {
@@ -248,7 +297,7 @@ bool TASEDITOR_PROJECT::load(const char* fullName)
 		unsigned int projectFileVersion;
 		if (read32le(&projectFileVersion, &ifs))
 		{
-			if (projectFileVersion != PROJECT_FILE_CURRENT_VERSION)
+			if (projectFileVersion != PROJECT_FILE_CURRENT_VERSION && projectFileVersion != PROJECT_FILE_INDEXED_VERSION)
 			{
 				char message[2048] = {0};
 				strcpy(message, "This project was saved using different version of TAS Editor!\n\n");
@@ -295,8 +344,37 @@ bool TASEDITOR_PROJECT::load(const char* fullName)
 	unsigned int numberOfPointers = 0;
 	unsigned int dataOffset = 0;
 	unsigned int pointerOffset = taseditorDataOffset + PROJECT_FILE_OFFSET_OF_POINTERS_DATA;
-	if (loadAll)
+	// the modules may not match what was last saved to the file anymore
+	for (int i = 0; i < DEFAULT_NUMBER_OF_POINTERS; ++i)
+		savedSectionKeys[i].clear();
+	if (loadAll && fileIndex.open(fullName))
+	{
+		// the file is mapped, modules read their sections straight from it
+		EMUFILE* section;
+		section = fileIndex.getSection(PROJECT_SECTION_MARKERS);
+		markersManager->load(section ? section : &ifs, section ? section->ftell() : 0);
+		delete section;
+		section = fileIndex.getSection(PROJECT_SECTION_BOOKMARKS);
+		bookmarks->load(section ? section : &ifs, section ? section->ftell() : 0);
+		delete section;
+		section = fileIndex.getSection(PROJECT_SECTION_GREENZONE);
+		greenzone->load(section ? section : &ifs, section ? section->ftell() : 0);
+		delete section;
+		section = fileIndex.getSection(PROJECT_SECTION_HISTORY);
+		history->load(section ? section : &ifs, section ? section->ftell() : 0);
+		delete section;
+		section = fileIndex.getSection(PROJECT_SECTION_PIANO_ROLL);
+		tasWin->pianoRoll->load(section ? section : &ifs, section ? section->ftell() : 0);
+		delete section;
+		section = fileIndex.getSection(PROJECT_SECTION_SELECTION);
+		selection->load(section ? section : &ifs, section ? section->ftell() : 0);
+		delete section;
+		// everything is copied out of the mapping by now, but keep the index for the next save
+		fileIndex.close();
+	} else if (loadAll)
 	{
+		// version 3 file
+		fileIndex.reset();
 		read32le(&savedStuff, &ifs);
 		read32le(&numberOfPointers, &ifs);
 		// load modules
@@ -337,6 +415,7 @@ bool TASEDITOR_PROJECT::load(const char* fullName)
 		selection->load(&ifs, dataOffset);
 	} else
 	{
+		fileIndex.reset();
 		// reset modules
 		markersManager->load(&ifs, 0);
 		bookmarks->load(&ifs, 0);
@@ -16,6 +16,7 @@
 //#include "Qt/TasEditor/piano_roll.h"
 #include "Qt/TasEditor/taseditor_lua.h"
 #include "Qt/TasEditor/splicer.h"
+#include "Qt/TasEditor/project_index.h"
 //#include "Qt/TasEditor/editor.h"
 //#include "Qt/TasEditor/popup_display.h"
 
@@ -33,7 +34,10 @@
 #define PIANO_ROLL_SAVED 16
 #define SELECTION_SAVED 32
 
+// version 3 files keep the modules right after the header and point to them from it
 #define PROJECT_FILE_CURRENT_VERSION 3
+// version 4 files list the modules in the index at the end of the file, see PROJECT_INDEX
+#define PROJECT_FILE_INDEXED_VERSION 4
 
 #define PROJECT_FILE_OFFSET_OF_VERSION_NUMBER 0
 #define PROJECT_FILE_OFFSET_OF_SAVED_MODULES_MAP (PROJECT_FILE_OFFSET_OF_VERSION_NUMBER + 4)
@@ -41,6 +45,14 @@
 #define DEFAULT_NUMBER_OF_POINTERS 6
 #define PROJECT_FILE_OFFSET_OF_POINTERS_DATA (PROJECT_FILE_OFFSET_OF_NUMBER_OF_POINTERS + 4)
 
+// sections of the project index, in the same order as the pointers of version 3
+#define PROJECT_SECTION_MARKERS 0
+#define PROJECT_SECTION_BOOKMARKS 1
+#define PROJECT_SECTION_GREENZONE 2
+#define PROJECT_SECTION_HISTORY 3
+#define PROJECT_SECTION_PIANO_ROLL 4
+#define PROJECT_SECTION_SELECTION 5
+
 #define NUM_JOYPAD_BUTTONS 8
 #define MAX_NUM_JOYPADS 4
 
@@ -75,6 +87,8 @@ private:
 	std::string projectName;	// file name only
 	std::string fm2FileName;	// same as projectName but with .fm2 extension instead of .fm3
 
+	PROJECT_INDEX fileIndex;	// blocks of the project file as it was last saved or loaded
+	std::vector<unsigned int> savedSectionKeys[DEFAULT_NUMBER_OF_POINTERS];	// what the modules were like when their sections were saved to fileIndex
 };
 
 int getInputType(MovieData& md);
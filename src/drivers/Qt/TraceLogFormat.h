@@ -0,0 +1,54 @@
+// TraceLogFormat.h
+//
+// Binary trace log file layout, shared by the trace logger and the
+// traceDecode tool. Kept free of Qt and emulator headers so that the
+// decoder can be built on its own.
+//
+// A file is a traceLogFileHeader_t followed by traceLogBinRecord_t records,
+// one per executed instruction, until the end of the file. All values are
+// stored in the byte order of the machine that wrote the log, the decoder
+// uses the byteOrder field to detect a mismatch.
+
+#pragma once
+
+#include <stdint.h>
+
+#define TRACE_LOG_BIN_MAGIC       "FCEUXTRC"
+#define TRACE_LOG_BIN_VERSION     1
+#define TRACE_LOG_BIN_BYTE_ORDER  0x01020304
+
+// record flags
+#define TRACE_LOG_BIN_OVERFLOW    0x01   // instruction crosses the end of the address space
+#define TRACE_LOG_BIN_UNDEFINED   0x02   // opcode of unknown size
+
+struct traceLogFileHeader_t
+{
+	char     magic[8];      // TRACE_LOG_BIN_MAGIC, not null terminated
+	uint32_t version;
+	uint32_t byteOrder;     // TRACE_LOG_BIN_BYTE_ORDER as written by the logger
+	uint32_t recordSize;    // sizeof(traceLogBinRecord_t)
+	uint32_t reserved;
+};
+
+struct traceLogBinRecord_t
+{
+	uint64_t cycleCount;
+	uint64_t instrCount;
+	uint32_t frameCount;
+	uint32_t skippedLines;  // instructions left out before this one by the Code/Data Logger options
+	uint16_t PC;
+	int16_t  bank;          // -1 when not known
+	uint8_t  opCode[3];
+	uint8_t  opSize;
+	uint8_t  A;
+	uint8_t  X;
+	uint8_t  Y;
+	uint8_t  S;
+	uint8_t  P;
+	uint8_t  flags;
+	uint8_t  reserved[2];
+};
+
+// the layout is part of the file format, it must not depend on the compiler
+static_assert( sizeof(traceLogFileHeader_t) == 24, "traceLogFileHeader_t layout changed" );
+static_assert( sizeof(traceLogBinRecord_t) == 40, "traceLogBinRecord_t layout changed" );
@@ -22,13 +22,16 @@
 //
 #include <stdio.h>
 #include <math.h>
+#include <atomic>
 
 #ifdef WIN32
 #include <windows.h>
 #else
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include <QDir>
@@ -112,15 +115,29 @@ static traceRecord_t *logBuf = NULL;
 static int logBufMax = 3000000;
 static int logBufHead = 0;
 static int logBufTail = 0;
+static bool logBinary = false;
+// the emulation thread fills binBuf[binBufHead] and publishes it by advancing binBufHead (release),
+// the disk thread reads up to binBufHead (acquire) and hands the slots back through binBufTail the same way
+static std::atomic<bool> binLogActive(false);
+static traceLogBinRecord_t *binBuf = NULL;
+static std::atomic<unsigned int> binBufHead(0);
+static std::atomic<unsigned int> binBufTail(0);
 static bool overrunWarningArmed = true;
 static TraceLoggerDialog_t *traceLogWindow = NULL;
 static void pushMsgToLogBuffer(const char *msg);
 #ifdef WIN32
 #include <windows.h>
 static HANDLE logFile = INVALID_HANDLE_VALUE;
+static HANDLE logMapHandle = NULL;
 #else
 static int logFile = -1;
 #endif
+// binary logs are written through a window of the file mapped into memory,
+// the window moves forward in steps of TRACE_LOG_MAP_WINDOW bytes
+#define TRACE_LOG_MAP_WINDOW  (64 * 1024 * 1024)
+static uint8_t *logMap = NULL;
+static uint64_t logMapOffset = 0;
+static uint64_t logFilePos = 0;
 static std::string  logFilePath;
 //----------------------------------------------------
 static void initLogOption( const char *name, int bitmask )
@@ -238,6 +255,8 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 	connect(logMaxLinesComboBox, SIGNAL(activated(int)), this, SLOT(logMaxLinesChanged(int)));
 
 	logFileCbox = new QCheckBox(tr("Log to File"));
+	logBinaryCbox = new QCheckBox(tr("Binary Format"));
+	logBinaryCbox->setToolTip(tr("Write compact binary records instead of text, use the traceDecode tool to convert them"));
 	selLogFileButton = new QPushButton(tr("Browse..."));
 	startStopButton = new QPushButton(tr("Start Logging"));
 	autoUpdateCbox = new QCheckBox(tr("Automatically update this window while logging"));
@@ -249,6 +268,11 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 	logFileCbox->setChecked( opt );
 	connect(logFileCbox, SIGNAL(stateChanged(int)), this, SLOT(logToFileStateChanged(int)));
 
+	g_config->getOption("SDL.TraceLogBinaryFormat", &opt );
+	logBinaryCbox->setChecked( opt );
+	logBinaryCbox->setEnabled( !logging );
+	connect(logBinaryCbox, SIGNAL(stateChanged(int)), this, SLOT(logBinaryStateChanged(int)));
+
 	g_config->getOption("SDL.TraceLogPeriodicWindowUpdate", &opt );
 	autoUpdateCbox->setChecked( opt );
 	connect(autoUpdateCbox, SIGNAL(stateChanged(int)), this, SLOT(autoUpdateStateChanged(int)));
@@ -279,6 +303,7 @@ TraceLoggerDialog_t::TraceLoggerDialog_t(QWidget *parent)
 
 	hbox = new QHBoxLayout();
 	hbox->addWidget(logFileCbox);
+	hbox->addWidget(logBinaryCbox);
 	hbox->addWidget(selLogFileButton);
 
 	grid->addLayout(hbox, 1, 0, Qt::AlignLeft);
@@ -499,6 +524,7 @@ void TraceLoggerDialog_t::toggleLoggingOnOff(void)
 	if (logging)
 	{
 		logging = 0;
+		FCEUI_SetTracing(0);
 		msleep(1);
 		pushMsgToLogBuffer("Logging Finished");
 		startStopButton->setText(tr("Start Logging"));
@@ -508,6 +534,8 @@ void TraceLoggerDialog_t::toggleLoggingOnOff(void)
 		diskThread->quit();
 		diskThread->wait(1000);
 
+		logBinaryCbox->setEnabled(true);
+
 		traceView->update();
 	}
 	else
@@ -518,6 +546,8 @@ void TraceLoggerDialog_t::toggleLoggingOnOff(void)
 			{
 				openLogFile();
 			}
+			logBinary = logBinaryCbox->isChecked();
+			logBinaryCbox->setEnabled(false);
 			diskThread->start();
 			msleep(100);
 		}
@@ -525,6 +555,7 @@ void TraceLoggerDialog_t::toggleLoggingOnOff(void)
 		startStopButton->setText(tr("Stop Logging"));
 		startStopButton->setIcon( style()->standardIcon( QStyle::SP_MediaStop ) );
 		logging = 1;
+		FCEUI_SetTracing(1);
 	}
 }
 //----------------------------------------------------
@@ -624,6 +655,11 @@ void TraceLoggerDialog_t::logToFileStateChanged(int state)
 	g_config->setOption("SDL.TraceLogSaveToFile", state != Qt::Unchecked );
 }
 //----------------------------------------------------
+void TraceLoggerDialog_t::logBinaryStateChanged(int state)
+{
+	g_config->setOption("SDL.TraceLogBinaryFormat", state != Qt::Unchecked );
+}
+//----------------------------------------------------
 void TraceLoggerDialog_t::autoUpdateStateChanged(int state)
 {
 	g_config->setOption("SDL.TraceLogPeriodicWindowUpdate", state != Qt::Unchecked );
@@ -878,6 +914,21 @@ int traceRecord_t::convToText(char *txt, int *len)
 		return -1;
 	}
 
+	if ((flags & 0x04) && (asmTxtSize == 0))
+	{
+		// binary logging left the disassembly out on the emulation thread, do it now that the line is shown.
+		// the memory has changed since, so the referenced values are not shown.
+		int asmFlags = 0;
+
+		if (logging_options & LOG_SYMBOLIC)
+		{
+			asmFlags |= ASM_DEBUG_SYMS | ASM_DEBUG_REGS;
+		}
+		DisassembleWithDebug(cpu.PC + opSize, opCode, asmFlags, stmp);
+
+		appendAsmText(stmp);
+	}
+
 	if (skippedLines > 0)
 	{
 		sprintf(stmp, "(%d lines skipped) ", skippedLines);
@@ -1145,7 +1196,7 @@ static void pushToLogBuffer(traceRecord_t &rec)
 		recBufNum++;
 	}
 
-	if ( logBuf )
+	if ( logBuf && !binLogActive )
 	{
 		int nextHead, delayCount = 0;
 		logBuf[logBufHead] = rec;
@@ -1180,6 +1231,60 @@ static void pushToLogBuffer(traceRecord_t &rec)
 	}
 }
 //----------------------------------------------------
+static void pushToBinLogBuffer(const traceRecord_t &rec)
+{
+	unsigned int head, nextHead;
+	int delayCount = 0;
+
+	head = binBufHead.load(std::memory_order_relaxed);
+
+	traceLogBinRecord_t &bin = binBuf[head];
+
+	bin.cycleCount   = rec.cycleCount;
+	bin.instrCount   = rec.instrCount;
+	bin.frameCount   = rec.frameCount;
+	bin.skippedLines = rec.skippedLines;
+	bin.PC    = rec.cpu.PC;
+	bin.bank  = rec.bank;
+	bin.opCode[0] = rec.opCode[0];
+	bin.opCode[1] = rec.opCode[1];
+	bin.opCode[2] = rec.opCode[2];
+	bin.opSize = rec.opSize;
+	bin.A = rec.cpu.A;
+	bin.X = rec.cpu.X;
+	bin.Y = rec.cpu.Y;
+	bin.S = rec.cpu.S;
+	bin.P = rec.cpu.P;
+	bin.flags = rec.flags & (TRACE_LOG_BIN_OVERFLOW | TRACE_LOG_BIN_UNDEFINED);
+	bin.reserved[0] = bin.reserved[1] = 0;
+
+	nextHead = (head + 1) % logBufMax;
+
+	while (nextHead == binBufTail.load(std::memory_order_acquire))
+	{
+		SDL_Delay(1);
+
+		delayCount++;
+
+		if ( delayCount > 10000 )
+		{
+			// The disk thread is stuck, drop this record rather than
+			// advancing onto the tail, which would read as an empty ring.
+			if ( overrunWarningArmed )
+			{
+				if ( traceLogWindow )
+				{
+					traceLogWindow->showBufferWarning();
+				}
+				printf("Trace Log Overrun!!!\n");
+				overrunWarningArmed = false;
+			}
+			return;
+		}
+	}
+	binBufHead.store(nextHead, std::memory_order_release);
+}
+//----------------------------------------------------
 static void pushMsgToLogBuffer(const char *msg)
 {
 	traceRecord_t rec;
@@ -1200,6 +1305,7 @@ int FCEUD_TraceLoggerStart(void)
 			initTraceLogBuffer(1000000);
 		}
 		logging = 1;
+		FCEUI_SetTracing(1);
 	}
 	return logging;
 }
@@ -1234,7 +1340,7 @@ void FCEUD_TraceInstruction(uint8 *opcode, int size)
 		rec.opCode[i] = opcode[i];
 	}
 	rec.opSize = size;
-	rec.romAddr = GetPRGAddress(addr);
+	rec.romAddr = debugInstr.prgAddr;
 	rec.bank = getBank(addr);
 
 	rec.frameCount = currFrameCounter;
@@ -1290,6 +1396,18 @@ void FCEUD_TraceInstruction(uint8 *opcode, int size)
 		//sprintf(str_disassembly, "OVERFLOW");
 		rec.flags |= 0x01;
 	}
+	else if (binLogActive)
+	{
+		// the file gets the opcode bytes only, the trace view disassembles the lines it shows
+		if (size == 0)
+		{
+			rec.flags |= 0x02;
+		}
+		else
+		{
+			rec.flags |= 0x04;
+		}
+	}
 	else
 	{
 		char *a = 0;
@@ -1386,6 +1504,10 @@ void FCEUD_TraceInstruction(uint8 *opcode, int size)
 		rec.preWriteVal = 0;
 	}
 
+	if (binLogActive)
+	{
+		pushToBinLogBuffer(rec);
+	}
 	pushToLogBuffer(rec);
 
 	return; // TEST
@@ -2415,6 +2537,212 @@ TraceLogDiskThread_t::~TraceLogDiskThread_t(void)
 		free(logBuf);
 		logBuf = NULL;
 	}
+
+	binLogActive = false;
+
+	if ( binBuf )
+	{
+		free(binBuf);
+		binBuf = NULL;
+	}
+}
+//----------------------------------------------------
+// Moves the mapped window so that it starts at offset, growing the file to cover it.
+// Space is reserved up front, a full disk then fails here instead of faulting on a store.
+static const char *mapLogWindow( uint64_t offset )
+{
+#ifdef WIN32
+	uint64_t end = offset + TRACE_LOG_MAP_WINDOW;
+
+	if ( logMap )
+	{
+		UnmapViewOfFile( logMap ); logMap = NULL;
+	}
+	if ( logMapHandle )
+	{
+		CloseHandle( logMapHandle ); logMapHandle = NULL;
+	}
+	logMapHandle = CreateFileMappingA( logFile, NULL, PAGE_READWRITE, (DWORD)(end >> 32), (DWORD)end, NULL );
+
+	if ( logMapHandle == NULL )
+	{
+		return "Failed to extend log file";
+	}
+	logMap = (uint8_t*)MapViewOfFile( logMapHandle, FILE_MAP_WRITE, (DWORD)(offset >> 32), (DWORD)offset, TRACE_LOG_MAP_WINDOW );
+
+	if ( logMap == NULL )
+	{
+		return "Failed to map log file";
+	}
+#else
+	if ( logMap )
+	{
+		munmap( logMap, TRACE_LOG_MAP_WINDOW ); logMap = NULL;
+	}
+#ifdef __APPLE__
+	if ( ftruncate( logFile, offset + TRACE_LOG_MAP_WINDOW ) != 0 )
+#else
+	if ( posix_fallocate( logFile, offset, TRACE_LOG_MAP_WINDOW ) != 0 )
+#endif
+	{
+		return "Failed to extend log file";
+	}
+	void *map = mmap( NULL, TRACE_LOG_MAP_WINDOW, PROT_WRITE, MAP_SHARED, logFile, offset );
+
+	if ( map == MAP_FAILED )
+	{
+		return "Failed to map log file";
+	}
+	logMap = (uint8_t*)map;
+#endif
+	logMapOffset = offset;
+
+	return NULL;
+}
+//----------------------------------------------------
+static const char *appendLogFile( const void *buf, size_t size )
+{
+	const uint8_t *src = (const uint8_t*)buf;
+
+	while ( size > 0 )
+	{
+		if ( (logMap == NULL) || (logFilePos >= logMapOffset + TRACE_LOG_MAP_WINDOW) )
+		{
+			const char *err = mapLogWindow( logFilePos - (logFilePos % TRACE_LOG_MAP_WINDOW) );
+
+			if ( err )
+			{
+				return err;
+			}
+		}
+		size_t ofs = logFilePos - logMapOffset;
+		size_t num = TRACE_LOG_MAP_WINDOW - ofs;
+
+		if ( num > size )
+		{
+			num = size;
+		}
+		memcpy( logMap + ofs, src, num );
+
+		src += num; size -= num; logFilePos += num;
+	}
+	return NULL;
+}
+//----------------------------------------------------
+// Unmaps the last window and cuts the reserved space off the end of the file.
+static void finishLogFile(void)
+{
+#ifdef WIN32
+	LARGE_INTEGER pos;
+
+	if ( logMap )
+	{
+		UnmapViewOfFile( logMap ); logMap = NULL;
+	}
+	if ( logMapHandle )
+	{
+		CloseHandle( logMapHandle ); logMapHandle = NULL;
+	}
+	pos.QuadPart = logFilePos;
+
+	if ( SetFilePointerEx( logFile, pos, NULL, FILE_BEGIN ) )
+	{
+		SetEndOfFile( logFile );
+	}
+#else
+	if ( logMap )
+	{
+		munmap( logMap, TRACE_LOG_MAP_WINDOW ); logMap = NULL;
+	}
+	if ( ftruncate( logFile, logFilePos ) != 0 )
+	{
+		printf("Trace Log: Failed to trim log file\n");
+	}
+#endif
+	logMapOffset = logFilePos = 0;
+}
+//----------------------------------------------------
+static void binaryLogError( const char *err )
+{
+	char stmp[1024];
+
+	snprintf( stmp, sizeof(stmp), "Error: %s, binary trace log stopped: %s", err, logFilePath.c_str() );
+
+	consoleWindow->QueueErrorMsgWindow(stmp);
+}
+//----------------------------------------------------
+void TraceLogDiskThread_t::runBinary(void)
+{
+	traceLogFileHeader_t hdr;
+	const char *err;
+
+	memset( &hdr, 0, sizeof(hdr) );
+	memcpy( hdr.magic, TRACE_LOG_BIN_MAGIC, sizeof(hdr.magic) );
+	hdr.version    = TRACE_LOG_BIN_VERSION;
+	hdr.byteOrder  = TRACE_LOG_BIN_BYTE_ORDER;
+	hdr.recordSize = sizeof(traceLogBinRecord_t);
+
+	logMapOffset = logFilePos = 0;
+
+	err = appendLogFile( &hdr, sizeof(hdr) );
+
+	if ( err )
+	{
+		binaryLogError( err );
+		finishLogFile();
+		return;
+	}
+
+	if ( binBuf == NULL )
+	{
+		binBuf = (traceLogBinRecord_t *)malloc( logBufMax * sizeof(traceLogBinRecord_t) );
+
+		if ( binBuf == NULL )
+		{
+			consoleWindow->QueueErrorMsgWindow("Error: Failed to allocate trace log buffer");
+			finishLogFile();
+			return;
+		}
+	}
+	binBufHead.store(0, std::memory_order_relaxed);
+	binBufTail.store(0, std::memory_order_relaxed);
+	binLogActive.store(true, std::memory_order_release);
+
+	// records are copied into the mapped file as they are, the ring goes out in at most two pieces per pass
+	while ( 1 )
+	{
+		bool done = isInterruptionRequested();
+		unsigned int head = binBufHead.load(std::memory_order_acquire);
+		unsigned int tail = binBufTail.load(std::memory_order_relaxed);
+
+		while (head != tail)
+		{
+			unsigned int num = (head > tail) ? (head - tail) : (logBufMax - tail);
+
+			err = appendLogFile( &binBuf[tail], num * sizeof(traceLogBinRecord_t) );
+
+			if ( err )
+			{
+				break;
+			}
+			tail = (tail + num) % logBufMax;
+
+			binBufTail.store(tail, std::memory_order_release);
+		}
+		if ( err )
+		{
+			binaryLogError( err );
+			break;
+		}
+		if ( done )
+		{
+			break;
+		}
+		SDL_Delay(1);
+	}
+	binLogActive.store(false, std::memory_order_release);
+
+	finishLogFile();
 }
 //----------------------------------------------------
 void TraceLogDiskThread_t::run(void)
@@ -2429,8 +2757,17 @@ void TraceLogDiskThread_t::run(void)
 	setPriority( QThread::HighestPriority );
 
 #ifdef WIN32
-	logFile = CreateFileA( logFilePath.c_str(), GENERIC_WRITE, 
-			0, NULL, OPEN_ALWAYS, FILE_FLAG_WRITE_THROUGH | FILE_FLAG_NO_BUFFERING, NULL );
+	if ( logBinary )
+	{
+		// mapped views need read access and normal caching
+		logFile = CreateFileA( logFilePath.c_str(), GENERIC_READ | GENERIC_WRITE, 
+				0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	}
+	else
+	{
+		logFile = CreateFileA( logFilePath.c_str(), GENERIC_WRITE, 
+				0, NULL, OPEN_ALWAYS, FILE_FLAG_WRITE_THROUGH | FILE_FLAG_NO_BUFFERING, NULL );
+	}
 
 	if ( logFile == INVALID_HANDLE_VALUE )
 	{
@@ -2440,7 +2777,7 @@ void TraceLogDiskThread_t::run(void)
 		return;
 	}
 #else
-	logFile = open( logFilePath.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 
+	logFile = open( logFilePath.c_str(), O_CREAT | (logBinary ? O_RDWR : O_WRONLY) | O_TRUNC, 
 			S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH );
 
 	if ( logFile == -1 )
@@ -2451,62 +2788,69 @@ void TraceLogDiskThread_t::run(void)
 		return;
 	}
 #endif
-	if ( logBuf == NULL )
+	if ( logBinary )
 	{
-		size_t size;
+		runBinary();
+	}
+	else
+	{
+		if ( logBuf == NULL )
+		{
+			size_t size;
 
-		size = logBufMax * sizeof(traceRecord_t);
+			size = logBufMax * sizeof(traceRecord_t);
 
-		logBufHead = logBufTail = 0;
+			logBufHead = logBufTail = 0;
 
-		logBuf = (traceRecord_t *)malloc(size);
-	}
-	idx = 0;
+			logBuf = (traceRecord_t *)malloc(size);
+		}
+		idx = 0;
 
-	while ( !isInterruptionRequested() )
-	{
-		while (logBufHead != logBufTail)
+		while ( !isInterruptionRequested() )
 		{
-			logBuf[logBufTail].convToText(line);
-
-			i=0;
-			while ( line[i] != 0 )
+			while (logBufHead != logBufTail)
 			{
-				buf[idx] = line[i]; i++; idx++;
-			}
-			buf[idx] = '\n'; idx++;
+				logBuf[logBufTail].convToText(line);
 
-			logBufTail = (logBufTail + 1) % logBufMax;
+				i=0;
+				while ( line[i] != 0 )
+				{
+					buf[idx] = line[i]; i++; idx++;
+				}
+				buf[idx] = '\n'; idx++;
 
-			if ( idx >= blockSize )
-			{
-				#ifdef WIN32
-				DWORD bytesWritten;
-				WriteFile( logFile, buf, idx, &bytesWritten, NULL ); idx = 0;
-				#else
-				if ( write( logFile, buf, idx ) < 0 )
+				logBufTail = (logBufTail + 1) % logBufMax;
+
+				if ( idx >= blockSize )
 				{
-					// HANDLE ERROR TODO
+					#ifdef WIN32
+					DWORD bytesWritten;
+					WriteFile( logFile, buf, idx, &bytesWritten, NULL ); idx = 0;
+					#else
+					if ( write( logFile, buf, idx ) < 0 )
+					{
+						// HANDLE ERROR TODO
+					}
+					idx = 0;
+					#endif
 				}
-				idx = 0;
-				#endif
 			}
+			SDL_Delay(1);
 		}
-		SDL_Delay(1);
-	}
-	
-	if ( idx > 0 )
-	{
-		#ifdef WIN32
-		DWORD bytesWritten;
-		WriteFile( logFile, buf, idx, &bytesWritten, NULL ); idx = 0;
-		#else
-		if ( write( logFile, buf, idx ) < 0 )
+
+		if ( idx > 0 )
 		{
-			// HANDLE ERROR TODO
+			#ifdef WIN32
+			DWORD bytesWritten;
+			WriteFile( logFile, buf, idx, &bytesWritten, NULL ); idx = 0;
+			#else
+			if ( write( logFile, buf, idx ) < 0 )
+			{
+				// HANDLE ERROR TODO
+			}
+			idx = 0;
+			#endif
 		}
-		idx = 0;
-		#endif
 	}
 
 	#ifdef WIN32
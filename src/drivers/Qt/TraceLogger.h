@@ -22,6 +22,7 @@
 
 #include "Qt/SymbolicDebug.h"
 #include "Qt/ConsoleDebugger.h"
+#include "Qt/TraceLogFormat.h"
 #include "../../debug.h"
 
 struct traceRecord_t
@@ -141,6 +142,7 @@ class  TraceLogDiskThread_t : public QThread
 
 	protected:
 		void run( void ) override;
+		void runBinary( void );
 
 	public:
 		TraceLogDiskThread_t( QObject *parent = 0 );
@@ -167,6 +169,7 @@ protected:
 	QTimer *updateTimer;
 	QLabel    *logLastLbl;
 	QCheckBox *logFileCbox;
+	QCheckBox *logBinaryCbox;
 	QComboBox *logMaxLinesComboBox;
 
 	QCheckBox *autoUpdateCbox;
@@ -205,6 +208,7 @@ private slots:
 	void toggleLoggingOnOff(void);
 	void autoUpdateStateChanged(int state);
 	void logToFileStateChanged(int state);
+	void logBinaryStateChanged(int state);
 	void logRegStateChanged(int state);
 	void logFrameStateChanged(int state);
 	void logEmuMsgStateChanged(int state);
@@ -492,6 +492,7 @@ InitConfig()
 	config->addOption("soundq", "SDL.Sound.Quality", 1);
 	config->addOption("soundrecord", "SDL.Sound.RecordFile", "");
 	config->addOption("soundbufsize", "SDL.Sound.BufSize", 128);
+	config->addOption("SDL.Sound.AdaptiveBufSize", 1);
 	config->addOption("lowpass", "SDL.Sound.LowPass", 0);
 	config->addOption("SDL.Sound.UseGlobalFocus", 1);
     
@@ -575,6 +576,8 @@ InitConfig()
 	config->addOption('k', "netkey", "SDL.NetworkGameKey", "");
 	config->addOption("port", "SDL.NetworkPort", 4046);
 	config->addOption("players", "SDL.NetworkPlayers", 1);
+	config->addOption("rollback", "SDL.NetworkRollback", 0);
+	config->addOption("netloopback", "SDL.NetLoopbackTest", "");
      
 	// input configuration options
 	config->addOption("input1", "SDL.Input.0", "GamePad.0");
@@ -674,6 +677,7 @@ InitConfig()
 	// Trace Logger Options
 	config->addOption("SDL.TraceLogSaveToFile", 0);
 	config->addOption("SDL.TraceLogSaveFilePath", "");
+	config->addOption("SDL.TraceLogBinaryFormat", 0);
 	config->addOption("SDL.TraceLogPeriodicWindowUpdate", 1);
 	config->addOption("SDL.TraceLogRegisterState", 1);
 	config->addOption("SDL.TraceLogProcessorState", 1);
@@ -779,7 +783,7 @@ InitConfig()
 	config->addOption("SDL.TasEnableHotChanges"                        , tasCfg.enableHotChanges  );
 	config->addOption("SDL.TasFollowUndoContext"                       , tasCfg.followUndoContext  );
 	config->addOption("SDL.TasFollowMarkerNoteContext"                 , tasCfg.followMarkerNoteContext  );
-	config->addOption("SDL.TasGreenzoneCapacity"                       , tasCfg.greenzoneCapacity  );
+	config->addOption("SDL.TasGreenzoneMemoryLimit"                    , tasCfg.greenzoneMemoryLimit  );
 	config->addOption("SDL.TasMaxUndoLevels"                           , tasCfg.maxUndoLevels  );
 	config->addOption("SDL.TasEnableGreenzoning"                       , tasCfg.enableGreenzoning  );
 	config->addOption("SDL.TasAutofirePatternSkipsLag"                 , tasCfg.autofirePatternSkipsLag  );
@@ -803,6 +807,7 @@ InitConfig()
 	config->addOption("SDL.TasProjectSavingOptions_SavePianoRoll"      , tasCfg.projectSavingOptions_SavePianoRoll  );
 	config->addOption("SDL.TasProjectSavingOptions_SaveSelection"      , tasCfg.projectSavingOptions_SaveSelection  );
 	config->addOption("SDL.TasProjectSavingOptions_GreenzoneSavingMode", tasCfg.projectSavingOptions_GreenzoneSavingMode  );
+	config->addOption("SDL.TasProjectSavingOptions_IndexedFile"        , tasCfg.projectSavingOptions_IndexedFile  );
 	config->addOption("SDL.TasSaveCompact_SaveInBinary"                , tasCfg.saveCompact_SaveInBinary  );
 	config->addOption("SDL.TasSaveCompact_SaveMarkers"                 , tasCfg.saveCompact_SaveMarkers  );
 	config->addOption("SDL.TasSaveCompact_SaveBookmarks"               , tasCfg.saveCompact_SaveBookmarks  );
@@ -840,6 +845,10 @@ InitConfig()
     
 	// fm2 -> srt conversion
 	config->addOption("ripsubs", "SDL.RipSubs", "");
+
+	// iNES header checks of a list of roms
+	config->addOption("validate-romset", "SDL.ValidateRomSet", "");
+
 	
 	// enable new PPU core
 	config->addOption("newppu", "SDL.NewPPU", 0);
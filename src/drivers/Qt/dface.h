@@ -13,6 +13,9 @@ void WriteSound(int32 *Buffer, int Count);
 int KillSound(void);
 uint32 GetMaxSound(void);
 uint32 GetWriteSound(void);
+void GetSoundLatency(double *tgt, double *cur, double *min, double *max, unsigned int *starveCount);
+unsigned int GetSoundStarveCount(void);
+void ResetSoundLatency(void);
 void FCEUD_MuteSoundOutput(bool value);
 
 void SilenceSound(int s); /* DOS and SDL */
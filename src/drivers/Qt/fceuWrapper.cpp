@@ -24,8 +24,13 @@
 #include <stdint.h>
 #include <limits.h>
 #include <unzip.h>
+#include <atomic>
 
 #include <QFileInfo>
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
 #include <QStyleFactory>
 #include "Qt/main.h"
 #include "Qt/throttle.h"
@@ -39,6 +44,7 @@
 #include "Qt/unix-netplay.h"
 #include "Qt/AviRecord.h"
 #include "Qt/HexEditor.h"
+#include "Qt/FrameSnapshot.h"
 #include "Qt/SymbolicDebug.h"
 #include "Qt/CodeDataLogger.h"
 #include "Qt/ConsoleDebugger.h"
@@ -98,7 +104,10 @@ static int noconfig=0;
 static int frameskip=0;
 static int periodic_saves = 0;
 static int   mutexLocks = 0;
-static int   mutexPending = 0;
+static std::atomic<int> mutexPending(0);
+static QMutex           mutexPendingLock;
+static QWaitCondition   mutexPendingDone;
+static std::atomic<unsigned int> emulatorStallCount(0);
 static bool  emulatorHasMutex = 0;
 unsigned int emulatorCycleCount = 0;
 
@@ -593,6 +602,9 @@ static const char *DriverUsage =
 "--pauseframe   x       Pause movie playback at frame x.\n"
 "--fcmconvert   f       Convert fcm movie file f to fm2.\n"
 "--ripsubs      f       Convert movie's subtitles to srt\n"
+"--validate-romset f    Check the header of every iNES file listed in f, one\n"
+"                       path a line (- for stdin), and write a CSV of mapper,\n"
+"                       mirroring, battery, region and header fixes to stdout.\n"
 "--subtitles    {0|1}   Enable subtitle display\n"
 "--fourscore    {0|1}   Enable fourscore emulation\n"
 "--no-config    {0|1}   Use default config file and do not save\n"
@@ -604,6 +616,11 @@ static const char *DriverUsage =
 "                       game loaded.\n"
 "--players      x       Set the number of local players in a network play\n"
 "                       session.\n"
+"--rollback     x       Run up to x frames ahead of the server in network play,\n"
+"                       predicting the other players.  0 waits every frame.\n"
+"--netloopback  f,d,j,x Test rollback netplay with two simulated players for f\n"
+"                       frames, d to d+j frames of network delay and x frames\n"
+"                       of rollback, then exit.\n"
 "--rp2mic       {0|1}   Replace Port 2 Start with microphone (Famicom).\n"
 "--4buttonexit {0|1}    exit the emulator when A+B+Select+Start is pressed\n"
 "--loadstate {0-9|>9}   load from the given state when the game is loaded\n"
@@ -878,6 +895,20 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		return 0;
 	}
 
+	// check the headers of a list of roms without loading them
+	g_config->getOption("SDL.ValidateRomSet", &s);
+	g_config->setOption("SDL.ValidateRomSet", "");
+	if (!s.empty())
+	{
+		int count = FCEUI_ValidateRomSet(s.c_str(), "-");
+
+		if (count < 0)
+			FCEUD_PrintError("Couldn't open the rom list...");
+		DriverKill();
+		SDL_Quit();
+		return count < 0 ? 1 : 0;
+	}
+
 	nes_shm = open_nes_shm();
 
 	if ( nes_shm == NULL )
@@ -940,6 +971,22 @@ int  fceuWrapperInit( int argc, char *argv[] )
 		g_config->save();
 	}
 
+	// rollback netplay loopback test
+	g_config->getOption("SDL.NetLoopbackTest", &s);
+	g_config->setOption("SDL.NetLoopbackTest", "");
+	if (!s.empty())
+	{
+		int frames = 3600, delay = 4, jitter = 4, rollback = 8;
+
+		sscanf(s.c_str(), "%i,%i,%i,%i", &frames, &delay, &jitter, &rollback);
+
+		int ok = FCEUI_NetplayLoopbackTest(frames, delay, jitter, rollback);
+
+		DriverKill();
+		SDL_Quit();
+		exit(ok ? 0 : 1);
+	}
+
 	aviRecordInit();
 
 	// movie playback
@@ -1232,6 +1279,16 @@ void fceuWrapperLock(const char *filename, int line, const char *func)
 	lockFile.append(func);
 }
 
+// Called once a pending lock request has the mutex or gave up on it,
+// wakes the emulator thread if it is stepping aside for the request.
+static void mutexPendingRelease(void)
+{
+	mutexPendingLock.lock();
+	mutexPending--;
+	mutexPendingDone.wakeAll();
+	mutexPendingLock.unlock();
+}
+
 void fceuWrapperLock(void)
 {
 	mutexPending++;
@@ -1239,7 +1296,7 @@ void fceuWrapperLock(void)
 	{
 		consoleWindow->mutex->lock();
 	}
-	mutexPending--;
+	mutexPendingRelease();
 	if ( mutexLocks > 0 )
 	{
 		printf("Recursive Lock:%i\n", mutexLocks );
@@ -1273,7 +1330,7 @@ bool fceuWrapperTryLock(int timeout)
 	{
 		lockAcq = consoleWindow->mutex->tryLock( timeout );
 	}
-	mutexPending--;
+	mutexPendingRelease();
 
 	if ( lockAcq )
 	{
@@ -1304,16 +1361,39 @@ bool fceuWrapperIsLocked(void)
 	return mutexLocks > 0;
 }
 
+unsigned int fceuWrapperStallCount(void)
+{
+	return emulatorStallCount;
+}
+
 int  fceuWrapperUpdate( void )
 {
 	bool lock_acq;
 	static bool mutexLockFail = false;
 
-	// If a request is pending, 
-	// sleep to allow request to be serviced.
+	// If a request is pending, sleep until the GUI has the mutex.
+	// The lock below then waits only as long as the GUI actually holds it.
 	if ( mutexPending > 0 )
 	{
-		msleep( 16 );
+		QElapsedTimer pendingTimer;
+		qint64 waitTime;
+
+		emulatorStallCount++;
+
+		pendingTimer.start();
+
+		mutexPendingLock.lock();
+
+		while ( mutexPending > 0 )
+		{
+			waitTime = 16 - pendingTimer.elapsed();
+
+			if ( (waitTime <= 0) || !mutexPendingDone.wait( &mutexPendingLock, waitTime ) )
+			{
+				break;
+			}
+		}
+		mutexPendingLock.unlock();
 	}
 
 	lock_acq = fceuWrapperTryLock( __FILE__, __LINE__, __func__ );
@@ -1328,7 +1408,7 @@ int  fceuWrapperUpdate( void )
 			}
 			mutexLockFail = true;
 		}
-		msleep( 16 );
+		emulatorStallCount++;
 
 		return -1;
 	}
@@ -1339,6 +1419,8 @@ int  fceuWrapperUpdate( void )
 	{
 		DoFun(frameskip, periodic_saves);
 	
+		frameSnapshotPublish();
+
 		hexEditorUpdateMemoryValues();
 
 		if ( consoleWindow )
@@ -39,6 +39,7 @@ void fceuWrapperLock(const char *filename, int line, const char *func);
 bool fceuWrapperTryLock(int timeout = 1000);
 bool fceuWrapperTryLock(const char *filename, int line, const char *func, int timeout = 1000);
 bool fceuWrapperIsLocked(void);
+unsigned int fceuWrapperStallCount(void);
 void fceuWrapperUnLock(void);
 int  fceuWrapperSoftReset(void);
 int  fceuWrapperHardReset(void);
@@ -12,7 +12,6 @@
 #define  GL_NES_WIDTH   256
 #define  GL_NES_HEIGHT  240
 #define  NES_VIDEO_BUFLEN   5
-#define  NES_AUDIO_BUFLEN   480000
 
 struct  nes_shm_t
 {
@@ -45,20 +44,6 @@ struct  nes_shm_t
 		memset( pixbuf, 0, sizeof(pixbuf) );
 		memset( avibuf, 0, sizeof(avibuf) );
 	}
-
-	struct sndBuf_t
-	{
-		int  head;
-		int  tail;
-		int16_t  data[NES_AUDIO_BUFLEN];
-		unsigned int starveCounter;
-	} sndBuf;
-
-	void  push_sound_sample( int16_t sample )
-	{
-		sndBuf.data[ sndBuf.head ] = sample;
-		sndBuf.head = (sndBuf.head + 1) % NES_AUDIO_BUFLEN;
-	}
 };
 
 extern nes_shm_t *nes_shm;
@@ -31,17 +31,35 @@
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <atomic>
 
 extern Config *g_config;
 
-static volatile int *s_Buffer = 0;
+// Samples go from the emulation thread (WriteSound, the only producer) to the
+// SDL audio callback (fillaudio, the only consumer) through a lock free ring.
+// Head and tail count samples since the ring was reset, each is only advanced
+// by its owner with a release store that publishes the samples before it.
+static int *s_Buffer = 0;
+static unsigned int s_BufferMask;			// allocated size - 1, the size is a power of 2
+static std::atomic<unsigned int> s_BufferHead(0);	// next sample to play
+static std::atomic<unsigned int> s_BufferTail(0);	// next sample to write
+static std::atomic<unsigned int> s_StarveCount(0);	// samples the callback found missing
+
+// The fill level WriteSound keeps the ring at. With the adaptive buffer it
+// starts at a few device periods and grows by one period when the callback
+// starves, then slowly shrinks back while playback is clean, never going over
+// the configured buffer size.
 static unsigned int s_BufferSize;
-static unsigned int s_BufferSize25;
+static std::atomic<unsigned int> s_BufferSize25(0);
 static unsigned int s_BufferSize50;
 static unsigned int s_BufferSize75;
-static unsigned int s_BufferRead;
-static unsigned int s_BufferWrite;
-static volatile unsigned int s_BufferIn;
+static unsigned int s_BufferSizeMin;
+static unsigned int s_BufferSizeMax;
+static unsigned int s_DevicePeriod;			// samples per callback
+static unsigned int s_LastStarveCount = 0;
+static double       s_LastStarveTime = 0.0;
+static double       s_LatencyMin = 1.0;
+static double       s_LatencyMax = 0.0;
 static unsigned int s_SampleRate = 44100;
 static double noiseGate = 0.0;
 static double noiseGateRate = 0.010;
@@ -55,6 +73,29 @@ extern int EmulationPaused;
 extern double frmRateAdjRatio;
 extern double g_fpsScale;
 
+static inline unsigned int
+soundBufferFill(void)
+{
+	return s_BufferTail.load(std::memory_order_acquire) - s_BufferHead.load(std::memory_order_acquire);
+}
+
+static void
+setSoundBufferSize(unsigned int size)
+{
+	if (size < s_BufferSizeMin)
+	{
+		size = s_BufferSizeMin;
+	}
+	if (size > s_BufferSizeMax)
+	{
+		size = s_BufferSizeMax;
+	}
+	s_BufferSize = size;
+	s_BufferSize25.store(s_BufferSize/4, std::memory_order_relaxed);
+	s_BufferSize50 =    s_BufferSize/2;
+	s_BufferSize75 = (3*s_BufferSize)/4;
+}
+
 /**
  * Callback from the SDL to get and play audio data.
  */
@@ -63,14 +104,15 @@ fillaudio(void *udata,
 		uint8 *stream,
 		int len)
 {
-	char bufStarveDetected = 0;
 	static int16_t sample = 0;
 	char mute;
-	//unsigned int starve_lp = nes_shm->sndBuf.starveCounter;
 	int16 *tmps = (int16*)stream;
 	len >>= 1;
 
-	if ( s_BufferIn > s_BufferSize25 )
+	unsigned int head  = s_BufferHead.load(std::memory_order_relaxed);
+	unsigned int avail = s_BufferTail.load(std::memory_order_acquire) - head;
+
+	if ( avail > s_BufferSize25.load(std::memory_order_relaxed) )
 	{
 		fillInit = 0;
 	}
@@ -118,7 +160,7 @@ fillaudio(void *udata,
 			}
 			else
 			{
-				if ( s_BufferIn )
+				if ( avail )
 				{	
 					noiseGate += noiseGateRate;
 
@@ -129,11 +171,11 @@ fillaudio(void *udata,
 					}
 				}
 			}
-			if (s_BufferIn) 
+			if (avail) 
 			{
-				sample = s_Buffer[s_BufferRead] * noiseGate;
-				s_BufferRead = (s_BufferRead + 1) % s_BufferSize;
-				s_BufferIn--;
+				sample = s_Buffer[head & s_BufferMask] * noiseGate;
+				head++;
+				avail--;
 
 				*tmps = sample * noiseGate;
 			}
@@ -152,31 +194,25 @@ fillaudio(void *udata,
 	{
 		while (len) 
 		{
-			if (s_BufferIn) 
+			if (avail) 
 			{
-				sample = s_Buffer[s_BufferRead];
-				s_BufferRead = (s_BufferRead + 1) % s_BufferSize;
-				s_BufferIn--;
+				sample = s_Buffer[head & s_BufferMask];
+				head++;
+				avail--;
 			} else {
         	 		// Retain last known sample value, helps avoid clicking
         	 		// noise when sound system is starved of audio data.
 				//sample = 0; 
-				bufStarveDetected = 1;
-				nes_shm->sndBuf.starveCounter++;
+				s_StarveCount.fetch_add(1, std::memory_order_relaxed);
 			}
 
-			nes_shm->push_sound_sample( sample );
-
 			*tmps = sample;
 			tmps++;
 			len--;
 		}
 	}
-	if ( bufStarveDetected )
-	{
-		//s_StarveCounter = nes_shm->sndBuf.starveCounter - starve_lp;
-		//printf("Starve:%u\n", s_StarveCounter );
-	}
+	// hand the played samples back to WriteSound
+	s_BufferHead.store(head, std::memory_order_release);
 }
 
 /**
@@ -185,7 +221,7 @@ fillaudio(void *udata,
 int
 InitSound()
 {
-	int sound, soundrate, soundbufsize, soundvolume, soundtrianglevolume, soundsquare1volume, soundsquare2volume, soundnoisevolume, soundpcmvolume, soundq;
+	int sound, soundrate, soundbufsize, soundadaptive, soundvolume, soundtrianglevolume, soundsquare1volume, soundsquare2volume, soundnoisevolume, soundpcmvolume, soundq;
 	SDL_AudioSpec spec;
 	const char *driverName;
 	int frmRateSampleAdj = 0;
@@ -207,6 +243,7 @@ InitSound()
 	// load configuration variables
 	g_config->getOption("SDL.Sound.Rate", &soundrate);
 	g_config->getOption("SDL.Sound.BufSize", &soundbufsize);
+	g_config->getOption("SDL.Sound.AdaptiveBufSize", &soundadaptive);
 	g_config->getOption("SDL.Sound.Volume", &soundvolume);
 	g_config->getOption("SDL.Sound.Quality", &soundq);
 	g_config->getOption("SDL.Sound.TriangleVolume", &soundtrianglevolume);
@@ -223,16 +260,22 @@ InitSound()
 	spec.callback = fillaudio;
 	spec.userdata = 0;
 
-	s_BufferSize = soundbufsize * soundrate / 1000;
+	s_DevicePeriod = spec.samples;
+	s_BufferSizeMax = soundbufsize * soundrate / 1000;
 
 	// For safety, set a bare minimum:
-	if (s_BufferSize < spec.samples * 2)
+	if (s_BufferSizeMax < s_DevicePeriod * 2)
 	{
-		s_BufferSize = spec.samples * 2;
+		s_BufferSizeMax = s_DevicePeriod * 2;
 	}
-	s_BufferSize25 =    s_BufferSize/4;
-	s_BufferSize50 =    s_BufferSize/2;
-	s_BufferSize75 = (3*s_BufferSize)/4;
+	// the adaptive buffer starts low and only grows on underruns
+	s_BufferSizeMin = soundadaptive ? s_DevicePeriod * 2 : s_BufferSizeMax;
+	setSoundBufferSize(s_BufferSizeMin);
+
+	s_LastStarveCount = s_StarveCount.load(std::memory_order_relaxed);
+	s_LastStarveTime  = getHighPrecTimeStamp();
+	s_LatencyMin = 1.0;
+	s_LatencyMax = 0.0;
 
 	//printf("Audio Buffer: %i  %i \n", spec.samples, s_BufferSize );
 
@@ -241,13 +284,24 @@ InitSound()
 	noiseGateActive = true;
 	fillInit = 1;
 
-	s_Buffer = (int *)FCEU_dmalloc(sizeof(int) * s_BufferSize);
+	// round up to a power of 2 so ring positions can be masked, the fill
+	// level never goes over s_BufferSizeMax
+	unsigned int bufAlloc = 1;
+
+	while (bufAlloc < s_BufferSizeMax)
+	{
+		bufAlloc <<= 1;
+	}
+	s_BufferMask = bufAlloc - 1;
+
+	s_Buffer = (int *)FCEU_dmalloc(sizeof(int) * bufAlloc);
 
 	if (!s_Buffer)
 	{
 		return 0;
 	}
-	s_BufferRead = s_BufferWrite = s_BufferIn = 0;
+	s_BufferHead.store(0, std::memory_order_relaxed);
+	s_BufferTail.store(0, std::memory_order_relaxed);
 
 	if (SDL_OpenAudio(&spec, 0) < 0)
 	{
@@ -295,7 +349,93 @@ GetMaxSound(void)
 uint32
 GetWriteSound(void)
 {
-	return(s_BufferSize - s_BufferIn);
+	unsigned int fill = soundBufferFill();
+
+	return( (fill < s_BufferSize) ? (s_BufferSize - fill) : 0 );
+}
+
+/**
+ * Returns the audio latency in seconds: the current one, the target set by
+ * the buffer size, and the lowest and highest seen since the last reset.
+ */
+void
+GetSoundLatency(double *tgt, double *cur, double *min, double *max, unsigned int *starveCount)
+{
+	double period = (double)s_DevicePeriod / (double)s_SampleRate;
+
+	*tgt = period + ((double)s_BufferSize / (double)s_SampleRate);
+	*cur = period + ((double)soundBufferFill() / (double)s_SampleRate);
+	*min = s_LatencyMin;
+	*max = s_LatencyMax;
+	*starveCount = s_StarveCount.load(std::memory_order_relaxed);
+}
+
+/**
+ * Returns the number of samples the audio callback found missing since
+ * sound was started.
+ */
+unsigned int
+GetSoundStarveCount(void)
+{
+	return s_StarveCount.load(std::memory_order_relaxed);
+}
+
+void
+ResetSoundLatency(void)
+{
+	s_LatencyMin = 1.0;
+	s_LatencyMax = 0.0;
+}
+
+/**
+ * Grows the fill level after underruns and shrinks it back after a while
+ * without any, called from the emulation thread before writing samples.
+ */
+static void
+adaptSoundBufferSize(void)
+{
+	unsigned int starveCount = s_StarveCount.load(std::memory_order_relaxed);
+	double ts = getHighPrecTimeStamp();
+
+	if ( starveCount != s_LastStarveCount )
+	{
+		s_LastStarveCount = starveCount;
+		s_LastStarveTime  = ts;
+
+		setSoundBufferSize( s_BufferSize + s_DevicePeriod );
+	}
+	else if ( (ts - s_LastStarveTime) > 10.0 )
+	{
+		s_LastStarveTime = ts;
+
+		setSoundBufferSize( s_BufferSize - (s_DevicePeriod / 2) );
+	}
+}
+
+/**
+ * Waits until the ring has room for one more sample and writes it.
+ * Returns false when the audio callback stopped draining the ring.
+ */
+static bool
+pushSoundSample(int sample, int &waitCount)
+{
+	unsigned int tail = s_BufferTail.load(std::memory_order_relaxed);
+
+	while ( (tail - s_BufferHead.load(std::memory_order_acquire)) >= s_BufferSize )
+	{
+		SDL_Delay(1); waitCount++;
+
+		if ( waitCount > 1000 )
+		{
+			printf("Error: Sound sink is not draining... Breaking out of audio loop to prevent lockup.\n");
+			return false;
+		}
+	}
+	s_Buffer[tail & s_BufferMask] = sample;
+
+	s_BufferTail.store(tail + 1, std::memory_order_release);
+
+	return true;
 }
 
 /**
@@ -310,6 +450,7 @@ WriteSound(int32 *buf,
 	int ovrFlowSkip = 1;
 	int udrFlowDup  = 1;
 	static int skipCounter = 0;
+	unsigned int fill;
 
 	if ( NoWaiting & 0x01 )
 	{	// During Turbo mode, don't bother with sound as
@@ -317,12 +458,29 @@ WriteSound(int32 *buf,
 		return;
 	}
 
+	if ( s_BufferSizeMin < s_BufferSizeMax )
+	{
+		adaptSoundBufferSize();
+	}
+	fill = soundBufferFill();
+
+	double latency = ((double)(fill + s_DevicePeriod)) / (double)s_SampleRate;
+
+	if ( latency < s_LatencyMin )
+	{
+		s_LatencyMin = latency;
+	}
+	if ( latency > s_LatencyMax )
+	{
+		s_LatencyMax = latency;
+	}
+
 	if ( g_fpsScale >= 0.99995 )
 	{
 		uflowMode = 0;
 		ovrFlowSkip = (int)(g_fpsScale * 1000);
 
-		if ( s_BufferIn >= s_BufferSize50 )
+		if ( fill >= s_BufferSize50 )
 		{
 			ovrFlowSkip += 1;
 		}
@@ -335,11 +493,11 @@ WriteSound(int32 *buf,
 		{
 			udrFlowDup = 1;
 		}
-		if ( s_BufferIn < s_BufferSize50 )
+		if ( fill < s_BufferSize50 )
 		{
 			udrFlowDup++;
 		}
-		else if ( s_BufferIn > s_BufferSize75 )
+		else if ( fill > s_BufferSize75 )
 		{
 			udrFlowDup--;
 		}
@@ -352,37 +510,19 @@ WriteSound(int32 *buf,
 
 		if ( uflowMode )
 		{	// Underflow mode
-			SDL_LockAudio();
 			while (Count)
 			{
-				if ( s_BufferIn == s_BufferSize )
+				for (int i=0; i<udrFlowDup; i++)
 				{
-					SDL_UnlockAudio();
-					while (s_BufferIn == s_BufferSize) 
+					if ( !pushSoundSample( *buf, waitCount ) )
 					{
-						SDL_Delay(1); waitCount++;
-
-						if ( waitCount > 1000 )
-						{
-							printf("Error: Sound sink is not draining... Breaking out of audio loop to prevent lockup.\n");
-							return;
-						}
+						return;
 					}
-					SDL_LockAudio();
-				}
-
-				for (int i=0; i<udrFlowDup; i++)
-				{
-					s_Buffer[s_BufferWrite] = *buf;
-					s_BufferWrite = (s_BufferWrite + 1) % s_BufferSize;
-            
-					s_BufferIn++;
 				}
             
 				Count--;
 				buf++;
 			}
-			SDL_UnlockAudio();
 		}
 		else
 		{
@@ -390,64 +530,28 @@ WriteSound(int32 *buf,
 			{	// Perfect one to one realtime
 				skipCounter = 0;
 
-				SDL_LockAudio();
 				while (Count)
 				{
-					if (s_BufferIn == s_BufferSize) 
+					if ( !pushSoundSample( *buf, waitCount ) )
 					{
-						SDL_UnlockAudio();
-						while (s_BufferIn == s_BufferSize) 
-						{
-							SDL_Delay(1); waitCount++;
-
-							if ( waitCount > 1000 )
-							{
-								printf("Error: Sound sink is not draining... Breaking out of audio loop to prevent lockup.\n");
-								return;
-							}
-						}
-						SDL_LockAudio();
+						return;
 					}
-
-					s_Buffer[s_BufferWrite] = *buf;
 					Count--;
-					s_BufferWrite = (s_BufferWrite + 1) % s_BufferSize;
-            
-					s_BufferIn++;
 					buf++;
 				}
-				SDL_UnlockAudio();
 			}
 			else
 			{	// Overflow mode
-				SDL_LockAudio();
 				while (Count)
 				{
-					if (s_BufferIn == s_BufferSize) 
-					{
-						SDL_UnlockAudio();
-						while (s_BufferIn == s_BufferSize) 
-						{
-							SDL_Delay(1); waitCount++;
-
-							if ( waitCount > 1000 )
-							{
-								printf("Error: Sound sink is not draining... Breaking out of audio loop to prevent lockup.\n");
-								return;
-							}
-						}
-						SDL_LockAudio();
-					}
-
 					//printf("%i >= %i \n", skipCounter, ovrFlowSkip );
 
 					if ( skipCounter >= ovrFlowSkip )
 					{
-						s_Buffer[s_BufferWrite] = *buf;
-						s_BufferWrite = (s_BufferWrite + 1) % s_BufferSize;
-            
-						s_BufferIn++;
-
+						if ( !pushSoundSample( *buf, waitCount ) )
+						{
+							return;
+						}
 						skipCounter -= ovrFlowSkip;
 					}
 					skipCounter = (skipCounter+1000);
@@ -455,7 +559,6 @@ WriteSound(int32 *buf,
 					Count--;
 					buf++;
 				}
-				SDL_UnlockAudio();
 			}
 
 		}
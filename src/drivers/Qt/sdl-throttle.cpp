@@ -22,6 +22,7 @@
 
 #include "Qt/sdl.h"
 #include "Qt/throttle.h"
+#include "common/vidblit.h"
 
 #if defined(__linux__) || defined(__APPLE__) || defined(__unix__)
 #include <time.h>
@@ -189,6 +190,13 @@ int  getFrameTimingStats( struct frameTimingStat_t *stats )
 	stats->videoTimeDel.min = videoPeriodMin;
 	stats->videoTimeDel.max = videoPeriodMax;
 
+	GetSoundLatency( &stats->audioLatency.tgt, &stats->audioLatency.cur,
+	                 &stats->audioLatency.min, &stats->audioLatency.max,
+	                 &stats->audioStarveCount );
+
+	GetBlitFilterTime( &stats->videoFilterTime.cur, &stats->videoFilterTime.min,
+	                   &stats->videoFilterTime.max );
+
 	return 0;
 }
 
@@ -221,6 +229,9 @@ void resetFrameTiming(void)
 	frameIdleMin = 1.0;
 	videoPeriodMin = 1.0;
 	videoPeriodMax = 0.0;
+
+	ResetSoundLatency();
+	ResetBlitFilterTime();
 }
 
 /* LOGMUL = exp(log(2) / 3)
@@ -43,7 +43,21 @@ struct frameTimingStat_t
 		double max;
 	} videoTimeDel;
 
+	struct {
+		double tgt;
+		double cur;
+		double min;
+		double max;
+	} audioLatency;
+
+	struct {
+		double cur;
+		double min;
+		double max;
+	} videoFilterTime;
+
 	unsigned int lateCount;
+	unsigned int audioStarveCount;
 
 	bool enabled;
 };
@@ -95,7 +95,7 @@ FCEUD_NetworkConnect(void)
 	int netdivisor;
 
 	// get any required configuration variables
-	int port, localPlayers;
+	int port, localPlayers, rollback;
 	std::string server, username, password, key;
 	g_config->getOption("SDL.NetworkIP", &server);
 	g_config->getOption("SDL.NetworkUsername", &username);
@@ -103,6 +103,7 @@ FCEUD_NetworkConnect(void)
 	g_config->getOption("SDL.NetworkGameKey", &key);
 	g_config->getOption("SDL.NetworkPort", &port);
 	g_config->getOption("SDL.NetworkPlayers", &localPlayers);
+	g_config->getOption("SDL.NetworkRollback", &rollback);
     
     
 	g_config->setOption("SDL.NetworkIP", "");
@@ -236,7 +237,7 @@ FCEUD_NetworkConnect(void)
 	FCEU_DispMessage("Connection established.",0);
 
 	FCEUDnetplay = 1;
-	FCEUI_NetplayStart(localPlayers, netdivisor);
+	FCEUI_NetplayStart(localPlayers, netdivisor, rollback);
 
 	return 1;
 }
@@ -326,6 +327,23 @@ FCEUD_RecvData(void *data,
 	return 0;
 }
 
+int
+FCEUD_RecvDataPending(void)
+{
+#ifdef WIN32
+	u_long count = 0;
+
+	if(ioctlsocket(s_Socket, FIONREAD, &count))
+		return -1;
+#else
+	int count = 0;
+
+	if(ioctl(s_Socket, FIONREAD, &count))
+		return -1;
+#endif
+	return count;
+}
+
 void
 FCEUD_NetworkClose(void)
 {
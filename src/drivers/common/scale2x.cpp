@@ -222,6 +222,141 @@ void scale2x_32_def(scale2x_uint32* dst0, scale2x_uint32* dst1, const scale2x_ui
 	scale2x_32_def_single(dst1, src2, src1, src0, count);
 }
 
+/***************************************************************************/
+/* Scale2x SSE2/AVX2 implementation */
+
+#ifdef SCALE2X_SSE2
+
+#include <emmintrin.h>
+
+/*
+ * The vector versions compute the same selection as scale2x_8_def_single()
+ * for 16 (SSE2) or 32 (AVX2) central pixels at a time with byte compares and
+ * masks, so the result is identical to the C version. The border pixels and
+ * the remainder of the row are left to the C code.
+ */
+
+static inline void scale2x_8_border_first(scale2x_uint8* dst, const scale2x_uint8* src0, const scale2x_uint8* src1, const scale2x_uint8* src2)
+{
+	dst[0] = src1[0];
+	if (src1[1] == src0[0] && src2[0] != src0[0])
+		dst[1] = src0[0];
+	else
+		dst[1] = src1[0];
+}
+
+static inline void scale2x_8_central_last(scale2x_uint8* dst, const scale2x_uint8* src0, const scale2x_uint8* src1, const scale2x_uint8* src2, unsigned i, unsigned count)
+{
+	/* central pixels left over */
+	for (; i < count - 1; ++i) {
+		if (src0[i] != src2[i] && src1[i-1] != src1[i+1]) {
+			dst[2*i] = src1[i-1] == src0[i] ? src0[i] : src1[i];
+			dst[2*i+1] = src1[i+1] == src0[i] ? src0[i] : src1[i];
+		} else {
+			dst[2*i] = src1[i];
+			dst[2*i+1] = src1[i];
+		}
+	}
+
+	/* last pixel */
+	if (src1[i-1] == src0[i] && src2[i] != src0[i])
+		dst[2*i] = src0[i];
+	else
+		dst[2*i] = src1[i];
+	dst[2*i+1] = src1[i];
+}
+
+static inline void scale2x_8_sse2_single(scale2x_uint8* dst, const scale2x_uint8* src0, const scale2x_uint8* src1, const scale2x_uint8* src2, unsigned count)
+{
+	const __m128i ones = _mm_set1_epi8(-1);
+	unsigned i;
+
+	assert(count >= 2);
+
+	scale2x_8_border_first(dst, src0, src1, src2);
+
+	for (i = 1; i + 16 < count; i += 16) {
+		__m128i B = _mm_loadu_si128((const __m128i*)(src0 + i));
+		__m128i H = _mm_loadu_si128((const __m128i*)(src2 + i));
+		__m128i D = _mm_loadu_si128((const __m128i*)(src1 + i - 1));
+		__m128i E = _mm_loadu_si128((const __m128i*)(src1 + i));
+		__m128i F = _mm_loadu_si128((const __m128i*)(src1 + i + 1));
+		__m128i cond = _mm_andnot_si128(_mm_or_si128(_mm_cmpeq_epi8(B, H), _mm_cmpeq_epi8(D, F)), ones);
+		__m128i diff = _mm_and_si128(_mm_xor_si128(B, E), cond);
+		__m128i e0 = _mm_xor_si128(E, _mm_and_si128(diff, _mm_cmpeq_epi8(D, B)));
+		__m128i e1 = _mm_xor_si128(E, _mm_and_si128(diff, _mm_cmpeq_epi8(F, B)));
+
+		_mm_storeu_si128((__m128i*)(dst + 2*i), _mm_unpacklo_epi8(e0, e1));
+		_mm_storeu_si128((__m128i*)(dst + 2*i + 16), _mm_unpackhi_epi8(e0, e1));
+	}
+
+	scale2x_8_central_last(dst, src0, src1, src2, i, count);
+}
+
+/**
+ * Scale by a factor of 2 a row of pixels of 8 bits.
+ * This function operates like scale2x_8_def() but uses SSE2 instructions.
+ */
+void scale2x_8_sse2(scale2x_uint8* dst0, scale2x_uint8* dst1, const scale2x_uint8* src0, const scale2x_uint8* src1, const scale2x_uint8* src2, unsigned count)
+{
+	assert(count >= 2);
+
+	scale2x_8_sse2_single(dst0, src0, src1, src2, count);
+	scale2x_8_sse2_single(dst1, src2, src1, src0, count);
+}
+
+#ifdef SCALE2X_AVX2
+
+#include <immintrin.h>
+
+__attribute__((target("avx2")))
+static void scale2x_8_avx2_single(scale2x_uint8* dst, const scale2x_uint8* src0, const scale2x_uint8* src1, const scale2x_uint8* src2, unsigned count)
+{
+	const __m256i ones = _mm256_set1_epi8(-1);
+	unsigned i;
+
+	assert(count >= 2);
+
+	scale2x_8_border_first(dst, src0, src1, src2);
+
+	for (i = 1; i + 32 < count; i += 32) {
+		__m256i B = _mm256_loadu_si256((const __m256i*)(src0 + i));
+		__m256i H = _mm256_loadu_si256((const __m256i*)(src2 + i));
+		__m256i D = _mm256_loadu_si256((const __m256i*)(src1 + i - 1));
+		__m256i E = _mm256_loadu_si256((const __m256i*)(src1 + i));
+		__m256i F = _mm256_loadu_si256((const __m256i*)(src1 + i + 1));
+		__m256i cond = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpeq_epi8(B, H), _mm256_cmpeq_epi8(D, F)), ones);
+		__m256i diff = _mm256_and_si256(_mm256_xor_si256(B, E), cond);
+		__m256i e0 = _mm256_xor_si256(E, _mm256_and_si256(diff, _mm256_cmpeq_epi8(D, B)));
+		__m256i e1 = _mm256_xor_si256(E, _mm256_and_si256(diff, _mm256_cmpeq_epi8(F, B)));
+		/* the unpacks work within each 128 bit lane */
+		__m256i lo = _mm256_unpacklo_epi8(e0, e1);
+		__m256i hi = _mm256_unpackhi_epi8(e0, e1);
+
+		_mm256_storeu_si256((__m256i*)(dst + 2*i), _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i*)(dst + 2*i + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	scale2x_8_central_last(dst, src0, src1, src2, i, count);
+}
+
+/**
+ * Scale by a factor of 2 a row of pixels of 8 bits.
+ * This function operates like scale2x_8_def() but uses AVX2 instructions.
+ * Check that the cpu supports them before calling it.
+ */
+void scale2x_8_avx2(scale2x_uint8* dst0, scale2x_uint8* dst1, const scale2x_uint8* src0, const scale2x_uint8* src1, const scale2x_uint8* src2, unsigned count)
+{
+	assert(count >= 2);
+
+	scale2x_8_avx2_single(dst0, src0, src1, src2, count);
+	scale2x_8_avx2_single(dst1, src2, src1, src0, count);
+}
+
+#endif
+
+#endif
+
 /***************************************************************************/
 /* Scale2x MMX implementation */
 
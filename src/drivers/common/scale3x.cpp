@@ -381,3 +381,170 @@ void scale3x_32_def(scale3x_uint32* dst0, scale3x_uint32* dst1, scale3x_uint32*
 	scale3x_32_def_border(dst2, src2, src1, src0, count);
 }
 
+/***************************************************************************/
+/* Scale3x SSSE3 implementation */
+
+#ifdef SCALE3X_SSSE3
+
+#include <tmmintrin.h>
+
+/*
+ * Computes the same selection as scale3x_8_def_border() and
+ * scale3x_8_def_center() for 16 central pixels at a time, the three output
+ * bytes of each pixel are interleaved with pshufb. The border pixels and the
+ * remainder of the row are left to the C code, so the result is identical.
+ */
+
+/* store the bytes of e0, e1 and e2 interleaved as e0[0] e1[0] e2[0] e0[1] ... */
+__attribute__((target("ssse3")))
+static inline void scale3x_8_ssse3_store(scale3x_uint8* dst, __m128i e0, __m128i e1, __m128i e2)
+{
+	const __m128i m00 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+	const __m128i m01 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+	const __m128i m02 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+	const __m128i m10 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+	const __m128i m11 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+	const __m128i m12 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+	const __m128i m20 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+	const __m128i m21 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+	const __m128i m22 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+
+	_mm_storeu_si128((__m128i*)(dst + 0), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(e0, m00), _mm_shuffle_epi8(e1, m01)), _mm_shuffle_epi8(e2, m02)));
+	_mm_storeu_si128((__m128i*)(dst + 16), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(e0, m10), _mm_shuffle_epi8(e1, m11)), _mm_shuffle_epi8(e2, m12)));
+	_mm_storeu_si128((__m128i*)(dst + 32), _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(e0, m20), _mm_shuffle_epi8(e1, m21)), _mm_shuffle_epi8(e2, m22)));
+}
+
+__attribute__((target("ssse3")))
+static void scale3x_8_ssse3_border(scale3x_uint8* dst, const scale3x_uint8* src0, const scale3x_uint8* src1, const scale3x_uint8* src2, unsigned count)
+{
+	unsigned i;
+
+	assert(count >= 2);
+
+	/* first pixel */
+	dst[0] = src1[0];
+	dst[1] = src1[0];
+	if (src1[1] == src0[0] && src2[0] != src0[0])
+		dst[2] = src0[0];
+	else
+		dst[2] = src1[0];
+
+	/* central pixels, 16 at a time */
+	for (i = 1; i + 16 < count; i += 16) {
+		__m128i A = _mm_loadu_si128((const __m128i*)(src0 + i - 1));
+		__m128i B = _mm_loadu_si128((const __m128i*)(src0 + i));
+		__m128i C = _mm_loadu_si128((const __m128i*)(src0 + i + 1));
+		__m128i D = _mm_loadu_si128((const __m128i*)(src1 + i - 1));
+		__m128i E = _mm_loadu_si128((const __m128i*)(src1 + i));
+		__m128i F = _mm_loadu_si128((const __m128i*)(src1 + i + 1));
+		__m128i H = _mm_loadu_si128((const __m128i*)(src2 + i));
+		__m128i cond = _mm_or_si128(_mm_cmpeq_epi8(B, H), _mm_cmpeq_epi8(D, F));
+		__m128i diff = _mm_andnot_si128(cond, _mm_xor_si128(B, E));
+		__m128i DB = _mm_cmpeq_epi8(D, B);
+		__m128i FB = _mm_cmpeq_epi8(F, B);
+		__m128i m1 = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(E, C), DB), _mm_andnot_si128(_mm_cmpeq_epi8(E, A), FB));
+
+		/* every replacement value equals B */
+		scale3x_8_ssse3_store(dst + 3*i,
+			_mm_xor_si128(E, _mm_and_si128(diff, DB)),
+			_mm_xor_si128(E, _mm_and_si128(diff, m1)),
+			_mm_xor_si128(E, _mm_and_si128(diff, FB)));
+	}
+
+	/* central pixels left over */
+	for (; i < count - 1; ++i) {
+		if (src0[i] != src2[i] && src1[i-1] != src1[i+1]) {
+			dst[3*i] = src1[i-1] == src0[i] ? src1[i-1] : src1[i];
+			dst[3*i+1] = (src1[i-1] == src0[i] && src1[i] != src0[i+1]) || (src1[i+1] == src0[i] && src1[i] != src0[i-1]) ? src0[i] : src1[i];
+			dst[3*i+2] = src1[i+1] == src0[i] ? src1[i+1] : src1[i];
+		} else {
+			dst[3*i] = src1[i];
+			dst[3*i+1] = src1[i];
+			dst[3*i+2] = src1[i];
+		}
+	}
+
+	/* last pixel */
+	if (src1[i-1] == src0[i] && src2[i] != src0[i])
+		dst[3*i] = src0[i];
+	else
+		dst[3*i] = src1[i];
+	dst[3*i+1] = src1[i];
+	dst[3*i+2] = src1[i];
+}
+
+__attribute__((target("ssse3")))
+static void scale3x_8_ssse3_center(scale3x_uint8* dst, const scale3x_uint8* src0, const scale3x_uint8* src1, const scale3x_uint8* src2, unsigned count)
+{
+	unsigned i;
+
+	assert(count >= 2);
+
+	/* first pixel */
+	dst[0] = src1[0];
+	dst[1] = src1[0];
+	if (src0[0] != src2[0]) {
+		dst[2] = (src1[1] == src0[0] && src1[0] != src2[1]) || (src1[1] == src2[0] && src1[0] != src0[1]) ? src1[1] : src1[0];
+	} else {
+		dst[2] = src1[0];
+	}
+
+	/* central pixels, 16 at a time */
+	for (i = 1; i + 16 < count; i += 16) {
+		__m128i A = _mm_loadu_si128((const __m128i*)(src0 + i - 1));
+		__m128i B = _mm_loadu_si128((const __m128i*)(src0 + i));
+		__m128i C = _mm_loadu_si128((const __m128i*)(src0 + i + 1));
+		__m128i D = _mm_loadu_si128((const __m128i*)(src1 + i - 1));
+		__m128i E = _mm_loadu_si128((const __m128i*)(src1 + i));
+		__m128i F = _mm_loadu_si128((const __m128i*)(src1 + i + 1));
+		__m128i G = _mm_loadu_si128((const __m128i*)(src2 + i - 1));
+		__m128i H = _mm_loadu_si128((const __m128i*)(src2 + i));
+		__m128i I = _mm_loadu_si128((const __m128i*)(src2 + i + 1));
+		__m128i cond = _mm_or_si128(_mm_cmpeq_epi8(B, H), _mm_cmpeq_epi8(D, F));
+		__m128i m0 = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(E, G), _mm_cmpeq_epi8(D, B)), _mm_andnot_si128(_mm_cmpeq_epi8(E, A), _mm_cmpeq_epi8(D, H)));
+		__m128i m2 = _mm_or_si128(_mm_andnot_si128(_mm_cmpeq_epi8(E, I), _mm_cmpeq_epi8(F, B)), _mm_andnot_si128(_mm_cmpeq_epi8(E, C), _mm_cmpeq_epi8(F, H)));
+
+		scale3x_8_ssse3_store(dst + 3*i,
+			_mm_xor_si128(E, _mm_and_si128(_mm_andnot_si128(cond, m0), _mm_xor_si128(D, E))),
+			E,
+			_mm_xor_si128(E, _mm_and_si128(_mm_andnot_si128(cond, m2), _mm_xor_si128(F, E))));
+	}
+
+	/* central pixels left over */
+	for (; i < count - 1; ++i) {
+		if (src0[i] != src2[i] && src1[i-1] != src1[i+1]) {
+			dst[3*i] = (src1[i-1] == src0[i] && src1[i] != src2[i-1]) || (src1[i-1] == src2[i] && src1[i] != src0[i-1]) ? src1[i-1] : src1[i];
+			dst[3*i+1] = src1[i];
+			dst[3*i+2] = (src1[i+1] == src0[i] && src1[i] != src2[i+1]) || (src1[i+1] == src2[i] && src1[i] != src0[i+1]) ? src1[i+1] : src1[i];
+		} else {
+			dst[3*i] = src1[i];
+			dst[3*i+1] = src1[i];
+			dst[3*i+2] = src1[i];
+		}
+	}
+
+	/* last pixel */
+	if (src0[i] != src2[i]) {
+		dst[3*i] = (src1[i-1] == src0[i] && src1[i] != src2[i-1]) || (src1[i-1] == src2[i] && src1[i] != src0[i-1]) ? src1[i-1] : src1[i];
+	} else {
+		dst[3*i] = src1[i];
+	}
+	dst[3*i+1] = src1[i];
+	dst[3*i+2] = src1[i];
+}
+
+/**
+ * Scale by a factor of 3 a row of pixels of 8 bits.
+ * This function operates like scale3x_8_def() but uses SSSE3 instructions.
+ * Check that the cpu supports them before calling it.
+ */
+void scale3x_8_ssse3(scale3x_uint8* dst0, scale3x_uint8* dst1, scale3x_uint8* dst2, const scale3x_uint8* src0, const scale3x_uint8* src1, const scale3x_uint8* src2, unsigned count)
+{
+	assert(count >= 2);
+
+	scale3x_8_ssse3_border(dst0, src0, src1, src2, count);
+	scale3x_8_ssse3_center(dst1, src0, src1, src2, count);
+	scale3x_8_ssse3_border(dst2, src2, src1, src0, count);
+}
+
+#endif
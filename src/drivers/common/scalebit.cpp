@@ -39,6 +39,7 @@
 
 #include "scale2x.h"
 #include "scale3x.h"
+#include "scalebit.h"
 
 #if HAVE_ALLOCA_H
 #include <alloca.h>
@@ -47,6 +48,58 @@
 #include <assert.h>
 #include <stdlib.h>
 
+/**
+ * SIMD level of the 8 bit stages, set with scale_set_simd().
+ * -1 until the first call, then the best one the cpu supports.
+ */
+static int scale_simd = -1;
+
+/**
+ * Return the best SIMD level the cpu supports.
+ */
+int scale_cpu_simd(void)
+{
+#if defined(__GNUC__) && defined(__x86_64__)
+	if (__builtin_cpu_supports("avx2"))
+		return SCALE_SIMD_AVX2;
+	if (__builtin_cpu_supports("ssse3"))
+		return SCALE_SIMD_SSSE3;
+	return SCALE_SIMD_SSE2;
+#elif defined(_M_X64)
+	return SCALE_SIMD_SSE2;
+#else
+	return SCALE_SIMD_NONE;
+#endif
+}
+
+/**
+ * Select the SIMD level of the 8 bit Scale2x/Scale3x stages.
+ * The level is lowered to what the cpu supports. All levels give the same output.
+ * \param level One of the SCALE_SIMD_* values.
+ * \return The level actually selected.
+ */
+int scale_set_simd(int level)
+{
+	int best = scale_cpu_simd();
+
+	if (level < SCALE_SIMD_NONE)
+		level = SCALE_SIMD_NONE;
+	scale_simd = level < best ? level : best;
+
+	return scale_simd;
+}
+
+/**
+ * Return the SIMD level of the 8 bit Scale2x/Scale3x stages.
+ */
+int scale_get_simd(void)
+{
+	if (scale_simd < 0)
+		scale_set_simd(SCALE_SIMD_AVX2);
+
+	return scale_simd;
+}
+
 /**
  * Apply the Scale2x effect on a group of rows. Used internally.
  */
@@ -59,7 +112,21 @@ static inline void stage_scale2x(void* dst0, void* dst1, const void* src0, const
 		case 2 : scale2x_16_mmx((scale2x_uint16*)dst0, (scale2x_uint16*)dst1, (scale2x_uint16*)src0, (scale2x_uint16*)src1, (scale2x_uint16*)src2, pixel_per_row); break;
 		case 4 : scale2x_32_mmx((scale2x_uint32*)dst0, (scale2x_uint32*)dst1, (scale2x_uint32*)src0, (scale2x_uint32*)src1, (scale2x_uint32*)src2, pixel_per_row); break;
 #else
-		case 1 : scale2x_8_def((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row); break;
+		case 1 :
+#ifdef SCALE2X_AVX2
+			if (scale_simd >= SCALE_SIMD_AVX2) {
+				scale2x_8_avx2((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row);
+				break;
+			}
+#endif
+#ifdef SCALE2X_SSE2
+			if (scale_simd >= SCALE_SIMD_SSE2) {
+				scale2x_8_sse2((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row);
+				break;
+			}
+#endif
+			scale2x_8_def((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row);
+			break;
 		case 2 : scale2x_16_def((scale2x_uint16*)dst0, (scale2x_uint16*)dst1, (scale2x_uint16*)src0, (scale2x_uint16*)src1, (scale2x_uint16*)src2, pixel_per_row); break;
 		case 4 : scale2x_32_def((scale2x_uint32*)dst0, (scale2x_uint32*)dst1, (scale2x_uint32*)src0, (scale2x_uint32*)src1, (scale2x_uint32*)src2, pixel_per_row); break;
 #endif
@@ -73,7 +140,16 @@ static inline void stage_scale2x(void* dst0, void* dst1, const void* src0, const
 static inline void stage_scale3x(void* dst0, void* dst1, void* dst2, const void* src0, const void* src1, const void* src2, unsigned pixel, unsigned pixel_per_row)
 {
 	switch (pixel) {
+#ifdef SCALE3X_SSSE3
+		case 1 :
+			if (scale_simd >= SCALE_SIMD_SSSE3)
+				scale3x_8_ssse3((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)dst2, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row);
+			else
+				scale3x_8_def((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)dst2, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row);
+			break;
+#else
 		case 1 : scale3x_8_def((scale2x_uint8*)dst0, (scale2x_uint8*)dst1, (scale2x_uint8*)dst2, (scale2x_uint8*)src0, (scale2x_uint8*)src1, (scale2x_uint8*)src2, pixel_per_row); break;
+#endif
 		case 2 : scale3x_16_def((scale2x_uint16*)dst0, (scale2x_uint16*)dst1, (scale2x_uint16*)dst2, (scale2x_uint16*)src0, (scale2x_uint16*)src1, (scale2x_uint16*)src2, pixel_per_row); break;
 		case 4 : scale3x_32_def((scale2x_uint32*)dst0, (scale2x_uint32*)dst1, (scale2x_uint32*)dst2, (scale2x_uint32*)src0, (scale2x_uint32*)src1, (scale2x_uint32*)src2, pixel_per_row); break;
 	}
@@ -372,6 +448,9 @@ int scale_precondition(unsigned scale, unsigned pixel, unsigned width, unsigned
  */
 void scale(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_src, unsigned src_slice, unsigned pixel, unsigned width, unsigned height)
 {
+	if (scale_simd < 0)
+		scale_set_simd(SCALE_SIMD_AVX2);
+
 	switch (scale) {
 	case 2 :
 		scale2x(void_dst, dst_slice, void_src, src_slice, pixel, width, height);
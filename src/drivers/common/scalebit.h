@@ -36,6 +36,16 @@
 #ifndef __SCALEBIT_H
 #define __SCALEBIT_H
 
+/* SIMD levels of the 8 bit Scale2x/Scale3x stages */
+#define SCALE_SIMD_NONE  0
+#define SCALE_SIMD_SSE2  1   /* Scale2x */
+#define SCALE_SIMD_SSSE3 2   /* Scale2x, Scale3x */
+#define SCALE_SIMD_AVX2  3   /* Scale2x with 32 pixels per step, Scale3x */
+
+int scale_cpu_simd(void);
+int scale_set_simd(int level);
+int scale_get_simd(void);
+
 int scale_precondition(unsigned scale, unsigned pixel, unsigned width, unsigned height);
 void scale(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_src, unsigned src_slice, unsigned pixel, unsigned width, unsigned height);
 
@@ -20,6 +20,10 @@
 
 #include <stdlib.h>
 #include <math.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "scalebit.h"
 #include "hq2x.h"
 #include "hq3x.h"
@@ -29,6 +33,12 @@
 #include "../../palette.h"
 #include "../../utils/memory.h"
 #include "nes_ntsc.h"
+#include "vidblit.h"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define BLIT_AVX2
+#include <immintrin.h>
+#endif
 
 extern u8 *XBuf;
 extern u8 *XBackBuf;
@@ -55,6 +65,10 @@ static uint8  *specbuf8bpp = NULL;	// For 2xscale, 3xscale.
 static uint8  *ntscblit    = NULL;	// For nes_ntsc
 static uint32 *prescalebuf = NULL;	// Prescale pointresizes to 2x-4x to allow less blur with hardware acceleration.
 
+static double blitTimeCur = 0.0;	// seconds Blit8ToHigh() took for the last frame
+static double blitTimeMin = 1.0;
+static double blitTimeMax = 0.0;
+
 //////////////////////
 // PAL filter start //
 //////////////////////
@@ -105,6 +119,193 @@ static void CalculateShift(uint32 *CBM, int *cshiftr, int *cshiftl)
 }
 
 
+// The rows of nes_ntsc_blit() only depend on their own input and on the burst
+// phase, which goes up by one (mod 3) per row. So the NTSC frame is cut into
+// bands of rows that are filtered by a small pool of worker threads and the
+// calling thread at the same time, every band starting at the phase the
+// single threaded loop would have reached there. The copy to the screen reads
+// a few pixels past the end of each filtered row, so the bands only start
+// copying when every band is filtered. Blit8ToHigh() waits for all of them
+// before it returns, the picture is the same as with one thread.
+struct ntscFrame_t
+{
+	const uint8 *src;
+	const uint8 *srcD;
+	uint8 *dest;
+	int xr, yr;
+	int pitch;
+	int xscale;
+	int outxr;
+	int phase;
+};
+
+static ntscFrame_t ntscFrame;
+static int ntscNumBands = 1;
+static int ntscThreadCount = 0;	// 0 = pick from the number of cpus
+static std::thread ntscWorkers[NTSC_MAX_THREADS-1];
+static std::mutex ntscMutex;
+static std::condition_variable ntscStartCond;
+static std::condition_variable ntscFilteredCond;
+static std::condition_variable ntscDoneCond;
+static unsigned int ntscFrameSeq = 0;
+static int ntscFilterLeft = 0;	// bands still filtering, the calling thread's too
+static int ntscBandsLeft = 0;	// worker bands not yet copied
+static bool ntscWorkersQuit = false;
+
+static void NtscFilterBand(const ntscFrame_t *f, int band)
+{
+	int y0 = (f->yr * band) / ntscNumBands;
+	int y1 = (f->yr * (band+1)) / ntscNumBands;
+	const int in_stride = Bpp * f->outxr * 2;
+
+	if(y0 < y1)
+	{
+		nes_ntsc_blit( nes_ntsc, (unsigned char*)f->src + y0*f->xr, (unsigned char*)f->srcD + y0*f->xr, f->xr,
+		               (f->phase + y0) % nes_ntsc_burst_count, f->xr, y1-y0, ntscblit + y0*in_stride, in_stride );
+	}
+}
+
+static void NtscCopyBand(const ntscFrame_t *f, int band)
+{
+	int y0 = (f->yr * band) / ntscNumBands;
+	int y1 = (f->yr * (band+1)) / ntscNumBands;
+	const int in_stride = Bpp * f->outxr * 2;
+	const int out_stride = f->pitch;
+
+	const uint8 *in = ntscblit + y0*in_stride + (Bpp * f->xscale);
+	uint8 *out = f->dest + y0*2*out_stride;
+	for( int y = y0; y < y1; y++, in += in_stride, out += 2*out_stride ) {
+		memcpy(out, in, Bpp * f->outxr * f->xscale);
+		memcpy(out + out_stride, in, Bpp * f->outxr * f->xscale);
+	}
+}
+
+static void NtscBlitBand(const ntscFrame_t *f, int band)
+{
+	NtscFilterBand(f, band);
+
+	{
+		std::unique_lock<std::mutex> lock(ntscMutex);
+
+		if(--ntscFilterLeft == 0)
+			ntscFilteredCond.notify_all();
+		else
+			ntscFilteredCond.wait(lock, []{ return ntscFilterLeft == 0; });
+	}
+
+	NtscCopyBand(f, band);
+}
+
+static void NtscWorkerMain(int band)
+{
+	unsigned int seq = 0;
+
+	for(;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(ntscMutex);
+
+			ntscStartCond.wait(lock, [&]{ return ntscWorkersQuit || (ntscFrameSeq != seq); });
+
+			if(ntscWorkersQuit)
+				return;
+			seq = ntscFrameSeq;
+		}
+
+		NtscBlitBand(&ntscFrame, band);
+
+		{
+			std::lock_guard<std::mutex> lock(ntscMutex);
+
+			if(--ntscBandsLeft == 0)
+				ntscDoneCond.notify_one();
+		}
+	}
+}
+
+static void NtscStartWorkers(void)
+{
+	int count = ntscThreadCount;
+
+	if(count <= 0)
+	{
+		// leave a cpu for the gui and the sound
+		count = (int)std::thread::hardware_concurrency() - 1;
+	}
+	if(count > NTSC_MAX_THREADS)
+		count = NTSC_MAX_THREADS;
+	if(count < 1)
+		count = 1;
+
+	ntscWorkersQuit = false;
+	ntscFrameSeq = 0;
+	ntscNumBands = count;
+
+	// band 0 is done by the thread calling Blit8ToHigh()
+	for(int i = 1; i < ntscNumBands; i++)
+		ntscWorkers[i-1] = std::thread(NtscWorkerMain, i);
+}
+
+static void NtscStopWorkers(void)
+{
+	{
+		std::lock_guard<std::mutex> lock(ntscMutex);
+		ntscWorkersQuit = true;
+	}
+	ntscStartCond.notify_all();
+
+	for(int i = 1; i < ntscNumBands; i++)
+	{
+		if(ntscWorkers[i-1].joinable())
+			ntscWorkers[i-1].join();
+	}
+	ntscNumBands = 1;
+}
+
+static void NtscBlit(const ntscFrame_t *f)
+{
+	if(ntscNumBands <= 1)
+	{
+		NtscFilterBand(f, 0);
+		NtscCopyBand(f, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(ntscMutex);
+
+		ntscFrame = *f;
+		ntscFilterLeft = ntscNumBands;
+		ntscBandsLeft = ntscNumBands - 1;
+		ntscFrameSeq++;
+	}
+	ntscStartCond.notify_all();
+
+	NtscBlitBand(f, 0);
+
+	std::unique_lock<std::mutex> lock(ntscMutex);
+
+	ntscDoneCond.wait(lock, []{ return ntscBandsLeft == 0; });
+}
+
+int SetNtscBlitThreads(int count)
+{
+	int old = ntscThreadCount;
+
+	if(count < 0)
+		count = 0;
+	if(count > NTSC_MAX_THREADS)
+		count = NTSC_MAX_THREADS;
+	ntscThreadCount = count;
+
+	return old;
+}
+
+int GetNtscBlitThreads(void)
+{
+	return ntscNumBands;
+}
+
 int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int specfilt, int specfilteropt)
 {
 	// -Video Modes Tag-
@@ -135,6 +336,7 @@ int InitBlitToHigh(int b, uint32 rmask, uint32 gmask, uint32 bmask, int efx, int
 		{
 			nes_ntsc_init( nes_ntsc, &ntsc_setup, b );			
 			ntscblit = (uint8*)FCEU_dmalloc(602*257*b);
+			NtscStartWorkers();
 		}
 		
 	} // -Video Modes Tag-
@@ -263,6 +465,7 @@ void KillBlitToHigh(void)
 		specbuf=NULL;
 	}
 	if (nes_ntsc) {
+		NtscStopWorkers();
 		free(nes_ntsc);
 		nes_ntsc = NULL;
 	}
@@ -506,6 +709,137 @@ u32 ModernDeemphColorMap(u8* src, u8* srcbuf, int scale)
 	else { abort(); return 0; }
 }
 
+//the same colors as _ModernDeemphColorMap<SCALE>() for a whole row of pixels
+template<int SCALE> static void _ModernDeemphColorMapRow(u32* dest, u8* src, u8* srcbuf, int count)
+{
+	for(int x=0;x<count;x++)
+		dest[x] = _ModernDeemphColorMap<SCALE>(src+x,srcbuf);
+}
+
+#ifdef BLIT_AVX2
+//8 pixels per step, the palettetranslate lookups are done with a gather
+__attribute__((target("avx2")))
+static void ModernDeemphColorMapRowAVX2(u32* dest, const u8* src, const u8* deemph, int count)
+{
+	const __m256i low6 = _mm256_set1_epi32(0x3F);
+	const __m256i base = _mm256_set1_epi32(256);
+	const __m256i zero = _mm256_setzero_si256();
+	int x;
+
+	for(x=0;x+8<=count;x+=8)
+	{
+		__m256i pixel = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src+x)));
+		__m256i bits  = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(deemph+x)));
+		__m256i index = _mm256_add_epi32(_mm256_add_epi32(base,_mm256_and_si256(pixel,low6)),_mm256_slli_epi32(bits,6));
+
+		index = _mm256_blendv_epi8(index,pixel,_mm256_cmpeq_epi32(bits,zero));
+		_mm256_storeu_si256((__m256i*)(dest+x),_mm256_i32gather_epi32((const int*)palettetranslate,index,4));
+	}
+	for(;x<count;x++)
+	{
+		u8 pixel = src[x];
+
+		dest[x] = deemph[x] ? palettetranslate[256+(pixel&0x3F)+(deemph[x]*64)] : palettetranslate[pixel];
+	}
+}
+
+//scaled rows, the deemph bits are gathered too. xofs/SCALE is done as a
+//multiply and shift, which is exact for xofs < 256 and SCALE <= 9.
+template<int SCALE> __attribute__((target("avx2")))
+static void _ModernDeemphColorMapRowAVX2(u32* dest, u8* src, u8* srcbuf, int count)
+{
+	const __m256i lane = _mm256_setr_epi32(0,1,2,3,4,5,6,7);
+	const __m256i div  = _mm256_set1_epi32((65536+SCALE-1)/SCALE);
+	const __m256i low6 = _mm256_set1_epi32(0x3F);
+	const __m256i low8 = _mm256_set1_epi32(0xFF);
+	const __m256i base = _mm256_set1_epi32(256);
+	const __m256i zero = _mm256_setzero_si256();
+	int ofs = src-srcbuf;
+	int x = 0;
+
+	while(x < count)
+	{
+		//the pixels of one 256 byte block of srcbuf share a deemph row
+		int end = x + 256 - ((ofs+x)&255);
+		int xofs = (ofs+x)&255;
+		const u8* deemph = XDBuf + (((ofs+x)>>8)/SCALE)*256;
+
+		if(end > count)
+			end = count;
+
+		for(;x+8<=end;x+=8,xofs+=8)
+		{
+			__m256i col   = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_add_epi32(_mm256_set1_epi32(xofs),lane),div),16);
+			__m256i bits  = _mm256_and_si256(_mm256_i32gather_epi32((const int*)deemph,col,1),low8);
+			__m256i pixel = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src+x)));
+			__m256i index = _mm256_add_epi32(_mm256_add_epi32(base,_mm256_and_si256(pixel,low6)),_mm256_slli_epi32(bits,6));
+
+			index = _mm256_blendv_epi8(index,pixel,_mm256_cmpeq_epi32(bits,zero));
+			_mm256_storeu_si256((__m256i*)(dest+x),_mm256_i32gather_epi32((const int*)palettetranslate,index,4));
+		}
+		for(;x<end;x++)
+			dest[x] = _ModernDeemphColorMap<SCALE>(src+x,srcbuf);
+	}
+}
+#endif
+
+//the main blitting path, unscaled rows of XBuf
+static void ModernDeemphColorMapRow(u32* dest, u8* src, int count)
+{
+#ifdef BLIT_AVX2
+	if(scale_get_simd() >= SCALE_SIMD_AVX2)
+	{
+		ModernDeemphColorMapRowAVX2(dest,src,XDBuf+(src-XBuf),count);
+		return;
+	}
+#endif
+	_ModernDeemphColorMapRow<1>(dest,src,XBuf,count);
+}
+
+typedef void (*ModernDeemphColorMapRowFuncPtr)( u32*, u8*, u8*, int );
+
+static ModernDeemphColorMapRowFuncPtr getModernDeemphColorMapRowFunc(int scale)
+{
+	ModernDeemphColorMapRowFuncPtr ptr = NULL;
+
+	if(scale == 1) ptr = &_ModernDeemphColorMapRow<1>;
+	else if(scale == 2) ptr = &_ModernDeemphColorMapRow<2>;
+	else if(scale == 3) ptr = &_ModernDeemphColorMapRow<3>;
+	else if(scale == 4) ptr = &_ModernDeemphColorMapRow<4>;
+	else if(scale == 5) ptr = &_ModernDeemphColorMapRow<5>;
+	else if(scale == 6) ptr = &_ModernDeemphColorMapRow<6>;
+	else if(scale == 7) ptr = &_ModernDeemphColorMapRow<7>;
+	else if(scale == 8) ptr = &_ModernDeemphColorMapRow<8>;
+	else if(scale == 9) ptr = &_ModernDeemphColorMapRow<9>;
+	else { abort(); ptr = NULL; }
+
+#ifdef BLIT_AVX2
+	if(scale_get_simd() >= SCALE_SIMD_AVX2)
+	{
+		if(scale == 2) ptr = &_ModernDeemphColorMapRowAVX2<2>;
+		else if(scale == 3) ptr = &_ModernDeemphColorMapRowAVX2<3>;
+		else if(scale == 4) ptr = &_ModernDeemphColorMapRowAVX2<4>;
+		else if(scale == 5) ptr = &_ModernDeemphColorMapRowAVX2<5>;
+		else if(scale == 6) ptr = &_ModernDeemphColorMapRowAVX2<6>;
+		else if(scale == 7) ptr = &_ModernDeemphColorMapRowAVX2<7>;
+		else if(scale == 8) ptr = &_ModernDeemphColorMapRowAVX2<8>;
+		else if(scale == 9) ptr = &_ModernDeemphColorMapRowAVX2<9>;
+	}
+#endif
+
+	return ptr;
+}
+
+int SetBlitSimdLevel(int level)
+{
+	return scale_set_simd(level);
+}
+
+int GetBlitSimdLevel(void)
+{
+	return scale_get_simd();
+}
+
 typedef u32 (*ModernDeemphColorMapFuncPtr)( u8*, u8* );
 
 static ModernDeemphColorMapFuncPtr getModernDeemphColorMapFunc(int scale)
@@ -526,7 +860,7 @@ static ModernDeemphColorMapFuncPtr getModernDeemphColorMapFunc(int scale)
 	return ptr;
 }
 
-void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
+static void _Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
 {
 	int x,y;
 	int pinc;
@@ -542,6 +876,7 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		int mult; 
 		int base;
 		ModernDeemphColorMapFuncPtr ModernDeemphColorMapFunc = NULL;
+		ModernDeemphColorMapRowFuncPtr ModernDeemphColorMapRowFunc = NULL;
 		
 		// -Video Modes Tag-
 		if(silt == 2) mult = 2;
@@ -555,6 +890,7 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 			abort();
 		
 		ModernDeemphColorMapFunc = getModernDeemphColorMapFunc( mdcmxs );
+		ModernDeemphColorMapRowFunc = getModernDeemphColorMapRowFunc( mdcmxs );
 
 		xr *= mult;
 		yr *= mult;
@@ -565,16 +901,9 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		switch(Bpp)
 		{
 		case 4:
-			pinc=pitch-(xr<<2);
-			for(y=yr;y;y--,src+=base-xr)
+			for(y=yr;y;y--,src+=base,dest+=pitch)
 			{
-				for(x=xr;x;x--)
-				{
-				 *(uint32 *)dest=ModernDeemphColorMapFunc(src,specbuf8bpp);
-				 dest+=4;
-				 src++;
-				}
-				dest+=pinc;
+				ModernDeemphColorMapRowFunc((u32 *)dest,src,specbuf8bpp,xr);
 			}
 			break;
 		case 3:
@@ -617,40 +946,37 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		dest = (uint8 *)prescalebuf;
 		pitchbackup = pitch;		
 		pitch = xr*sizeof(uint32);
-		pinc = pitch-(xr<<2);
 
-		for(y=yr; y; y--, src+=256-xr)
+		for(y=yr; y; y--, src+=256, dest+=pitch)
 		{
-			for(x=xr; x; x--)
-			{
-				*(uint32 *)dest = _ModernDeemphColorMap<1>(src,XBuf);
-				dest += 4;
-				src++;
-			}
-			dest += pinc;
+			ModernDeemphColorMapRow((u32 *)dest,src,xr);
 		}
 
 		if (Bpp == 4) // are other modes really needed?
 		{
 			uint32 *s = prescalebuf;
 			uint32 *d = (uint32 *)destbackup; // use 32-bit pointers ftw
-			int subpixel,yend;
+			int subpixel,rowlen;
 
-			yend = yr*yscale;
+			rowlen = xr*xscale;
 
-			for (y=0; y<yend; y++)
+			for (y=0; y<yr; y++, s+=xr)
 			{
-				int back = xr*(y%yscale>0); // bool as multiplier
+				uint32 *row = d;
+
 				for (x=0; x<xr; x++)
 				{
 					for (subpixel=0; subpixel<xscale; subpixel++)
 					{
-						*d++ = *(s-back);
+						*d++ = s[x];
 					}
-					s++;
 				}
-				if (back)
-					s -= xr;
+				// the other rows of a scaled row are copies of the first
+				for (subpixel=1; subpixel<yscale; subpixel++)
+				{
+					memcpy(d, row, rowlen*sizeof(uint32));
+					d += rowlen;
+				}
 			}
 		}
 		return;
@@ -858,42 +1184,47 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 			{
 			case 4:
 				if ( nes_ntsc && GameInfo && GameInfo->type!=GIT_NSF) {
+					ntscFrame_t frame;
 					int outxr = 301;
 					//if(xr == 282) outxr = 282; //hack for windows
 					burst_phase ^= 1;
 
-					u8* srcD = XDBuf + (src-XBuf); // get deemphasis buffer
-					nes_ntsc_blit( nes_ntsc, (unsigned char*)src, (unsigned char*)srcD, xr, burst_phase, xr, yr, ntscblit, (2*outxr) * Bpp );
-
-					const uint8 *in = ntscblit + (Bpp * xscale);
-					uint8 *out = dest;
-					const int in_stride = Bpp * outxr * 2;
-					const int out_stride = pitch;
-					for( int y = 0; y < yr; y++, in += in_stride, out += 2*out_stride ) {
-						memcpy(out, in, Bpp * outxr * xscale);
-						memcpy(out + out_stride, in, Bpp * outxr * xscale);
-					}
+					frame.src = src;
+					frame.srcD = XDBuf + (src-XBuf); // get deemphasis buffer
+					frame.dest = dest;
+					frame.xr = xr;
+					frame.yr = yr;
+					frame.pitch = pitch;
+					frame.xscale = xscale;
+					frame.outxr = outxr;
+					frame.phase = burst_phase;
+					NtscBlit(&frame);
 				} else {
-					pinc=pitch-((xr*xscale)<<2);
-					for(y=yr;y;y--,src+=256-xr)
+					int rowlen=(xr*xscale)<<2;
+
+					for(y=yr;y;y--,src+=256)
 					{
+						uint8 *row=dest;
 						int doo=yscale;
-						        
-						do
+
+						for(x=0;x<xr;x++)
 						{
-							for(x=xr;x;x--,src++)
+							uint32 color=palettetranslate[src[x]];
+							int too=xscale;
+							do
 							{
-								int too=xscale;
-								do
-								{
-									*(uint32 *)dest=palettetranslate[*src];
-									dest+=4;
-								} while(--too);
-							}
-							src-=xr;
-							dest+=pinc;
-						} while(--doo);
-						src+=xr;
+								*(uint32 *)dest=color;
+								dest+=4;
+							} while(--too);
+						}
+						dest+=pitch-rowlen;
+
+						//the other rows of a scaled row are copies of the first
+						while(--doo)
+						{
+							memcpy(dest,row,rowlen);
+							dest+=pitch;
+						}
 					}
 				}
 				break;
@@ -958,17 +1289,10 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 			switch(Bpp)
 			{
 			case 4:
-				pinc=pitch-(xr<<2);
-				for(y=yr;y;y--,src+=256-xr)
+				for(y=yr;y;y--,src+=256,dest+=pitch)
 				{
-					for(x=xr;x;x--)
-					{
-						//THE MAIN BLITTING CODEPATH (there may be others that are important)
-						*(uint32 *)dest = _ModernDeemphColorMap<1>(src,XBuf);
-						dest+=4;
-						src++;
-					}
-					dest+=pinc;
+					//THE MAIN BLITTING CODEPATH (there may be others that are important)
+					ModernDeemphColorMapRow((u32 *)dest,src,xr);
 				}
 				break;
 			case 3:
@@ -1030,3 +1354,30 @@ void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale,
 		}
 	}
 }
+
+void Blit8ToHigh(uint8 *src, uint8 *dest, int xr, int yr, int pitch, int xscale, int yscale)
+{
+	auto t0 = std::chrono::steady_clock::now();
+
+	_Blit8ToHigh(src, dest, xr, yr, pitch, xscale, yscale);
+
+	blitTimeCur = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+	if(blitTimeCur < blitTimeMin)
+		blitTimeMin = blitTimeCur;
+	if(blitTimeCur > blitTimeMax)
+		blitTimeMax = blitTimeCur;
+}
+
+void GetBlitFilterTime(double *cur, double *min, double *max)
+{
+	*cur = blitTimeCur;
+	*min = (blitTimeMin > blitTimeMax) ? blitTimeMax : blitTimeMin;
+	*max = blitTimeMax;
+}
+
+void ResetBlitFilterTime(void)
+{
+	blitTimeMin = 1.0;
+	blitTimeMax = 0.0;
+}
@@ -29,4 +29,20 @@ void Blit32to16(uint32 *src, uint16 *dest, int xr, int yr, int dpitch,
         int shiftr[3], int shiftl[3]);
 
 
-u32 ModernDeemphColorMap(u8* src, u8* srcbuf, int scale);
\ No newline at end of file
+u32 ModernDeemphColorMap(u8* src, u8* srcbuf, int scale);
+
+// SIMD paths of the blitters and scalers (SCALE_SIMD_* in scalebit.h). The best one
+// the cpu supports is used by default, all of them give the same picture.
+int SetBlitSimdLevel(int level);
+int GetBlitSimdLevel(void);
+
+// Threads nes_ntsc rendering is split across, 0 picks one per cpu (up to
+// NTSC_MAX_THREADS). Takes effect on the next InitBlitToHigh().
+#define NTSC_MAX_THREADS 4
+int SetNtscBlitThreads(int count);
+int GetNtscBlitThreads(void);
+
+// Seconds Blit8ToHigh() took for the last frame and the shortest and longest
+// frame since ResetBlitFilterTime().
+void GetBlitFilterTime(double *cur, double *min, double *max);
+void ResetBlitFilterTime(void);
\ No newline at end of file
@@ -1058,6 +1058,9 @@ void UpdateDebugger(bool jump_to_pc)
 	if (ppupixel>341)	//maximum number of pixels per scanline
 		ppupixel = 0;	//Currently pixel display is borked until Run 128 lines is clicked, this keeps garbage from displaying
 
+	// the cpu core only keeps these up to date while DebugCycle() runs
+	UpdateVBlankScanLines();
+
 	// If not in the 0-239 pixel range, make special cases for display
 	if (scanline == 240 && vblankScanLines < (PAL?72:22))
 	{
@@ -519,7 +519,7 @@ void FCEUD_UpdateInput()
 	bool mouse_relative=false;
 
 	//aquanull: if we are ok with getting real input even when emulation is paused, why should we bother skipping it when playing a movie?
-	bool skipRealInput = (FCEUMOV_Mode() == MOVIEMODE_PLAY && currFrameCounter < (int)currMovieData.records.size());
+	bool skipRealInput = (FCEUMOV_Mode() == MOVIEMODE_PLAY && currFrameCounter < currMovieData.getNumRecords());
 
 	UpdateRawInputAndHotkeys();
 
@@ -382,6 +382,15 @@ int FCEUD_RecvData(void *data, uint32 len)
   return 0;
 }
 
+int FCEUD_RecvDataPending(void)
+{
+ unsigned long count;
+
+ if(ioctlsocket(Socket,FIONREAD,&count))
+  return(-1);
+ return((int)count);
+}
+
 CFGSTRUCT NetplayConfig[]={
         AC(remotetport),
         AC(netlocalplayers),
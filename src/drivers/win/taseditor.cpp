@@ -134,6 +134,7 @@ bool enterTASEditor()
 				// use current movie to create a new project
 				FCEUI_StopMovie();
 				movieMode = MOVIEMODE_TASEDITOR;
+				currMovieData.unpackRecords();
 			}
 			// if movie length is less or equal to currFrame, pad it with empty frames
 			if (((int)currMovieData.records.size() - 1) < currFrameCounter)
@@ -728,6 +728,7 @@ void BeginLoggingSequence(void)
 	olddatacount = datacount;
 
 	logging=1;
+	FCEUI_SetTracing(1);
 	SetDlgItemText(hTracer, IDC_BTN_START_STOP_LOGGING,"Stop Logging");
 	return;
 }
@@ -744,7 +745,7 @@ void FCEUD_TraceInstruction(uint8 *opcode, int size)
 
 	// if instruction executed from the RAM, skip this, log all instead
 	// TODO: loops folding mame-lyke style
-	if (GetPRGAddress(addr) != -1)
+	if (debugInstr.prgAddr != -1)
 	{
 		if(((logging_options & LOG_NEW_INSTRUCTIONS) && (oldcodecount != codecount)) ||
 		   ((logging_options & LOG_NEW_DATA) && (olddatacount != datacount)))
@@ -1031,6 +1032,7 @@ void EndLoggingSequence()
 		// ClearTraceLogBuf();
 	}
 	logging = 0;
+	FCEUI_SetTracing(0);
 	SetDlgItemText(hTracer, IDC_BTN_START_STOP_LOGGING,"Start Logging");
 }
 
@@ -43,6 +43,7 @@
 #include "file.h"
 #include "vsuni.h"
 #include "ines.h"
+#include "debug.h"
 #ifdef __WIN_DRIVER__
 #include "drivers/win/pref.h"
 #include "utils/xstring.h"
@@ -251,6 +252,14 @@ static readfunc *AReadG;
 static writefunc *BWriteG;
 static int RWWrap = 0;
 
+//the cpu core reads through AReadDirect[A >> 8][A] when that entry is set, instead of calling ARead[A].
+//an entry is only set while the whole 256 byte page uses one handler that does nothing but read
+//RAM or the mapped PRG (see UpdateReadDirect); registers, cheats, game genie and mapper
+//specific handlers keep their page NULL and go through ARead as before.
+uint8 *AReadDirect[0x100];
+static readfunc AReadPageFunc[0x100];	//handler shared by all addresses of a page, or NULL
+static void CheckReadPages(int32 start, int32 end);
+
 //mbg merge 7/18/06 docs
 //bit0 indicates whether emulation is paused
 //bit1 indicates whether emulation is in frame step mode
@@ -304,6 +313,7 @@ void FlushGenieRW(void) {
 		AReadG = NULL;
 		BWriteG = NULL;
 		RWWrap = 0;
+		CheckReadPages(0x8000, 0xFFFF);
 	}
 }
 
@@ -330,6 +340,8 @@ void SetReadHandler(int32 start, int32 end, readfunc func) {
 	else
 		for (x = end; x >= start; x--)
 			ARead[x] = func;
+
+	CheckReadPages(start, end);
 }
 
 writefunc GetWriteHandler(int32 a) {
@@ -390,6 +402,34 @@ static DECLFR(ARAMH) {
 	return RAM[A & 0x7FF];
 }
 
+void UpdateReadDirect(int32 start, int32 end) {
+	for (int32 p = start >> 8; p <= (end >> 8); p++) {
+		readfunc func = AReadPageFunc[p];
+		uint8 *ptr = NULL;
+
+		if (func == ARAML || func == ARAMH)
+			ptr = RAM + ((p << 8) & 0x7FF) - (p << 8);
+		else if ((func == CartBR || func == CartBROB) && Page[p >> 3])
+			ptr = Page[p >> 3];
+
+		AReadDirect[p] = ptr;
+	}
+}
+
+static void CheckReadPages(int32 start, int32 end) {
+	for (int32 p = start >> 8; p <= (end >> 8); p++) {
+		readfunc func = ARead[p << 8];
+
+		for (int32 x = (p << 8) + 1; x <= ((p << 8) | 0xFF); x++)
+			if (ARead[x] != func) {
+				func = NULL;
+				break;
+			}
+		AReadPageFunc[p] = func;
+	}
+	UpdateReadDirect(start, end);
+}
+
 
 void ResetGameLoaded(void) {
 	if (GameInfo) FCEU_CloseGame();
@@ -723,9 +763,47 @@ extern unsigned int frameAdvHoldTimer;
 ///Emulates a single frame.
 
 ///Skip may be passed in, if FRAMESKIP is #defined, to cause this to emulate more than one frame
+//Runs a frame from reading the joypads to the lua callbacks after it.  FCEUI_Emulate() and the
+//frames netplay rollback runs again both go through here, so they see the same input path.
+//Returns the number of sound samples, 0 when skip is 2.
+int FCEU_RunFrame(int skip) {
+	int ssize = 0;
+
+	FCEU_UpdateInput();
+	lagFlag = 1;
+
+#ifdef _S9XLUA_H
+	CallRegisteredLuaFunctions(LUACALL_BEFOREEMULATION);
+#endif
+
+	if (geniestage != 1) FCEU_ApplyPeriodicCheats();
+	FCEUPPU_Loop(skip);
+
+	if (skip != 2) ssize = FlushEmulateSound();  //If skip = 2 we are skipping sound processing
+
+#ifdef _S9XLUA_H
+	FCEU_LuaFlushDeferredMemHooks();
+	CallRegisteredLuaFunctions(LUACALL_AFTEREMULATION);
+#endif
+
+	return ssize;
+}
+
+//Ends a frame that FCEU_RunFrame() ran.
+void FCEU_EndFrame(void) {
+	timestampbase += timestamp;
+	timestamp = 0;
+	soundtimestamp = 0;
+
+	if (lagFlag) {
+		lagCounter++;
+		justLagged = true;
+	} else justLagged = false;
+}
+
 void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int skip) {
 	//skip initiates frame skip if 1, or frame skip and sound skip if 2
-	int r, ssize;
+	int ssize;
 
 	JustFrameAdvanced = false;
 
@@ -796,21 +874,10 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 	FCEU_LuaFrameBoundary();
 #endif
 
-	FCEU_UpdateInput();
-	lagFlag = 1;
-
-#ifdef _S9XLUA_H
-	CallRegisteredLuaFunctions(LUACALL_BEFOREEMULATION);
-#endif
-
-	if (geniestage != 1) FCEU_ApplyPeriodicCheats();
-	r = FCEUPPU_Loop(skip);
-
-	if (skip != 2) ssize = FlushEmulateSound();  //If skip = 2 we are skipping sound processing
+	//rollback netplay keeps the state from here, before the input of the frame
+	if (FCEUnetplay) NetplayFrameStart();
 
-#ifdef _S9XLUA_H
-	CallRegisteredLuaFunctions(LUACALL_AFTEREMULATION);
-#endif
+	ssize = FCEU_RunFrame(skip);
 
 	FCEU_PutImage();
 
@@ -834,9 +901,7 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 		exit(0);
 #endif
 
-	timestampbase += timestamp;
-	timestamp = 0;
-	soundtimestamp = 0;
+	FCEU_EndFrame();
 
 	*pXBuf = skip ? 0 : XBuf;
 	if (skip == 2) { //If skip = 2, then bypass sound
@@ -859,15 +924,64 @@ void FCEUI_Emulate(uint8 **pXBuf, int32 **SoundBuf, int32 *SoundBufSize, int ski
 		#endif
 	}
 
-	if (lagFlag) {
-		lagCounter++;
-		justLagged = true;
-	} else justLagged = false;
-
 	if (movieSubtitles)
 		ProcessSubtitles();
 }
 
+int FCEUI_EmulateFrames(FCEUI_FrameBatch *batch) {
+	extern uint8 joy[4];
+	int soundCount = 0;
+
+	batch->framesRun = 0;
+	batch->soundOutCount = 0;
+
+	if (!GameInfo)
+		return 0;
+
+	for (int frame = 0; frame < batch->frames; frame++) {
+		if (batch->input) {
+			uint32 input = batch->input[frame];
+			joy[0] = input;
+			joy[1] = input >> 8;
+			joy[2] = input >> 16;
+			joy[3] = input >> 24;
+		}
+		lagFlag = 1;
+
+		if (geniestage != 1) FCEU_ApplyPeriodicCheats();
+		FCEUPPU_Loop(0);
+
+		if (batch->soundOut) {
+			int ssize = FlushEmulateSound();
+			int room = batch->soundOutMax - soundCount;
+			if (ssize > room)
+				ssize = room;
+			if (ssize > 0) {
+				memcpy(batch->soundOut + soundCount, WaveFinal, ssize * sizeof(int32));
+				soundCount += ssize;
+			}
+		}
+
+		FCEU_EndFrame();
+
+		if (batch->ramOut) {
+			uint8 *out = batch->ramOut + frame * batch->ramAddrCount;
+			for (int i = 0; i < batch->ramAddrCount; i++) {
+				uint16 A = batch->ramAddrs[i];
+				uint8 *p = AReadDirect[A >> 8];
+				out[i] = p ? p[A] : GetMem(A);
+			}
+		}
+		batch->framesRun++;
+	}
+
+	if (batch->frameOut)
+		memcpy(batch->frameOut, XBuf, 256 * 240);
+	batch->soundOutCount = soundCount;
+
+	return batch->framesRun;
+}
+
 void FCEUI_CloseGame(void) {
 	if (!FCEU_IsValidUI(FCEUI_CLOSEGAME))
 		return;
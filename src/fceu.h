@@ -28,6 +28,7 @@ void SetReadHandler(int32 start, int32 end, readfunc func);
 void SetWriteHandler(int32 start, int32 end, writefunc func);
 writefunc GetWriteHandler(int32 a);
 readfunc GetReadHandler(int32 a);
+void UpdateReadDirect(int32 start, int32 end);
 
 int AllocGenieRW(void);
 void FlushGenieRW(void);
@@ -38,6 +39,9 @@ void ResetMapping(void);
 void ResetNES(void);
 void PowerNES(void);
 
+int FCEU_RunFrame(int skip);
+void FCEU_EndFrame(void);
+
 void SetAutoFireOffset(int offset);
 void SetAutoFirePattern(int onframes, int offframes);
 void GetAutoFirePattern( int *onframes, int *offframes);
@@ -80,6 +84,7 @@ void FCEU_WriteRomByte(uint32 i, uint8 value);
 
 extern readfunc ARead[0x10000];
 extern writefunc BWrite[0x10000];
+extern uint8 *AReadDirect[0x100];
 
 enum GI {
 	GI_RESETM2	=1,
@@ -28,6 +28,7 @@ enum LuaMemHookType
 	LUAMEMHOOK_COUNT
 };
 void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType);
+bool FCEU_LuaCPUHooksActive(); // true if the cpu core has to report writes and executed instructions
 
 struct LuaSaveData
 {
@@ -67,6 +68,7 @@ void CallRegisteredLuaLoadFunctions(int savestateNumber, const LuaSaveData& save
 // Just forward function declarations
 
 void FCEU_LuaFrameBoundary();
+void FCEU_LuaFlushDeferredMemHooks(); // passes the accesses matching deferred memory hooks to the script
 int FCEU_LoadLuaCode(const char *filename, const char *arg=NULL);
 void FCEU_ReloadLuaCode();
 void FCEU_LuaStop();
@@ -9,6 +9,7 @@
 #include "filter.h"
 
 #include "fcoeffs.h"
+#include "fir/firkernels.h"
 
 #include <cmath>
 #include <cstdio>
@@ -19,6 +20,8 @@ static int32 coeffs[NCOEFFS];
 static uint32 mrindex;
 static uint32 mrratio;
 
+static FirKernel firKernel = NULL;	//picked for this cpu by MakeFilters()
+
 void SexyFilter2(int32 *in, int32 count)
 {
  #ifdef moo
@@ -109,15 +112,9 @@ int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
 	if(FSettings.soundq==2)
         for(x=mrindex;x<max;x+=mrratio)
         {
-			int32 acc=0,acc2=0;
-			unsigned int c;
-			int32 *S,*D;
+			int32 acc,acc2;
 
-			for(c=SQ2NCOEFFS,S=&in[(x>>16)-SQ2NCOEFFS],D=sq2coeffs;c;c--,D++)
-			{
-				acc+=(S[c]**D)>>6;
-				acc2+=(S[1+c]**D)>>6;
-			}
+			firKernel(&in[(x>>16)-SQ2NCOEFFS],sq2coeffs,SQ2NCOEFFS,&acc,&acc2);
 
 			acc=((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
 			*out=acc;
@@ -127,15 +124,9 @@ int32 NeoFilterSound(int32 *in, int32 *out, uint32 inlen, int32 *leftover)
 	else
 		for(x=mrindex;x<max;x+=mrratio)
 		{
-			int32 acc=0,acc2=0;
-			unsigned int c;
-			const int32 *S,*D;
+			int32 acc,acc2;
 
-			for(c=NCOEFFS,S=&in[(x>>16)-NCOEFFS],D=coeffs;c;c--,D++)
-			{
-				acc+=(S[c]**D)>>6;
-				acc2+=(S[1+c]**D)>>6;
-			}
+			firKernel(&in[(x>>16)-NCOEFFS],coeffs,NCOEFFS,&acc,&acc2);
 
 			acc=((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
 			*out=acc;
@@ -176,6 +167,14 @@ void MakeFilters(int32 rate)
  int32 x;
  uint32 nco;
 
+ if(!firKernel)
+ {
+  FirKernelInfo kernels[FIR_MAX_KERNELS];
+
+  FirGetKernels(kernels);
+  firKernel=kernels[0].func;
+ }
+
  if(FSettings.soundq==2)
   nco=SQ2NCOEFFS;
  else
@@ -0,0 +1,106 @@
+// firbench - checks the NeoFilterSound() kernels against the scalar one and
+// reports how many output samples per second each of them produces.
+//
+// Build with "make firbench" in this directory, run "./firbench [seconds]".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+typedef int32_t int32;
+typedef int64_t int64;
+
+#include "../fcoeffs.h"
+#include "firkernels.h"
+
+#define NTSC_CPU 1789772.7272727272727272
+
+// the output loop of NeoFilterSound()
+static size_t resample(FirKernel kernel, const int32 *in, uint32_t inlen, const int32 *coef, unsigned int n, uint32_t ratio, int32 *out)
+{
+	uint32_t max = (inlen-1)<<16;
+	size_t count = 0;
+
+	for (uint32_t x = (n+1)<<16; x < max; x += ratio)
+	{
+		int32 acc, acc2;
+
+		kernel(&in[(x>>16)-n], coef, n, &acc, &acc2);
+
+		out[count++] = ((int64)acc*(65536-(x&65535))+(int64)acc2*(x&65535))>>(16+11);
+	}
+	return count;
+}
+
+int main(int argc, char *argv[])
+{
+	static const struct
+	{
+		int rate;
+		const int32 *tab;
+		const int32 *sq2tab;
+	} rates[] = {
+		{ 44100, C44100NTSC, SQ2C44100NTSC },
+		{ 48000, C48000NTSC, SQ2C48000NTSC },
+		{ 96000, C96000NTSC, SQ2C96000NTSC },
+	};
+	FirKernelInfo kernels[FIR_MAX_KERNELS];
+	int numKernels = FirGetKernels(kernels);
+	double seconds = (argc > 1) ? atof(argv[1]) : 2.0;
+	int errors = 0;
+
+	uint32_t inlen = (uint32_t)(NTSC_CPU * seconds);
+	std::vector<int32> in(inlen);
+
+	srand(1);
+	for (uint32_t i = 0; i < inlen; i++)
+	{
+		// WaveHi holds 16 bit sample values after the wlookup pass
+		in[i] = rand() & 0xFFFF;
+	}
+
+	for (size_t r = 0; r < sizeof(rates)/sizeof(rates[0]); r++)
+	{
+		for (int quality = 1; quality <= 2; quality++)
+		{
+			unsigned int n = (quality == 2) ? SQ2NCOEFFS : NCOEFFS;
+			const int32 *tab = (quality == 2) ? rates[r].sq2tab : rates[r].tab;
+			uint32_t ratio = (uint32_t)((int64)(NTSC_CPU*65536)/rates[r].rate);
+			std::vector<int32> coef(n), ref(inlen), out(inlen);
+			size_t refCount = 0;
+
+			// same layout as MakeFilters()
+			for (unsigned int x = 0; x < n/2; x++)
+			{
+				coef[x] = coef[n-1-x] = tab[x];
+			}
+
+			for (int k = numKernels-1; k >= 0; k--)
+			{
+				auto t0 = std::chrono::steady_clock::now();
+				size_t count = resample(kernels[k].func, &in[0], inlen, &coef[0], n, ratio, &out[0]);
+				auto t1 = std::chrono::steady_clock::now();
+				double dt = std::chrono::duration<double>(t1 - t0).count();
+				const char *result = "";
+
+				if (kernels[k].func == FirScalar)
+				{
+					ref = out;
+					refCount = count;
+				}
+				else if ((count != refCount) || memcmp(&out[0], &ref[0], count*sizeof(int32)))
+				{
+					result = "  MISMATCH";
+					errors++;
+				}
+				printf("%5i Hz  %-9s  %-6s  %12.0f samples/sec  %6.2fx realtime%s\n",
+					rates[r].rate, (quality == 2) ? "very high" : "high", kernels[k].name,
+					count/dt, count/dt/rates[r].rate, result);
+			}
+		}
+	}
+	return errors ? 1 : 0;
+}
@@ -0,0 +1,176 @@
+/// \file
+/// \brief FIR kernels for NeoFilterSound()
+///
+/// Every kernel computes the same two dot products as the original scalar
+/// loop in filter.cpp, for the windows starting at S+1 and S+2:
+///
+///   acc  += (S[c]   * D[n-c]) >> 6
+///   acc2 += (S[1+c] * D[n-c]) >> 6     for c = n..1
+///
+/// The tables built by MakeFilters() are symmetric (D[k] == D[n-1-k]), so the
+/// vector kernels walk S and D forwards with one coefficient load feeding both
+/// sums. Products are shifted before they are added and all sums wrap like
+/// the scalar int32 code, so the order of the additions doesn't matter and the
+/// results are bit identical.
+
+#ifndef _FIRKERNELS_H
+#define _FIRKERNELS_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define FIR_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FIR_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FIR_NEON
+#include <arm_neon.h>
+#endif
+
+typedef void (*FirKernel)(const int32 *S, const int32 *D, unsigned int n, int32 *pacc, int32 *pacc2);
+
+static void FirScalar(const int32 *S, const int32 *D, unsigned int n, int32 *pacc, int32 *pacc2)
+{
+	int32 acc=0,acc2=0;
+	unsigned int c;
+
+	for(c=n;c;c--,D++)
+	{
+		acc+=(S[c]**D)>>6;
+		acc2+=(S[1+c]**D)>>6;
+	}
+	*pacc=acc;
+	*pacc2=acc2;
+}
+
+//the last n%width taps of the vector kernels
+static inline void FirTail(const int32 *S, const int32 *D, unsigned int j, unsigned int n, int32 *pacc, int32 *pacc2)
+{
+	int32 acc=*pacc,acc2=*pacc2;
+
+	for(;j<n;j++)
+	{
+		acc+=(S[1+j]*D[j])>>6;
+		acc2+=(S[2+j]*D[j])>>6;
+	}
+	*pacc=acc;
+	*pacc2=acc2;
+}
+
+#ifdef FIR_SSE2
+//low 32 bits of the lane products, SSE2 has no pmulld
+static inline __m128i FirMul32(__m128i a, __m128i b)
+{
+	__m128i even=_mm_mul_epu32(a,b);
+	__m128i odd=_mm_mul_epu32(_mm_srli_epi64(a,32),_mm_srli_epi64(b,32));
+
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even,_MM_SHUFFLE(0,0,2,0)),
+	                          _mm_shuffle_epi32(odd,_MM_SHUFFLE(0,0,2,0)));
+}
+
+static inline int32 FirSum128(__m128i v)
+{
+	v=_mm_add_epi32(v,_mm_shuffle_epi32(v,_MM_SHUFFLE(1,0,3,2)));
+	v=_mm_add_epi32(v,_mm_shuffle_epi32(v,_MM_SHUFFLE(2,3,0,1)));
+	return _mm_cvtsi128_si32(v);
+}
+
+static void FirSSE2(const int32 *S, const int32 *D, unsigned int n, int32 *pacc, int32 *pacc2)
+{
+	__m128i acc=_mm_setzero_si128(),acc2=_mm_setzero_si128();
+	unsigned int j;
+
+	for(j=0;j+4<=n;j+=4)
+	{
+		__m128i d=_mm_loadu_si128((const __m128i*)(D+j));
+
+		acc=_mm_add_epi32(acc,_mm_srai_epi32(FirMul32(_mm_loadu_si128((const __m128i*)(S+1+j)),d),6));
+		acc2=_mm_add_epi32(acc2,_mm_srai_epi32(FirMul32(_mm_loadu_si128((const __m128i*)(S+2+j)),d),6));
+	}
+	*pacc=FirSum128(acc);
+	*pacc2=FirSum128(acc2);
+	FirTail(S,D,j,n,pacc,pacc2);
+}
+#endif
+
+#ifdef FIR_AVX2
+__attribute__((target("avx2")))
+static void FirAVX2(const int32 *S, const int32 *D, unsigned int n, int32 *pacc, int32 *pacc2)
+{
+	__m256i acc=_mm256_setzero_si256(),acc2=_mm256_setzero_si256();
+	unsigned int j;
+
+	for(j=0;j+8<=n;j+=8)
+	{
+		__m256i d=_mm256_loadu_si256((const __m256i*)(D+j));
+
+		acc=_mm256_add_epi32(acc,_mm256_srai_epi32(_mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(S+1+j)),d),6));
+		acc2=_mm256_add_epi32(acc2,_mm256_srai_epi32(_mm256_mullo_epi32(_mm256_loadu_si256((const __m256i*)(S+2+j)),d),6));
+	}
+	__m128i a=_mm_add_epi32(_mm256_castsi256_si128(acc),_mm256_extracti128_si256(acc,1));
+	__m128i a2=_mm_add_epi32(_mm256_castsi256_si128(acc2),_mm256_extracti128_si256(acc2,1));
+
+	a=_mm_add_epi32(a,_mm_shuffle_epi32(a,_MM_SHUFFLE(1,0,3,2)));
+	a=_mm_add_epi32(a,_mm_shuffle_epi32(a,_MM_SHUFFLE(2,3,0,1)));
+	a2=_mm_add_epi32(a2,_mm_shuffle_epi32(a2,_MM_SHUFFLE(1,0,3,2)));
+	a2=_mm_add_epi32(a2,_mm_shuffle_epi32(a2,_MM_SHUFFLE(2,3,0,1)));
+	*pacc=_mm_cvtsi128_si32(a);
+	*pacc2=_mm_cvtsi128_si32(a2);
+	FirTail(S,D,j,n,pacc,pacc2);
+}
+#endif
+
+#ifdef FIR_NEON
+static void FirNEON(const int32 *S, const int32 *D, unsigned int n, int32 *pacc, int32 *pacc2)
+{
+	int32x4_t acc=vdupq_n_s32(0),acc2=vdupq_n_s32(0);
+	unsigned int j;
+
+	for(j=0;j+4<=n;j+=4)
+	{
+		int32x4_t d=vld1q_s32(D+j);
+
+		acc=vaddq_s32(acc,vshrq_n_s32(vmulq_s32(vld1q_s32(S+1+j),d),6));
+		acc2=vaddq_s32(acc2,vshrq_n_s32(vmulq_s32(vld1q_s32(S+2+j),d),6));
+	}
+	*pacc=vgetq_lane_s32(acc,0)+vgetq_lane_s32(acc,1)+vgetq_lane_s32(acc,2)+vgetq_lane_s32(acc,3);
+	*pacc2=vgetq_lane_s32(acc2,0)+vgetq_lane_s32(acc2,1)+vgetq_lane_s32(acc2,2)+vgetq_lane_s32(acc2,3);
+	FirTail(S,D,j,n,pacc,pacc2);
+}
+#endif
+
+//the kernels this build and cpu can run, fastest first, FirScalar last
+struct FirKernelInfo
+{
+	const char *name;
+	FirKernel func;
+};
+
+static int FirGetKernels(FirKernelInfo *list)
+{
+	int count=0;
+
+	#ifdef FIR_AVX2
+	if(__builtin_cpu_supports("avx2"))
+	{
+		list[count].name="AVX2";
+		list[count++].func=FirAVX2;
+	}
+	#endif
+	#ifdef FIR_SSE2
+	list[count].name="SSE2";
+	list[count++].func=FirSSE2;
+	#endif
+	#ifdef FIR_NEON
+	list[count].name="NEON";
+	list[count++].func=FirNEON;
+	#endif
+	list[count].name="scalar";
+	list[count++].func=FirScalar;
+	return count;
+}
+
+#define FIR_MAX_KERNELS 4
+
+#endif
@@ -41,6 +41,8 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 extern SFORMAT FCEUVSUNI_STATEINFO[];
 
@@ -129,6 +131,36 @@ void iNESGI(GI h) { //bbit edited: removed static keyword
 
 uint32 iNESGameCRC32 = 0;
 
+//The game tables below stay in the order they were written in, and the first entry for a
+//checksum is the one that counts.  A TableIndex sorts pointers to the entries the first time a
+//table is searched, so every load after that is a binary search instead of a walk of the table.
+template<typename T, typename K, K (*Key)(const T &)>
+class TableIndex
+{
+	std::vector<const T *> entries;
+
+	static bool Less(const T *a, const T *b) { return Key(*a) < Key(*b); }
+	static bool LessKey(const T *a, K k) { return Key(*a) < k; }
+
+public:
+	TableIndex(const T *table, size_t count)
+	{
+		entries.reserve(count);
+		for (size_t x = 0; x < count; x++)
+			entries.push_back(&table[x]);
+		std::stable_sort(entries.begin(), entries.end(), Less);
+	}
+
+	//the first entry with the key in table order, NULL if there's none
+	const T *Find(K k) const
+	{
+		typename std::vector<const T *>::const_iterator it = std::lower_bound(entries.begin(), entries.end(), k, LessKey);
+		if (it == entries.end() || Key(**it) != k)
+			return NULL;
+		return *it;
+	}
+};
+
 struct CRCMATCH {
 	uint32 crc;
 	char *name;
@@ -141,6 +173,8 @@ struct INPSEL {
 	ESIFC inputfc;
 };
 
+static uint32 INPSELKey(const INPSEL &e) { return e.crc32; }
+
 static void SetInput(void) {
 	static struct INPSEL moo[] =
 	{
@@ -215,16 +249,13 @@ static void SetInput(void) {
 		{0x67b126b9,	SI_GAMEPAD,		SI_GAMEPAD,		SIFC_FAMINETSYS },	// Famicom Network System
 		{0x00000000,	SI_UNSET,		SI_UNSET,		SIFC_UNSET		}
 	};
-	int x = 0;
-
-	while (moo[x].input1 >= 0 || moo[x].input2 >= 0 || moo[x].inputfc >= 0) {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			GameInfo->input[0] = moo[x].input1;
-			GameInfo->input[1] = moo[x].input2;
-			GameInfo->inputfc = moo[x].inputfc;
-			break;
-		}
-		x++;
+	static const TableIndex<INPSEL, uint32, INPSELKey> index(moo, ARRAY_SIZE(moo) - 1);
+	const INPSEL *inp = index.Find(iNESGameCRC32);
+
+	if (inp) {
+		GameInfo->input[0] = inp->input1;
+		GameInfo->input[1] = inp->input2;
+		GameInfo->inputfc = inp->inputfc;
 	}
 }
 
@@ -243,15 +274,17 @@ static struct BADINF BadROMImages[] =
 	#include "ines-bad.h"
 };
 
+static uint64 BADINFKey(const BADINF &e) { return e.md5partial; }
+
+static const BADINF *FindBad(uint64 md5partial) {
+	static const TableIndex<BADINF, uint64, BADINFKey> index(BadROMImages, ARRAY_SIZE(BadROMImages) - 1);
+	return index.Find(md5partial);
+}
+
 void CheckBad(uint64 md5partial) {
-	int32 x = 0;
-	while (BadROMImages[x].name) {
-		if (BadROMImages[x].md5partial == md5partial) {
-			FCEU_PrintError("The copy game you have loaded, \"%s\", is bad, and will not work properly in FCEUX.", BadROMImages[x].name);
-			return;
-		}
-		x++;
-	}
+	const BADINF *bad = FindBad(md5partial);
+	if (bad)
+		FCEU_PrintError("The copy game you have loaded, \"%s\", is bad, and will not work properly in FCEUX.", bad->name);
 }
 
 
@@ -262,6 +295,10 @@ struct CHINF {
 	const char* params;
 };
 
+static uint32 CHINFKey(const CHINF &e) { return e.crc32; }
+static uint64 MasterRomInfoKey(const TMasterRomInfo &e) { return e.md5lower; }
+static uint64 SavieKey(const uint64 &e) { return e; }
+
 static const TMasterRomInfo sMasterRomInfo[] = {
 	{ 0x62b51b108a01d2beULL, "bonus=0" }, //4-in-1 (FK23C8021)[p1][!].nes
 	{ 0x8bb48490d8d22711ULL, "bonus=0" }, //4-in-1 (FK23C8033)[p1][!].nes
@@ -276,7 +313,14 @@ static const TMasterRomInfo sMasterRomInfo[] = {
 const TMasterRomInfo* MasterRomInfo;
 TMasterRomInfoParams MasterRomInfoParams;
 
-static void CheckHInfo(void) {
+#define INESFIX_MAPPER   1
+#define INESFIX_MIRROR   2
+#define INESFIX_BATTERY  4
+#define INESFIX_NOCHR    8
+
+//Corrects the mapper number, mirroring, battery bit and CHR ROM size read from the header of the
+//game with these checksums.  Returns the INESFIX_* bits of the header fields that were wrong.
+static int CorrectHeader(uint32 crc32, uint64 partialmd5, int *mapper, uint8 *mirroring, uint8 *romtype, uint32 *chrsize) {
 	/* ROM images that have the battery-backed bit set in the header that really
 	don't have battery-backed RAM is not that big of a problem, so I'll
 	treat this differently by only listing games that should have battery-backed RAM.
@@ -326,105 +370,102 @@ static void CheckHInfo(void) {
 	{
 		#include "ines-correct.h"
 	};
-	int32 tofix = 0, x, mask;
-	uint64 partialmd5 = 0;
-
-	for (x = 0; x < 8; x++)
-		partialmd5 |= (uint64)iNESCart.MD5[15 - x] << (x * 8);
-	CheckBad(partialmd5);
-
-	MasterRomInfo = NULL;
-	for (int i = 0; i < ARRAY_SIZE(sMasterRomInfo); i++) {
-		const TMasterRomInfo& info = sMasterRomInfo[i];
-		if (info.md5lower != partialmd5)
-			continue;
-
-		MasterRomInfo = &info;
-		if (!info.params) break;
-
-		std::vector<std::string> toks = tokenize_str(info.params, ",");
-		for (int j = 0; j < (int)toks.size(); j++) {
-			std::vector<std::string> parts = tokenize_str(toks[j], "=");
-			MasterRomInfoParams[parts[0]] = parts[1];
-		}
-		break;
-	}
-
-	x = 0;
-	do {
-		if (moo[x].crc32 == iNESGameCRC32) {
-			if (moo[x].mapper >= 0) {
-				if (moo[x].mapper & 0x800 && VROM_size) {
-					VROM_size = 0;
-					free(VROM);
-					VROM = NULL;
-					tofix |= 8;
-				}
-				if (moo[x].mapper & 0x1000)
-					mask = 0xFFF;
-				else
-					mask = 0xFF;
-				if (MapperNo != (moo[x].mapper & mask)) {
-					tofix |= 1;
-					MapperNo = moo[x].mapper & mask;
-				}
+	static const TableIndex<CHINF, uint32, CHINFKey> mooIndex(moo, ARRAY_SIZE(moo) - 1);
+	static const TableIndex<uint64, uint64, SavieKey> savieIndex(savie, ARRAY_SIZE(savie) - 1);
+	const CHINF *fix = mooIndex.Find(crc32);
+	int32 tofix = 0, mask;
+
+	if (fix) {
+		if (fix->mapper >= 0) {
+			if (fix->mapper & 0x800 && *chrsize) {
+				*chrsize = 0;
+				tofix |= INESFIX_NOCHR;
 			}
-			if (moo[x].mirror >= 0) {
-				if (moo[x].mirror == 8) {
-					if (Mirroring == 2) {	/* Anything but hard-wired(four screen). */
-						tofix |= 2;
-						Mirroring = 0;
-					}
-				} else if (Mirroring != moo[x].mirror) {
-					if (Mirroring != (moo[x].mirror & ~4))
-						if ((moo[x].mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
-														needs to be set(the iNES header can't
-														hold this information).
-														*/
-							tofix |= 2;
-					Mirroring = moo[x].mirror;
-				}
+			if (fix->mapper & 0x1000)
+				mask = 0xFFF;
+			else
+				mask = 0xFF;
+			if (*mapper != (fix->mapper & mask)) {
+				tofix |= INESFIX_MAPPER;
+				*mapper = fix->mapper & mask;
 			}
-			break;
 		}
-		x++;
-	} while (moo[x].mirror >= 0 || moo[x].mapper >= 0);
-
-	x = 0;
-	while (savie[x] != 0) {
-		if (savie[x] == partialmd5) {
-			if (!(head.ROM_type & 2)) {
-				tofix |= 4;
-				head.ROM_type |= 2;
+		if (fix->mirror >= 0) {
+			if (fix->mirror == 8) {
+				if (*mirroring == 2) {	/* Anything but hard-wired(four screen). */
+					tofix |= INESFIX_MIRROR;
+					*mirroring = 0;
+				}
+			} else if (*mirroring != fix->mirror) {
+				if (*mirroring != (fix->mirror & ~4))
+					if ((fix->mirror & ~4) <= 2)	/* Don't complain if one-screen mirroring
+													needs to be set(the iNES header can't
+													hold this information).
+													*/
+						tofix |= INESFIX_MIRROR;
+				*mirroring = fix->mirror;
 			}
 		}
-		x++;
+	}
+
+	if (savieIndex.Find(partialmd5)) {
+		if (!(*romtype & 2)) {
+			tofix |= INESFIX_BATTERY;
+			*romtype |= 2;
+		}
 	}
 
 	/* Games that use these iNES mappers tend to have the four-screen bit set
 	when it should not be.
 	*/
-	if ((MapperNo == 118 || MapperNo == 24 || MapperNo == 26) && (Mirroring == 2)) {
-		Mirroring = 0;
-		tofix |= 2;
+	if ((*mapper == 118 || *mapper == 24 || *mapper == 26) && (*mirroring == 2)) {
+		*mirroring = 0;
+		tofix |= INESFIX_MIRROR;
 	}
 
 	/* Four-screen mirroring implicitly set. */
-	if (MapperNo == 99)
-		Mirroring = 2;
+	if (*mapper == 99)
+		*mirroring = 2;
+
+	return tofix;
+}
+
+static void CheckHInfo(void) {
+	static const TableIndex<TMasterRomInfo, uint64, MasterRomInfoKey> masterIndex(sMasterRomInfo, ARRAY_SIZE(sMasterRomInfo));
+	int32 tofix, x;
+	uint64 partialmd5 = 0;
+
+	for (x = 0; x < 8; x++)
+		partialmd5 |= (uint64)iNESCart.MD5[15 - x] << (x * 8);
+	CheckBad(partialmd5);
+
+	MasterRomInfo = masterIndex.Find(partialmd5);
+	if (MasterRomInfo && MasterRomInfo->params) {
+		std::vector<std::string> toks = tokenize_str(MasterRomInfo->params, ",");
+		for (int j = 0; j < (int)toks.size(); j++) {
+			std::vector<std::string> parts = tokenize_str(toks[j], "=");
+			MasterRomInfoParams[parts[0]] = parts[1];
+		}
+	}
+
+	tofix = CorrectHeader(iNESGameCRC32, partialmd5, &MapperNo, &Mirroring, &head.ROM_type, &VROM_size);
+	if (tofix & INESFIX_NOCHR) {
+		free(VROM);
+		VROM = NULL;
+	}
 
 	if (tofix) {
 		char gigastr[768];
 		strcpy(gigastr, "The iNES header contains incorrect information.  For now, the information will be corrected in RAM.  ");
-		if (tofix & 1)
+		if (tofix & INESFIX_MAPPER)
 			sprintf(gigastr + strlen(gigastr), "The mapper number should be set to %d.  ", MapperNo);
-		if (tofix & 2) {
+		if (tofix & INESFIX_MIRROR) {
 			const char *mstr[3] = { "Horizontal", "Vertical", "Four-screen" };
 			sprintf(gigastr + strlen(gigastr), "Mirroring should be set to \"%s\".  ", mstr[Mirroring & 3]);
 		}
-		if (tofix & 4)
+		if (tofix & INESFIX_BATTERY)
 			strcat(gigastr, "The battery-backed bit should be set.  ");
-		if (tofix & 8)
+		if (tofix & INESFIX_NOCHR)
 			strcat(gigastr, "This game should not have any CHR ROM.  ");
 		strcat(gigastr, "\n");
 		FCEU_printf("%s", gigastr);
@@ -736,6 +777,68 @@ BMAPPINGLocal bmap[] = {
 	{"",					0, NULL}
 };
 
+static int32 BMAPPINGLocalKey(const BMAPPINGLocal &e) { return e.number; }
+
+static const BMAPPINGLocal *FindMapper(int32 num) {
+	static const TableIndex<BMAPPINGLocal, int32, BMAPPINGLocalKey> index(bmap, ARRAY_SIZE(bmap) - 1);
+	return index.Find(num);
+}
+
+//Gets the PRG ROM size in 16 KiB banks rounded up to a power of 2, the CHR ROM size in 8 KiB
+//banks and the number of PRG banks the file really has from a header.  Returns false when the
+//mapper takes PRG ROM sizes that aren't a power of 2, then only prgread banks should be read.
+static bool GetROMSizes(const iNES_HEADER *h, int mapper, uint32 *prg, uint32 *chr, uint32 *prgread) {
+	bool ines2 = ((h->ROM_type2 & 0x0C) == 0x08);
+
+	if (!ines2)	{
+		*prgread = h->ROM_size;
+	}
+	else {
+		if ((h->Upper_ROM_VROM_size & 0x0F) != 0x0F)
+			// simple notation
+			*prgread = h->ROM_size | ((h->Upper_ROM_VROM_size & 0x0F) << 8);
+		else
+			// exponent-multiplier notation
+			*prgread = ((1 << (h->ROM_size >> 2)) * ((h->ROM_size & 0b11) * 2 + 1)) >> 14;
+	}
+
+	if (!h->ROM_size && !ines2)
+		*prg = 256;
+	else
+		*prg = uppow2(*prgread);
+
+	if (!ines2)	{
+		*chr = h->VROM_size;
+	}
+	else {
+		if ((h->Upper_ROM_VROM_size & 0xF0) != 0xF0)
+			// simple notation
+			*chr = uppow2(h->VROM_size | ((h->Upper_ROM_VROM_size & 0xF0) << 4));
+		else
+			*chr = ((1 << (h->VROM_size >> 2)) * ((h->VROM_size & 0b11) * 2 + 1)) >> 13;
+	}
+
+	for (int i = 0; i != sizeof(not_power2) / sizeof(not_power2[0]); ++i) {
+		//for games not to the power of 2, so we just read enough
+		//prg rom from it, but we have to keep ROM_size to the power of 2
+		//since PRGCartMapping wants ROM_size to be to the power of 2
+		//so instead if not to power of 2, we just use head.ROM_size when
+		//we use FCEU_read
+		if (not_power2[i] == mapper)
+			return false;
+	}
+	return true;
+}
+
+//PAL or NTSC can't be told from an iNES 1 header, so it's guessed from the file name
+static bool IsPALName(const char *name) {
+	return strstr(name, "(E)") || strstr(name, "(e)")
+		|| strstr(name, "(Europe)") || strstr(name, "(PAL)")
+		|| strstr(name, "(F)") || strstr(name, "(f)")
+		|| strstr(name, "(G)") || strstr(name, "(g)")
+		|| strstr(name, "(I)") || strstr(name, "(i)");
+}
+
 int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	struct md5_context md5;
 
@@ -766,48 +869,8 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	} else
 		Mirroring = (head.ROM_type & 1);
 
-	int not_round_size;
-	if (!iNES2)	{
-		not_round_size = head.ROM_size;
-	}
-	else {
-		if ((head.Upper_ROM_VROM_size & 0x0F) != 0x0F)
-			// simple notation
-			not_round_size = head.ROM_size | ((head.Upper_ROM_VROM_size & 0x0F) << 8);
-		else
-			// exponent-multiplier notation
-			not_round_size = ((1 << (head.ROM_size >> 2)) * ((head.ROM_size & 0b11) * 2 + 1)) >> 14;
-	}
-	
-	if (!head.ROM_size && !iNES2)
-		ROM_size = 256;
-	else
-		ROM_size = uppow2(not_round_size);
-
-	VROM_size = uppow2(head.VROM_size | (iNES2?((head.Upper_ROM_VROM_size & 0xF0)<<4):0));
-	if (!iNES2)	{
-		VROM_size = head.VROM_size;
-	}
-	else {
-		if ((head.Upper_ROM_VROM_size & 0xF0) != 0xF0)
-			// simple notation
-			VROM_size = uppow2(head.VROM_size | ((head.Upper_ROM_VROM_size & 0xF0) << 4));
-		else
-			VROM_size = ((1 << (head.VROM_size >> 2)) * ((head.VROM_size & 0b11) * 2 + 1)) >> 13;
-	}
-
-	int round = true;
-	for (int i = 0; i != sizeof(not_power2) / sizeof(not_power2[0]); ++i) {
-		//for games not to the power of 2, so we just read enough
-		//prg rom from it, but we have to keep ROM_size to the power of 2
-		//since PRGCartMapping wants ROM_size to be to the power of 2
-		//so instead if not to power of 2, we just use head.ROM_size when
-		//we use FCEU_read
-		if (not_power2[i] == MapperNo) {
-			round = false;
-			break;
-		}
-	}
+	uint32 not_round_size;
+	bool round = GetROMSizes(&head, MapperNo, &ROM_size, &VROM_size, &not_round_size);
 
 	if ((ROM = (uint8*)FCEU_malloc(ROM_size << 14)) == NULL)
 		return 0;
@@ -864,13 +927,10 @@ int iNESLoad(const char *name, FCEUFILE *fp, int OverwriteVidMode) {
 	}
 
 	const char* mappername = "Not Listed";
+	const BMAPPINGLocal *mapper = FindMapper(MapperNo);
 
-	for (int mappertest = 0; mappertest < (sizeof bmap / sizeof bmap[0]) - 1; mappertest++) {
-		if (bmap[mappertest].number == MapperNo) {
-			mappername = bmap[mappertest].name;
-			break;
-		}
-	}
+	if (mapper)
+		mappername = mapper->name;
 
 	FCEU_printf(" Mapper #: %d\n", MapperNo);
 	FCEU_printf(" Mapper name: %s\n", mappername);
@@ -965,14 +1025,7 @@ init_ok:
 	if (iNES2) {
 		FCEUI_SetVidSystem(((head.TV_system & 3) == 1) ? 1 : 0);
 	} else if (OverwriteVidMode) {
-		if (strstr(name, "(E)") || strstr(name, "(e)")
-			|| strstr(name, "(Europe)") || strstr(name, "(PAL)")
-			|| strstr(name, "(F)") || strstr(name, "(f)")
-			|| strstr(name, "(G)") || strstr(name, "(g)")
-			|| strstr(name, "(I)") || strstr(name, "(i)"))
-			FCEUI_SetVidSystem(1);
-		else
-			FCEUI_SetVidSystem(0);
+		FCEUI_SetVidSystem(IsPALName(name) ? 1 : 0);
 	}
 	return LOADER_OK;
 }
@@ -1035,61 +1088,213 @@ char *iNesShortFName(void) {
 	return ret + 1;
 }
 
+//Writes the CSV line of one file for FCEUI_ValidateRomSet.  Only the header and the ROM data are
+//read, the header goes through the same corrections as iNESLoad but nothing is set up.
+static void ValidateRom(const char *path, FILE *csv, std::vector<uint8> &data) {
+	static const char *tvsystem[4] = { "NTSC", "PAL", "multi", "Dendy" };
+	static const char hexdigits[] = "0123456789abcdef";
+	FCEUFILE *fp = FCEU_fopen(path, NULL, "rb", 0);
+	const char *status = "ok";
+	iNES_HEADER h;
+
+	fputc('"', csv);
+	for (const char *c = path; *c; c++) {
+		if (*c == '"')
+			fputc('"', csv);
+		fputc(*c, csv);
+	}
+	fputc('"', csv);
+
+	if (!fp) {
+		fprintf(csv, ",unreadable\n");
+		return;
+	}
+	if (FCEU_fread(&h, 1, 16, fp) != 16 || memcmp(&h, "NES\x1A", 4)) {
+		FCEU_fclose(fp);
+		fprintf(csv, ",not ines\n");
+		return;
+	}
+	h.cleanup();
+
+	bool ines2 = ((h.ROM_type2 & 0x0C) == 0x08);
+	int mapper = (h.ROM_type >> 4) | (h.ROM_type2 & 0xF0);
+	if (ines2) mapper |= ((h.ROM_type3 & 0x0F) << 8);
+	uint8 mirroring = (h.ROM_type & 8) ? 2 : (h.ROM_type & 1);
+	uint8 romtype = h.ROM_type;
+	uint32 prg, chr, prgread;
+	bool truncated = false;
+
+	//NES 2.0 exponent-multiplier sizes that big don't fit in GetROMSizes' math, nor in any file
+	if (ines2 && ((((h.Upper_ROM_VROM_size & 0x0F) == 0x0F) && (h.ROM_size >> 2) > 28) ||
+		(((h.Upper_ROM_VROM_size & 0xF0) == 0xF0) && (h.VROM_size >> 2) > 28))) {
+		FCEU_fclose(fp);
+		fprintf(csv, ",bad header\n");
+		return;
+	}
+
+	bool round = GetROMSizes(&h, mapper, &prg, &chr, &prgread);
+	uint64 trainer = (h.ROM_type & 4) ? 512 : 0;
+	uint64 prgbytes = (uint64)(round ? prg : prgread) << 14;
+	uint64 chrbytes = (uint64)chr << 13;
+
+	//the sizes come from the header, check them against the file before making room for them
+	if (!prg || !prgbytes) {
+		FCEU_fclose(fp);
+		fprintf(csv, ",bad header\n");
+		return;
+	}
+	if (16 + trainer + prgbytes + chrbytes > FCEU_fgetsize(fp)) {
+		FCEU_fclose(fp);
+		fprintf(csv, ",truncated\n");
+		return;
+	}
+
+	if (trainer)
+		FCEU_fseek(fp, 512, SEEK_CUR);
+
+	//read and hashed like iNESLoad does it, the PRG ROM is padded with 0xFF to a power of 2
+	data.assign(((size_t)prg << 14) + chrbytes, 0xFF);
+	if (FCEU_fread(&data[0], 0x4000, round ? prg : prgread, fp) != prgbytes)
+		truncated = true;
+	if (chr && FCEU_fread(&data[(size_t)prg << 14], 0x2000, chr, fp) != chrbytes)
+		truncated = true;
+	FCEU_fclose(fp);
+
+	uint32 crc32 = CalcCRC32(0, &data[0], data.size());
+	struct md5_context md5;
+	uint8 digest[16];
+	uint64 partialmd5 = 0;
+
+	md5_starts(&md5);
+	md5_update(&md5, &data[0], data.size());
+	md5_finish(&md5, digest);
+	for (int x = 0; x < 8; x++)
+		partialmd5 |= (uint64)digest[15 - x] << (x * 8);
+
+	int tofix = CorrectHeader(crc32, partialmd5, &mapper, &mirroring, &romtype, &chr);
+	const BMAPPINGLocal *board = FindMapper(mapper);
+	const BADINF *bad = FindBad(partialmd5);
+	const char *region;
+
+	if (ines2) {
+		region = tvsystem[h.TV_system & 3];
+	} else {
+		const char *name = strrchr(path, '/');
+		const char *name2 = strrchr(path, '\\');
+		if (!name || (name2 && name2 > name))
+			name = name2;
+		region = IsPALName(name ? name + 1 : path) ? "PAL" : "NTSC";
+	}
+
+	if (bad)
+		status = "bad";
+	else if (!board)
+		status = "unsupported";
+	else if (truncated)
+		status = "truncated";
+	else if (tofix)
+		status = "corrected";
+
+	char md5str[33];
+	for (int x = 0; x < 16; x++) {
+		md5str[x * 2] = hexdigits[digest[x] >> 4];
+		md5str[x * 2 + 1] = hexdigits[digest[x] & 15];
+	}
+	md5str[32] = 0;
+
+	fprintf(csv, ",%s,%08x,%s,%s,%d,\"%s\",%s,%s,%s,%u,%u,\"%s%s%s%s\",\"%s\"\n",
+		status, crc32, md5str, ines2 ? "NES 2.0" : "iNES", mapper, board ? board->name : "",
+		mirroring == 2 ? "four-screen" : mirroring >= 0x10 ? "one-screen" : (mirroring & 1) ? "vertical" : "horizontal",
+		(romtype & 2) ? "yes" : "no", region, (round ? prg : prgread) * 16, chr * 8,
+		(tofix & INESFIX_MAPPER) ? "mapper " : "", (tofix & INESFIX_MIRROR) ? "mirroring " : "",
+		(tofix & INESFIX_BATTERY) ? "battery " : "", (tofix & INESFIX_NOCHR) ? "chr " : "",
+		bad ? bad->name : "");
+}
+
+int FCEUI_ValidateRomSet(const char *list, const char *csv) {
+	FILE *in = strcmp(list, "-") ? fopen(list, "r") : stdin;
+	FILE *out;
+	std::vector<uint8> data;
+	char line[4096];
+	int count = 0;
+
+	if (!in)
+		return -1;
+	out = strcmp(csv, "-") ? fopen(csv, "w") : stdout;
+	if (!out) {
+		if (in != stdin) fclose(in);
+		return -1;
+	}
+
+	fprintf(out, "file,status,crc32,md5,format,mapper,mapper name,mirroring,battery,region,prg kib,chr kib,fixes,bad dump\n");
+	while (fgets(line, sizeof(line), in)) {
+		size_t len = strlen(line);
+		while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = 0;
+		if (!len)
+			continue;
+		ValidateRom(line, out, data);
+		count++;
+	}
+
+	if (in != stdin) fclose(in);
+	if (out != stdout) fclose(out);
+	else fflush(out);
+	return count;
+}
+
 static int iNES_Init(int num) {
-	BMAPPINGLocal *tmp = bmap;
+	const BMAPPINGLocal *tmp = FindMapper(num);
 
 	CHRRAMSize = -1;
 
 	if (GameInfo->type == GIT_VSUNI)
 		AddExState(FCEUVSUNI_STATEINFO, ~0, 0, 0);
 
-	while (tmp->init) {
-		if (num == tmp->number) {
-			UNIFchrrama = NULL;	// need here for compatibility with UNIF mapper code
-			if (!VROM_size) {
-				if(!iNESCart.ines2)
-				{
-					switch (num) {	// FIXME, mapper or game data base with the board parameters and ROM/RAM sizes
-					case 13:  CHRRAMSize = 16 * 1024; break;
-					case 6:
-					case 29:
-					case 30:
-					case 45:
-					case 96:  CHRRAMSize = 32 * 1024; break;
-					case 176: CHRRAMSize = 128 * 1024; break;
-					default:  CHRRAMSize = 8 * 1024; break;
-					}
-					iNESCart.vram_size = CHRRAMSize;
-				}
-				else
-				{
-					CHRRAMSize = iNESCart.battery_vram_size + iNESCart.vram_size;
-				}
-				if (CHRRAMSize > 0)
-				{
-					int mCHRRAMSize = (CHRRAMSize < 1024) ? 1024 : CHRRAMSize; // VPage has a resolution of 1k banks, ensure minimum allocation to prevent malicious access from NES software
-					if ((UNIFchrrama = VROM = (uint8*)FCEU_dmalloc(mCHRRAMSize)) == NULL) return 2;
-					FCEU_MemoryRand(VROM, CHRRAMSize);
-					SetupCartCHRMapping(0, VROM, CHRRAMSize, 1);
-					AddExState(VROM, CHRRAMSize, 0, "CHRR");
-				}
-				else {
-					// mapper 256 (OneBus) has not CHR-RAM _and_ has not CHR-ROM region in iNES file
-					// so zero-sized CHR should be supported at least for this mapper
-					VROM = NULL;
-				}
-			}
-			if (head.ROM_type & 8)
-			{
-				if (ExtraNTARAM != NULL)
-				{
-					AddExState(ExtraNTARAM, 2048, 0, "EXNR");
-				}
+	if (!tmp)
+		return 1;
+
+	UNIFchrrama = NULL;	// need here for compatibility with UNIF mapper code
+	if (!VROM_size) {
+		if(!iNESCart.ines2)
+		{
+			switch (num) {	// FIXME, mapper or game data base with the board parameters and ROM/RAM sizes
+			case 13:  CHRRAMSize = 16 * 1024; break;
+			case 6:
+			case 29:
+			case 30:
+			case 45:
+			case 96:  CHRRAMSize = 32 * 1024; break;
+			case 176: CHRRAMSize = 128 * 1024; break;
+			default:  CHRRAMSize = 8 * 1024; break;
 			}
-			tmp->init(&iNESCart);
-			return 0;
+			iNESCart.vram_size = CHRRAMSize;
+		}
+		else
+		{
+			CHRRAMSize = iNESCart.battery_vram_size + iNESCart.vram_size;
+		}
+		if (CHRRAMSize > 0)
+		{
+			int mCHRRAMSize = (CHRRAMSize < 1024) ? 1024 : CHRRAMSize; // VPage has a resolution of 1k banks, ensure minimum allocation to prevent malicious access from NES software
+			if ((UNIFchrrama = VROM = (uint8*)FCEU_dmalloc(mCHRRAMSize)) == NULL) return 2;
+			FCEU_MemoryRand(VROM, CHRRAMSize);
+			SetupCartCHRMapping(0, VROM, CHRRAMSize, 1);
+			AddExState(VROM, CHRRAMSize, 0, "CHRR");
+		}
+		else {
+			// mapper 256 (OneBus) has not CHR-RAM _and_ has not CHR-ROM region in iNES file
+			// so zero-sized CHR should be supported at least for this mapper
+			VROM = NULL;
 		}
-		tmp++;
 	}
-	return 1;
+	if (head.ROM_type & 8)
+	{
+		if (ExtraNTARAM != NULL)
+		{
+			AddExState(ExtraNTARAM, 2048, 0, "EXNR");
+		}
+	}
+	tmp->init(&iNESCart);
+	return 0;
 }
@@ -321,6 +321,20 @@ static const char* luaMemHookTypeStrings [] =
 //make sure we have the right number of strings
 CTASSERT(sizeof(luaMemHookTypeStrings)/sizeof(*luaMemHookTypeStrings) ==  LUAMEMHOOK_COUNT)
 
+// hooks registered with memory.register*deferred, called once per frame with all the matching accesses
+static const char* luaMemHookDeferredStrings [] =
+{
+	"MEMHOOK_WRITE_DEFERRED",
+	"MEMHOOK_READ_DEFERRED",
+	"MEMHOOK_EXEC_DEFERRED",
+
+	"MEMHOOK_WRITE_SUB_DEFERRED",
+	"MEMHOOK_READ_SUB_DEFERRED",
+	"MEMHOOK_EXEC_SUB_DEFERRED",
+};
+
+CTASSERT(sizeof(luaMemHookDeferredStrings)/sizeof(*luaMemHookDeferredStrings) ==  LUAMEMHOOK_COUNT)
+
 static char* rawToCString(lua_State* L, int idx=0);
 static const char* toCString(lua_State* L, int idx=0);
 
@@ -2109,7 +2123,10 @@ void HandleCallbackError(lua_State* L)
 // (it must not use any part of Lua or perform any per-script operations,
 //  otherwise it would definitely be too slow.)
 // calculating the regions when a hook is added/removed may be slow,
-// but this is an intentional tradeoff to obtain a high speed of checking during later execution
+// but this is an intentional tradeoff to obtain a high speed of checking during later execution.
+// accesses inside the CPU address space are answered by a bitmap with one bit per byte,
+// so the cost does not grow with the number of hooked addresses;
+// the tiers of islands are only walked for accesses outside of it.
 struct TieredRegion
 {
 	template<unsigned int maxGap>
@@ -2162,6 +2179,9 @@ struct TieredRegion
 	Region<0x1000> mid;
 	Region<0> narrow;
 
+	enum { BITMAP_BYTES = 0x10000 };
+	std::vector<uint8> bitmap;	// bit per byte of the CPU address space, empty when nothing is hooked
+
 	void Calculate(std::vector<unsigned int>& bytes)
 	{
 		std::sort(bytes.begin(), bytes.end());
@@ -2169,6 +2189,17 @@ struct TieredRegion
 		broad.Calculate(bytes);
 		mid.Calculate(bytes);
 		narrow.Calculate(bytes);
+
+		bitmap.clear();
+		if(!bytes.empty())
+		{
+			bitmap.resize(BITMAP_BYTES / 8, 0);
+			for(size_t i = 0; i != bytes.size(); ++i)
+			{
+				if(bytes[i] < BITMAP_BYTES)
+					bitmap[bytes[i] >> 3] |= 1 << (bytes[i] & 7);
+			}
+		}
 	}
 
 	TieredRegion()
@@ -2185,17 +2216,84 @@ struct TieredRegion
 	// note: it is illegal to call this if NotEmpty() returns 0
 	__forceinline bool Contains(unsigned int address, int size)
 	{
+		if(address < BITMAP_BYTES && address + size <= BITMAP_BYTES)
+		{
+			for(unsigned int i = address; i != address+size; i++)
+			{
+				if(bitmap[i >> 3] & (1 << (i & 7)))
+					return true;
+			}
+			return false;
+		}
 		return broad.islands[0].Contains(address,size) &&
 		       mid.Contains(address,size) &&
 			   narrow.Contains(address,size);
 	}
 };
-TieredRegion hookedRegions [LUAMEMHOOK_COUNT];
+TieredRegion hookedRegions [LUAMEMHOOK_COUNT];		// immediate and deferred hooks together, checked first
+TieredRegion immediateRegions [LUAMEMHOOK_COUNT];
+TieredRegion deferredRegions [LUAMEMHOOK_COUNT];
+
+// accesses matching a deferred hook, kept until the end of the frame.
+// when a frame makes more accesses than fit, the oldest ones are overwritten and counted as dropped
+struct DeferredMemHookAccess
+{
+	unsigned int address;
+	unsigned int value;
+	unsigned short size;
+	unsigned short hookType;
+};
+#define DEFERRED_MEMHOOK_RING_SIZE 0x10000	// must be a power of 2
+static DeferredMemHookAccess deferredMemHookRing[DEFERRED_MEMHOOK_RING_SIZE];
+static unsigned int deferredMemHookHead;	// next slot to write
+static unsigned int deferredMemHookCount;
+static unsigned int deferredMemHookDropped;
+
+static void ClearDeferredMemHooks()
+{
+	deferredMemHookHead = 0;
+	deferredMemHookCount = 0;
+	deferredMemHookDropped = 0;
+}
+
+static void QueueDeferredMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
+{
+	DeferredMemHookAccess& access = deferredMemHookRing[deferredMemHookHead];
+	access.address = address;
+	access.value = value;
+	access.size = size;
+	access.hookType = hookType;
+	deferredMemHookHead = (deferredMemHookHead + 1) & (DEFERRED_MEMHOOK_RING_SIZE - 1);
+	if(deferredMemHookCount == DEFERRED_MEMHOOK_RING_SIZE)
+		deferredMemHookDropped++;
+	else
+		deferredMemHookCount++;
+}
+
+static void CollectHookedBytes(const char* tableName, std::vector<unsigned int>& hookedBytes)
+{
+	lua_settop(L, 0);
+	lua_getfield(L, LUA_REGISTRYINDEX, tableName);
+	if(lua_istable(L, -1))
+	{
+		lua_pushnil(L);
+		while(lua_next(L, -2))
+		{
+			if(lua_isfunction(L, -1))
+			{
+				unsigned int addr = lua_tointeger(L, -2);
+				hookedBytes.push_back(addr);
+			}
+			lua_pop(L, 1);
+		}
+	}
+	lua_settop(L, 0);
+}
 
 
 static void CalculateMemHookRegions(LuaMemHookType hookType)
 {
-	std::vector<unsigned int> hookedBytes;
+	std::vector<unsigned int> immediateBytes, deferredBytes;
 //	std::map<int, LuaContextInfo*>::iterator iter = luaContextInfo.begin();
 //	std::map<int, LuaContextInfo*>::iterator end = luaContextInfo.end();
 //	while(iter != end)
@@ -2206,28 +2304,26 @@ static void CalculateMemHookRegions(LuaMemHookType hookType)
 //			lua_State* L = info.L;
 			if(L)
 			{
-				lua_settop(L, 0);
-				lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
-				lua_pushnil(L);
-				while(lua_next(L, -2))
-				{
-					if(lua_isfunction(L, -1))
-					{
-						unsigned int addr = lua_tointeger(L, -2);
-						hookedBytes.push_back(addr);
-					}
-					lua_pop(L, 1);
-				}
-				lua_settop(L, 0);
+				CollectHookedBytes(luaMemHookTypeStrings[hookType], immediateBytes);
+				CollectHookedBytes(luaMemHookDeferredStrings[hookType], deferredBytes);
 			}
 		}
 //		++iter;
 //	}
+	std::vector<unsigned int> hookedBytes(immediateBytes);
+	hookedBytes.insert(hookedBytes.end(), deferredBytes.begin(), deferredBytes.end());
+	immediateRegions[hookType].Calculate(immediateBytes);
+	deferredRegions[hookType].Calculate(deferredBytes);
 	hookedRegions[hookType].Calculate(hookedBytes);
 }
 
 static void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
 {
+	if(deferredRegions[hookType].NotEmpty() && deferredRegions[hookType].Contains(address, size))
+		QueueDeferredMemHook(address, size, value, hookType);
+	if(!immediateRegions[hookType].NotEmpty() || !immediateRegions[hookType].Contains(address, size))
+		return;
+
 //	std::map<int, LuaContextInfo*>::iterator iter = luaContextInfo.begin();
 //	std::map<int, LuaContextInfo*>::iterator end = luaContextInfo.end();
 //	while(iter != end)
@@ -2293,6 +2389,102 @@ void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value
 	}
 }
 
+bool FCEU_LuaCPUHooksActive()
+{
+	return hookedRegions[LUAMEMHOOK_WRITE].NotEmpty() || hookedRegions[LUAMEMHOOK_EXEC].NotEmpty();
+}
+
+// hands the accesses queued since the last call to the deferred hooks.
+// every callback is called once, with a table of {address=, size=, value=} records in the order of the accesses;
+// the table's "dropped" field counts the accesses of the frame that did not fit in the queue
+void FCEU_LuaFlushDeferredMemHooks()
+{
+	if (!deferredMemHookCount && !deferredMemHookDropped)
+		return;
+	if (!L)
+	{
+		ClearDeferredMemHooks();
+		return;
+	}
+
+	lua_settop(L, 0);
+	lua_newtable(L);	// 1: batch of each callback, by callback
+	lua_newtable(L);	// 2: callbacks in the order of their first access
+	int numFuncs = 0;
+
+	unsigned int index = (deferredMemHookHead - deferredMemHookCount) & (DEFERRED_MEMHOOK_RING_SIZE - 1);
+	for (unsigned int n = 0; n != deferredMemHookCount; n++, index = (index + 1) & (DEFERRED_MEMHOOK_RING_SIZE - 1))
+	{
+		const DeferredMemHookAccess& access = deferredMemHookRing[index];
+		lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookDeferredStrings[access.hookType]);	// 3
+		bool found = false;
+		for (unsigned int i = access.address; i != access.address + access.size; i++)
+		{
+			lua_rawgeti(L, 3, i);	// 4
+			if (lua_isfunction(L, -1))
+			{
+				found = true;
+				break;
+			}
+			lua_pop(L, 1);
+		}
+		if (!found)
+		{
+			// the hook was removed by a callback earlier in the frame
+			lua_settop(L, 2);
+			continue;
+		}
+
+		lua_pushvalue(L, 4);
+		lua_rawget(L, 1);	// 5
+		if (lua_isnil(L, -1))
+		{
+			lua_pop(L, 1);
+			lua_newtable(L);
+			lua_pushvalue(L, 4);
+			lua_pushvalue(L, 5);
+			lua_rawset(L, 1);
+			lua_pushvalue(L, 4);
+			lua_rawseti(L, 2, ++numFuncs);
+		}
+
+		lua_createtable(L, 0, 3);
+		lua_pushinteger(L, access.address);
+		lua_setfield(L, -2, "address");
+		lua_pushinteger(L, access.size);
+		lua_setfield(L, -2, "size");
+		lua_pushinteger(L, access.value);
+		lua_setfield(L, -2, "value");
+		lua_rawseti(L, 5, lua_objlen(L, 5) + 1);
+		lua_settop(L, 2);
+	}
+
+	unsigned int dropped = deferredMemHookDropped;
+	ClearDeferredMemHooks();
+
+	for (int k = 1; k <= numFuncs; k++)
+	{
+		lua_rawgeti(L, 2, k);
+		lua_pushvalue(L, -1);
+		lua_rawget(L, 1);
+		lua_pushinteger(L, dropped);
+		lua_setfield(L, -2, "dropped");
+
+		bool wasRunning = (luaRunning!=0);
+		luaRunning = true;
+		int errorcode = lua_pcall(L, 1, 0, 0);
+		luaRunning = wasRunning;
+		if (errorcode)
+		{
+			HandleCallbackError(L);
+			// the script is stopped
+			return;
+		}
+		lua_settop(L, 2);
+	}
+	lua_settop(L, 0);
+}
+
 void CallRegisteredLuaFunctions(LuaCallID calltype)
 {
 	assert((unsigned int)calltype < (unsigned int)LUACALL_COUNT);
@@ -2360,7 +2552,7 @@ void TaseditorDisableManualFunctionIfNeeded()
 }
 #endif
 
-static int memory_registerHook(lua_State* L, LuaMemHookType hookType, int defaultSize)
+static int memory_registerHook(lua_State* L, LuaMemHookType hookType, int defaultSize, bool deferred = false)
 {
 	// get first argument: address
 	unsigned int addr = luaL_checkinteger(L,1);
@@ -2388,7 +2580,7 @@ static int memory_registerHook(lua_State* L, LuaMemHookType hookType, int defaul
 	lua_settop(L,funcIdx);
 
 	// get the address-to-callback table for this hook type of the current script
-	lua_getfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[hookType]);
+	lua_getfield(L, LUA_REGISTRYINDEX, deferred ? luaMemHookDeferredStrings[hookType] : luaMemHookTypeStrings[hookType]);
 
 	// count how many callback functions we'll be displacing
 	int numFuncsAfter = clearing ? 0 : size;
@@ -2465,6 +2657,14 @@ static int memory_registerexec(lua_State *L)
 {
 	return memory_registerHook(L, MatchHookTypeToCPU(L,LUAMEMHOOK_EXEC), 1);
 }
+static int memory_registerwritedeferred(lua_State *L)
+{
+	return memory_registerHook(L, MatchHookTypeToCPU(L,LUAMEMHOOK_WRITE), 1, true);
+}
+static int memory_registerexecdeferred(lua_State *L)
+{
+	return memory_registerHook(L, MatchHookTypeToCPU(L,LUAMEMHOOK_EXEC), 1, true);
+}
 
 //adelikat: table pulled from GENS.  credz nitsuja!
 
@@ -2678,9 +2878,11 @@ static int zapper_read(lua_State *L){
 		else
 			z = currFrameCounter -1;
 
-		x = currMovieData.records[z].zappers[1].x;	//adelikat:  Used hardcoded port 1 since as far as I know, only port 1 is valid for zappers
-		y = currMovieData.records[z].zappers[1].y;
-		click = currMovieData.records[z].zappers[1].b;
+		MovieRecord record;
+		currMovieData.getRecord(z, record);
+		x = record.zappers[1].x;	//adelikat:  Used hardcoded port 1 since as far as I know, only port 1 is valid for zappers
+		y = record.zappers[1].y;
+		click = record.zappers[1].b;
 	}
 	else
 	{
@@ -5985,6 +6187,8 @@ static const struct luaL_reg memorylib [] = {
 	{"registerwrite", memory_registerwrite},
 	//{"registerread", memory_registerread}, TODO
 	{"registerexec", memory_registerexec},
+	{"registerwritedeferred", memory_registerwritedeferred},
+	{"registerexecdeferred", memory_registerexecdeferred},
 	// alternate names
 	{"register", memory_registerwrite},
 	{"registerrun", memory_registerexec},
@@ -6368,6 +6572,8 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 		{
 			lua_newtable(L);
 			lua_setfield(L, LUA_REGISTRYINDEX, luaMemHookTypeStrings[i]);
+			lua_newtable(L);
+			lua_setfield(L, LUA_REGISTRYINDEX, luaMemHookDeferredStrings[i]);
 		}
 	}
 
@@ -6408,6 +6614,7 @@ int FCEU_LoadLuaCode(const char *filename, const char *arg)
 	luaRunning = TRUE;
 	skipRerecords = FALSE;
 	numMemHooks = 0;
+	ClearDeferredMemHooks();
 	transparencyModifier = 255; // opaque
 
 	//wasPaused = FCEUI_EmulationPaused();
@@ -6500,6 +6707,7 @@ void FCEU_LuaStop() {
 	/*info.*/numMemHooks = 0;
 	for(int i = 0; i < LUAMEMHOOK_COUNT; i++)
 		CalculateMemHookRegions((LuaMemHookType)i);
+	ClearDeferredMemHooks();
 
 	//sometimes iup uninitializes com
 	//MBG TODO - test whether this is really necessary. i dont think it is
@@ -38,6 +38,9 @@ extern void AddRecentMovieFile(const char *filename);
 extern bool mustEngageTaseditor;
 #endif
 
+#else
+#include <unistd.h>
+#include <sys/wait.h>
 #endif
 
 #ifdef __QT_DRIVER__
@@ -123,6 +126,7 @@ char lagcounterbuf[32] = {0};
 
 void MovieData::clearRecordRange(int start, int len)
 {
+	unpackRecords();
 	for(int i=0;i<len;i++)
 	{
 		records[i+start].clear();
@@ -131,6 +135,7 @@ void MovieData::clearRecordRange(int start, int len)
 
 void MovieData::eraseRecords(int at, int frames)
 {
+	unpackRecords();
 	if (at < (int)records.size())
 	{
 		if (frames == 1)
@@ -149,6 +154,7 @@ void MovieData::eraseRecords(int at, int frames)
 
 void MovieData::insertEmpty(int at, int frames)
 {
+	unpackRecords();
 	if (at == -1)
 	{
 		records.resize(records.size() + frames);
@@ -162,6 +168,7 @@ void MovieData::cloneRegion(int at, int frames)
 {
 	if (at < 0) return;
 
+	unpackRecords();
 	records.insert(records.begin() + at, frames, MovieRecord());
 
 	for(int i = 0; i < frames; i++)
@@ -331,6 +338,34 @@ bool MovieRecord::parseBinary(MovieData* md, EMUFILE* is)
 	return true;
 }
 
+void MovieRecord::parseBinary(MovieData* md, const uint8* data)
+{
+	commands = *data++;
+
+	if(md->fourscore)
+	{
+		memcpy(&joysticks,data,4);
+	}
+	else
+	{
+		for(int port=0;port<2;port++)
+		{
+			if(md->ports[port] == SI_GAMEPAD)
+				joysticks[port] = *data++;
+			else if(md->ports[port] == SI_ZAPPER)
+			{
+				zappers[port].x = *data++;
+				zappers[port].y = *data++;
+				zappers[port].b = *data++;
+				zappers[port].bogo = *data++;
+				zappers[port].zaphit = 0;
+				for(int i=0;i<8;i++)
+					zappers[port].zaphit |= (uint64)*data++ << (i*8);
+			}
+		}
+	}
+}
+
 
 void MovieRecord::dumpBinary(MovieData* md, EMUFILE* os, int index)
 {
@@ -410,6 +445,7 @@ MovieData::MovieData()
 	, binaryFlag(false)
 	, loadFrameCount(-1)
 	, microphone(false)
+	, packedRecordSize(1)
 	, RAMInitOption(0)
 	, RAMInitSeed(0)
 {
@@ -418,9 +454,53 @@ MovieData::MovieData()
 
 void MovieData::truncateAt(int frame)
 {
+	unpackRecords();
 	records.resize(frame);
 }
 
+int MovieData::getBinaryRecordSize()
+{
+	int recordsize = 1; //1 for the command
+	if(fourscore)
+		recordsize += 4; //4 joysticks
+	else
+	{
+		for(int i=0;i<2;i++)
+		{
+			switch(ports[i])
+			{
+			case SI_GAMEPAD: recordsize++; break;
+			case SI_ZAPPER: recordsize+=12; break;
+			}
+		}
+	}
+	return recordsize;
+}
+
+void MovieData::getRecord(int frame, MovieRecord& record)
+{
+	if(packedRecords.empty())
+		record = records[frame];
+	else
+	{
+		record.clear();
+		record.parseBinary(this, &packedRecords[frame * packedRecordSize]);
+	}
+}
+
+//turns the packed input into records, for everything that edits the movie or needs the whole vector
+void MovieData::unpackRecords()
+{
+	if(packedRecords.empty())
+		return;
+
+	int numRecords = getNumRecords();
+	records.resize(numRecords);
+	for(int i=0;i<numRecords;i++)
+		records[i].parseBinary(this, &packedRecords[i * packedRecordSize]);
+	std::vector<uint8>().swap(packedRecords);
+}
+
 void MovieData::installValue(std::string& key, std::string& val)
 {
 	//todo - use another config system, or drive this from a little data structure. because this is gross
@@ -531,19 +611,30 @@ int MovieData::dump(EMUFILE *os, bool binary, bool seekToCurrFramePos)
 	{
 		//put one | to start the binary dump
 		os->fputc('|');
-		for (int i = 0; i < (int)records.size(); i++)
+		if (!packedRecords.empty())
 		{
-			if (seekToCurrFramePos && currFrameCounter == i)
-				currFramePos = os->ftell();
-			records[i].dumpBinary(this, os, i);
+			//packed input is already in the binary layout
+			if (seekToCurrFramePos && currFrameCounter >= 0 && currFrameCounter < getNumRecords())
+				currFramePos = os->ftell() + currFrameCounter * packedRecordSize;
+			os->fwrite(&packedRecords[0], packedRecords.size());
+		} else
+		{
+			for (int i = 0; i < (int)records.size(); i++)
+			{
+				if (seekToCurrFramePos && currFrameCounter == i)
+					currFramePos = os->ftell();
+				records[i].dumpBinary(this, os, i);
+			}
 		}
 	} else
 	{
-		for (int i = 0; i < (int)records.size(); i++)
+		MovieRecord record;
+		for (int i = 0; i < getNumRecords(); i++)
 		{
 			if (seekToCurrFramePos && currFrameCounter == i)
 				currFramePos = os->ftell();
-			records[i].dump(this, os, i);
+			getRecord(i, record);
+			record.dump(this, os, i);
 		}
 	}
 
@@ -605,20 +696,7 @@ bool FCEUMOV_Mode(int modemask)
 
 static void LoadFM2_binarychunk(MovieData& movieData, EMUFILE* fp, int size)
 {
-	int recordsize = 1; //1 for the command
-	if(movieData.fourscore)
-		recordsize += 4; //4 joysticks
-	else
-	{
-		for(int i=0;i<2;i++)
-		{
-			switch(movieData.ports[i])
-			{
-			case SI_GAMEPAD: recordsize++; break;
-			case SI_ZAPPER: recordsize+=12; break;
-			}
-		}
-	}
+	int recordsize = movieData.getBinaryRecordSize();
 
 	//find out how much remains in the file
 	int curr = fp->ftell();
@@ -634,15 +712,163 @@ static void LoadFM2_binarychunk(MovieData& movieData, EMUFILE* fp, int size)
 	if (movieData.loadFrameCount!=-1 && movieData.loadFrameCount<numRecords)
 		numRecords=movieData.loadFrameCount;
 
-	movieData.records.resize(numRecords);
-	for(int i=0;i<numRecords;i++)
+	//keep the records as they are in the file, they get unpacked when needed
+	movieData.packedRecordSize = recordsize;
+	movieData.packedRecords.resize(numRecords*recordsize);
+	if(numRecords)
+		fp->fread(&movieData.packedRecords[0],numRecords*recordsize);
+}
+
+//reads the movie a block at a time instead of a virtual fgetc() per character
+class FM2Reader
+{
+public:
+	FM2Reader(EMUFILE* fp, int size)
+		: fp(fp)
+		, start(fp->ftell())
+		, limit(size)
+		, available(fp->size() - start)
+		, filled(0)
+		, pos(0)
+		, len(0)
+		, failed(fp->fail())
+	{}
+
+	int getc()
+	{
+		if(pos == len && !fill())
+			return -1;
+		return buf[pos++];
+	}
+
+	//only right after a getc() that returned a character
+	void unget() { pos--; }
+
+	//the records themselves may be read past the size limit, like the old parser did
+	int consumed() { return filled - (len - pos); }
+	int remaining() { return limit - consumed(); }
+
+	//leaves the stream right after the last character read, as if it had been read with fgetc()
+	void finish()
+	{
+		fp->fseek(start + consumed(), SEEK_SET);
+		if(!failed)
+			fp->unfail();
+	}
+
+private:
+	bool fill()
 	{
-		movieData.records[i].parseBinary(&movieData,fp);
+		int todo = std::min<int>(sizeof(buf), available - filled);
+		if(todo <= 0)
+			return false;
+		int got = (int)fp->fread(buf, todo);
+		if(got <= 0)
+			return false;
+		filled += got;
+		pos = 0;
+		len = got;
+		return true;
 	}
+
+	EMUFILE* fp;
+	int start, limit, available, filled, pos, len;
+	bool failed;
+	uint8 buf[65536];
+};
+
+//same as templateIntegerDecFromIstream()
+template<typename T> static T FM2_readDec(FM2Reader& reader)
+{
+	T ret = 0;
+	bool pre = true;
+
+	for(;;)
+	{
+		int c = reader.getc();
+		if(c == -1) return ret;
+		int d = c - '0';
+		if((d<0 || d>9))
+		{
+			if(!pre)
+				break;
+		}
+		else
+		{
+			pre = false;
+			ret *= 10;
+			ret += d;
+		}
+	}
+	reader.unget();
+	return ret;
+}
+
+//same as MovieRecord::parseJoy()
+static uint8 FM2_readJoy(FM2Reader& reader)
+{
+	uint8 joystate = 0;
+	for(int i=0;i<8;i++)
+	{
+		int c = reader.getc();
+		joystate <<= 1;
+		joystate |= ((c=='.'||c==' '||c==-1)?0:1);
+	}
+	return joystate;
+}
+
+//parses a text record like MovieRecord::parse() does, but into the binary layout
+static void FM2_parseRecord(MovieData& movieData, FM2Reader& reader, uint8* out)
+{
+	//by the time we get in here, the initial pipe has already been extracted
+
+	*out++ = (uint8)FM2_readDec<uint32>(reader);
+	reader.getc(); //eat the pipe
+
+	if(movieData.fourscore)
+	{
+		for(int i=0;i<4;i++)
+		{
+			*out++ = FM2_readJoy(reader);
+			reader.getc(); //eat the pipe
+		}
+	}
+	else
+	{
+		for(int port=0;port<2;port++)
+		{
+			if(movieData.ports[port] == SI_GAMEPAD)
+				*out++ = FM2_readJoy(reader);
+			else if(movieData.ports[port] == SI_ZAPPER)
+			{
+				*out++ = (uint8)FM2_readDec<uint32>(reader);
+				*out++ = (uint8)FM2_readDec<uint32>(reader);
+				*out++ = (uint8)FM2_readDec<uint32>(reader);
+				*out++ = (uint8)FM2_readDec<uint32>(reader);
+				//a cpu cycle count, passes 32 bits after about 40 minutes
+				uint64 zaphit = FM2_readDec<uint64>(reader);
+				for(int i=0;i<8;i++)
+					*out++ = (uint8)(zaphit >> (i*8));
+			}
+
+			reader.getc(); //eat the pipe
+		}
+	}
+
+	//(no fcexp data is logged right now)
+	reader.getc(); //eat the pipe
+
+	//should be left at a newline
 }
 
-//yuck... another custom text parser.
 bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
+{
+	return LoadFM2(movieData, fp, size, stopAfterHeader, false);
+}
+
+//yuck... another custom text parser.
+//with keepPacked, the input stays in MovieData::packedRecords until something calls unpackRecords()
+bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader, bool keepPacked)
 {
 	// if there's no "binary" tag in the movie header, consider it as a movie in text format
 	movieData.binaryFlag = false;
@@ -679,10 +905,12 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 	bool bail = false;
 	bool iswhitespace, isrecchar, isnewline;
 	int c;
+	int numRecords = 0;
+	FM2Reader reader(fp, size);
 	for(;;)
 	{
-		if(size--<=0) goto bail;
-		c = fp->fgetc();
+		if(reader.remaining() <= 0) goto bail;
+		c = reader.getc();
 		if(c == -1)
 			goto bail;
 		iswhitespace = (c==' '||c=='\t');
@@ -690,11 +918,12 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 		isnewline = (c==10||c==13);
 		if(isrecchar && movieData.binaryFlag && !stopAfterHeader)
 		{
-			LoadFM2_binarychunk(movieData, fp, size);
-			return true;
-		} else if (isnewline && movieData.loadFrameCount == movieData.records.size())
+			reader.finish();
+			LoadFM2_binarychunk(movieData, fp, reader.remaining());
+			goto finish;
+		} else if (isnewline && movieData.loadFrameCount == numRecords)
 			// exit prematurely if loaded the specified amound of records
-			return true;
+			break;
 		switch(state)
 		{
 		case NEWLINE:
@@ -710,13 +939,16 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 		case RECORD:
 			{
 				dorecord:
-				if (stopAfterHeader) return true;
-				int currcount = movieData.records.size();
-				movieData.records.resize(currcount+1);
-				int preparse = fp->ftell();
-				movieData.records[currcount].parse(&movieData, fp);
-				int postparse = fp->ftell();
-				size -= (postparse-preparse);
+				if (stopAfterHeader)
+				{
+					reader.finish();
+					return true;
+				}
+				int recordsize = movieData.getBinaryRecordSize();
+				movieData.packedRecordSize = recordsize;
+				movieData.packedRecords.resize((numRecords+1)*recordsize);
+				FM2_parseRecord(movieData, reader, &movieData.packedRecords[numRecords*recordsize]);
+				numRecords++;
 				state = NEWLINE;
 				break;
 			}
@@ -755,7 +987,11 @@ bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader)
 		done: ;
 		if(bail) break;
 	}
+	reader.finish();
 
+	finish:
+	if (!keepPacked)
+		movieData.unpackRecords();
 	return true;
 }
 
@@ -1059,7 +1295,8 @@ bool FCEUI_LoadMovie(const char *fname, bool _read_only, int _pauseframe)
 	AddRecentMovieFile(name.c_str());
 #endif
 
-	LoadFM2(currMovieData, fp->stream, fp->size, false);
+	//the input is only unpacked if the movie gets edited
+	LoadFM2(currMovieData, fp->stream, fp->size, false, true);
 	LoadSubtitles(currMovieData);
 	delete fp;
 
@@ -1227,7 +1464,7 @@ void FCEUMOV_AddInputState()
 	if (movieMode == MOVIEMODE_PLAY)
 	{
 		//stop when we run out of frames
-		if (currFrameCounter >= (int)currMovieData.records.size())
+		if (currFrameCounter >= currMovieData.getNumRecords())
 		{
 			FinishPlayback();
 			//tell all drivers to poll input and set up their logical states
@@ -1236,7 +1473,9 @@ void FCEUMOV_AddInputState()
 			portFC.driver->Update(portFC.ptr,portFC.attrib);
 		} else
 		{
-			MovieRecord* mr = &currMovieData.records[currFrameCounter];
+			MovieRecord record;
+			currMovieData.getRecord(currFrameCounter, record);
+			MovieRecord* mr = &record;
 
 			//reset and power cycle if necessary
 			if(mr->command_power())
@@ -1255,7 +1494,7 @@ void FCEUMOV_AddInputState()
 		}
 
 		//if we are on the last frame, then pause the emulator if the player requested it
-		if (currFrameCounter == currMovieData.records.size()-1)
+		if (currFrameCounter == currMovieData.getNumRecords()-1)
 		{
 			if(FCEUD_PauseAfterPlayback())
 			{
@@ -1274,6 +1513,8 @@ void FCEUMOV_AddInputState()
 	{
 		MovieRecord mr;
 
+		currMovieData.unpackRecords();
+
 		joyports[0].log(&mr);
 		joyports[1].log(&mr);
 		mr.commands = _currCommand;
@@ -1345,7 +1586,7 @@ void FCEU_DrawMovies(uint8 *XBuf)
 		
 		if (movieMode == MOVIEMODE_PLAY)
 		{
-			sprintf(counterbuf, "%d/%d%s%s", currFrameCounter, (int)currMovieData.records.size(), GetMovieRecordModeStr(), GetMovieReadOnlyStr());
+			sprintf(counterbuf, "%d/%d%s%s", currFrameCounter, currMovieData.getNumRecords(), GetMovieRecordModeStr(), GetMovieReadOnlyStr());
 		} else if (movieMode == MOVIEMODE_RECORD)
 		{
 			if (movieRecordMode == MOVIE_RECORD_MODE_TRUNCATE)
@@ -1354,7 +1595,7 @@ void FCEU_DrawMovies(uint8 *XBuf)
 				sprintf(counterbuf, "%d/%d%s%s (record)", currFrameCounter, (int)currMovieData.records.size(), GetMovieRecordModeStr(), GetMovieReadOnlyStr());
 		} else if (movieMode == MOVIEMODE_FINISHED)
 		{
-			sprintf(counterbuf,"%d/%d%s%s (finished)",currFrameCounter,(int)currMovieData.records.size(), GetMovieRecordModeStr(), GetMovieReadOnlyStr());
+			sprintf(counterbuf,"%d/%d%s%s (finished)",currFrameCounter,currMovieData.getNumRecords(), GetMovieRecordModeStr(), GetMovieReadOnlyStr());
 			color = 0x17; //Show red to get attention
 		} else if (movieMode == MOVIEMODE_TASEDITOR)
 		{
@@ -1399,15 +1640,18 @@ int FCEUMOV_WriteState(EMUFILE* os)
 int CheckTimelines(MovieData& stateMovie, MovieData& currMovie)
 {
 	// end_frame = min(urrMovie.records.size(), stateMovie.records.size(), currFrameCounter)
-	int end_frame = currMovie.records.size();
-	if (end_frame > (int)stateMovie.records.size())
-		end_frame = stateMovie.records.size();
+	int end_frame = currMovie.getNumRecords();
+	if (end_frame > stateMovie.getNumRecords())
+		end_frame = stateMovie.getNumRecords();
 	if (end_frame > currFrameCounter)
 		end_frame = currFrameCounter;
 
+	MovieRecord stateRecord, currRecord;
 	for (int x = 0; x < end_frame; x++)
 	{
-		if (!stateMovie.records[x].Compare(currMovie.records[x]))
+		stateMovie.getRecord(x, stateRecord);
+		currMovie.getRecord(x, currRecord);
+		if (!stateRecord.Compare(currRecord))
 			return x;
 	}
 	// no mismatch found
@@ -1563,23 +1807,23 @@ bool FCEUMOV_ReadState(EMUFILE* is, uint32 size)
 			} else if ((int)tempMovieData.records.size() < currFrameCounter)
 			{
 				// this is post-movie savestate and must be checked further
-				if (tempMovieData.records.size() < currMovieData.records.size())
+				if ((int)tempMovieData.records.size() < currMovieData.getNumRecords())
 				{
 					// this savestate doesn't contain enough input to be checked
 					//TODO: turn frame counter to red to get attention
 					if (!backupSavestates)	//If backups are disabled we can just resume normally since we can't restore so stop movie and inform user
 					{
-						FCEU_PrintError("Error: Savestate taken from a frame (%d) after the final frame in the savestated movie (%d) cannot be verified against current movie (%d). This is not permitted.\nUnable to restore backup, movie playback stopped.", currFrameCounter, tempMovieData.records.size() - 1, currMovieData.records.size() - 1);
+						FCEU_PrintError("Error: Savestate taken from a frame (%d) after the final frame in the savestated movie (%d) cannot be verified against current movie (%d). This is not permitted.\nUnable to restore backup, movie playback stopped.", currFrameCounter, tempMovieData.records.size() - 1, currMovieData.getNumRecords() - 1);
 						FCEUI_StopMovie();
 					} else
-						FCEU_PrintError("Savestate taken from a frame (%d) after the final frame in the savestated movie (%d) cannot be verified against current movie (%d). This is not permitted.", currFrameCounter, tempMovieData.records.size() - 1, currMovieData.records.size() - 1);
+						FCEU_PrintError("Savestate taken from a frame (%d) after the final frame in the savestated movie (%d) cannot be verified against current movie (%d). This is not permitted.", currFrameCounter, tempMovieData.records.size() - 1, currMovieData.getNumRecords() - 1);
 					return false;
 				}
 			}
 
 			// Finally, this is a savestate file for this movie
 			// We'll allow loading post-movie savestates that were made after finishing current movie
-			if (currFrameCounter < (int)currMovieData.records.size())
+			if (currFrameCounter < currMovieData.getNumRecords())
 				movieMode = MOVIEMODE_PLAY;
 			else
 				FinishPlayback();
@@ -1679,7 +1923,7 @@ void FCEUI_ToggleInputDisplay(void)
 
 int FCEUI_GetMovieLength()
 {
-	return currMovieData.records.size();
+	return currMovieData.getNumRecords();
 }
 
 int FCEUI_GetMovieRerecordCount()
@@ -1737,14 +1981,14 @@ void FCEUI_MovieToggleRecording()
 
 	if (movieMode == MOVIEMODE_INACTIVE)
 		strcpy(message, "Cannot toggle Recording");
-	else if (currFrameCounter > (int)currMovieData.records.size())
+	else if (currFrameCounter > currMovieData.getNumRecords())
 	{
 		movie_readonly = !movie_readonly;
 		if (movie_readonly)
 			strcpy(message, "Movie is now Read-Only (finished)");
 		else
 			strcpy(message, "Movie is now Read+Write (finished)");
-	} else if (movieMode == MOVIEMODE_PLAY || (movieMode == MOVIEMODE_FINISHED && currFrameCounter == (int)currMovieData.records.size()))
+	} else if (movieMode == MOVIEMODE_PLAY || (movieMode == MOVIEMODE_FINISHED && currFrameCounter == currMovieData.getNumRecords()))
 	{
 		strcpy(message, "Movie is now Read+Write");
 		movie_readonly = false;
@@ -1757,7 +2001,7 @@ void FCEUI_MovieToggleRecording()
 		movie_readonly = true;
 		movieMode = MOVIEMODE_PLAY;
 		RedumpWholeMovieFile(true);
-		if (currFrameCounter >= (int)currMovieData.records.size())
+		if (currFrameCounter >= currMovieData.getNumRecords())
 		{
 			extern int closeFinishedMovie;
 			if (closeFinishedMovie)
@@ -1783,12 +2027,13 @@ void FCEUI_MovieInsertFrame()
 		strcpy(message, "No movie to insert a frame.");
 	else if (movie_readonly)
 		strcpy(message, "Cannot modify movie in Read-Only mode.");
-	else if (currFrameCounter > (int)currMovieData.records.size())
+	else if (currFrameCounter > currMovieData.getNumRecords())
 		strcpy(message, "Cannot insert a frame here.");
 	else if (movieMode == MOVIEMODE_RECORD || movieMode == MOVIEMODE_PLAY || movieMode == MOVIEMODE_FINISHED)
 	{
 		strcpy(message, "1 frame inserted");
 		strcat(message, GetMovieModeStr());
+		currMovieData.unpackRecords();
 		std::vector<MovieRecord>::iterator iter = currMovieData.records.begin();
 		currMovieData.records.insert(iter + currFrameCounter, MovieRecord());
 		FCEUMOV_IncrementRerecordCount();
@@ -1810,11 +2055,12 @@ void FCEUI_MovieDeleteFrame()
 		strcpy(message, "No movie to delete a frame.");
 	else if (movie_readonly)
 		strcpy(message, "Cannot modify movie in Read-Only mode.");
-	else if (currFrameCounter >= (int)currMovieData.records.size())
+	else if (currFrameCounter >= currMovieData.getNumRecords())
 		strcpy(message, "Nothing to delete past movie end.");
 	else if (movieMode == MOVIEMODE_RECORD || movieMode == MOVIEMODE_PLAY)
 	{
 		strcpy(message, "1 frame deleted");
+		currMovieData.unpackRecords();
 		std::vector<MovieRecord>::iterator iter = currMovieData.records.begin();
 		currMovieData.records.erase(iter + currFrameCounter);
 		FCEUMOV_IncrementRerecordCount();
@@ -1848,7 +2094,7 @@ void FCEUI_MovieTruncate()
 		strcpy(message, "No movie to truncate.");
 	else if (movie_readonly)
 		strcpy(message, "Cannot modify movie in Read-Only mode.");
-	else if (currFrameCounter >= (int)currMovieData.records.size())
+	else if (currFrameCounter >= currMovieData.getNumRecords())
 		strcpy(message, "Nothing to truncate past movie end.");
 	else if (movieMode == MOVIEMODE_RECORD || movieMode == MOVIEMODE_PLAY)
 	{
@@ -1964,7 +2210,7 @@ bool FCEUI_MovieGetInfo(FCEUFILE* fp, MOVIE_INFO& info, bool skipFrameCount)
 	info.RAMInitOption = md.RAMInitOption;
 	info.RAMInitSeed = md.RAMInitSeed;
 	info.nosynchack = true;
-	info.num_frames = md.records.size();
+	info.num_frames = md.getNumRecords();
 	info.md5_of_rom_used = md.romChecksum;
 	info.emu_version_used = md.emuVersion;
 	info.name_of_rom_used = md.romFilename;
@@ -2093,3 +2339,380 @@ void FCEUI_MakeBackupMovie(bool dispMessage)
 	}
 }
 
+
+//movie verification -------------------------------------------------------------
+
+//the state hashes of a verified movie are kept next to it in <movie>.hashes:
+//  fceux movie hashes 1
+//  interval <frames>
+//  chunks <name> <name> ...
+//  <frame> <crc32> <crc32> ...     a line for each checkpoint, in the order of the chunks line
+#define MOVIE_HASHES_ID "fceux movie hashes 1"
+
+struct MOVIE_HASHES
+{
+	int interval;
+	std::vector<std::string> names;
+	std::vector<int> frames;
+	std::vector<uint32> hashes;		//names.size() of them for every frame
+};
+
+static bool LoadMovieHashes(const char *fname, MOVIE_HASHES &h)
+{
+	FILE *fp = FCEUD_UTF8fopen(fname, "rb");
+	if (!fp)
+		return false;
+
+	std::string text;
+	char buf[65536];
+	size_t got;
+	while ((got = fread(buf, 1, sizeof(buf), fp)) > 0)
+		text.append(buf, got);
+	fclose(fp);
+
+	std::istringstream is(text);
+	std::string line, word;
+
+	if (!getline(is, line) || line != MOVIE_HASHES_ID)
+		return false;
+	if (!(is >> word >> h.interval) || word != "interval" || h.interval <= 0)
+		return false;
+	is >> word;
+	getline(is, line);
+	if (word != "chunks")
+		return false;
+	std::istringstream names(line);
+	h.names.clear();
+	while (names >> word)
+		h.names.push_back(word);
+
+	h.frames.clear();
+	h.hashes.clear();
+	int frame;
+	while (is >> std::dec >> frame)
+	{
+		h.frames.push_back(frame);
+		for (size_t i = 0; i < h.names.size(); i++)
+		{
+			uint32 crc;
+			if (!(is >> std::hex >> crc))
+				return false;
+			h.hashes.push_back(crc);
+		}
+	}
+	return is.eof() && !h.frames.empty();
+}
+
+static bool SaveMovieHashes(const char *fname, const MOVIE_HASHES &h)
+{
+	//written under another name first so that a crash never leaves half a reference behind
+	std::string tmpName = std::string(fname) + ".tmp";
+	FILE *fp = FCEUD_UTF8fopen(tmpName.c_str(), "w");
+	if (!fp)
+		return false;
+
+	fprintf(fp, "%s\ninterval %d\nchunks", MOVIE_HASHES_ID, h.interval);
+	for (size_t i = 0; i < h.names.size(); i++)
+		fprintf(fp, " %s", h.names[i].c_str());
+	fputc('\n', fp);
+	for (size_t f = 0; f < h.frames.size(); f++)
+	{
+		fprintf(fp, "%d", h.frames[f]);
+		for (size_t i = 0; i < h.names.size(); i++)
+			fprintf(fp, " %08x", h.hashes[f * h.names.size() + i]);
+		fputc('\n', fp);
+	}
+
+	bool ok = !ferror(fp);
+	ok = !fclose(fp) && ok;
+	if (!ok || rename(tmpName.c_str(), fname))
+	{
+		remove(tmpName.c_str());
+		return false;
+	}
+	return true;
+}
+
+static std::string VerifyCsvString(const std::string &s)
+{
+	std::string ret = "\"";
+	for (size_t i = 0; i < s.size(); i++)
+	{
+		if (s[i] == '"')
+			ret += '"';
+		ret += s[i];
+	}
+	return ret + "\"";
+}
+
+//Plays one movie for FCEUI_VerifyMovies and returns its CSV line.  Loads the game, so whatever
+//was running before is gone afterwards.
+static std::string VerifyMovie(const std::string &rom, const std::string &movie, int interval)
+{
+	std::string hashesName = movie + ".hashes";
+	MOVIE_HASHES ref, run;
+	bool haveRef = CheckFileExists(hashesName.c_str());
+	std::vector<uint32> hashes;
+	int checkpoints = 0, lastMatch = -1, desyncFrame = -1, differing = 0;
+	const char *status = "ok";
+	std::string chunk, detail;
+
+	if (haveRef && !LoadMovieHashes(hashesName.c_str(), ref))
+		detail = "unreadable " + hashesName;
+	else if (!FCEUI_LoadGame(rom.c_str(), 1, true))
+		detail = "couldn't load the rom";
+	else if (!FCEUI_LoadMovie(movie.c_str(), true, 0) || !FCEUMOV_Mode(MOVIEMODE_PLAY))
+		detail = "couldn't play the movie";
+	else
+	{
+		int length = FCEUI_GetMovieLength();
+		uint8 *gfx;
+		int32 *sound;
+		int32 ssize;
+
+		run.interval = haveRef ? ref.interval : interval;
+		FCEUSS_FastStateNames(run.names);
+		if (haveRef && run.names != ref.names)
+		{
+			//different mapper state or a different core, nothing to compare
+			desyncFrame = 0;
+			chunk = "(state layout)";
+		}
+
+		//a checkpoint at power on, every interval frames and after the last frame
+		while (desyncFrame < 0)
+		{
+			if (currFrameCounter % run.interval == 0 || currFrameCounter == length)
+			{
+				FCEUSS_HashFastState(hashes);
+				if (!haveRef)
+				{
+					run.frames.push_back(currFrameCounter);
+					run.hashes.insert(run.hashes.end(), hashes.begin(), hashes.end());
+				} else if (checkpoints >= (int)ref.frames.size() || ref.frames[checkpoints] != currFrameCounter)
+				{
+					desyncFrame = currFrameCounter;
+					chunk = "(movie length)";
+					break;
+				} else
+				{
+					const uint32 *expected = &ref.hashes[checkpoints * ref.names.size()];
+					for (size_t i = 0; i < hashes.size(); i++)
+					{
+						if (hashes[i] != expected[i] && !differing++)
+							chunk = run.names[i];
+					}
+					if (differing)
+					{
+						desyncFrame = currFrameCounter;
+						break;
+					}
+					lastMatch = currFrameCounter;
+				}
+				checkpoints++;
+			}
+			if (currFrameCounter >= length)
+				break;
+
+			int frame = currFrameCounter;
+			FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+			if (currFrameCounter == frame || !FCEUMOV_Mode(MOVIEMODE_PLAY))
+			{
+				detail = "playback stopped";
+				break;
+			}
+		}
+		if (haveRef && desyncFrame < 0 && !detail.size() && checkpoints < (int)ref.frames.size())
+		{
+			desyncFrame = ref.frames[checkpoints];
+			chunk = "(movie length)";
+		}
+
+		if (desyncFrame >= 0)
+			status = "desync";
+		else if (!haveRef && !detail.size())
+		{
+			if (SaveMovieHashes(hashesName.c_str(), run))
+				status = "new";
+			else
+				detail = "couldn't write " + hashesName;
+		}
+	}
+	if (detail.size() && desyncFrame < 0)
+		status = "error";
+
+	char buf[128];
+	std::string line = VerifyCsvString(movie) + "," + status;
+	sprintf(buf, ",%d,%d,", currFrameCounter, checkpoints);
+	line += buf;
+	if (lastMatch >= 0)
+	{
+		sprintf(buf, "%d", lastMatch);
+		line += buf;
+	}
+	line += ',';
+	if (desyncFrame >= 0)
+	{
+		sprintf(buf, "%d,%s,%d", desyncFrame, VerifyCsvString(chunk).c_str(), differing);
+		line += buf;
+	} else
+		line += ",,";
+	line += "," + VerifyCsvString(detail) + "\n";
+	return line;
+}
+
+int FCEUI_VerifyMovies(const char *list, const char *report, int interval, int jobs)
+{
+	FILE *in = strcmp(list, "-") ? FCEUD_UTF8fopen(list, "r") : stdin;
+	FILE *out;
+	std::vector<std::string> roms, movies;
+	std::string text;
+	char buf[4096];
+
+	if (!in)
+		return -1;
+	while (fgets(buf, sizeof(buf), in))
+	{
+		text = buf;
+		while (text.size() && (text[text.size() - 1] == '\n' || text[text.size() - 1] == '\r'))
+			text.resize(text.size() - 1);
+		if (text.empty() || text[0] == '#')
+			continue;
+		size_t tab = text.find('\t');
+		roms.push_back(tab == std::string::npos ? std::string() : text.substr(0, tab));
+		movies.push_back(tab == std::string::npos ? text : text.substr(tab + 1));
+	}
+	if (in != stdin) fclose(in);
+
+	out = strcmp(report, "-") ? FCEUD_UTF8fopen(report, "w") : stdout;
+	if (!out)
+		return -1;
+	if (interval <= 0)
+		interval = 60;
+
+	int count = (int)movies.size(), failed = 0;
+	std::vector<std::string> results(count);
+
+	fprintf(out, "movie,status,frames,checkpoints,last matching frame,first differing frame,first differing chunk,differing chunks,detail\n");
+	fflush(out);
+
+#ifdef WIN32
+	//no fork(), the movies are played one after another in this process
+	(void)jobs;
+	for (int i = 0; i < count; i++)
+	{
+		if (roms[i].empty())
+			results[i] = VerifyCsvString(movies[i]) + ",error,,,,,,,\"no rom\"\n";
+		else
+		{
+			results[i] = VerifyMovie(roms[i], movies[i], interval);
+			FCEUI_StopMovie();
+			FCEUI_CloseGame();
+		}
+		fputs(results[i].c_str(), out);
+		fflush(out);
+	}
+#else
+	//the emulator is one global state, so every movie gets a process of its own
+	if (jobs <= 0)
+		jobs = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (jobs <= 0)
+		jobs = 1;
+
+	struct VERIFY_WORKER
+	{
+		pid_t pid;
+		int fd;
+		int index;
+	};
+	std::vector<VERIFY_WORKER> workers;
+	std::vector<bool> finished(count, false);
+	int next = 0, written = 0;
+
+	fflush(stdout);
+	fflush(stderr);
+	while (written < count)
+	{
+		while (next < count && (int)workers.size() < jobs)
+		{
+			int i = next++;
+			int fds[2];
+			pid_t pid = -1;
+
+			if (roms[i].empty())
+				results[i] = VerifyCsvString(movies[i]) + ",error,,,,,,,\"no rom\"\n";
+			else if (pipe(fds))
+				results[i] = VerifyCsvString(movies[i]) + ",error,,,,,,,\"couldn't start a worker\"\n";
+			else if ((pid = fork()) < 0)
+			{
+				close(fds[0]);
+				close(fds[1]);
+				results[i] = VerifyCsvString(movies[i]) + ",error,,,,,,,\"couldn't start a worker\"\n";
+			}
+			if (pid < 0)
+			{
+				finished[i] = true;
+				continue;
+			}
+			if (!pid)
+			{
+				//the core talks on stdout while loading, keep that out of the report
+				close(fds[0]);
+				if (!freopen("/dev/null", "w", stdout))
+					fclose(stdout);
+				std::string line = VerifyMovie(roms[i], movies[i], interval);
+				ssize_t w = write(fds[1], line.data(), line.size());
+				(void)w;
+				_exit(0);
+			}
+			close(fds[1]);
+			VERIFY_WORKER worker = { pid, fds[0], i };
+			workers.push_back(worker);
+		}
+
+		if (!workers.empty())
+		{
+			int status;
+			pid_t pid = waitpid(-1, &status, 0);
+			if (pid < 0)
+				break;
+			for (size_t w = 0; w < workers.size(); w++)
+			{
+				if (workers[w].pid != pid)
+					continue;
+
+				//the line fits in the pipe, the worker never blocks on it
+				int i = workers[w].index;
+				ssize_t got;
+				while ((got = read(workers[w].fd, buf, sizeof(buf))) > 0)
+					results[i].append(buf, got);
+				close(workers[w].fd);
+				if (results[i].empty())
+				{
+					sprintf(buf, ",error,,,,,,,\"worker %s %d\"\n", WIFSIGNALED(status) ? "killed by signal" : "exited with", WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+					results[i] = VerifyCsvString(movies[i]) + buf;
+				}
+				finished[i] = true;
+				workers.erase(workers.begin() + w);
+				break;
+			}
+		}
+
+		//the report keeps the order of the list
+		while (written < count && finished[written])
+		{
+			fputs(results[written++].c_str(), out);
+			fflush(out);
+		}
+	}
+#endif
+
+	for (int i = 0; i < count; i++)
+	{
+		size_t pos = VerifyCsvString(movies[i]).size() + 1;
+		if (results[i].compare(pos, 3, "ok,") && results[i].compare(pos, 4, "new,"))
+			failed++;
+	}
+	if (out != stdout) fclose(out);
+	return failed;
+}
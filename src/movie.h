@@ -164,6 +164,7 @@ public:
 
 	void parse(MovieData* md, EMUFILE* is);
 	bool parseBinary(MovieData* md, EMUFILE* is);
+	void parseBinary(MovieData* md, const uint8* data);
 	void dump(MovieData* md, EMUFILE* os, int index);
 	void dumpBinary(MovieData* md, EMUFILE* os, int index);
 	void parseJoy(EMUFILE* is, uint8& joystate);
@@ -210,7 +211,14 @@ public:
 	//whether microphone is enabled
 	bool microphone;
 
-	int getNumRecords() { return (int)records.size(); }
+	// input of a movie that is only being played back stays in the binary fm2 layout until something needs the records
+	std::vector<uint8> packedRecords;
+	int packedRecordSize;
+
+	int getNumRecords() { return packedRecords.empty() ? (int)records.size() : (int)(packedRecords.size() / packedRecordSize); }
+	void getRecord(int frame, MovieRecord& record);
+	void unpackRecords();
+	int getBinaryRecordSize();
 
 	int RAMInitOption, RAMInitSeed;
 
@@ -315,6 +323,7 @@ void FCEU_DisplaySubtitles(const char *format, ...);
 
 void poweron(bool shouldDisableBatteryLoading);
 bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader);
+bool LoadFM2(MovieData& movieData, EMUFILE* fp, int size, bool stopAfterHeader, bool keepPacked);
 
 
 #endif //__MOVIE_H_
@@ -28,6 +28,8 @@
 #include "cheat.h"
 #include "input.h"
 #include "driver.h"
+#include "vsuni.h"
+#include "movie.h"
 #include "utils/memory.h"
 
 #include <cstdio>
@@ -35,6 +37,8 @@
 #include <cstring>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <deque>
+#include <vector>
 //#include <unistd.h> //mbg merge 7/17/06 removed
 
 #include <zlib.h>
@@ -46,6 +50,66 @@ static int numlocal;
 static int netdivisor;
 static int netdcount;
 
+//Rollback netplay doesn't wait for the server every frame.  The frame runs right away with the
+//remote joypads predicted from the last ones the server sent, and a fast state of every frame's
+//start, taken before its input, goes into a ring.  When the server's joypads for a frame turn out
+//different, the emulator goes back to that frame and runs the frames since then again.
+#define NETPLAY_RBRING    32  //more than NETPLAY_ROLLBACK_MAX
+#define NETPLAY_RBMAXCMDS 8   //simple commands kept per frame, more are dropped
+
+typedef struct
+{
+	uint8 *state;      //fast state from the start of the frame
+	uint32 local;      //the local joypads sent for the frame, in FCEUD_SendData order
+	uint32 input;      //the joypads the frame was last run with
+	uint32 confirmed;  //the joypads the server sent for the frame
+	uint8 cmds[NETPLAY_RBMAXCMDS]; //simple commands the server sent before the frame
+	int numcmds;
+} NETPLAY_RBFRAME;
+
+typedef struct
+{
+	int maxahead;      //frames that may run before the server confirms them
+	uint32 frame;      //frames run since netplay started
+	uint32 confirmed;  //frames the server sent the joypads for
+	uint32 redo;       //first frame that ran with the wrong joypads, frame if there's none
+	uint32 replay;     //frame being run again, while replaying
+	bool replaying;
+	int slot[4];       //joypad of each local player, -1 until the server tells
+	uint8 cmds[NETPLAY_RBMAXCMDS]; //simple commands waiting for the next frame from the server
+	int numcmds;
+	uint32 rollbacks, redone, stalls;
+	NETPLAY_RBFRAME frames[NETPLAY_RBRING];
+} NETPLAY_ROLLBACK;
+
+static NETPLAY_ROLLBACK *rb; //NULL for lockstep netplay
+
+//netplay talks through these, the loopback test swaps them out
+static int (*NetSend)(void *data, uint32 len) = FCEUD_SendData;
+static int (*NetRecv)(void *data, uint32 len) = FCEUD_RecvData;
+static int (*NetPending)(void) = FCEUD_RecvDataPending;
+
+static NETPLAY_ROLLBACK *RollbackAlloc(int maxahead)
+{
+	NETPLAY_ROLLBACK *r = (NETPLAY_ROLLBACK *)FCEU_malloc(sizeof(NETPLAY_ROLLBACK));
+	uint32 size = FCEUSS_FastStateSize();
+
+	r->maxahead = maxahead < NETPLAY_ROLLBACK_MAX ? maxahead : NETPLAY_ROLLBACK_MAX;
+	for(int x = 0; x < NETPLAY_RBRING; x++)
+		r->frames[x].state = (uint8 *)FCEU_malloc(size);
+	for(int x = 0; x < 4; x++)
+		r->slot[x] = -1;
+	return(r);
+}
+
+static void RollbackFree(NETPLAY_ROLLBACK *r)
+{
+	if(!r) return;
+	for(int x = 0; x < NETPLAY_RBRING; x++)
+		FCEU_free(r->frames[x].state);
+	FCEU_free(r);
+}
+
 //NetError should only be called after a FCEUD_*Data function returned 0, in the function
 //that called FCEUD_*Data, to prevent it from being called twice.
 
@@ -60,13 +124,15 @@ void FCEUI_NetplayStop(void)
 	if(FCEUnetplay)
 	{
 		FCEUnetplay = 0;
+		RollbackFree(rb);
+		rb = 0;
 		FCEU_FlushGameCheats(0,1);  //Don't save netplay cheats.
 		FCEU_LoadGameCheats(0);    //Reload our original cheats.
 	}
 	else puts("Check your code!");
 }
 
-int FCEUI_NetplayStart(int nlocal, int divisor)
+int FCEUI_NetplayStart(int nlocal, int divisor, int rollback)
 {
 	FCEU_FlushGameCheats(0, 0);  //Save our pre-netplay cheats.
 	FCEU_LoadGameCheats(0);    // Load them again, for pre-multiplayer action.
@@ -76,6 +142,8 @@ int FCEUI_NetplayStart(int nlocal, int divisor)
 	numlocal = nlocal;
 	netdivisor = divisor;
 	netdcount = 0;
+	RollbackFree(rb);
+	rb = rollback > 0 ? RollbackAlloc(rollback) : 0;
 	return(1);
 }
 
@@ -89,7 +157,7 @@ int FCEUNET_SendCommand(uint8 cmd, uint32 len)
 	buf[0] = 0xFF;
 	FCEU_en32lsb(&buf[numlocal], len);
 	buf[numlocal + 4] = cmd;
-	if(!FCEUD_SendData(buf,numlocal + 1 + 4))
+	if(!NetSend(buf,numlocal + 1 + 4))
 	{
 		NetError();
 		return(0);
@@ -105,7 +173,7 @@ void FCEUI_NetplayText(uint8 *text)
 
 	if(!FCEUNET_SendCommand(FCEUNPCMD_TEXT,len)) return;
 
-	if(!FCEUD_SendData(text,len))
+	if(!NetSend(text,len))
 		NetError();
 }
 
@@ -139,7 +207,7 @@ int FCEUNET_SendFile(uint8 cmd, char *fn)
 		free(cbuf);
 		return(0);
 	}
-	if(!FCEUD_SendData(cbuf, len))
+	if(!NetSend(cbuf, len))
 	{
 		NetError();
 		free(cbuf);
@@ -150,6 +218,28 @@ int FCEUNET_SendFile(uint8 cmd, char *fn)
 	return(1);
 }
 
+static int RecvText(uint32 len)
+{
+	uint8 *tbuf;
+
+	if(len > 100000)  // Insanity check!
+	{
+		NetError();
+		return(0);
+	}
+	tbuf = (uint8*)malloc(len + 1); //mbg merge 7/17/06 added cast
+	tbuf[len] = 0;
+	if(!NetRecv(tbuf, len))
+	{
+		NetError();
+		free(tbuf);
+		return(0);
+	}
+	FCEUD_NetplayText(tbuf);
+	free(tbuf);
+	return(1);
+}
+
 static FILE *FetchFile(uint32 remlen)
 {
 	uint32 clen = remlen;
@@ -168,7 +258,7 @@ static FILE *FetchFile(uint32 remlen)
 	if((fp = tmpfile()))
 	{
 		cbuf = (char *)FCEU_dmalloc(clen); //mbg merge 7/17/06 added cast
-		if(!FCEUD_RecvData(cbuf, clen))
+		if(!NetRecv(cbuf, clen))
 		{
 			NetError();
 			fclose(fp);
@@ -195,18 +285,205 @@ static FILE *FetchFile(uint32 remlen)
 	return(0);
 }
 
+//The server's joypads from the newest frame it sent, with the local players' joypads of frame f.
+static uint32 RollbackPredict(uint32 f)
+{
+	uint32 input = rb->confirmed ? rb->frames[(rb->confirmed - 1) % NETPLAY_RBRING].confirmed : 0;
+	uint32 local = rb->frames[f % NETPLAY_RBRING].local;
+
+	for(int x = 0; x < numlocal; x++)
+	{
+		if(rb->slot[x] < 0) continue;
+		input &= ~(0xFFu << (rb->slot[x] * 8));
+		input |= ((local >> (x * 8)) & 0xFF) << (rb->slot[x] * 8);
+	}
+	return(input);
+}
+
+//The joypads frame f is about to run with.  Does the commands the server sent for it.
+static uint32 RollbackFrameInput(uint32 f)
+{
+	NETPLAY_RBFRAME *fr = &rb->frames[f % NETPLAY_RBRING];
+
+	if(f < rb->confirmed)
+	{
+		for(int x = 0; x < fr->numcmds; x++)
+			FCEU_DoSimpleCommand(fr->cmds[x]);
+		fr->input = fr->confirmed;
+	}
+	else
+		fr->input = RollbackPredict(f);
+	return(fr->input);
+}
+
+static void RollbackConfirm(uint32 input)
+{
+	uint32 f = rb->confirmed++;
+	NETPLAY_RBFRAME *fr = &rb->frames[f % NETPLAY_RBRING];
+
+	fr->confirmed = input;
+	memcpy(fr->cmds, rb->cmds, rb->numcmds);
+	fr->numcmds = rb->numcmds;
+	rb->numcmds = 0;
+
+	if(f < rb->frame && f < rb->redo && (fr->input != input || fr->numcmds))
+		rb->redo = f;
+}
+
+//Handles one message from the server.  Returns 0 when netplay was stopped.
+static int RollbackReceive(void)
+{
+	uint8 buf[5];
+
+	if(!NetRecv(buf,5))
+	{
+		NetError();
+		return(0);
+	}
+
+	switch(buf[4])
+	{
+	case 0: RollbackConfirm(FCEU_de32lsb(buf)); break;
+	case FCEUNPCMD_PLAYERS:
+		{
+			int n = 0;
+
+			for(int x = 0; x < 4; x++)
+				rb->slot[x] = -1;
+			for(int x = 0; x < 4; x++)
+				if(buf[x] && n < numlocal)
+					rb->slot[n++] = x;
+		}
+		break;
+	case FCEUNPCMD_TEXT: return(RecvText(FCEU_de32lsb(buf)));
+	case FCEUNPCMD_SAVESTATE: break; //not done for lockstep netplay either
+	case FCEUNPCMD_LOADCHEATS:
+		{
+			FILE *fp = FetchFile(FCEU_de32lsb(buf));
+			if(!fp) return(0);
+			FCEU_FlushGameCheats(0,1);
+			FCEU_LoadGameCheats(fp);
+		}
+		break;
+	default:
+		if(rb->numcmds < NETPLAY_RBMAXCMDS)
+			rb->cmds[rb->numcmds++] = buf[4];
+		break;
+	}
+	return(1);
+}
+
+//Goes back to the first frame that ran with the wrong joypads and runs it and the frames after it again.
+//They go through the same input path as the first time, NetplayUpdate() gives them the joypads.
+static void RollbackRedo(void)
+{
+	rb->rollbacks++;
+	rb->redone += rb->frame - rb->redo;
+
+	FCEUSS_LoadFast(rb->frames[rb->redo % NETPLAY_RBRING].state);
+	rb->replaying = true;
+	for(rb->replay = rb->redo; rb->replay < rb->frame; rb->replay++)
+	{
+		if(rb->replay != rb->redo)
+			FCEUSS_SaveFast(rb->frames[rb->replay % NETPLAY_RBRING].state);
+		FCEU_RunFrame(0);
+		FCEU_EndFrame();
+	}
+	rb->replaying = false;
+	rb->redo = rb->frame;
+}
+
+//Takes what the server sent so far, waiting for it when too far ahead, and fixes up the frames
+//that were mispredicted.  Returns 0 when netplay was stopped.
+static int RollbackPoll(void)
+{
+	bool stalled = false;
+
+	for(;;)
+	{
+		int pending = NetPending();
+
+		if(pending < 0)
+		{
+			NetError();
+			return(0);
+		}
+		if(pending < 5)
+		{
+			if(rb->frame - rb->confirmed < (uint32)rb->maxahead)
+				break;
+			if(!stalled)
+				rb->stalls++;
+			stalled = true;
+		}
+		if(!RollbackReceive())
+			return(0);
+	}
+
+	if(rb->redo < rb->frame)
+		RollbackRedo();
+	return(1);
+}
+
+//Called at the start of every frame, before its input.  Fixes up the mispredicted frames and
+//keeps the state the frame starts from.
+void NetplayFrameStart(void)
+{
+	if(!rb || !RollbackPoll())
+		return;
+	FCEUSS_SaveFast(rb->frames[rb->frame % NETPLAY_RBRING].state);
+}
+
+static void RollbackUpdate(uint8 *joyp)
+{
+	NETPLAY_RBFRAME *fr = &rb->frames[rb->frame % NETPLAY_RBRING];
+	uint8 joypb[4];
+	uint32 input;
+
+	//the local joypads of a frame run again were sent the first time
+	if(rb->replaying)
+	{
+		FCEU_en32lsb(joyp, RollbackFrameInput(rb->replay));
+		return;
+	}
+
+	memcpy(joypb,joyp,4);
+
+	/* 0xFF is used as a command escape, same as in lockstep. */
+	if(joypb[0] == 0xFF)
+		joypb[0] = 0xF;
+	if(!NetSend(joypb,numlocal))
+	{
+		NetError();
+		return;
+	}
+	fr->local = FCEU_de32lsb(joypb);
+
+	input = RollbackFrameInput(rb->frame);
+	rb->frame++;
+	rb->redo = rb->frame;
+
+	FCEU_en32lsb(joyp, input);
+}
+
 void NetplayUpdate(uint8 *joyp)
 {
 	static uint8 buf[5];  /* 4 play states, + command/extra byte */
 	static uint8 joypb[4];
 
+	if(rb)
+	{
+		RollbackUpdate(joyp);
+		return;
+	}
+
 	memcpy(joypb,joyp,4);
 
 	/* This shouldn't happen, but just in case.  0xFF is used as a command escape elsewhere. */
 	if(joypb[0] == 0xFF)
 		joypb[0] = 0xF;
 	if(!netdcount)
-		if(!FCEUD_SendData(joypb,numlocal))
+		if(!NetSend(joypb,numlocal))
 		{
 			NetError();
 			return;
@@ -216,7 +493,7 @@ void NetplayUpdate(uint8 *joyp)
 	{
 		do
 		{
-			if(!FCEUD_RecvData(buf,5))
+			if(!NetRecv(buf,5))
 			{
 				NetError();
 				return;
@@ -226,26 +503,8 @@ void NetplayUpdate(uint8 *joyp)
 			{
 			default: FCEU_DoSimpleCommand(buf[4]);break;
 			case FCEUNPCMD_TEXT:
-				{
-					uint8 *tbuf;
-					uint32 len = FCEU_de32lsb(buf);
-
-					if(len > 100000)  // Insanity check!
-					{
-						NetError();
-						return;
-					}
-					tbuf = (uint8*)malloc(len + 1); //mbg merge 7/17/06 added cast
-					tbuf[len] = 0;
-					if(!FCEUD_RecvData(tbuf, len))
-					{
-						NetError();
-						free(tbuf);
-						return;
-					}
-					FCEUD_NetplayText(tbuf);
-					free(tbuf);
-				}
+				if(!RecvText(FCEU_de32lsb(buf)))
+					return;
 				break;
 			case FCEUNPCMD_SAVESTATE:
 				{
@@ -324,3 +583,279 @@ void NetplayUpdate(uint8 *joyp)
 		*(uint32 *)joyp=*(uint32 *)netjoy;
 	}
 }
+
+
+//Loopback test of rollback netplay.  Two players, each with its own emulator kept in a fast state,
+//talk to a server in rollback mode over links that take delay to delay+jitter frames.  Every
+//player runs its frames through FCEUI_Emulate() with a joypad that changes now and then, and
+//player 1 resets the game halfway.  Once all of the frames have been confirmed, both emulators have to be the same as one
+//that ran the frames with the joypads the server relayed, without any prediction.
+
+struct LOOPBACK_MSG
+{
+	uint32 arrival;
+	std::vector<uint8> data;
+};
+
+struct LOOPBACK_PLAYER
+{
+	NETPLAY_ROLLBACK *rb;
+	uint8 *state;
+	uint8 pad;
+	std::deque<LOOPBACK_MSG> up, down;  //in flight to the server and from it
+	uint32 upArrival, downArrival;      //of the last message on the link, it doesn't reorder
+	std::deque<uint8> inbox;            //arrived from the server
+	std::deque<uint8> joypads;          //arrived at the server, not relayed yet
+};
+
+static LOOPBACK_PLAYER *loopPlayer; //the player whose emulator is loaded
+static uint32 loopPads;             //what the gamepads read while the test runs
+static uint32 loopNow, loopSeed;
+static int loopDelay, loopJitter;
+static bool loopFailed;
+
+static uint32 LoopbackRand(void)
+{
+	loopSeed = loopSeed * 1103515245 + 12345;
+	return(loopSeed >> 16);
+}
+
+static void LoopbackPost(std::deque<LOOPBACK_MSG> &link, uint32 &last, const uint8 *data, uint32 len)
+{
+	LOOPBACK_MSG msg;
+
+	msg.arrival = loopNow + loopDelay + (loopJitter ? LoopbackRand() % (loopJitter + 1) : 0);
+	if(msg.arrival < last)
+		msg.arrival = last;
+	last = msg.arrival;
+	msg.data.assign(data, data + len);
+	link.push_back(msg);
+}
+
+static int LoopbackSend(void *data, uint32 len)
+{
+	LoopbackPost(loopPlayer->up, loopPlayer->upArrival, (uint8 *)data, len);
+	return(1);
+}
+
+static int LoopbackRecv(void *data, uint32 len)
+{
+	//nothing else runs while the player waits, so it would wait forever
+	if(loopPlayer->inbox.size() < len)
+	{
+		loopFailed = true;
+		return(0);
+	}
+	std::copy(loopPlayer->inbox.begin(), loopPlayer->inbox.begin() + len, (uint8 *)data);
+	loopPlayer->inbox.erase(loopPlayer->inbox.begin(), loopPlayer->inbox.begin() + len);
+	return(1);
+}
+
+static int LoopbackPending(void)
+{
+	return((int)loopPlayer->inbox.size());
+}
+
+static void LoopbackBroadcast(LOOPBACK_PLAYER *players, const uint8 *buf, std::vector<uint8> &relayed)
+{
+	relayed.insert(relayed.end(), buf, buf + 5);
+	for(int p = 0; p < 2; p++)
+		LoopbackPost(players[p].down, players[p].downArrival, buf, 5);
+}
+
+//What fceux-server does in rollback mode, with one local player per client.
+static void LoopbackServer(LOOPBACK_PLAYER *players, std::vector<uint8> &relayed)
+{
+	for(int p = 0; p < 2; p++)
+	{
+		LOOPBACK_PLAYER *pl = &players[p];
+
+		while(!pl->up.empty() && pl->up.front().arrival <= loopNow)
+		{
+			std::vector<uint8> &msg = pl->up.front().data;
+
+			if(msg[0] == 0xFF)
+			{
+				uint8 buf[5] = { 0, 0, 0, 0, msg[1 + 4] };
+				LoopbackBroadcast(players, buf, relayed);
+			}
+			else
+				pl->joypads.push_back(msg[0]);
+			pl->up.pop_front();
+
+			while(!players[0].joypads.empty() && !players[1].joypads.empty())
+			{
+				uint8 buf[5] = { players[0].joypads.front(), players[1].joypads.front(), 0, 0, 0 };
+				players[0].joypads.pop_front();
+				players[1].joypads.pop_front();
+				LoopbackBroadcast(players, buf, relayed);
+			}
+		}
+	}
+	for(int p = 0; p < 2; p++)
+	{
+		LOOPBACK_PLAYER *pl = &players[p];
+
+		while(!pl->down.empty() && pl->down.front().arrival <= loopNow)
+		{
+			pl->inbox.insert(pl->inbox.end(), pl->down.front().data.begin(), pl->down.front().data.end());
+			pl->down.pop_front();
+		}
+	}
+}
+
+static void LoopbackSwitch(LOOPBACK_PLAYER *pl)
+{
+	FCEUSS_LoadFast(pl->state);
+	rb = pl->rb;
+	loopPlayer = pl;
+}
+
+static void LoopbackEmulate(uint32 pads)
+{
+	uint8 *gfx;
+	int32 *sound, ssize;
+
+	loopPads = pads;
+	FCEUI_Emulate(&gfx, &sound, &ssize, 0);
+}
+
+//Runs the next frame of a player, unless it would have to wait for the server.
+static bool LoopbackFrame(LOOPBACK_PLAYER *pl, int p, int frames)
+{
+	uint32 known = pl->rb->confirmed;
+
+	for(size_t x = 4; x < pl->inbox.size(); x += 5)
+		if(!pl->inbox[x])
+			known++;
+	if(pl->rb->frame - known >= (uint32)pl->rb->maxahead)
+		return(false);
+
+	LoopbackSwitch(pl);
+	if(LoopbackRand() % 8 == 0)
+		pl->pad = LoopbackRand();
+	if(p == 0 && pl->rb->frame == (uint32)frames / 2)
+		FCEUNET_SendCommand(FCEUNPCMD_RESET, 0);
+
+	LoopbackEmulate(pl->pad);
+	FCEUSS_SaveFast(pl->state);
+	return(true);
+}
+
+int FCEUI_NetplayLoopbackTest(int frames, int delay, int jitter, int rollback)
+{
+	LOOPBACK_PLAYER players[2];
+	std::vector<uint8> relayed;
+	uint32 size, stalls[2] = { 0, 0 };
+	uint8 *start, *expected;
+	int savedlocal = numlocal, paused;
+	JOYPORT savedports[2] = { joyports[0], joyports[1] };
+	bool match[2];
+
+	//the frames would go into the movie
+	if(!GameInfo || FCEUnetplay || FCEUMOV_Mode(MOVIEMODE_PLAY|MOVIEMODE_RECORD|MOVIEMODE_TASEDITOR))
+		return(0);
+	if(frames <= 0 || delay < 0 || jitter < 0 || rollback <= 0)
+		return(0);
+
+	size = FCEUSS_FastStateSize();
+	start = (uint8 *)FCEU_malloc(size);
+	expected = (uint8 *)FCEU_malloc(size);
+	FCEUSS_SaveFast(start);
+
+	NetSend = LoopbackSend;
+	NetRecv = LoopbackRecv;
+	NetPending = LoopbackPending;
+	FCEUI_SetInput(0, SI_GAMEPAD, &loopPads, 0);
+	FCEUI_SetInput(1, SI_GAMEPAD, &loopPads, 0);
+	paused = FCEUI_EmulationPaused();
+	FCEUI_SetEmulationPaused(0);
+	FCEUnetplay = 1;
+	numlocal = 1;
+	loopNow = 0;
+	loopSeed = 1;
+	loopDelay = delay;
+	loopJitter = jitter;
+	loopFailed = false;
+
+	for(int p = 0; p < 2; p++)
+	{
+		uint8 buf[5] = { 0, 0, 0, 0, FCEUNPCMD_PLAYERS };
+
+		players[p].rb = RollbackAlloc(rollback);
+		players[p].state = (uint8 *)FCEU_malloc(size);
+		memcpy(players[p].state, start, size);
+		players[p].pad = 0;
+		players[p].upArrival = players[p].downArrival = 0;
+		buf[p] = 1;
+		LoopbackPost(players[p].down, players[p].downArrival, buf, 5);
+	}
+
+	//one frame of time per tick.  the players sometimes skip a tick, so one gets ahead of the other
+	for(uint32 limit = (frames + 1) * (2 * (delay + jitter) + 2) + 100; loopNow < limit && !loopFailed; loopNow++)
+	{
+		bool done = true;
+
+		LoopbackServer(players, relayed);
+		for(int p = 0; p < 2 && !loopFailed; p++)
+		{
+			if(players[p].rb->frame >= (uint32)frames)
+				continue;
+			done = false;
+			if(jitter && LoopbackRand() % 16 == 0)
+				continue;
+			if(!LoopbackFrame(&players[p], p, frames))
+				stalls[p]++;
+		}
+		if(done && players[0].up.empty() && players[1].up.empty() && players[0].down.empty() && players[1].down.empty())
+			break;
+	}
+
+	//take the rest of what the server sent
+	for(int p = 0; p < 2 && !loopFailed; p++)
+	{
+		LoopbackSwitch(&players[p]);
+		RollbackPoll();
+		FCEUSS_SaveFast(players[p].state);
+	}
+
+	//the same frames with the relayed joypads only
+	FCEUnetplay = 0;
+	rb = 0;
+	FCEUSS_LoadFast(start);
+	for(size_t x = 0; x < relayed.size(); x += 5)
+	{
+		if(relayed[x + 4])
+			FCEU_DoSimpleCommand(relayed[x + 4]);
+		else
+			LoopbackEmulate(FCEU_de32lsb(&relayed[x]));
+	}
+	FCEUSS_SaveFast(expected);
+
+	FCEU_printf("Netplay loopback: %d frames, %d+%d frames delay, %d frames rollback\n", frames, delay, jitter, rollback);
+	for(int p = 0; p < 2; p++)
+	{
+		NETPLAY_ROLLBACK *r = players[p].rb;
+
+		match[p] = !loopFailed && r->confirmed == (uint32)frames && !memcmp(players[p].state, expected, size);
+		FCEU_printf(" Player %d: %u frames confirmed, %u rollbacks, %u frames run again, %u stalls: %s\n",
+			p + 1, r->confirmed, r->rollbacks, r->redone, stalls[p], match[p] ? "state matches" : "DESYNC");
+		RollbackFree(r);
+		FCEU_free(players[p].state);
+	}
+
+	FCEUSS_LoadFast(start);
+	FCEU_free(start);
+	FCEU_free(expected);
+	rb = 0;
+	loopPlayer = 0;
+	numlocal = savedlocal;
+	FCEUI_SetEmulationPaused(paused);
+	for(int x = 0; x < 2; x++)
+		FCEUI_SetInput(x, savedports[x].type, savedports[x].ptr, savedports[x].attrib);
+	NetSend = FCEUD_SendData;
+	NetRecv = FCEUD_RecvData;
+	NetPending = FCEUD_RecvDataPending;
+
+	return(match[0] && match[1]);
+}
@@ -1,5 +1,6 @@
 int InitNetplay(void);
 void NetplayUpdate(uint8 *joyp);
+void NetplayFrameStart(void);
 extern int FCEUnetplay;
 
 
@@ -13,6 +14,8 @@ extern int FCEUnetplay;
 //#define FCEUNPCMD_FDSEJECT	0x19
 #define FCEUNPCMD_FDSSELECT	0x1A
 
+#define FCEUNPCMD_PLAYERS       0x40 /* Sent from server to client in rollback mode, buf[n] != 0 for its players. */
+
 #define FCEUNPCMD_LOADSTATE     0x80
 
 #define FCEUNPCMD_SAVESTATE     0x81 /* Sent from server to client. */
@@ -581,12 +581,45 @@ void FCEU_SoundCPUHook(int cycles)
  }
 }
 
-void RDoPCM(void)
+/* The output of a channel only changes when its wave length counter runs out,
+   so the high quality renderers below work through whole runs of cycles between
+   those points.  Instead of adding their output to WaveHi for every cpu cycle,
+   they put the change of a channel's output at the start of a run in WaveHiStep.
+   FlushEmulateSound() adds the changes up and adds the running total to WaveHi
+   right before it is used, which gives the same sum as filling every cycle. */
+static uint32 WaveHiStep[40000];
+static uint32 WaveHiLevel[5];  /* output of each channel at ChannelBC */
+static uint32 WaveHiTotal;     /* sum of the outputs at soundtsoffs */
+
+/* Channel x outputs value for count cycles from V. */
+static INLINE void WaveHiSet(int x, uint32 V, int32 count, int32 value)
 {
- uint32 V; //mbg merge 7/17/06 made uint32
+ if(count<=0 || (uint32)value==WaveHiLevel[x])
+  return;
+ WaveHiStep[V]+=(uint32)value-WaveHiLevel[x];
+ WaveHiLevel[x]=value;
+}
+
+static void WaveHiReset(void)
+{
+ memset(WaveHiStep,0,sizeof(WaveHiStep));
+ memset(WaveHiLevel,0,sizeof(WaveHiLevel));
+ WaveHiTotal=0;
+}
+
+/* Number of cycles, at most left, until a wave length counter that is
+   decremented every cycle reaches 0. A counter that is already 0 or below
+   won't get there again, same as with the cycle by cycle code. */
+static INLINE uint32 WaveRunLength(int32 counter, uint32 left)
+{
+ if(counter>0 && (uint32)counter<left)
+  return counter;
+ return left;
+}
 
- for(V=ChannelBC[4];V<SOUNDTS;V++)
-  WaveHi[V]+=(((RawDALatch<<16)/256) * FSettings.PCMVolume)&(~0xFFFF); // TODO get rid of floating calculations to binary. set log volume scaling.
+void RDoPCM(void)
+{
+ WaveHiSet(4,ChannelBC[4],SOUNDTS-ChannelBC[4],(((RawDALatch<<16)/256) * FSettings.PCMVolume)&(~0xFFFF)); // TODO get rid of floating calculations to binary. set log volume scaling.
  ChannelBC[4]=SOUNDTS;
 }
 
@@ -596,17 +629,17 @@ static INLINE void RDoSQ(int x)		//Int x decides if this is Square Wave 1 or 2
    int32 V;
    int32 amp, ampx;
    int32 rthresh;
-   int32 *D;
+   uint32 P;
    int32 currdc;
    int32 cf;
    int32 rc;
 
    if(curfreq[x]<8 || curfreq[x]>0x7ff)
-    goto endit;
+    goto silent;
    if(!CheckFreq(curfreq[x],PSG[(x<<2)|0x1]))
-    goto endit;
+    goto silent;
    if(!lengthcount[x])
-    goto endit;
+    goto silent;
 
    if(EnvUnits[x].Mode&0x1)
     amp=EnvUnits[x].Speed;
@@ -622,7 +655,7 @@ static INLINE void RDoSQ(int x)		//Int x decides if this is Square Wave 1 or 2
 
    rthresh=RectDuties[(PSG[(x<<2)]&0xC0)>>6];
 
-   D=&WaveHi[ChannelBC[x]];
+   P=ChannelBC[x];
    V=SOUNDTS-ChannelBC[x];
 
    currdc=RectDutyCount[x];
@@ -631,20 +664,25 @@ static INLINE void RDoSQ(int x)		//Int x decides if this is Square Wave 1 or 2
 
    while(V>0)
    {
-    if(currdc<rthresh)
-     *D+=amp;
-    rc--;
+    int32 run=WaveRunLength(rc,V);
+
+    WaveHiSet(x,P,run,currdc<rthresh ? amp : 0);
+    rc-=run;
     if(!rc)
     {
      rc=cf;
      currdc=(currdc+1)&7;
     }
-    V--;
-    D++;
+    V-=run;
+    P+=run;
    }
 
    RectDutyCount[x]=currdc;
    wlcount[x]=rc;
+   goto endit;
+
+   silent:
+   WaveHiSet(x,ChannelBC[x],SOUNDTS-ChannelBC[x],0);
 
    endit:
    ChannelBC[x]=SOUNDTS;
@@ -778,15 +816,17 @@ static void RDoTriangle(void)
    start++;
   }*/
   int32 cout = (tcout/256*FSettings.TriangleVolume)&(~0xFFFF);
-  for(V=ChannelBC[2];V<SOUNDTS;V++)
-   WaveHi[V]+=cout;
+  WaveHiSet(2,ChannelBC[2],SOUNDTS-ChannelBC[2],cout);
  }
  else
-  for(V=ChannelBC[2];V<SOUNDTS;V++)
+  for(V=ChannelBC[2];V<SOUNDTS;)
   {
+    uint32 run=WaveRunLength(wlcount[2],SOUNDTS-V);
+
     //Modify volume based on channel volume modifiers
-	WaveHi[V]+=(tcout/256*FSettings.TriangleVolume)&(~0xFFFF);  // TODO OPTIMIZE ME!
-    wlcount[2]--;
+    WaveHiSet(2,V,run,(tcout/256*FSettings.TriangleVolume)&(~0xFFFF));
+    V+=run;
+    wlcount[2]-=run;
     if(!wlcount[2])
     {
      wlcount[2]=(PSG[0xa]|((PSG[0xb]&7)<<8))+1;
@@ -971,10 +1011,13 @@ static void RDoNoise(void)
  }
 
  if(PSG[0xE]&0x80)  // "short" noise
-  for(V=ChannelBC[3];V<SOUNDTS;V++)
+  for(V=ChannelBC[3];V<SOUNDTS;)
   {
-   WaveHi[V]+=outo;
-   wlcount[3]--;
+   uint32 run=WaveRunLength(wlcount[3],SOUNDTS-V);
+
+   WaveHiSet(3,V,run,outo);
+   V+=run;
+   wlcount[3]-=run;
    if(!wlcount[3])
    {
     uint8 feedback;
@@ -989,10 +1032,13 @@ static void RDoNoise(void)
    }
   }
  else
-  for(V=ChannelBC[3];V<SOUNDTS;V++)
+  for(V=ChannelBC[3];V<SOUNDTS;)
   {
-   WaveHi[V]+=outo;
-   wlcount[3]--;
+   uint32 run=WaveRunLength(wlcount[3],SOUNDTS-V);
+
+   WaveHiSet(3,V,run,outo);
+   V+=run;
+   wlcount[3]-=run;
    if(!wlcount[3])
    {
     uint8 feedback;
@@ -1056,15 +1102,22 @@ int FlushEmulateSound(void)
   if(FSettings.soundq>=1)
   {
    int32 *tmpo=&WaveHi[soundtsoffs];
+   uint32 *step=&WaveHiStep[soundtsoffs];
 
    if(GameExpSound.HiFill) GameExpSound.HiFill();
 
    for(x=soundtimestamp;x;x--)
    {
-    uint32 b=*tmpo;
+    uint32 b;
+
+    WaveHiTotal+=*step;
+    *step++=0;
+    b=*tmpo+WaveHiTotal;
     *tmpo=(b&65535)+wlookup2[(b>>16)&255]+wlookup1[b>>24];
     tmpo++;
    }
+   /* only differs when a frame ran without flushing the sound */
+   WaveHiTotal=WaveHiLevel[0]+WaveHiLevel[1]+WaveHiLevel[2]+WaveHiLevel[3]+WaveHiLevel[4];
    end=NeoFilterSound(WaveHi,WaveFinal,SOUNDTS,&left);
 
    memmove(WaveHi,WaveHi+SOUNDTS-left,left*sizeof(uint32));
@@ -1203,6 +1256,7 @@ void FCEUSND_Power(void)
 
 	memset(Wave,0,sizeof(Wave));
         memset(WaveHi,0,sizeof(WaveHi));
+	WaveHiReset();
 	memset(&EnvUnits,0,sizeof(EnvUnits));
 
         for(x=0;x<5;x++)
@@ -1265,6 +1319,7 @@ void SetSoundVariables(void)
   nesincsize=(int64)(((int64)1<<17)*(double)(PAL?PAL_CPU:NTSC_CPU)/(FSettings.SndRate * 16));
   memset(sqacc,0,sizeof(sqacc));
   memset(ChannelBC,0,sizeof(ChannelBC));
+  WaveHiReset();
 
   LoadDMCPeriod(DMCFormat&0xF);  // For changing from PAL to NTSC
 
@@ -54,6 +54,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <cctype>
 //#include <unistd.h> //mbg merge 7/17/06 removed
 
 #include <vector>
@@ -92,6 +93,20 @@ std::vector<uint8> compressed_buf;
 static SFORMAT SFMDATA[SFMDATA_SIZE];
 static int SFEXINDEX;
 
+//flattened list of everything a fast state holds, rebuilt when the mapper's ex state changes
+struct FASTSTATE_ENTRY
+{
+	void *v;
+	uint32 size;
+	bool indirect;
+	bool movie;	//only restored while a movie is active, same as chunk 6 of a regular savestate
+	const char *chunk;
+	const char *desc;
+};
+static std::vector<FASTSTATE_ENTRY> fastStateLayout;
+static uint32 fastStateSize = 0;
+static bool fastStateDirty = true;
+
 #define RLSB 		FCEUSTATE_RLSB	//0x80000000
 
 
@@ -710,6 +725,227 @@ bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params)
 }
 
 
+static void AddFastStateEntries(SFORMAT *sf, const char *chunk, bool movie)
+{
+	while(sf->v)
+	{
+		if(sf->s==~0)		//Link to another struct
+		{
+			AddFastStateEntries((SFORMAT *)sf->v, chunk, movie);
+			sf++;
+			continue;
+		}
+		FASTSTATE_ENTRY entry;
+		entry.v = sf->v;
+		entry.size = sf->s&(~FCEUSTATE_FLAGS);
+		entry.indirect = (sf->s&FCEUSTATE_INDIRECT) != 0;
+		entry.movie = movie;
+		entry.chunk = chunk;
+		entry.desc = sf->desc;
+		if(entry.size)
+		{
+			fastStateLayout.push_back(entry);
+			fastStateSize += entry.size;
+		}
+		sf++;
+	}
+}
+
+static void BuildFastStateLayout()
+{
+	if(!fastStateDirty)
+		return;
+
+	fastStateLayout.clear();
+	fastStateSize = 0;
+	AddFastStateEntries(SFCPU, "CPU", false);
+	AddFastStateEntries(SFCPUC, "CPUC", false);
+	AddFastStateEntries(FCEUPPU_STATEINFO, "PPU", false);
+	AddFastStateEntries(FCEU_NEWPPU_STATEINFO, "NPPU", false);
+	AddFastStateEntries(FCEUCTRL_STATEINFO, "CTRL", false);
+	AddFastStateEntries(FCEUSND_STATEINFO, "SND", false);
+	AddFastStateEntries(FCEUMOV_STATEINFO, "MOV", true);
+	//SFMDATA isn't cleared by ResetExState, so only walk the entries that are actually in use
+	for(int x=0;x<SFEXINDEX;x++)
+	{
+		SFORMAT sf[2] = { SFMDATA[x], { 0 } };
+		AddFastStateEntries(sf, "EXT", false);
+	}
+	fastStateDirty = false;
+}
+
+uint32 FCEUSS_FastStateSize()
+{
+	BuildFastStateLayout();
+	return fastStateSize;
+}
+
+void FCEUSS_SaveFast(uint8* buf)
+{
+	BuildFastStateLayout();
+
+	FCEUPPU_SaveState();
+	FCEUSND_SaveState();
+	if(SPreSave) SPreSave();
+	for(size_t i=0;i<fastStateLayout.size();i++)
+	{
+		const FASTSTATE_ENTRY& entry = fastStateLayout[i];
+		memcpy(buf, entry.indirect ? *(uint8 **)entry.v : entry.v, entry.size);
+		buf += entry.size;
+	}
+	if(SPostSave) SPostSave();
+}
+
+void FCEUSS_LoadFast(const uint8* buf)
+{
+	BuildFastStateLayout();
+
+	bool movie = FCEUMOV_Mode(MOVIEMODE_PLAY|MOVIEMODE_RECORD|MOVIEMODE_FINISHED);
+	for(size_t i=0;i<fastStateLayout.size();i++)
+	{
+		const FASTSTATE_ENTRY& entry = fastStateLayout[i];
+		if(!entry.movie || movie)
+			memcpy(entry.indirect ? *(uint8 **)entry.v : entry.v, buf, entry.size);
+		buf += entry.size;
+	}
+
+	//the sound chunk is always there, see ReadStateChunks
+	extern int resetDMCacc;
+	resetDMCacc=0;
+
+	if(GameStateRestore)
+		GameStateRestore(FCEU_VERSION_NUMERIC);
+	FCEUPPU_LoadState(FCEU_VERSION_NUMERIC);
+	FCEUSND_LoadState(FCEU_VERSION_NUMERIC);
+}
+
+void FCEUSS_FastStateNames(std::vector<std::string>& names)
+{
+	BuildFastStateLayout();
+
+	names.clear();
+	for(size_t i=0;i<fastStateLayout.size();i++)
+	{
+		const FASTSTATE_ENTRY& entry = fastStateLayout[i];
+		if(entry.movie)
+			continue;
+		//descriptions are up to 4 chars and not always terminated
+		std::string name = entry.chunk;
+		name += '.';
+		for(int j=0;j<4 && entry.desc && entry.desc[j];j++)
+			name += isalnum((uint8)entry.desc[j]) ? entry.desc[j] : '_';
+		names.push_back(name);
+	}
+}
+
+void FCEUSS_HashFastState(std::vector<uint32>& hashes)
+{
+	static std::vector<uint8> buf;
+
+	buf.resize(FCEUSS_FastStateSize());
+	FCEUSS_SaveFast(&buf[0]);
+
+	hashes.clear();
+	const uint8* p = &buf[0];
+	for(size_t i=0;i<fastStateLayout.size();i++)
+	{
+		const FASTSTATE_ENTRY& entry = fastStateLayout[i];
+		if(!entry.movie)
+			hashes.push_back(crc32(0, p, entry.size));
+		p += entry.size;
+	}
+}
+
+static uint8* WriteDeltaLength(uint8* out, uint32 len)
+{
+	while(len >= 0x80)
+	{
+		*out++ = (len & 0x7F) | 0x80;
+		len >>= 7;
+	}
+	*out++ = len;
+	return out;
+}
+
+static const uint8* ReadDeltaLength(const uint8* in, uint32* len)
+{
+	int shift = 0;
+	*len = 0;
+	while(*in & 0x80)
+	{
+		*len |= (*in++ & 0x7F) << shift;
+		shift += 7;
+	}
+	*len |= *in++ << shift;
+	return in;
+}
+
+uint32 FCEUSS_DeltaMaxSize(uint32 size)
+{
+	//a delta is never bigger than the state plus the first pair of run lengths
+	return size + 16;
+}
+
+uint32 FCEUSS_FastDeltaMaxSize()
+{
+	return FCEUSS_DeltaMaxSize(FCEUSS_FastStateSize());
+}
+
+uint32 FCEUSS_EncodeFastDelta(const uint8* base, const uint8* cur, uint8* delta)
+{
+	return FCEUSS_EncodeDelta(base, cur, FCEUSS_FastStateSize(), delta);
+}
+
+uint32 FCEUSS_EncodeDelta(const uint8* base, const uint8* cur, uint32 size, uint8* delta)
+{
+	//the delta is a list of (unchanged run, changed run, changed bytes xor base) triplets.
+	//changed runs swallow gaps of less than 4 unchanged bytes, those would cost more to skip than to store
+	uint8* out = delta;
+	uint32 pos = 0;
+
+	while(pos < size)
+	{
+		uint32 start = pos;
+		while(pos < size && base[pos] == cur[pos])
+			pos++;
+		if(pos == size)
+			break;
+		uint32 same = pos - start;
+
+		start = pos;
+		uint32 gap = 0;
+		while(pos < size && gap < 4)
+		{
+			if(base[pos] == cur[pos])
+				gap++;
+			else
+				gap = 0;
+			pos++;
+		}
+		pos -= gap;
+
+		out = WriteDeltaLength(out, same);
+		out = WriteDeltaLength(out, pos - start);
+		for(uint32 i=start;i<pos;i++)
+			*out++ = base[i] ^ cur[i];
+	}
+	return out - delta;
+}
+
+void FCEUSS_ApplyFastDelta(uint8* state, const uint8* delta, uint32 deltaLen)
+{
+	const uint8* end = delta + deltaLen;
+	while(delta < end)
+	{
+		uint32 same, changed;
+		delta = ReadDeltaLength(delta, &same);
+		delta = ReadDeltaLength(delta, &changed);
+		state += same;
+		for(uint32 i=0;i<changed;i++)
+			*state++ ^= *delta++;
+	}
+}
+
 bool FCEUSS_Load(const char *fname, bool display_message)
 {
 	EMUFILE* st;
@@ -856,6 +1092,7 @@ void ResetExState(void (*PreSave)(void), void (*PostSave)(void))
 	SPreSave = PreSave;
 	SPostSave = PostSave;
 	SFEXINDEX=0;
+	fastStateDirty = true;
 }
 
 void AddExState(void *v, uint32 s, int type, const char *desc)
@@ -908,6 +1145,7 @@ void AddExState(void *v, uint32 s, int type, const char *desc)
 		}
 	}
 	SFMDATA[SFEXINDEX].v=0;		// End marker.
+	fastStateDirty = true;
 }
 
 void FCEUI_SelectStateNext(int n)
@@ -18,6 +18,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <string>
+#include <vector>
+
 enum ENUM_SSLOADPARAMS
 {
 	SSLOADPARAM_NOBACKUP,
@@ -32,6 +35,29 @@ bool FCEUSS_SaveMS(EMUFILE* outstream, int compressionLevel);
 
 bool FCEUSS_LoadFP(EMUFILE* is, ENUM_SSLOADPARAMS params);
 
+//fast states: every registered SFORMAT entry copied into a flat buffer in a fixed order, without
+//chunk headers, the screen buffer or compression. meant for per-frame use (rollback, greenzone);
+//a fast state is only valid for the loaded game in the running emulator and is never written to disk
+uint32 FCEUSS_FastStateSize();
+void FCEUSS_SaveFast(uint8* buf);
+void FCEUSS_LoadFast(const uint8* buf);
+
+//xor delta between two fast states. applying a delta to either of its states gives back the other one
+uint32 FCEUSS_FastDeltaMaxSize();
+uint32 FCEUSS_EncodeFastDelta(const uint8* base, const uint8* cur, uint8* delta);
+void FCEUSS_ApplyFastDelta(uint8* state, const uint8* delta, uint32 deltaLen);
+
+//a crc32 of every fast state entry except the movie ones, for comparing the emulation against an
+//earlier run. the names are "chunk.desc" (e.g. "CPU.RAM", "SND.FHCN", "EXT.CREG") in the same order
+void FCEUSS_FastStateNames(std::vector<std::string>& names);
+void FCEUSS_HashFastState(std::vector<uint32>& hashes);
+
+//same encoding for any two buffers of equal size, e.g. uncompressed FCEUSS_SaveMS savestates,
+//applied with FCEUSS_ApplyFastDelta as well.
+//the delta buffer must have room for FCEUSS_DeltaMaxSize(size) bytes
+uint32 FCEUSS_DeltaMaxSize(uint32 size);
+uint32 FCEUSS_EncodeDelta(const uint8* base, const uint8* cur, uint32 size, uint8* delta);
+
 extern int CurrentState;
 void FCEUSS_CheckStates(void);
 
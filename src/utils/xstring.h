@@ -69,7 +69,7 @@ std::string readNullTerminatedAscii(EMUFILE* is);
 //extracts a decimal uint from an istream
 template<typename T> T templateIntegerDecFromIstream(EMUFILE* is)
 {
-	unsigned int ret = 0;
+	T ret = 0;
 	bool pre = true;
 
 	for(;;)
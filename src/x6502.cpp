@@ -47,33 +47,49 @@ void (*MapIRQHook)(int a);
 //normal memory read
 static INLINE uint8 RdMem(unsigned int A)
 {
+ uint8 *p = AReadDirect[A >> 8];
+ if(p)
+  return(_DB=p[A]);
  return(_DB=ARead[A](A));
 }
 
 //normal memory write
-static INLINE void WrMem(unsigned int A, uint8 V)
+template<bool hooked>
+static INLINE void WrMemT(unsigned int A, uint8 V)
 {
 	BWrite[A](A,V);
 	#ifdef _S9XLUA_H
-	CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
+	if(hooked)
+		CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
 	#endif
 }
 
 static INLINE uint8 RdRAM(unsigned int A)
 {
   //bbit edited: this was changed so cheat substituion would work
+  //(cheated addresses never get a direct page, see UpdateReadDirect)
+  uint8 *p = AReadDirect[A >> 8];
+  if(p)
+   return(_DB=p[A]);
   return(_DB=ARead[A](A));
   // return(_DB=RAM[A]);
 }
 
-static INLINE void WrRAM(unsigned int A, uint8 V)
+template<bool hooked>
+static INLINE void WrRAMT(unsigned int A, uint8 V)
 {
 	RAM[A]=V;
 	#ifdef _S9XLUA_H
-	CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
+	if(hooked)
+		CallRegisteredLuaMemHook(A, 1, V, LUAMEMHOOK_WRITE);
 	#endif
 }
 
+//the opcode macros below (and ops.inc) are only expanded inside X6502_RunLoop,
+//so the writes pick up that loop's template argument
+#define WrMem(A,V) WrMemT<hooked>(A,V)
+#define WrRAM(A,V) WrRAMT<hooked>(A,V)
+
 uint8 X6502_DMR(uint32 A)
 {
  ADDCYC(1);
@@ -421,15 +437,26 @@ void X6502_Power(void)
  StackAddrBackup = -1;
 }
 
-void X6502_Run(int32 cycles)
+//true if anything needs to see individual instructions or writes:
+//breakpoints, stepping, the code/data logger, the trace logger or lua memory hooks
+static bool X6502_HooksActive(void)
 {
-  if(PAL)
-   cycles*=15;    // 15*4=60
-  else
-   cycles*=16;    // 16*4=64
+ #ifdef FCEUDEF_DEBUGGER
+ if(DebugCycleActive())
+  return true;
+ #endif
+ #ifdef _S9XLUA_H
+ if(FCEU_LuaCPUHooksActive())
+  return true;
+ #endif
+ return false;
+}
 
-  _count+=cycles;
-extern int test; test++;
+//the hooked and the plain loop are the same code; with hooked=false the
+//debugger and lua calls are compiled out so nothing is left but the emulation
+template<bool hooked>
+static void X6502_RunLoop(void)
+{
   while(_count>0)
   {
    int32 temp;
@@ -489,8 +516,11 @@ extern int test; test++;
               //major speed hit.
    }
 
+   if(hooked)
+   {
 	//will probably cause a major speed decrease on low-end systems
-   DEBUG( DebugCycle() );
+	DEBUG( DebugCycle() );
+   }
 
    IncrementInstructionsCounters();
 
@@ -506,7 +536,8 @@ extern int test; test++;
    if (!overclocking)
     FCEU_SoundCPUHook(temp);
    #ifdef _S9XLUA_H
-   CallRegisteredLuaMemHook(_PC, 1, 0, LUAMEMHOOK_EXEC);
+   if(hooked)
+    CallRegisteredLuaMemHook(_PC, 1, 0, LUAMEMHOOK_EXEC);
    #endif
    _PC++;
    switch(b1)
@@ -516,6 +547,23 @@ extern int test; test++;
   }
 }
 
+void X6502_Run(int32 cycles)
+{
+  if(PAL)
+   cycles*=15;    // 15*4=60
+  else
+   cycles*=16;    // 16*4=64
+
+  _count+=cycles;
+extern int test; test++;
+  //hooks can only be set up between runs (the gui has to take the emulator
+  //lock first), so checking once per call is enough
+  if(X6502_HooksActive())
+   X6502_RunLoop<true>();
+  else
+   X6502_RunLoop<false>();
+}
+
 //--------------------------
 //---Called from debuggers
 void FCEUI_NMI(void)
@@ -0,0 +1,342 @@
+/////////////////////////////////////////////////////////////////
+// traceDecode.cpp
+//
+// Converts binary trace logs written by the FCEUX Trace Logger
+//  ("Binary Format" option) to the same text layout as the
+//  text logs. The log is memory mapped and only the requested
+//  range of records is touched, so very long traces can be
+//  browsed a slice at a time.
+//
+/////////////////////////////////////////////////////////////////
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../src/drivers/Qt/TraceLogFormat.h"
+
+enum addrMode
+{
+	ERR, IMP, IMM, ZP, ZPX, ZPY, ABS, ABX, ABY, IND, IZX, IZY, REL, JMP
+};
+
+struct opInfo
+{
+	const char *name;
+	int mode;
+};
+
+static const opInfo opTable[256] =
+{
+	{"BRK",IMP}, {"ORA",IZX}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"ORA",ZP}, {"ASL",ZP}, {"???",ERR}, {"PHP",IMP}, {"ORA",IMM}, {"ASL",IMP}, {"???",ERR}, {"???",ERR}, {"ORA",ABS}, {"ASL",ABS}, {"???",ERR}, // 00
+	{"BPL",REL}, {"ORA",IZY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"ORA",ZPX}, {"ASL",ZPX}, {"???",ERR}, {"CLC",IMP}, {"ORA",ABY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"ORA",ABX}, {"ASL",ABX}, {"???",ERR}, // 10
+	{"JSR",JMP}, {"AND",IZX}, {"???",ERR}, {"???",ERR}, {"BIT",ZP}, {"AND",ZP}, {"ROL",ZP}, {"???",ERR}, {"PLP",IMP}, {"AND",IMM}, {"ROL",IMP}, {"???",ERR}, {"BIT",ABS}, {"AND",ABS}, {"ROL",ABS}, {"???",ERR}, // 20
+	{"BMI",REL}, {"AND",IZY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"AND",ZPX}, {"ROL",ZPX}, {"???",ERR}, {"SEC",IMP}, {"AND",ABY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"AND",ABX}, {"ROL",ABX}, {"???",ERR}, // 30
+	{"RTI",IMP}, {"EOR",IZX}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"EOR",ZP}, {"LSR",ZP}, {"???",ERR}, {"PHA",IMP}, {"EOR",IMM}, {"LSR",IMP}, {"???",ERR}, {"JMP",JMP}, {"EOR",ABS}, {"LSR",ABS}, {"???",ERR}, // 40
+	{"BVC",REL}, {"EOR",IZY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"EOR",ZPX}, {"LSR",ZPX}, {"???",ERR}, {"CLI",IMP}, {"EOR",ABY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"EOR",ABX}, {"LSR",ABX}, {"???",ERR}, // 50
+	{"RTS",IMP}, {"ADC",IZX}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"ADC",ZP}, {"ROR",ZP}, {"???",ERR}, {"PLA",IMP}, {"ADC",IMM}, {"ROR",IMP}, {"???",ERR}, {"JMP",IND}, {"ADC",ABS}, {"ROR",ABS}, {"???",ERR}, // 60
+	{"BVS",REL}, {"ADC",IZY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"ADC",ZPX}, {"ROR",ZPX}, {"???",ERR}, {"SEI",IMP}, {"ADC",ABY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"ADC",ABX}, {"ROR",ABX}, {"???",ERR}, // 70
+	{"???",ERR}, {"STA",IZX}, {"???",ERR}, {"???",ERR}, {"STY",ZP}, {"STA",ZP}, {"STX",ZP}, {"???",ERR}, {"DEY",IMP}, {"???",ERR}, {"TXA",IMP}, {"???",ERR}, {"STY",ABS}, {"STA",ABS}, {"STX",ABS}, {"???",ERR}, // 80
+	{"BCC",REL}, {"STA",IZY}, {"???",ERR}, {"???",ERR}, {"STY",ZPX}, {"STA",ZPX}, {"STX",ZPY}, {"???",ERR}, {"TYA",IMP}, {"STA",ABY}, {"TXS",IMP}, {"???",ERR}, {"???",ERR}, {"STA",ABX}, {"???",ERR}, {"???",ERR}, // 90
+	{"LDY",IMM}, {"LDA",IZX}, {"LDX",IMM}, {"???",ERR}, {"LDY",ZP}, {"LDA",ZP}, {"LDX",ZP}, {"???",ERR}, {"TAY",IMP}, {"LDA",IMM}, {"TAX",IMP}, {"???",ERR}, {"LDY",ABS}, {"LDA",ABS}, {"LDX",ABS}, {"???",ERR}, // A0
+	{"BCS",REL}, {"LDA",IZY}, {"???",ERR}, {"???",ERR}, {"LDY",ZPX}, {"LDA",ZPX}, {"LDX",ZPY}, {"???",ERR}, {"CLV",IMP}, {"LDA",ABY}, {"TSX",IMP}, {"???",ERR}, {"LDY",ABX}, {"LDA",ABX}, {"LDX",ABY}, {"???",ERR}, // B0
+	{"CPY",IMM}, {"CMP",IZX}, {"???",ERR}, {"???",ERR}, {"CPY",ZP}, {"CMP",ZP}, {"DEC",ZP}, {"???",ERR}, {"INY",IMP}, {"CMP",IMM}, {"DEX",IMP}, {"???",ERR}, {"CPY",ABS}, {"CMP",ABS}, {"DEC",ABS}, {"???",ERR}, // C0
+	{"BNE",REL}, {"CMP",IZY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"CMP",ZPX}, {"DEC",ZPX}, {"???",ERR}, {"CLD",IMP}, {"CMP",ABY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"CMP",ABX}, {"DEC",ABX}, {"???",ERR}, // D0
+	{"CPX",IMM}, {"SBC",IZX}, {"???",ERR}, {"???",ERR}, {"CPX",ZP}, {"SBC",ZP}, {"INC",ZP}, {"???",ERR}, {"INX",IMP}, {"SBC",IMM}, {"NOP",IMP}, {"???",ERR}, {"CPX",ABS}, {"SBC",ABS}, {"INC",ABS}, {"???",ERR}, // E0
+	{"BEQ",REL}, {"SBC",IZY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"SBC",ZPX}, {"INC",ZPX}, {"???",ERR}, {"SED",IMP}, {"SBC",ABY}, {"???",ERR}, {"???",ERR}, {"???",ERR}, {"SBC",ABX}, {"INC",ABX}, {"???",ERR}, // F0
+};
+
+static bool showFrames = false;
+static bool showCycles = false;
+static bool showInstrs = false;
+static bool showBank   = false;
+static bool stackTabs  = false;
+
+//----------------------------------------------------
+static void disassemble( const traceLogBinRecord_t &rec, char *str )
+{
+	const opInfo &op = opTable[ rec.opCode[0] ];
+	unsigned int addr = rec.PC + rec.opSize;
+	unsigned int abs  = rec.opCode[1] | (rec.opCode[2] << 8);
+
+	switch ( op.mode )
+	{
+		case IMP: sprintf( str, "%s", op.name ); break;
+		case IMM: sprintf( str, "%s #$%02X", op.name, rec.opCode[1] ); break;
+		case ZP:  sprintf( str, "%s $%02X", op.name, rec.opCode[1] ); break;
+		case ZPX: sprintf( str, "%s $%02X,X @ $%04X", op.name, rec.opCode[1], (rec.opCode[1] + rec.X) & 0xFF ); break;
+		case ZPY: sprintf( str, "%s $%02X,Y @ $%04X", op.name, rec.opCode[1], (rec.opCode[1] + rec.Y) & 0xFF ); break;
+		case ABS: sprintf( str, "%s $%04X", op.name, abs ); break;
+		case ABX: sprintf( str, "%s $%04X,X @ $%04X", op.name, abs, (abs + rec.X) & 0xFFFF ); break;
+		case ABY: sprintf( str, "%s $%04X,Y @ $%04X", op.name, abs, (abs + rec.Y) & 0xFFFF ); break;
+		case IND: sprintf( str, "%s ($%04X)", op.name, abs ); break;
+		case IZX: sprintf( str, "%s ($%02X,X)", op.name, rec.opCode[1] ); break;
+		case IZY: sprintf( str, "%s ($%02X),Y", op.name, rec.opCode[1] ); break;
+		case REL: sprintf( str, "%s $%04X", op.name, (addr + (int8_t)rec.opCode[1]) & 0xFFFF ); break;
+		case JMP: sprintf( str, "%s $%04X", op.name, abs ); break;
+		default:  strcpy( str, "ERROR" ); break;
+	}
+}
+//----------------------------------------------------
+static void printRecord( FILE *out, const traceLogBinRecord_t &rec )
+{
+	char line[256], asmTxt[128];
+	int i = 0, j;
+
+	if ( rec.skippedLines > 0 )
+	{
+		i += sprintf( &line[i], "(%u lines skipped) ", rec.skippedLines );
+	}
+	if ( showFrames )
+	{
+		i += sprintf( &line[i], "f%-6u ", rec.frameCount );
+	}
+	if ( showCycles )
+	{
+		i += sprintf( &line[i], "c%-11llu ", (unsigned long long)rec.cycleCount );
+	}
+	if ( showInstrs )
+	{
+		i += sprintf( &line[i], "i%-11llu ", (unsigned long long)rec.instrCount );
+	}
+
+	int tmp = rec.P ^ 0xFF;
+	i += sprintf( &line[i], "A:%02X X:%02X Y:%02X S:%02X P:%c%c%c%c%c%c%c%c ",
+			rec.A, rec.X, rec.Y, rec.S,
+			'N' | (tmp & 0x80) >> 2,
+			'V' | (tmp & 0x40) >> 1,
+			'U' | (tmp & 0x20),
+			'B' | (tmp & 0x10) << 1,
+			'D' | (tmp & 0x08) << 2,
+			'I' | (tmp & 0x04) << 3,
+			'Z' | (tmp & 0x02) << 4,
+			'C' | (tmp & 0x01) << 5 );
+
+	if ( stackTabs )
+	{
+		int spaces = (0xFF - rec.S) & 31;
+
+		while ( spaces > 0 )
+		{
+			line[i++] = ' '; spaces--;
+		}
+	}
+	else
+	{
+		line[i++] = ' ';
+	}
+
+	if ( showBank && (rec.PC >= 0x8000) )
+	{
+		i += sprintf( &line[i], "$%02X:%04X: ", rec.bank, rec.PC );
+	}
+	else if ( showBank )
+	{
+		i += sprintf( &line[i], "  $%04X: ", rec.PC );
+	}
+	else
+	{
+		i += sprintf( &line[i], "$%04X: ", rec.PC );
+	}
+
+	for (j = 0; j < 3; j++)
+	{
+		if ( j < rec.opSize )
+		{
+			i += sprintf( &line[i], "%02X ", rec.opCode[j] );
+		}
+		else
+		{
+			i += sprintf( &line[i], "   " );
+		}
+	}
+
+	if ( rec.flags & TRACE_LOG_BIN_OVERFLOW )
+	{
+		strcpy( asmTxt, "OVERFLOW" );
+	}
+	else if ( (rec.flags & TRACE_LOG_BIN_UNDEFINED) || (rec.opSize == 0) )
+	{
+		strcpy( asmTxt, "UNDEFINED" );
+	}
+	else
+	{
+		disassemble( rec, asmTxt );
+	}
+	fprintf( out, "%.*s%s\n", i, line, asmTxt );
+}
+//----------------------------------------------------
+static void usage( const char *prog )
+{
+	fprintf( stderr, "Usage: %s [-f] [-c] [-i] [-b] [-t] [-s first] [-n count] [-o output] tracefile\n", prog );
+	fprintf( stderr, "  -f        print the frame count\n" );
+	fprintf( stderr, "  -c        print the cycle count\n" );
+	fprintf( stderr, "  -i        print the instruction count\n" );
+	fprintf( stderr, "  -b        print the bank number of ROM addresses\n" );
+	fprintf( stderr, "  -t        indent the lines according to the stack pointer\n" );
+	fprintf( stderr, "  -s first  start at record number first\n" );
+	fprintf( stderr, "  -n count  decode at most count records\n" );
+	fprintf( stderr, "  -o file   write to file instead of the standard output\n" );
+}
+//----------------------------------------------------
+int main( int argc, char *argv[] )
+{
+	const char *inPath = NULL, *outPath = NULL;
+	unsigned long long first = 0, count = ~0ULL;
+	const unsigned char *data;
+	size_t size;
+	FILE *out = stdout;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *arg = argv[i];
+
+		if ( (arg[0] != '-') || (arg[1] == 0) )
+		{
+			inPath = arg; continue;
+		}
+		switch ( arg[1] )
+		{
+			case 'f': showFrames = true; break;
+			case 'c': showCycles = true; break;
+			case 'i': showInstrs = true; break;
+			case 'b': showBank   = true; break;
+			case 't': stackTabs  = true; break;
+			case 's':
+			case 'n':
+			case 'o':
+				if ( i+1 >= argc )
+				{
+					usage( argv[0] ); return 1;
+				}
+				if ( arg[1] == 's' )
+				{
+					first = strtoull( argv[++i], NULL, 0 );
+				}
+				else if ( arg[1] == 'n' )
+				{
+					count = strtoull( argv[++i], NULL, 0 );
+				}
+				else
+				{
+					outPath = argv[++i];
+				}
+			break;
+			default:
+				usage( argv[0] ); return 1;
+		}
+	}
+
+	if ( inPath == NULL )
+	{
+		usage( argv[0] ); return 1;
+	}
+
+#ifdef WIN32
+	HANDLE file = CreateFileA( inPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL );
+
+	if ( file == INVALID_HANDLE_VALUE )
+	{
+		fprintf( stderr, "Error: Failed to open %s\n", inPath ); return 1;
+	}
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx( file, &fileSize );
+	size = (size_t)fileSize.QuadPart;
+
+	HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+
+	data = mapping ? (const unsigned char *)MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : NULL;
+#else
+	int fd = open( inPath, O_RDONLY );
+
+	if ( fd == -1 )
+	{
+		fprintf( stderr, "Error: Failed to open %s\n", inPath ); return 1;
+	}
+	struct stat st;
+
+	if ( fstat( fd, &st ) != 0 )
+	{
+		fprintf( stderr, "Error: Failed to read %s\n", inPath ); return 1;
+	}
+	size = st.st_size;
+
+	data = NULL;
+
+	if ( size > 0 )
+	{
+		void *map = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+
+		if ( map != MAP_FAILED )
+		{
+			data = (const unsigned char *)map;
+			madvise( map, size, MADV_SEQUENTIAL );
+		}
+	}
+#endif
+	if ( data == NULL )
+	{
+		fprintf( stderr, "Error: Failed to map %s\n", inPath ); return 1;
+	}
+
+	traceLogFileHeader_t hdr;
+
+	if ( size < sizeof(hdr) )
+	{
+		fprintf( stderr, "Error: %s is not a binary trace log\n", inPath ); return 1;
+	}
+	memcpy( &hdr, data, sizeof(hdr) );
+
+	if ( memcmp( hdr.magic, TRACE_LOG_BIN_MAGIC, sizeof(hdr.magic) ) != 0 )
+	{
+		fprintf( stderr, "Error: %s is not a binary trace log\n", inPath ); return 1;
+	}
+	if ( hdr.byteOrder != TRACE_LOG_BIN_BYTE_ORDER )
+	{
+		fprintf( stderr, "Error: %s was written on a machine of different byte order\n", inPath ); return 1;
+	}
+	if ( (hdr.version != TRACE_LOG_BIN_VERSION) || (hdr.recordSize != sizeof(traceLogBinRecord_t)) )
+	{
+		fprintf( stderr, "Error: %s uses an unsupported version %u of the format\n", inPath, hdr.version ); return 1;
+	}
+
+	unsigned long long numRecs = (size - sizeof(hdr)) / sizeof(traceLogBinRecord_t);
+
+	if ( outPath )
+	{
+		out = fopen( outPath, "w" );
+
+		if ( out == NULL )
+		{
+			fprintf( stderr, "Error: Failed to open %s for writing\n", outPath ); return 1;
+		}
+	}
+
+	const unsigned char *recs = data + sizeof(hdr);
+
+	for (unsigned long long n = first; (n < numRecs) && (n - first < count); n++)
+	{
+		traceLogBinRecord_t rec;
+
+		// the mapping is only guaranteed to be byte aligned past the header
+		memcpy( &rec, recs + n * sizeof(traceLogBinRecord_t), sizeof(rec) );
+
+		printRecord( out, rec );
+	}
+
+	if ( out != stdout )
+	{
+		fclose( out );
+	}
+	return 0;
+}
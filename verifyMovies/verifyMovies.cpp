@@ -0,0 +1,84 @@
+// verifyMovies - plays back movies on a headless emulator and checks the
+// emulation against the state hashes kept next to each movie.
+//
+// It runs without a driver, so it needs no display, and the report goes to
+// a file of its own. FCEUI_VerifyMovies does the work.
+//
+// Build with "make", run "./verifyMovies [options] list report".
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/types.h"
+#include "../src/driver.h"
+
+static uint32 padState = 0;
+
+static void usage(void)
+{
+	printf("usage: verifyMovies [-i interval] [-j jobs] list report\n");
+	printf("  -i interval  hash the state every interval frames for a new movie.hashes (default 60)\n");
+	printf("  -j jobs      movies played at a time, 0 for one per CPU core (default 0)\n");
+	printf("  list         one rom<tab>movie pair a line, - for stdin\n");
+	printf("  report       the CSV to write, - for stdout\n");
+}
+
+int main(int argc, char *argv[])
+{
+	const char *files[2] = { NULL, NULL };
+	int interval = 60, jobs = 0, numFiles = 0, failed;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "-i") && (i + 1 < argc))
+		{
+			interval = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "-j") && (i + 1 < argc))
+		{
+			jobs = atoi(argv[++i]);
+		}
+		else if ((argv[i][0] == '-') && argv[i][1])
+		{
+			usage();
+			return 2;
+		}
+		else if (numFiles < 2)
+		{
+			files[numFiles++] = argv[i];
+		}
+		else
+		{
+			usage();
+			return 2;
+		}
+	}
+	if (numFiles != 2)
+	{
+		usage();
+		return 2;
+	}
+
+	if (!FCEUI_Initialize())
+	{
+		fprintf(stderr, "Failed to initialize the emulator\n");
+		return 2;
+	}
+	FCEUI_SetBaseDirectory(".");
+
+	// movies set their own ports when they are loaded
+	FCEUI_SetInput(0, SI_GAMEPAD, &padState, 0);
+	FCEUI_SetInput(1, SI_GAMEPAD, &padState, 0);
+
+	failed = FCEUI_VerifyMovies(files[0], files[1], interval, jobs);
+
+	FCEUI_Kill();
+
+	if (failed < 0)
+	{
+		fprintf(stderr, "Couldn't open %s or %s\n", files[0], files[1]);
+		return 2;
+	}
+	return failed ? 1 : 0;
+}